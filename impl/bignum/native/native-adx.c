@@ -0,0 +1,150 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* This file is compiled with BMI2 and ADX enabled.  Nothing in it may be called
+ * unless the processor has been checked for support, which is done in native.c.
+ */
+#include "internal.h"
+#include "util.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "native.h"
+
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__BMI2__) && \
+	defined(__ADX__) && defined(FEATURE_128_BIT_INTEGERS)
+#define FEATURE_ADX
+#endif
+
+HIDE()
+#ifdef FEATURE_ADX
+/* mulx leaves the flags alone, so the low halves of the products are added in
+ * with adox and the result with adcx, which keeps two independent carry chains.
+ * Nothing in the loops may touch the flags, hence lea and jrcxz.  The main loop
+ * does four limbs at a time and the second the rest.
+ */
+static uint64_t addmul_1(uint64_t *r, const uint64_t *a, size_t n,
+		uint64_t b)
+{
+	uint64_t hi = 0, lo, next, rest = n % 4;
+
+	n /= 4;
+	__asm__(
+		"xorl %k[lo], %k[lo]\n\t"
+		"1:\n\t"
+		"jrcxz 2f\n\t"
+		"mulx (%[a]), %[lo], %[next]\n\t"
+		"adox %[hi], %[lo]\n\t"
+		"adcx (%[r]), %[lo]\n\t"
+		"movq %[lo], (%[r])\n\t"
+		"mulx 8(%[a]), %[lo], %[hi]\n\t"
+		"adox %[next], %[lo]\n\t"
+		"adcx 8(%[r]), %[lo]\n\t"
+		"movq %[lo], 8(%[r])\n\t"
+		"mulx 16(%[a]), %[lo], %[next]\n\t"
+		"adox %[hi], %[lo]\n\t"
+		"adcx 16(%[r]), %[lo]\n\t"
+		"movq %[lo], 16(%[r])\n\t"
+		"mulx 24(%[a]), %[lo], %[hi]\n\t"
+		"adox %[next], %[lo]\n\t"
+		"adcx 24(%[r]), %[lo]\n\t"
+		"movq %[lo], 24(%[r])\n\t"
+		"leaq 32(%[a]), %[a]\n\t"
+		"leaq 32(%[r]), %[r]\n\t"
+		"leaq -1(%[n]), %[n]\n\t"
+		"jmp 1b\n\t"
+		"2:\n\t"
+		"movq %[rest], %[n]\n\t"
+		"3:\n\t"
+		"jrcxz 4f\n\t"
+		"mulx (%[a]), %[lo], %[next]\n\t"
+		"adox %[hi], %[lo]\n\t"
+		"adcx (%[r]), %[lo]\n\t"
+		"movq %[lo], (%[r])\n\t"
+		"movq %[next], %[hi]\n\t"
+		"leaq 8(%[a]), %[a]\n\t"
+		"leaq 8(%[r]), %[r]\n\t"
+		"leaq -1(%[n]), %[n]\n\t"
+		"jmp 3b\n\t"
+		"4:\n\t"
+		"movl $0, %k[lo]\n\t"
+		"adox %[lo], %[hi]\n\t"
+		"adcx %[lo], %[hi]\n\t"
+		: [hi] "+&r" (hi), [lo] "=&r" (lo), [next] "=&r" (next),
+		  [a] "+&r" (a), [r] "+&r" (r), [n] "+&c" (n)
+		: [rest] "r" (rest), "d" (b)
+		: "cc", "memory");
+	return hi;
+}
+
+static void mul(uint64_t *r, const uint64_t *a, size_t an, const uint64_t *b,
+		size_t bn)
+{
+	memset(r, 0, bn * sizeof(*r));
+	for (size_t i = 0; i < an; i++)
+		r[i+bn] = addmul_1(r+i, b, bn, a[i]);
+}
+
+/* The products of distinct limbs are summed once and doubled, and then the
+ * squares of each limb are added in.
+ */
+static void sqr(uint64_t *r, const uint64_t *a, size_t n)
+{
+	uint64_t carry = 0;
+
+	memset(r, 0, 2 * n * sizeof(*r));
+	for (size_t i = 0; i + 1 < n; i++)
+		r[i+n] = addmul_1(r+2*i+1, a+i+1, n-i-1, a[i]);
+	for (size_t i = 0; i < 2 * n; i++) {
+		const uint64_t t = r[i];
+		r[i] = (t << 1) | carry;
+		carry = t >> 63;
+	}
+	carry = 0;
+	for (size_t i = 0; i < n; i++) {
+		const uint128_t sq = (uint128_t)a[i] * a[i];
+		const uint128_t lo = (uint128_t)r[2*i] + (uint64_t)sq + carry;
+		const uint128_t hi = (uint128_t)r[2*i+1] +
+			(uint64_t)(sq >> 64) + (uint64_t)(lo >> 64);
+		r[2*i] = lo;
+		r[2*i+1] = hi;
+		carry = hi >> 64;
+	}
+}
+
+static const struct native_kernels kernels = {
+	.addmul_1 = addmul_1,
+	.mul = mul,
+	.sqr = sqr
+};
+#endif
+
+const struct native_kernels *native_kernels_adx(void)
+{
+#ifdef FEATURE_ADX
+	return &kernels;
+#else
+	return NULL;
+#endif
+}
+UNHIDE()
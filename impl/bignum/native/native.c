@@ -0,0 +1,1804 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* A bignum implementation with no external dependencies.  Every number has
+ * room for NATIVE_BITS bits, so nothing is allocated except the numbers
+ * themselves and Montgomery contexts, and all temporaries live on the stack.
+ * Operations whose result does not fit fail with -DREW_ERR_INVALID.
+ *
+ * Multiplication is schoolbook below KARATSUBA_THRESHOLD limbs and Karatsuba
+ * above it.  Modular exponentiation with an odd modulus uses Montgomery
+ * multiplication and a fixed window, scanning the whole table for each window
+ * and multiplying in every one, so that its timing depends only on the sizes
+ * of its arguments.  Exponentiation with an even modulus, two-base
+ * exponentiation, inversion, and gcd are not constant time; they are meant for
+ * public values.
+ */
+#include "internal.h"
+#include "util.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define FEATURE_CPUID
+#endif
+
+#include <drew/bignum.h>
+#include <drew/plugin.h>
+
+#include "native.h"
+
+#define NATIVE_BITS 8192
+#define NLIMBS (NATIVE_BITS / 64)
+#define KARATSUBA_THRESHOLD 48
+#define EXP_WINDOW 4
+#define EXP_TABLE (1 << EXP_WINDOW)
+
+HIDE()
+struct bignum {
+	size_t n;
+	bool neg;
+	uint64_t d[NLIMBS];
+};
+
+struct drew_bignum_mont_s {
+	size_t n;
+	uint64_t minv;
+	uint64_t m[NLIMBS];
+	uint64_t rr[NLIMBS];
+	uint64_t one[NLIMBS];
+};
+
+#define BN(x) ((struct bignum *)((x)->ctx))
+
+static int bn_info(int op, void *p);
+static int bn_info2(const drew_bignum_t *, int, drew_param_t *,
+		const drew_param_t *);
+static int bn_init(drew_bignum_t *, int, const drew_loader_t *,
+		const drew_param_t *);
+static int bn_clone(drew_bignum_t *, const drew_bignum_t *, int);
+static int bn_fini(drew_bignum_t *, int);
+static int bn_nbits(const drew_bignum_t *);
+static int bn_nbytes(const drew_bignum_t *);
+static int bn_bytes(const drew_bignum_t *, uint8_t *, size_t);
+static int bn_setbytes(drew_bignum_t *, const uint8_t *, size_t);
+static int bn_setzero(drew_bignum_t *);
+static int bn_setsmall(drew_bignum_t *, long);
+static int bn_negate(drew_bignum_t *, const drew_bignum_t *);
+static int bn_abs(drew_bignum_t *, const drew_bignum_t *);
+static int bn_compare(const drew_bignum_t *, const drew_bignum_t *, int);
+static int bn_comparesmall(const drew_bignum_t *, long);
+static int bn_bitwiseor(drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *);
+static int bn_bitwiseand(drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *);
+static int bn_bitwisexor(drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *);
+static int bn_bitwisenot(drew_bignum_t *, const drew_bignum_t *);
+static int bn_getbit(const drew_bignum_t *, size_t);
+static int bn_setbit(drew_bignum_t *, size_t, bool);
+static int bn_add(drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *);
+static int bn_sub(drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *);
+static int bn_mul(drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *);
+static int bn_div(drew_bignum_t *, drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *);
+static int bn_mulpow2(drew_bignum_t *, const drew_bignum_t *, size_t);
+static int bn_divpow2(drew_bignum_t *, drew_bignum_t *, const drew_bignum_t *,
+		size_t);
+static int bn_shiftleft(drew_bignum_t *, const drew_bignum_t *, size_t);
+static int bn_shiftright(drew_bignum_t *, const drew_bignum_t *, size_t);
+static int bn_square(drew_bignum_t *, const drew_bignum_t *);
+static int bn_mod(drew_bignum_t *, const drew_bignum_t *, const drew_bignum_t *);
+static int bn_expsmall(drew_bignum_t *, const drew_bignum_t *, unsigned long);
+static int bn_expmod(drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *, const drew_bignum_t *);
+static int bn_squaremod(drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *);
+static int bn_addmod(drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *, const drew_bignum_t *);
+static int bn_mulmod(drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *, const drew_bignum_t *);
+static int bn_invmod(drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *);
+static int bn_gcd(drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *);
+static int bn_test(void *, const drew_loader_t *);
+static int bn_expmod2(drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *, const drew_bignum_t *);
+static int bn_montinit(drew_bignum_mont_t **, const drew_bignum_t *);
+static int bn_montfini(drew_bignum_mont_t *);
+static int bn_montset(const drew_bignum_mont_t *, drew_bignum_t *,
+		const drew_bignum_t *);
+static int bn_montget(const drew_bignum_mont_t *, drew_bignum_t *,
+		const drew_bignum_t *);
+static int bn_montmul(const drew_bignum_mont_t *, drew_bignum_t *,
+		const drew_bignum_t *, const drew_bignum_t *);
+static int bn_montsquare(const drew_bignum_mont_t *, drew_bignum_t *,
+		const drew_bignum_t *);
+static int bn_montexp(const drew_bignum_mont_t *, drew_bignum_t *,
+		const drew_bignum_t *, const drew_bignum_t *);
+static int bn_montexp2(const drew_bignum_mont_t *, drew_bignum_t *,
+		const drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *, const drew_bignum_t *);
+
+
+static const drew_bignum_functbl_t bn_functbl = {
+	.info = bn_info,
+	.info2 = bn_info2,
+	.init = bn_init,
+	.clone = bn_clone,
+	.fini = bn_fini,
+	.nbits = bn_nbits,
+	.nbytes = bn_nbytes,
+	.bytes = bn_bytes,
+	.setbytes = bn_setbytes,
+	.setzero = bn_setzero,
+	.setsmall = bn_setsmall,
+	.negate = bn_negate,
+	.abs = bn_abs,
+	.compare = bn_compare,
+	.comparesmall = bn_comparesmall,
+	.bitwiseor = bn_bitwiseor,
+	.bitwiseand = bn_bitwiseand,
+	.bitwisexor = bn_bitwisexor,
+	.bitwisenot = bn_bitwisenot,
+	.getbit = bn_getbit,
+	.setbit = bn_setbit,
+	.add = bn_add,
+	.sub = bn_sub,
+	.mul = bn_mul,
+	.div = bn_div,
+	.mulpow2 = bn_mulpow2,
+	.divpow2 = bn_divpow2,
+	.shiftleft = bn_shiftleft,
+	.shiftright = bn_shiftright,
+	.square = bn_square,
+	.mod = bn_mod,
+	.expsmall = bn_expsmall,
+	.squaremod = bn_squaremod,
+	.addmod = bn_addmod,
+	.mulmod = bn_mulmod,
+	.expmod = bn_expmod,
+	.invmod = bn_invmod,
+	.gcd = bn_gcd,
+	.test = bn_test,
+	.expmod2 = bn_expmod2,
+	.montinit = bn_montinit,
+	.montfini = bn_montfini,
+	.montset = bn_montset,
+	.montget = bn_montget,
+	.montmul = bn_montmul,
+	.montsquare = bn_montsquare,
+	.montexp = bn_montexp,
+	.montexp2 = bn_montexp2
+};
+
+static inline void mul64(uint64_t *hi, uint64_t *lo, uint64_t a, uint64_t b)
+{
+#if defined(FEATURE_128_BIT_INTEGERS)
+	uint128_t t = (uint128_t)a * b;
+	*hi = t >> 64;
+	*lo = t;
+#else
+	const uint64_t al = a & 0xffffffff, ah = a >> 32;
+	const uint64_t bl = b & 0xffffffff, bh = b >> 32;
+	const uint64_t ll = al * bl, lh = al * bh, hl = ah * bl, hh = ah * bh;
+	const uint64_t mid = (ll >> 32) + (lh & 0xffffffff) + (hl & 0xffffffff);
+	*lo = (mid << 32) | (ll & 0xffffffff);
+	*hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+#endif
+}
+
+// Divides hi:lo by d, which must be greater than hi.
+static inline uint64_t div128(uint64_t hi, uint64_t lo, uint64_t d,
+		uint64_t *rem)
+{
+#if defined(FEATURE_128_BIT_INTEGERS)
+	const uint128_t t = ((uint128_t)hi << 64) | lo;
+	const uint64_t q = t / d;
+	*rem = t - (uint128_t)q * d;
+	return q;
+#else
+	uint64_t q = 0;
+
+	for (int i = 0; i < 64; i++) {
+		const uint64_t top = hi >> 63;
+		hi = (hi << 1) | (lo >> 63);
+		lo <<= 1;
+		q <<= 1;
+		if (top || hi >= d) {
+			hi -= d;
+			q |= 1;
+		}
+	}
+	*rem = hi;
+	return q;
+#endif
+}
+
+static inline unsigned clz64(uint64_t x)
+{
+#if defined(__GNUC__)
+	return x ? __builtin_clzll(x) : 64;
+#else
+	unsigned n = 0;
+
+	for (; n < 64 && !(x & (UINT64_C(1) << 63)); n++)
+		x <<= 1;
+	return n;
+#endif
+}
+
+static uint64_t add_n(uint64_t *r, const uint64_t *a, const uint64_t *b,
+		size_t n)
+{
+	uint64_t carry = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		const uint64_t t = a[i] + carry;
+		carry = t < carry;
+		r[i] = t + b[i];
+		carry += r[i] < t;
+	}
+	return carry;
+}
+
+static uint64_t sub_n(uint64_t *r, const uint64_t *a, const uint64_t *b,
+		size_t n)
+{
+	uint64_t borrow = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		const uint64_t t = a[i] - borrow;
+		borrow = t > a[i];
+		r[i] = t - b[i];
+		borrow += r[i] > t;
+	}
+	return borrow;
+}
+
+// r[0..n) = a[0..n) + c.
+static uint64_t add_1(uint64_t *r, const uint64_t *a, size_t n, uint64_t c)
+{
+	for (size_t i = 0; i < n; i++) {
+		r[i] = a[i] + c;
+		c = r[i] < c;
+	}
+	return c;
+}
+
+// r[0..n) = a[0..n) - c.
+static uint64_t sub_1(uint64_t *r, const uint64_t *a, size_t n, uint64_t c)
+{
+	for (size_t i = 0; i < n; i++) {
+		const uint64_t t = a[i];
+		r[i] = t - c;
+		c = r[i] > t;
+	}
+	return c;
+}
+
+static int cmp_n(const uint64_t *a, const uint64_t *b, size_t n)
+{
+	for (size_t i = n; i-- > 0; )
+		if (a[i] != b[i])
+			return a[i] < b[i] ? -1 : 1;
+	return 0;
+}
+
+// Shifts left by s bits, 0 <= s < 64, returning the bits shifted out.
+static uint64_t lshift_n(uint64_t *r, const uint64_t *a, size_t n, unsigned s)
+{
+	uint64_t carry = 0;
+
+	if (!s) {
+		memmove(r, a, n * sizeof(*r));
+		return 0;
+	}
+	for (size_t i = 0; i < n; i++) {
+		const uint64_t t = a[i];
+		r[i] = (t << s) | carry;
+		carry = t >> (64 - s);
+	}
+	return carry;
+}
+
+static void rshift_n(uint64_t *r, const uint64_t *a, size_t n, unsigned s)
+{
+	uint64_t carry = 0;
+
+	if (!s) {
+		memmove(r, a, n * sizeof(*r));
+		return;
+	}
+	for (size_t i = n; i-- > 0; ) {
+		const uint64_t t = a[i];
+		r[i] = (t >> s) | carry;
+		carry = t << (64 - s);
+	}
+}
+
+static uint64_t addmul_1(uint64_t *r, const uint64_t *a, size_t n, uint64_t b)
+{
+	uint64_t carry = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		uint64_t hi, lo;
+		mul64(&hi, &lo, a[i], b);
+		lo += carry;
+		hi += lo < carry;
+		r[i] += lo;
+		hi += r[i] < lo;
+		carry = hi;
+	}
+	return carry;
+}
+
+static uint64_t submul_1(uint64_t *r, const uint64_t *a, size_t n, uint64_t b)
+{
+	uint64_t borrow = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		uint64_t hi, lo;
+		mul64(&hi, &lo, a[i], b);
+		lo += borrow;
+		hi += lo < borrow;
+		hi += r[i] < lo;
+		r[i] -= lo;
+		borrow = hi;
+	}
+	return borrow;
+}
+
+// (c2, c1, c0) += a * b
+static inline void mac(uint64_t *c0, uint64_t *c1, uint64_t *c2, uint64_t a,
+		uint64_t b)
+{
+	uint64_t hi, lo;
+
+	mul64(&hi, &lo, a, b);
+	*c0 += lo;
+	hi += *c0 < lo;
+	*c1 += hi;
+	*c2 += *c1 < hi;
+}
+
+// Comba's method: each column of the product is summed and then stored.
+static void mul_comba(uint64_t *r, const uint64_t *a, size_t an,
+		const uint64_t *b, size_t bn)
+{
+	uint64_t c0 = 0, c1 = 0, c2 = 0;
+
+	for (size_t k = 0; k + 1 < an + bn; k++) {
+		const size_t lo = k >= bn ? k - bn + 1 : 0;
+		const size_t hi = k < an ? k : an - 1;
+
+		for (size_t i = lo; i <= hi; i++)
+			mac(&c0, &c1, &c2, a[i], b[k-i]);
+		r[k] = c0;
+		c0 = c1;
+		c1 = c2;
+		c2 = 0;
+	}
+	r[an+bn-1] = c0;
+}
+
+// As mul_comba, but products of distinct limbs are computed once and doubled.
+static void sqr_comba(uint64_t *r, const uint64_t *a, size_t n)
+{
+	uint64_t c0 = 0, c1 = 0, c2 = 0;
+
+	for (size_t k = 0; k + 1 < 2 * n; k++) {
+		uint64_t d0 = 0, d1 = 0, d2 = 0, carry;
+
+		for (size_t i = k >= n ? k - n + 1 : 0; i < k - i; i++)
+			mac(&d0, &d1, &d2, a[i], a[k-i]);
+		d2 = (d2 << 1) | (d1 >> 63);
+		d1 = (d1 << 1) | (d0 >> 63);
+		d0 <<= 1;
+		if (!(k & 1))
+			mac(&d0, &d1, &d2, a[k/2], a[k/2]);
+
+		c0 += d0;
+		carry = c0 < d0;
+		c1 += carry;
+		c2 += c1 < carry;
+		c1 += d1;
+		c2 += (c1 < d1) + d2;
+		r[k] = c0;
+		c0 = c1;
+		c1 = c2;
+		c2 = 0;
+	}
+	r[2*n-1] = c0;
+}
+
+static const struct native_kernels kernels_c = {
+	.addmul_1 = addmul_1,
+	.mul = mul_comba,
+	.sqr = sqr_comba
+};
+
+static const struct native_kernels *kernels;
+
+static const struct native_kernels *select_kernels(void)
+{
+	const struct native_kernels *k = NULL;
+#ifdef FEATURE_CPUID
+	unsigned a, b, c, d;
+
+	if (__get_cpuid_max(0, NULL) >= 7) {
+		__cpuid_count(7, 0, a, b, c, d);
+		if ((b & bit_BMI2) && (b & bit_ADX))
+			k = native_kernels_adx();
+	}
+#endif
+	return k ? k : &kernels_c;
+}
+
+/* The kernels are chosen the first time they are needed.  Every thread makes
+ * the same choice, so a race only means the check is done twice.
+ */
+static const struct native_kernels *get_kernels(void)
+{
+	const struct native_kernels *k = __atomic_load_n(&kernels,
+			__ATOMIC_RELAXED);
+
+	if (!k) {
+		k = select_kernels();
+		__atomic_store_n(&kernels, k, __ATOMIC_RELAXED);
+	}
+	return k;
+}
+
+/* d = |x - y|, where x has xn limbs and y has yn <= xn.  Returns all ones if
+ * x < y and zero otherwise, without branching on either.
+ */
+static uint64_t sub_abs(uint64_t *d, const uint64_t *x, size_t xn,
+		const uint64_t *y, size_t yn)
+{
+	const uint64_t borrow = sub_1(d+yn, x+yn, xn-yn, sub_n(d, x, y, yn));
+	const uint64_t mask = -borrow;
+	uint64_t carry = borrow;
+
+	for (size_t i = 0; i < xn; i++) {
+		const uint64_t t = (d[i] ^ mask) + carry;
+		carry = t < carry;
+		d[i] = t;
+	}
+	return mask;
+}
+
+/* Karatsuba multiplication of two n-limb numbers into r[0..2n).  With a =
+ * a1 B + a0 and b = b1 B + b0, the middle term a1 b0 + a0 b1 is a0 b0 + a1 b1 -
+ * (a1 - a0)(b1 - b0).  The sign of the last product is applied with a mask, so
+ * this takes the same time for any inputs of a given length.
+ */
+static void mul_n(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t n)
+{
+	const size_t l = n / 2, h = n - l;
+	uint64_t da[NLIMBS/2], db[NLIMBS/2], p[NLIMBS];
+	uint64_t t[NLIMBS+1], u[NLIMBS+1];
+	uint64_t mask, carry;
+
+	if (n < KARATSUBA_THRESHOLD) {
+		get_kernels()->mul(r, a, n, b, n);
+		return;
+	}
+
+	mask = sub_abs(da, a+l, h, a, l) ^ sub_abs(db, b+l, h, b, l);
+	mul_n(p, da, db, h);
+	mul_n(r, a, b, l);
+	mul_n(r+2*l, a+l, b+l, h);
+
+	carry = add_n(t, r+2*l, r, 2*l);
+	t[2*h] = add_1(t+2*l, r+4*l, 2*(h-l), carry);
+
+	// The mask is set if the differences had opposite signs.
+	u[2*h] = t[2*h] - sub_n(u, t, p, 2*h);
+	t[2*h] += add_n(t, t, p, 2*h);
+	for (size_t i = 0; i <= 2 * h; i++)
+		t[i] = (t[i] & mask) | (u[i] & ~mask);
+
+	carry = add_n(r+l, r+l, t, 2*h+1);
+	add_1(r+l+2*h+1, r+l+2*h+1, l-1, carry);
+}
+
+// As mul_n, but the product of the differences is a square and so positive.
+static void sqr_n(uint64_t *r, const uint64_t *a, size_t n)
+{
+	const size_t l = n / 2, h = n - l;
+	uint64_t da[NLIMBS/2], p[NLIMBS], t[NLIMBS+1];
+	uint64_t carry;
+
+	if (n < KARATSUBA_THRESHOLD) {
+		get_kernels()->sqr(r, a, n);
+		return;
+	}
+
+	sub_abs(da, a+l, h, a, l);
+	sqr_n(p, da, h);
+	sqr_n(r, a, l);
+	sqr_n(r+2*l, a+l, h);
+
+	carry = add_n(t, r+2*l, r, 2*l);
+	t[2*h] = add_1(t+2*l, r+4*l, 2*(h-l), carry);
+	t[2*h] -= sub_n(t, t, p, 2*h);
+
+	carry = add_n(r+l, r+l, t, 2*h+1);
+	add_1(r+l+2*h+1, r+l+2*h+1, l-1, carry);
+}
+
+// r[0..an+bn) = a * b, where neither an nor bn is zero or more than NLIMBS.
+static void mul_any(uint64_t *r, const uint64_t *a, size_t an,
+		const uint64_t *b, size_t bn)
+{
+	if (an == bn && an >= KARATSUBA_THRESHOLD)
+		mul_n(r, a, b, an);
+	else if (an >= bn)
+		get_kernels()->mul(r, a, an, b, bn);
+	else
+		get_kernels()->mul(r, b, bn, a, an);
+}
+
+/* Knuth's algorithm D.  q[0..an-bn] = a / b and r[0..bn) = a mod b, where b has
+ * no leading zero limbs and an >= bn.  q may be NULL.  a may have up to
+ * 2 NLIMBS + 1 limbs, so that products can be reduced.
+ */
+static void divrem(uint64_t *q, uint64_t *r, const uint64_t *a, size_t an,
+		const uint64_t *b, size_t bn)
+{
+	uint64_t u[2*NLIMBS+2], v[NLIMBS];
+	const unsigned s = clz64(b[bn-1]);
+
+	if (bn == 1) {
+		uint64_t rem = 0;
+
+		for (size_t i = an; i-- > 0; ) {
+			const uint64_t t = div128(rem, a[i], b[0], &rem);
+			if (q)
+				q[i] = t;
+		}
+		r[0] = rem;
+		return;
+	}
+
+	lshift_n(v, b, bn, s);
+	u[an] = lshift_n(u, a, an, s);
+	for (size_t j = an - bn + 1; j-- > 0; ) {
+		const uint64_t top = v[bn-1];
+		uint64_t qhat, rhat, hi, lo, borrow;
+		bool fits = true;
+
+		if (u[j+bn] >= top) {
+			qhat = ~UINT64_C(0);
+			rhat = u[j+bn-1] + top;
+			fits = rhat >= top;
+		}
+		else
+			qhat = div128(u[j+bn], u[j+bn-1], top, &rhat);
+		while (fits) {
+			mul64(&hi, &lo, qhat, v[bn-2]);
+			if (hi < rhat || (hi == rhat && lo <= u[j+bn-2]))
+				break;
+			qhat--;
+			rhat += top;
+			fits = rhat >= top;
+		}
+
+		borrow = submul_1(u+j, v, bn, qhat);
+		if (u[j+bn] < borrow) {
+			qhat--;
+			u[j+bn] += add_n(u+j, u+j, v, bn);
+		}
+		u[j+bn] -= borrow;
+		if (q)
+			q[j] = qhat;
+	}
+	rshift_n(r, u, bn, s);
+}
+
+static void normalize(struct bignum *x)
+{
+	while (x->n && !x->d[x->n-1])
+		x->n--;
+	if (!x->n)
+		x->neg = false;
+}
+
+static void num_copy(struct bignum *r, const struct bignum *a)
+{
+	memmove(r->d, a->d, a->n * sizeof(*r->d));
+	r->n = a->n;
+	r->neg = a->neg;
+}
+
+static void num_setlimb(struct bignum *r, uint64_t v)
+{
+	r->d[0] = v;
+	r->n = !!v;
+	r->neg = false;
+}
+
+static int num_cmp(const struct bignum *a, const struct bignum *b)
+{
+	if (a->n != b->n)
+		return a->n < b->n ? -1 : 1;
+	return cmp_n(a->d, b->d, a->n);
+}
+
+// r = a + b if negb is false and a - b if it is true.
+static int num_addsub(struct bignum *r, const struct bignum *a,
+		const struct bignum *b, bool negb)
+{
+	const bool bneg = b->neg ^ negb;
+
+	if (a->neg == bneg) {
+		const struct bignum *x = a->n >= b->n ? a : b;
+		const struct bignum *y = a->n >= b->n ? b : a;
+		const bool neg = a->neg;
+		size_t n = x->n;
+		uint64_t carry;
+
+		carry = add_n(r->d, x->d, y->d, y->n);
+		carry = add_1(r->d+y->n, x->d+y->n, x->n-y->n, carry);
+		if (carry) {
+			if (n == NLIMBS)
+				return -DREW_ERR_INVALID;
+			r->d[n++] = carry;
+		}
+		r->n = n;
+		r->neg = neg;
+	}
+	else {
+		const int cmp = num_cmp(a, b);
+		const struct bignum *x = cmp >= 0 ? a : b;
+		const struct bignum *y = cmp >= 0 ? b : a;
+		const bool neg = cmp >= 0 ? a->neg : bneg;
+		const size_t n = x->n;
+
+		sub_1(r->d+y->n, x->d+y->n, x->n-y->n,
+				sub_n(r->d, x->d, y->d, y->n));
+		r->n = n;
+		r->neg = neg;
+		normalize(r);
+	}
+	return 0;
+}
+
+static int num_mul(struct bignum *r, const struct bignum *a,
+		const struct bignum *b)
+{
+	uint64_t t[2*NLIMBS];
+	const bool neg = a->neg ^ b->neg;
+	size_t n = a->n + b->n;
+
+	if (!a->n || !b->n) {
+		num_setlimb(r, 0);
+		return 0;
+	}
+	if (a == b)
+		sqr_n(t, a->d, a->n);
+	else
+		mul_any(t, a->d, a->n, b->d, b->n);
+	while (n && !t[n-1])
+		n--;
+	if (n > NLIMBS)
+		return -DREW_ERR_INVALID;
+	memcpy(r->d, t, n * sizeof(*t));
+	r->n = n;
+	r->neg = neg;
+	return 0;
+}
+
+// Division rounding towards zero.  Either q or r may be NULL.
+static int num_divrem(struct bignum *q, struct bignum *r,
+		const struct bignum *a, const struct bignum *b)
+{
+	uint64_t qd[NLIMBS], rd[NLIMBS];
+	const bool qneg = a->neg ^ b->neg, rneg = a->neg;
+	size_t qn, rn;
+
+	if (!b->n)
+		return -DREW_ERR_INVALID;
+	if (a->n < b->n) {
+		qn = 0;
+		rn = a->n;
+		memcpy(rd, a->d, rn * sizeof(*rd));
+	}
+	else {
+		divrem(qd, rd, a->d, a->n, b->d, b->n);
+		qn = a->n - b->n + 1;
+		rn = b->n;
+	}
+	if (q) {
+		memcpy(q->d, qd, qn * sizeof(*qd));
+		q->n = qn;
+		q->neg = qneg;
+		normalize(q);
+	}
+	if (r) {
+		memcpy(r->d, rd, rn * sizeof(*rd));
+		r->n = rn;
+		r->neg = rneg;
+		normalize(r);
+	}
+	return 0;
+}
+
+/* r = (-1)^neg t mod m, with the result in [0, |m|).  t has tn limbs, up to 2
+ * NLIMBS.
+ */
+static int reduce(struct bignum *r, const uint64_t *t, size_t tn, bool neg,
+		const struct bignum *m)
+{
+	uint64_t rd[NLIMBS];
+	const size_t mn = m->n;
+
+	if (!mn)
+		return -DREW_ERR_INVALID;
+	while (tn && !t[tn-1])
+		tn--;
+	if (tn < mn) {
+		memcpy(rd, t, tn * sizeof(*rd));
+		memset(rd+tn, 0, (mn - tn) * sizeof(*rd));
+	}
+	else
+		divrem(NULL, rd, t, tn, m->d, mn);
+	if (neg && tn) {
+		uint64_t z[NLIMBS];
+
+		memset(z, 0, mn * sizeof(*z));
+		if (cmp_n(rd, z, mn))
+			sub_n(rd, m->d, rd, mn);
+	}
+	memcpy(r->d, rd, mn * sizeof(*rd));
+	r->n = mn;
+	r->neg = false;
+	normalize(r);
+	return 0;
+}
+
+static int num_mod(struct bignum *r, const struct bignum *a,
+		const struct bignum *m)
+{
+	return reduce(r, a->d, a->n, a->neg, m);
+}
+
+static int num_mulmod(struct bignum *r, const struct bignum *a,
+		const struct bignum *b, const struct bignum *m)
+{
+	uint64_t t[2*NLIMBS];
+
+	if (!m->n)
+		return -DREW_ERR_INVALID;
+	if (!a->n || !b->n) {
+		num_setlimb(r, 0);
+		return 0;
+	}
+	if (a == b)
+		sqr_n(t, a->d, a->n);
+	else
+		mul_any(t, a->d, a->n, b->d, b->n);
+	return reduce(r, t, a->n + b->n, a->neg ^ b->neg, m);
+}
+
+/* The extended Euclidean algorithm, keeping only the coefficient of a.  At each
+ * step, s_i a = r_i (mod m).
+ */
+static int num_invmod(struct bignum *res, const struct bignum *a,
+		const struct bignum *m)
+{
+	struct bignum v[6];
+	struct bignum *r0 = v+0, *r1 = v+1, *s0 = v+2, *s1 = v+3;
+	struct bignum *q = v+4, *t = v+5, *tmp;
+	int ret = 0;
+
+	if (!m->n)
+		return -DREW_ERR_INVALID;
+	RETFAIL(num_mod(r0, a, m));
+	num_copy(r1, m);
+	r1->neg = false;
+	num_setlimb(s0, 1);
+	num_setlimb(s1, 0);
+	while (r1->n) {
+		num_divrem(q, t, r0, r1);
+		tmp = r0, r0 = r1, r1 = t, t = tmp;
+		if ((ret = num_mul(t, q, s1)) ||
+				(ret = num_addsub(t, s0, t, true)))
+			goto out;
+		tmp = s0, s0 = s1, s1 = t, t = tmp;
+	}
+	if (r0->n != 1 || r0->d[0] != 1) {
+		ret = -DREW_ERR_INVALID;
+		goto out;
+	}
+	ret = num_mod(res, s0, m);
+out:
+	memset(v, 0, sizeof(v));
+	return ret;
+}
+
+static int mont_setup(struct drew_bignum_mont_s *m, const struct bignum *mod)
+{
+	uint64_t t[2*NLIMBS+1];
+	uint64_t inv;
+	const size_t n = mod->n;
+
+	if (mod->neg || !n || !(mod->d[0] & 1) || (n == 1 && mod->d[0] == 1))
+		return -DREW_ERR_INVALID;
+
+	// Each step doubles the number of correct bits, starting from three.
+	inv = mod->d[0];
+	for (int i = 0; i < 5; i++)
+		inv *= 2 - mod->d[0] * inv;
+
+	m->n = n;
+	m->minv = -inv;
+	memcpy(m->m, mod->d, n * sizeof(*m->m));
+	memset(t, 0, sizeof(t));
+	t[n] = 1;
+	divrem(NULL, m->one, t, n+1, m->m, n);
+	t[n] = 0;
+	t[2*n] = 1;
+	divrem(NULL, m->rr, t, 2*n+1, m->m, n);
+	return 0;
+}
+
+/* Montgomery reduction: r = t R^-1 mod m, where t < m R.  The final subtraction
+ * is always done and its result kept or discarded with a mask.
+ */
+static void redc(const struct drew_bignum_mont_s *m, uint64_t *r, uint64_t *t)
+{
+	const struct native_kernels *k = get_kernels();
+	const size_t n = m->n;
+	uint64_t top = 0, borrow, mask;
+
+	for (size_t i = 0; i < n; i++) {
+		const uint64_t c = k->addmul_1(t+i, m->m, n, t[i] * m->minv);
+		uint64_t s = t[i+n] + top;
+
+		top = s < top;
+		s += c;
+		top += s < c;
+		t[i+n] = s;
+	}
+	borrow = sub_n(r, t+n, m->m, n);
+	mask = -(uint64_t)(top | !borrow);
+	for (size_t i = 0; i < n; i++)
+		r[i] = (r[i] & mask) | (t[i+n] & ~mask);
+}
+
+// Both inputs must be less than m.  r may be the same as either.
+static void mont_mul(const struct drew_bignum_mont_s *m, uint64_t *r,
+		const uint64_t *a, const uint64_t *b)
+{
+	uint64_t t[2*NLIMBS];
+
+	if (a == b)
+		sqr_n(t, a, m->n);
+	else
+		mul_n(t, a, b, m->n);
+	redc(m, r, t);
+}
+
+// Loads a, which must be less than m, as m->n limbs.
+static int mont_load(const struct drew_bignum_mont_s *m, uint64_t *r,
+		const struct bignum *a)
+{
+	if (a->n > m->n)
+		return -DREW_ERR_INVALID;
+	memcpy(r, a->d, a->n * sizeof(*r));
+	memset(r+a->n, 0, (m->n - a->n) * sizeof(*r));
+	return 0;
+}
+
+static void mont_store(const struct drew_bignum_mont_s *m, struct bignum *r,
+		const uint64_t *a)
+{
+	memcpy(r->d, a, m->n * sizeof(*a));
+	r->n = m->n;
+	r->neg = false;
+	normalize(r);
+}
+
+// r = aR mod m.  a need not be reduced.
+static int mont_to(const struct drew_bignum_mont_s *m, uint64_t *r,
+		const struct bignum *a)
+{
+	struct bignum t;
+	struct bignum mod = {.n = m->n};
+
+	memcpy(mod.d, m->m, m->n * sizeof(*mod.d));
+	RETFAIL(reduce(&t, a->d, a->n, a->neg, &mod));
+	mont_load(m, r, &t);
+	mont_mul(m, r, r, m->rr);
+	return 0;
+}
+
+static void mont_from(const struct drew_bignum_mont_s *m, struct bignum *r,
+		const uint64_t *a)
+{
+	uint64_t t[2*NLIMBS], u[NLIMBS];
+
+	memcpy(t, a, m->n * sizeof(*t));
+	memset(t+m->n, 0, m->n * sizeof(*t));
+	redc(m, u, t);
+	mont_store(m, r, u);
+}
+
+static inline unsigned window(const uint64_t *x, size_t bit)
+{
+	return (x[bit / 64] >> (bit % 64)) & (EXP_TABLE - 1);
+}
+
+// Reads table[idx] while touching every entry.
+static void table_select(uint64_t *r, uint64_t (*table)[NLIMBS],
+		unsigned idx, size_t n)
+{
+	memset(r, 0, n * sizeof(*r));
+	for (unsigned i = 0; i < EXP_TABLE; i++) {
+		const uint64_t mask = -((((uint64_t)(i ^ idx)) - 1) >> 63);
+		for (size_t j = 0; j < n; j++)
+			r[j] |= table[i][j] & mask;
+	}
+}
+
+/* r = g^x with g and r in Montgomery form.  Every window of x, including
+ * leading zeros, costs EXP_WINDOW squarings and a multiplication, so only the
+ * number of limbs in x is revealed.
+ */
+static void mont_exp(const struct drew_bignum_mont_s *m, uint64_t *r,
+		const uint64_t *g, const uint64_t *x, size_t xn)
+{
+	uint64_t table[EXP_TABLE][NLIMBS], t[NLIMBS];
+	const size_t n = m->n;
+	size_t bit = xn * 64 - EXP_WINDOW;
+
+	if (!xn) {
+		memcpy(r, m->one, n * sizeof(*r));
+		return;
+	}
+
+	memcpy(table[0], m->one, n * sizeof(*r));
+	memcpy(table[1], g, n * sizeof(*r));
+	for (int i = 2; i < EXP_TABLE; i++)
+		mont_mul(m, table[i], table[i-1], g);
+
+	table_select(r, table, window(x, bit), n);
+	while (bit) {
+		bit -= EXP_WINDOW;
+		for (int i = 0; i < EXP_WINDOW; i++)
+			mont_mul(m, r, r, r);
+		table_select(t, table, window(x, bit), n);
+		mont_mul(m, r, r, t);
+	}
+	memset(table, 0, sizeof(table));
+	memset(t, 0, sizeof(t));
+}
+
+static inline unsigned bits2(const struct bignum *x, size_t bit)
+{
+	return bit / 64 < x->n ? (x->d[bit / 64] >> (bit % 64)) & 3 : 0;
+}
+
+/* r = g1^x1 g2^x2 with g1, g2, and r in Montgomery form, using Straus's
+ * algorithm with two bits of each exponent at a time.  table[i + 4j] is g1^i
+ * g2^j.
+ */
+static void mont_exp2(const struct drew_bignum_mont_s *m, uint64_t *r,
+		const uint64_t *g1, const struct bignum *x1, const uint64_t *g2,
+		const struct bignum *x2)
+{
+	uint64_t table[16][NLIMBS];
+	const size_t n = m->n;
+	size_t bit = (x1->n > x2->n ? x1->n : x2->n) * 64;
+	bool started = false;
+
+	memcpy(table[0], m->one, n * sizeof(*r));
+	memcpy(table[1], g1, n * sizeof(*r));
+	memcpy(table[4], g2, n * sizeof(*r));
+	mont_mul(m, table[2], g1, g1);
+	mont_mul(m, table[3], table[2], g1);
+	mont_mul(m, table[8], g2, g2);
+	mont_mul(m, table[12], table[8], g2);
+	for (int j = 4; j < 16; j += 4)
+		for (int i = 1; i < 4; i++)
+			mont_mul(m, table[i+j], table[i], table[j]);
+
+	memcpy(r, m->one, n * sizeof(*r));
+	while (bit) {
+		unsigned idx;
+
+		bit -= 2;
+		idx = bits2(x1, bit) | (bits2(x2, bit) << 2);
+		if (started) {
+			mont_mul(m, r, r, r);
+			mont_mul(m, r, r, r);
+		}
+		if (idx) {
+			mont_mul(m, r, r, table[idx]);
+			started = true;
+		}
+	}
+}
+
+// Square and multiply with division, for even moduli.
+static int expmod_slow(struct bignum *r, const struct bignum *g,
+		const struct bignum *x, const struct bignum *mod)
+{
+	struct bignum b, t, one;
+	size_t bits = x->n ? x->n * 64 - clz64(x->d[x->n-1]) : 0;
+
+	num_setlimb(&one, 1);
+	RETFAIL(num_mod(&b, g, mod));
+	RETFAIL(num_mod(&t, &one, mod));
+	while (bits--) {
+		RETFAIL(num_mulmod(&t, &t, &t, mod));
+		if ((x->d[bits / 64] >> (bits % 64)) & 1)
+			RETFAIL(num_mulmod(&t, &t, &b, mod));
+	}
+	num_copy(r, &t);
+	return 0;
+}
+
+static int num_expmod(struct bignum *r, const struct bignum *g,
+		const struct bignum *x, const struct bignum *mod)
+{
+	struct drew_bignum_mont_s m;
+	struct bignum base;
+	uint64_t t[NLIMBS];
+	const struct bignum *xm = x;
+	struct bignum xabs;
+
+	if (!mod->n || mod->neg)
+		return -DREW_ERR_INVALID;
+	if (x->neg) {
+		RETFAIL(num_invmod(&base, g, mod));
+		g = &base;
+		num_copy(&xabs, x);
+		xabs.neg = false;
+		xm = &xabs;
+	}
+	if (!(mod->d[0] & 1))
+		return expmod_slow(r, g, xm, mod);
+	if (mod->n == 1 && mod->d[0] == 1) {
+		num_setlimb(r, 0);
+		return 0;
+	}
+	RETFAIL(mont_setup(&m, mod));
+	RETFAIL(mont_to(&m, t, g));
+	mont_exp(&m, t, t, xm->d, xm->n);
+	mont_from(&m, r, t);
+	memset(t, 0, sizeof(t));
+	return 0;
+}
+
+static int bn_info(int op, void *p)
+{
+	switch (op) {
+		case DREW_BIGNUM_VERSION:
+			return DREW_BIGNUM_ABI_MONT;
+		case DREW_BIGNUM_INTSIZE:
+			return sizeof(struct bignum);
+		default:
+			return -DREW_ERR_INVALID;
+	}
+}
+
+static int bn_info2(const drew_bignum_t *ctx, int op, drew_param_t *out,
+		const drew_param_t *in)
+{
+	return bn_info(op, NULL);
+}
+
+static int bn_init(drew_bignum_t *ctx, int flags, const drew_loader_t *ldr,
+		const drew_param_t *param)
+{
+	struct bignum *newctx = ctx->ctx;
+
+	if (!(flags & DREW_BIGNUM_FIXED))
+		if (!(newctx = malloc(sizeof(*newctx))))
+			return -ENOMEM;
+	newctx->n = 0;
+	newctx->neg = false;
+
+	ctx->ctx = newctx;
+	ctx->functbl = &bn_functbl;
+
+	return 0;
+}
+
+static int bn_fini(drew_bignum_t *ctx, int flags)
+{
+	struct bignum *c = ctx->ctx;
+
+	memset(c, 0, sizeof(*c));
+	if (!(flags & DREW_BIGNUM_FIXED))
+		free(c);
+
+	ctx->ctx = NULL;
+	return 0;
+}
+
+static int bn_clone(drew_bignum_t *newctx, const drew_bignum_t *oldctx,
+		int flags)
+{
+	if (flags & DREW_BIGNUM_COPY) {
+		num_copy(BN(newctx), BN(oldctx));
+		return 0;
+	}
+	if (!(flags & DREW_BIGNUM_FIXED))
+		if (!(newctx->ctx = malloc(sizeof(struct bignum))))
+			return -ENOMEM;
+
+	num_copy(newctx->ctx, oldctx->ctx);
+	newctx->functbl = oldctx->functbl;
+	return 0;
+}
+
+static int bn_nbits(const drew_bignum_t *ctx)
+{
+	const struct bignum *x = BN(ctx);
+
+	return x->n ? x->n * 64 - clz64(x->d[x->n-1]) : 0;
+}
+
+static int bn_nbytes(const drew_bignum_t *ctx)
+{
+	return (bn_nbits(ctx) + 7) / 8;
+}
+
+static int bn_bytes(const drew_bignum_t *ctx, uint8_t *data, size_t len)
+{
+	const struct bignum *x = BN(ctx);
+	const size_t nbytes = bn_nbytes(ctx);
+
+	if (data && len) {
+		if (len < nbytes)
+			return -DREW_ERR_MORE_DATA;
+		for (size_t i = 0; i < nbytes; i++)
+			data[nbytes-1-i] = x->d[i / 8] >> (8 * (i % 8));
+	}
+	return x->neg;
+}
+
+static int bn_setbytes(drew_bignum_t *ctx, const uint8_t *data,
+		size_t len)
+{
+	struct bignum *x = BN(ctx);
+
+	while (len && !*data)
+		data++, len--;
+	if (len > sizeof(x->d))
+		return -DREW_ERR_INVALID;
+	x->n = (len + 7) / 8;
+	x->neg = false;
+	memset(x->d, 0, x->n * sizeof(*x->d));
+	for (size_t i = 0; i < len; i++)
+		x->d[i / 8] |= (uint64_t)data[len-1-i] << (8 * (i % 8));
+	return 0;
+}
+
+static int bn_setzero(drew_bignum_t *ctx)
+{
+	num_setlimb(BN(ctx), 0);
+	return 0;
+}
+
+static int bn_setsmall(drew_bignum_t *ctx, long v)
+{
+	struct bignum *x = BN(ctx);
+
+	num_setlimb(x, v < 0 ? -(unsigned long)v : (unsigned long)v);
+	x->neg = v < 0;
+	return 0;
+}
+
+static int bn_negate(drew_bignum_t *res, const drew_bignum_t *in)
+{
+	struct bignum *r = BN(res);
+
+	num_copy(r, BN(in));
+	r->neg = r->n && !r->neg;
+	return 0;
+}
+
+static int bn_abs(drew_bignum_t *res, const drew_bignum_t *in)
+{
+	num_copy(BN(res), BN(in));
+	BN(res)->neg = false;
+	return 0;
+}
+
+static int bn_compare(const drew_bignum_t *a, const drew_bignum_t *b, int flag)
+{
+	const struct bignum *x = BN(a), *y = BN(b);
+
+	if (flag & DREW_BIGNUM_ABS)
+		return num_cmp(x, y);
+	if (x->neg != y->neg)
+		return x->neg ? -1 : 1;
+	return x->neg ? -num_cmp(x, y) : num_cmp(x, y);
+}
+
+// Like the other implementations, this compares magnitudes.
+static int bn_comparesmall(const drew_bignum_t *c, long val)
+{
+	const struct bignum *x = BN(c);
+	const uint64_t v = val < 0 ? -(unsigned long)val : (unsigned long)val;
+
+	if (x->n > 1)
+		return 1;
+	if ((x->n ? x->d[0] : 0) == v)
+		return 0;
+	return (x->n ? x->d[0] : 0) < v ? -1 : 1;
+}
+
+enum bitop {
+	BIT_OR,
+	BIT_AND,
+	BIT_XOR
+};
+
+// These work on the magnitudes and keep the sign of a.
+static int bitwise(drew_bignum_t *c, const drew_bignum_t *a,
+		const drew_bignum_t *b, enum bitop op)
+{
+	struct bignum *r = BN(c);
+	const struct bignum *x = BN(a), *y = BN(b);
+	const size_t n = x->n > y->n ? x->n : y->n;
+	const bool neg = x->neg;
+
+	for (size_t i = 0; i < n; i++) {
+		const uint64_t s = i < x->n ? x->d[i] : 0;
+		const uint64_t t = i < y->n ? y->d[i] : 0;
+
+		switch (op) {
+			case BIT_OR:
+				r->d[i] = s | t;
+				break;
+			case BIT_AND:
+				r->d[i] = s & t;
+				break;
+			case BIT_XOR:
+				r->d[i] = s ^ t;
+				break;
+		}
+	}
+	r->n = n;
+	r->neg = neg;
+	normalize(r);
+	return 0;
+}
+
+static int bn_bitwiseor(drew_bignum_t *c, const drew_bignum_t *a,
+		const drew_bignum_t *b)
+{
+	return bitwise(c, a, b, BIT_OR);
+}
+
+static int bn_bitwiseand(drew_bignum_t *c, const drew_bignum_t *a,
+		const drew_bignum_t *b)
+{
+	return bitwise(c, a, b, BIT_AND);
+}
+
+static int bn_bitwisexor(drew_bignum_t *c, const drew_bignum_t *a,
+		const drew_bignum_t *b)
+{
+	return bitwise(c, a, b, BIT_XOR);
+}
+
+// Inverts the bits below the most significant one.
+static int bn_bitwisenot(drew_bignum_t *res, const drew_bignum_t *in)
+{
+	struct bignum *r = BN(res);
+	const struct bignum *x = BN(in);
+	const unsigned s = x->n ? clz64(x->d[x->n-1]) : 0;
+
+	num_copy(r, x);
+	for (size_t i = 0; i < r->n; i++)
+		r->d[i] = ~r->d[i];
+	if (r->n)
+		r->d[r->n-1] &= ~UINT64_C(0) >> s;
+	normalize(r);
+	return 0;
+}
+
+static int bn_getbit(const drew_bignum_t *ctx, size_t bitno)
+{
+	const struct bignum *x = BN(ctx);
+
+	if (bitno / 64 >= x->n)
+		return 0;
+	return (x->d[bitno / 64] >> (bitno % 64)) & 1;
+}
+
+static int bn_setbit(drew_bignum_t *ctx, size_t bitno, bool val)
+{
+	struct bignum *x = BN(ctx);
+	const size_t limb = bitno / 64;
+	const uint64_t bit = UINT64_C(1) << (bitno % 64);
+
+	if (limb >= x->n) {
+		if (!val)
+			return 0;
+		if (limb >= NLIMBS)
+			return -DREW_ERR_INVALID;
+		memset(x->d+x->n, 0, (limb + 1 - x->n) * sizeof(*x->d));
+		x->n = limb + 1;
+	}
+	if (val)
+		x->d[limb] |= bit;
+	else
+		x->d[limb] &= ~bit;
+	normalize(x);
+	return 0;
+}
+
+static int bn_add(drew_bignum_t *res, const drew_bignum_t *a,
+		const drew_bignum_t *b)
+{
+	return num_addsub(BN(res), BN(a), BN(b), false);
+}
+
+static int bn_sub(drew_bignum_t *res, const drew_bignum_t *a,
+		const drew_bignum_t *b)
+{
+	return num_addsub(BN(res), BN(a), BN(b), true);
+}
+
+static int bn_mul(drew_bignum_t *r, const drew_bignum_t *a,
+		const drew_bignum_t *b)
+{
+	return num_mul(BN(r), BN(a), BN(b));
+}
+
+static int bn_div(drew_bignum_t *quot, drew_bignum_t *rem,
+		const drew_bignum_t *dividend, const drew_bignum_t *divisor)
+{
+	return num_divrem(quot ? BN(quot) : NULL, rem ? BN(rem) : NULL,
+			BN(dividend), BN(divisor));
+}
+
+static int bn_mulpow2(drew_bignum_t *c, const drew_bignum_t *a, size_t b)
+{
+	struct bignum *r = BN(c);
+	const struct bignum *x = BN(a);
+	const size_t w = b / 64, s = b % 64, xn = x->n;
+	const bool neg = x->neg;
+	uint64_t top;
+
+	if (!xn) {
+		num_setlimb(r, 0);
+		return 0;
+	}
+	top = s ? x->d[xn-1] >> (64 - s) : 0;
+	if (w >= NLIMBS || xn + w + !!top > NLIMBS)
+		return -DREW_ERR_INVALID;
+
+	if (top)
+		r->d[xn+w] = top;
+	for (size_t i = xn; i-- > 0; )
+		r->d[i+w] = (x->d[i] << s) |
+			(s && i ? x->d[i-1] >> (64 - s) : 0);
+	memset(r->d, 0, w * sizeof(*r->d));
+	r->n = xn + w + !!top;
+	r->neg = neg;
+	return 0;
+}
+
+// Shifts the magnitude right, keeping the sign.
+static void num_rshift(struct bignum *r, const struct bignum *x, size_t b)
+{
+	const size_t w = b / 64, s = b % 64;
+	const bool neg = x->neg;
+	size_t n;
+
+	if (w >= x->n) {
+		num_setlimb(r, 0);
+		return;
+	}
+	n = x->n - w;
+	for (size_t i = 0; i < n; i++)
+		r->d[i] = (x->d[i+w] >> s) |
+			(s && i + 1 < n ? x->d[i+w+1] << (64 - s) : 0);
+	r->n = n;
+	r->neg = neg;
+	normalize(r);
+}
+
+static int bn_divpow2(drew_bignum_t *quot, drew_bignum_t *rem,
+		const drew_bignum_t *a, size_t b)
+{
+	struct bignum q;
+
+	num_rshift(&q, BN(a), b);
+	if (rem) {
+		struct bignum *r = BN(rem);
+		const size_t w = b / 64, s = b % 64;
+
+		num_copy(r, BN(a));
+		if (w < r->n) {
+			r->n = w + !!s;
+			if (s)
+				r->d[w] &= (UINT64_C(1) << s) - 1;
+			normalize(r);
+		}
+	}
+	num_copy(BN(quot), &q);
+	return 0;
+}
+
+static int bn_shiftleft(drew_bignum_t *res, const drew_bignum_t *in, size_t n)
+{
+	return bn_mulpow2(res, in, n);
+}
+
+static int bn_shiftright(drew_bignum_t *res, const drew_bignum_t *in, size_t n)
+{
+	num_rshift(BN(res), BN(in), n);
+	return 0;
+}
+
+static int bn_square(drew_bignum_t *r, const drew_bignum_t *in)
+{
+	return num_mul(BN(r), BN(in), BN(in));
+}
+
+static int bn_mod(drew_bignum_t *r, const drew_bignum_t *a,
+		const drew_bignum_t *mod)
+{
+	return num_mod(BN(r), BN(a), BN(mod));
+}
+
+static int bn_expsmall(drew_bignum_t *r, const drew_bignum_t *a,
+		unsigned long exp)
+{
+	struct bignum b, t;
+
+	num_copy(&b, BN(a));
+	num_setlimb(&t, 1);
+	for (; exp; exp >>= 1) {
+		if (exp & 1)
+			RETFAIL(num_mul(&t, &t, &b));
+		if (exp > 1)
+			RETFAIL(num_mul(&b, &b, &b));
+	}
+	num_copy(BN(r), &t);
+	return 0;
+}
+
+static int bn_squaremod(drew_bignum_t *c, const drew_bignum_t *a,
+		const drew_bignum_t *n)
+{
+	return num_mulmod(BN(c), BN(a), BN(a), BN(n));
+}
+
+static int bn_addmod(drew_bignum_t *c, const drew_bignum_t *a,
+		const drew_bignum_t *b, const drew_bignum_t *n)
+{
+	struct bignum t;
+
+	RETFAIL(num_addsub(&t, BN(a), BN(b), false));
+	return num_mod(BN(c), &t, BN(n));
+}
+
+static int bn_mulmod(drew_bignum_t *c, const drew_bignum_t *a,
+		const drew_bignum_t *b, const drew_bignum_t *n)
+{
+	return num_mulmod(BN(c), BN(a), BN(b), BN(n));
+}
+
+static int bn_expmod(drew_bignum_t *r, const drew_bignum_t *g,
+		const drew_bignum_t *x, const drew_bignum_t *mod)
+{
+	return num_expmod(BN(r), BN(g), BN(x), BN(mod));
+}
+
+static int bn_expmod2(drew_bignum_t *r, const drew_bignum_t *g1,
+		const drew_bignum_t *x1, const drew_bignum_t *g2,
+		const drew_bignum_t *x2, const drew_bignum_t *mod)
+{
+	struct drew_bignum_mont_s m;
+	struct bignum t, u;
+
+	if (mont_setup(&m, BN(mod))) {
+		RETFAIL(num_expmod(&t, BN(g1), BN(x1), BN(mod)));
+		RETFAIL(num_expmod(&u, BN(g2), BN(x2), BN(mod)));
+		return num_mulmod(BN(r), &t, &u, BN(mod));
+	}
+	return bn_montexp2(&m, r, g1, x1, g2, x2);
+}
+
+static int bn_invmod(drew_bignum_t *r, const drew_bignum_t *a,
+		const drew_bignum_t *mod)
+{
+	return num_invmod(BN(r), BN(a), BN(mod));
+}
+
+static int bn_gcd(drew_bignum_t *r, const drew_bignum_t *a,
+		const drew_bignum_t *b)
+{
+	struct bignum x, y, t;
+
+	num_copy(&x, BN(a));
+	num_copy(&y, BN(b));
+	x.neg = y.neg = false;
+	while (y.n) {
+		num_divrem(NULL, &t, &x, &y);
+		num_copy(&x, &y);
+		num_copy(&y, &t);
+	}
+	num_copy(BN(r), &x);
+	return 0;
+}
+
+static int bn_montinit(drew_bignum_mont_t **mp, const drew_bignum_t *mod)
+{
+	drew_bignum_mont_t *m;
+	int res;
+
+	if (!(m = malloc(sizeof(*m))))
+		return -ENOMEM;
+	if ((res = mont_setup(m, BN(mod)))) {
+		free(m);
+		return res;
+	}
+	*mp = m;
+	return 0;
+}
+
+static int bn_montfini(drew_bignum_mont_t *m)
+{
+	if (m) {
+		memset(m, 0, sizeof(*m));
+		free(m);
+	}
+	return 0;
+}
+
+static int bn_montset(const drew_bignum_mont_t *m, drew_bignum_t *r,
+		const drew_bignum_t *a)
+{
+	uint64_t t[NLIMBS];
+
+	RETFAIL(mont_to(m, t, BN(a)));
+	mont_store(m, BN(r), t);
+	return 0;
+}
+
+static int bn_montget(const drew_bignum_mont_t *m, drew_bignum_t *r,
+		const drew_bignum_t *a)
+{
+	uint64_t t[NLIMBS];
+
+	RETFAIL(mont_load(m, t, BN(a)));
+	mont_from(m, BN(r), t);
+	return 0;
+}
+
+static int bn_montmul(const drew_bignum_mont_t *m, drew_bignum_t *r,
+		const drew_bignum_t *a, const drew_bignum_t *b)
+{
+	uint64_t s[NLIMBS], t[NLIMBS];
+
+	RETFAIL(mont_load(m, s, BN(a)));
+	if (a == b)
+		mont_mul(m, s, s, s);
+	else {
+		RETFAIL(mont_load(m, t, BN(b)));
+		mont_mul(m, s, s, t);
+	}
+	mont_store(m, BN(r), s);
+	return 0;
+}
+
+static int bn_montsquare(const drew_bignum_mont_t *m, drew_bignum_t *r,
+		const drew_bignum_t *a)
+{
+	return bn_montmul(m, r, a, a);
+}
+
+static int bn_montexp(const drew_bignum_mont_t *m, drew_bignum_t *r,
+		const drew_bignum_t *g, const drew_bignum_t *x)
+{
+	uint64_t t[NLIMBS];
+	const struct bignum *y = BN(x), *base = BN(g);
+	struct bignum inv;
+
+	if (y->neg) {
+		struct bignum mod = {.n = m->n};
+
+		memcpy(mod.d, m->m, m->n * sizeof(*mod.d));
+		RETFAIL(num_invmod(&inv, base, &mod));
+		base = &inv;
+	}
+	RETFAIL(mont_to(m, t, base));
+	mont_exp(m, t, t, y->d, y->n);
+	mont_from(m, BN(r), t);
+	memset(t, 0, sizeof(t));
+	return 0;
+}
+
+// The exponents are taken to be public, as they are in signature verification.
+static int bn_montexp2(const drew_bignum_mont_t *m, drew_bignum_t *r,
+		const drew_bignum_t *g1, const drew_bignum_t *x1,
+		const drew_bignum_t *g2, const drew_bignum_t *x2)
+{
+	uint64_t s[NLIMBS], t[NLIMBS];
+	struct bignum y1, y2, mod = {.n = m->n};
+	const struct bignum *bases[2] = {BN(g1), BN(g2)};
+	const struct bignum *exps[2] = {BN(x1), BN(x2)};
+	struct bignum inv[2], *ys[2] = {&y1, &y2};
+
+	memcpy(mod.d, m->m, m->n * sizeof(*mod.d));
+	for (int i = 0; i < 2; i++) {
+		num_copy(ys[i], exps[i]);
+		if (ys[i]->neg) {
+			RETFAIL(num_invmod(inv+i, bases[i], &mod));
+			bases[i] = inv+i;
+			ys[i]->neg = false;
+		}
+	}
+	RETFAIL(mont_to(m, s, bases[0]));
+	RETFAIL(mont_to(m, t, bases[1]));
+	mont_exp2(m, s, s, &y1, t, &y2);
+	mont_from(m, BN(r), s);
+	return 0;
+}
+
+/* Deterministic pseudorandom limbs for the self-test, from xorshift64*. */
+static void test_fill(uint64_t *x, size_t n, uint64_t *state)
+{
+	for (size_t i = 0; i < n; i++) {
+		*state ^= *state >> 12;
+		*state ^= *state << 25;
+		*state ^= *state >> 27;
+		x[i] = *state * UINT64_C(2685821657736338717);
+	}
+}
+
+/* The Mersenne primes 2^127 - 1 and 2^521 - 1 give known answers for inversion
+ * and, by Fermat's little theorem, exponentiation.  The multiplication and
+ * division routines are checked against each other on numbers large enough to
+ * use Karatsuba multiplication, and the processor-specific kernels against the
+ * portable ones.
+ */
+static int bn_test(void *p, const drew_loader_t *ldr)
+{
+	static const unsigned exps[] = {127, 521};
+	const struct native_kernels *k = get_kernels();
+	struct bignum a, b, c, q, r, t, one;
+	uint64_t state = 0x0123456789abcdef, x[2*NLIMBS], y[2*NLIMBS];
+	int res = 0;
+
+	num_setlimb(&one, 1);
+	for (size_t i = 0; i < DIM(exps); i++) {
+		struct bignum pm, e;
+
+		num_setlimb(&pm, 0);
+		pm.n = (exps[i] + 63) / 64;
+		memset(pm.d, 0xff, pm.n * sizeof(*pm.d));
+		pm.d[pm.n-1] >>= 64 * pm.n - exps[i];
+		num_copy(&e, &pm);
+		e.d[0]--;
+		for (uint64_t g = 2; g < 6; g++) {
+			num_setlimb(&a, g);
+			if (num_expmod(&b, &a, &e, &pm) || num_cmp(&b, &one))
+				res |= 1;
+			if (num_invmod(&b, &a, &pm) || num_mulmod(&c, &a, &b, &pm) ||
+					num_cmp(&c, &one))
+				res |= 2;
+		}
+	}
+
+	for (size_t n = 1; n <= NLIMBS / 2; n += n < 8 ? 1 : 5) {
+		const size_t len = 2 * n * sizeof(*x);
+
+		a.n = b.n = n;
+		c.n = n - 1 ? n - 1 : 1;
+		a.neg = b.neg = c.neg = false;
+		test_fill(a.d, n, &state);
+		test_fill(b.d, n, &state);
+		test_fill(c.d, c.n, &state);
+		b.d[n-1] |= 1;
+		c.d[c.n-1] &= b.d[n-1] >> 1;
+		normalize(&c);
+		if (num_mul(&t, &a, &b) || num_addsub(&t, &t, &c, false) ||
+				num_divrem(&q, &r, &t, &b) || num_cmp(&q, &a) ||
+				num_cmp(&r, &c))
+			res |= 4;
+
+		mul_comba(y, a.d, n, b.d, n);
+		mul_n(x, a.d, b.d, n);
+		res |= memcmp(x, y, len) ? 8 : 0;
+		k->mul(x, a.d, n, b.d, n);
+		res |= memcmp(x, y, len) ? 16 : 0;
+		// Inverting b changes the sign of b1 - b0 in mul_n.
+		for (size_t i = 0; i < n; i++)
+			b.d[i] = ~b.d[i];
+		mul_comba(y, a.d, n, b.d, n);
+		mul_n(x, a.d, b.d, n);
+		res |= memcmp(x, y, len) ? 8 : 0;
+		sqr_comba(y, a.d, n);
+		sqr_n(x, a.d, n);
+		res |= memcmp(x, y, len) ? 8 : 0;
+		k->sqr(x, a.d, n);
+		res |= memcmp(x, y, len) ? 16 : 0;
+		mul_comba(x, a.d, n, a.d, n);
+		res |= memcmp(x, y, len) ? 32 : 0;
+	}
+
+	return res;
+}
+
+struct plugin {
+	const char *name;
+	const drew_bignum_functbl_t *functbl;
+};
+
+static struct plugin plugin_data[] = {
+	{ "Bignum", &bn_functbl },
+	{ "BignumNative", &bn_functbl }
+};
+
+EXPORT()
+int DREW_PLUGIN_NAME(native)(void *ldr, int op, int id, void *p)
+{
+	int nplugins = sizeof(plugin_data)/sizeof(plugin_data[0]);
+
+	if (id < 0 || id >= nplugins)
+		return -DREW_ERR_INVALID;
+
+	switch (op) {
+		case DREW_LOADER_LOOKUP_NAME:
+			return 0;
+		case DREW_LOADER_GET_NPLUGINS:
+			return nplugins;
+		case DREW_LOADER_GET_TYPE:
+			return DREW_TYPE_BIGNUM;
+		case DREW_LOADER_GET_FUNCTBL_SIZE:
+			return sizeof(drew_bignum_functbl_t);
+		case DREW_LOADER_GET_FUNCTBL:
+			memcpy(p, plugin_data[id].functbl, sizeof(drew_bignum_functbl_t));
+			return 0;
+		case DREW_LOADER_GET_NAME_SIZE:
+			return strlen(plugin_data[id].name) + 1;
+		case DREW_LOADER_GET_NAME:
+			memcpy(p, plugin_data[id].name, strlen(plugin_data[id].name)+1);
+			return 0;
+		default:
+			return -DREW_ERR_INVALID;
+	}
+}
+UNEXPORT()
+UNHIDE()
@@ -0,0 +1,52 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* The inner loops of the native bignum plugin.  Everything else is written in
+ * terms of these, so a faster version of one of them for a given processor
+ * speeds up the whole plugin.  Numbers are arrays of 64-bit limbs, least
+ * significant first.
+ */
+#ifndef DREW_BIGNUM_NATIVE_H
+#define DREW_BIGNUM_NATIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct native_kernels {
+	// r[0..n) += a[0..n) * b, returning the limb carried out.  n > 0.
+	uint64_t (*addmul_1)(uint64_t *, const uint64_t *, size_t, uint64_t);
+	/* r[0..an+bn) = a[0..an) * b[0..bn).  r may not overlap a or b, and an
+	 * and bn are both nonzero.
+	 */
+	void (*mul)(uint64_t *, const uint64_t *, size_t, const uint64_t *,
+			size_t);
+	// r[0..2n) = a[0..n)^2, with the same restrictions as mul.
+	void (*sqr)(uint64_t *, const uint64_t *, size_t);
+};
+
+/* Returns the kernels using mulx, adcx, and adox, or NULL if they were not
+ * compiled in.  These may only be used once the processor has been checked for
+ * BMI2 and ADX.
+ */
+const struct native_kernels *native_kernels_adx(void);
+
+#endif
@@ -39,6 +39,11 @@ struct bignum {
 	BIGNUM *bn;
 };
 
+struct drew_bignum_mont_s {
+	BN_MONT_CTX *mont;
+	BIGNUM *mod;
+};
+
 #define NEW_CTX(x) \
 	do { \
 		if (!(x = BN_CTX_new())) \
@@ -108,6 +113,24 @@ static int bn_invmod(drew_bignum_t *, const drew_bignum_t *,
 static int bn_gcd(drew_bignum_t *, const drew_bignum_t *,
 		const drew_bignum_t *);
 static int bn_test(void *, const drew_loader_t *);
+static int bn_expmod2(drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *, const drew_bignum_t *);
+static int bn_montinit(drew_bignum_mont_t **, const drew_bignum_t *);
+static int bn_montfini(drew_bignum_mont_t *);
+static int bn_montset(const drew_bignum_mont_t *, drew_bignum_t *,
+		const drew_bignum_t *);
+static int bn_montget(const drew_bignum_mont_t *, drew_bignum_t *,
+		const drew_bignum_t *);
+static int bn_montmul(const drew_bignum_mont_t *, drew_bignum_t *,
+		const drew_bignum_t *, const drew_bignum_t *);
+static int bn_montsquare(const drew_bignum_mont_t *, drew_bignum_t *,
+		const drew_bignum_t *);
+static int bn_montexp(const drew_bignum_mont_t *, drew_bignum_t *,
+		const drew_bignum_t *, const drew_bignum_t *);
+static int bn_montexp2(const drew_bignum_mont_t *, drew_bignum_t *,
+		const drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *, const drew_bignum_t *);
 
 
 static const drew_bignum_functbl_t bn_functbl = {
@@ -149,14 +172,23 @@ static const drew_bignum_functbl_t bn_functbl = {
 	.expmod = bn_expmod,
 	.invmod = bn_invmod,
 	.gcd = bn_gcd,
-	.test = bn_test
+	.test = bn_test,
+	.expmod2 = bn_expmod2,
+	.montinit = bn_montinit,
+	.montfini = bn_montfini,
+	.montset = bn_montset,
+	.montget = bn_montget,
+	.montmul = bn_montmul,
+	.montsquare = bn_montsquare,
+	.montexp = bn_montexp,
+	.montexp2 = bn_montexp2
 };
 
 static int bn_info(int op, void *p)
 {
 	switch (op) {
 		case DREW_BIGNUM_VERSION:
-			return CURRENT_ABI;
+			return DREW_BIGNUM_ABI_MONT;
 		case DREW_BIGNUM_INTSIZE:
 			return sizeof(struct bignum);
 		default:
@@ -512,6 +544,31 @@ static int bn_expmod(drew_bignum_t *r, const drew_bignum_t *g,
 	return res;
 }
 
+static int bn_expmod2(drew_bignum_t *r, const drew_bignum_t *g1,
+		const drew_bignum_t *x1, const drew_bignum_t *g2,
+		const drew_bignum_t *x2, const drew_bignum_t *mod)
+{
+	int res = 0;
+	BN_CTX *ctx;
+	NEW_CTX(ctx);
+	BIGNUM *t = BN_new();
+	// The simultaneous exponentiation needs Montgomery form.
+	if (BN_is_odd(MP(mod)))
+		res = !BN_mod_exp2_mont(t, MP(g1), MP(x1), MP(g2), MP(x2),
+				MP(mod), ctx, NULL);
+	else {
+		BIGNUM *u = BN_new();
+		res = !BN_mod_exp(t, MP(g1), MP(x1), MP(mod), ctx) ||
+			!BN_mod_exp(u, MP(g2), MP(x2), MP(mod), ctx) ||
+			!BN_mod_mul(t, t, u, MP(mod), ctx);
+		BN_free(u);
+	}
+	BN_copy(MP(r), t);
+	BN_free(t);
+	DEL_CTX(ctx);
+	return res;
+}
+
 static int bn_invmod(drew_bignum_t *r, const drew_bignum_t *a,
 		const drew_bignum_t *mod)
 {
@@ -540,6 +597,113 @@ static int bn_gcd(drew_bignum_t *r, const drew_bignum_t *a,
 	return res;
 }
 
+static int bn_montinit(drew_bignum_mont_t **mp, const drew_bignum_t *mod)
+{
+	const BIGNUM *n = MP(mod);
+	drew_bignum_mont_t *m;
+	BN_CTX *ctx = NULL;
+
+	if (!BN_is_odd(n) || BN_is_one(n) || BN_is_negative(n))
+		return -DREW_ERR_INVALID;
+	if (!(m = calloc(1, sizeof(*m))))
+		return -ENOMEM;
+	if (!(ctx = BN_CTX_new()) || !(m->mont = BN_MONT_CTX_new()) ||
+			!(m->mod = BN_dup(n)) ||
+			!BN_MONT_CTX_set(m->mont, m->mod, ctx)) {
+		if (ctx)
+			DEL_CTX(ctx);
+		bn_montfini(m);
+		return -ENOMEM;
+	}
+	DEL_CTX(ctx);
+	*mp = m;
+	return 0;
+}
+
+static int bn_montfini(drew_bignum_mont_t *m)
+{
+	if (m) {
+		BN_MONT_CTX_free(m->mont);
+		BN_free(m->mod);
+		free(m);
+	}
+	return 0;
+}
+
+static int bn_montset(const drew_bignum_mont_t *m, drew_bignum_t *r,
+		const drew_bignum_t *a)
+{
+	int res = 0;
+	BN_CTX *ctx;
+	NEW_CTX(ctx);
+	// The conversion only works for values already reduced.
+	if (BN_is_negative(MP(a)) || BN_ucmp(MP(a), m->mod) >= 0)
+		res = !BN_nnmod(MP(r), MP(a), m->mod, ctx) ||
+			!BN_to_montgomery(MP(r), MP(r), m->mont, ctx);
+	else
+		res = !BN_to_montgomery(MP(r), MP(a), m->mont, ctx);
+	DEL_CTX(ctx);
+	return res;
+}
+
+static int bn_montget(const drew_bignum_mont_t *m, drew_bignum_t *r,
+		const drew_bignum_t *a)
+{
+	int res = 0;
+	BN_CTX *ctx;
+	NEW_CTX(ctx);
+	res = !BN_from_montgomery(MP(r), MP(a), m->mont, ctx);
+	DEL_CTX(ctx);
+	return res;
+}
+
+static int bn_montmul(const drew_bignum_mont_t *m, drew_bignum_t *r,
+		const drew_bignum_t *a, const drew_bignum_t *b)
+{
+	int res = 0;
+	BN_CTX *ctx;
+	NEW_CTX(ctx);
+	res = !BN_mod_mul_montgomery(MP(r), MP(a), MP(b), m->mont, ctx);
+	DEL_CTX(ctx);
+	return res;
+}
+
+static int bn_montsquare(const drew_bignum_mont_t *m, drew_bignum_t *r,
+		const drew_bignum_t *a)
+{
+	return bn_montmul(m, r, a, a);
+}
+
+static int bn_montexp(const drew_bignum_mont_t *m, drew_bignum_t *r,
+		const drew_bignum_t *g, const drew_bignum_t *x)
+{
+	int res = 0;
+	BN_CTX *ctx;
+	NEW_CTX(ctx);
+	BIGNUM *t = BN_new();
+	res = !BN_mod_exp_mont(t, MP(g), MP(x), m->mod, ctx, m->mont);
+	BN_copy(MP(r), t);
+	BN_free(t);
+	DEL_CTX(ctx);
+	return res;
+}
+
+static int bn_montexp2(const drew_bignum_mont_t *m, drew_bignum_t *r,
+		const drew_bignum_t *g1, const drew_bignum_t *x1,
+		const drew_bignum_t *g2, const drew_bignum_t *x2)
+{
+	int res = 0;
+	BN_CTX *ctx;
+	NEW_CTX(ctx);
+	BIGNUM *t = BN_new();
+	res = !BN_mod_exp2_mont(t, MP(g1), MP(x1), MP(g2), MP(x2), m->mod,
+			ctx, m->mont);
+	BN_copy(MP(r), t);
+	BN_free(t);
+	DEL_CTX(ctx);
+	return res;
+}
+
 static int bn_fini(drew_bignum_t *ctx, int flags)
 {
 	struct bignum *c = ctx->ctx;
@@ -32,6 +32,7 @@
 #include <tommath.h>
 
 #include <drew/bignum.h>
+#include <drew/mem.h>
 #include <drew/plugin.h>
 
 // "Bare" MP and MPConstant, "Bare" DIGit and DIGitConstant.
@@ -56,6 +57,16 @@ struct bignum {
 	mp_digit dig;
 };
 
+/* one and rr are R and R^2 mod m, where R is the power of the digit base used
+ * by mp_montgomery_reduce.
+ */
+struct drew_bignum_mont_s {
+	mp_int m;
+	mp_int one;
+	mp_int rr;
+	mp_digit rho;
+};
+
 static inline int fixup_return(int val)
 {
 	switch (val) {
@@ -125,6 +136,24 @@ static int bn_invmod(drew_bignum_t *, const drew_bignum_t *,
 static int bn_gcd(drew_bignum_t *, const drew_bignum_t *,
 		const drew_bignum_t *);
 static int bn_test(void *, const drew_loader_t *);
+static int bn_expmod2(drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *, const drew_bignum_t *);
+static int bn_montinit(drew_bignum_mont_t **, const drew_bignum_t *);
+static int bn_montfini(drew_bignum_mont_t *);
+static int bn_montset(const drew_bignum_mont_t *, drew_bignum_t *,
+		const drew_bignum_t *);
+static int bn_montget(const drew_bignum_mont_t *, drew_bignum_t *,
+		const drew_bignum_t *);
+static int bn_montmul(const drew_bignum_mont_t *, drew_bignum_t *,
+		const drew_bignum_t *, const drew_bignum_t *);
+static int bn_montsquare(const drew_bignum_mont_t *, drew_bignum_t *,
+		const drew_bignum_t *);
+static int bn_montexp(const drew_bignum_mont_t *, drew_bignum_t *,
+		const drew_bignum_t *, const drew_bignum_t *);
+static int bn_montexp2(const drew_bignum_mont_t *, drew_bignum_t *,
+		const drew_bignum_t *, const drew_bignum_t *,
+		const drew_bignum_t *, const drew_bignum_t *);
 
 
 static const drew_bignum_functbl_t bn_functbl = {
@@ -166,14 +195,23 @@ static const drew_bignum_functbl_t bn_functbl = {
 	.expmod = bn_expmod,
 	.invmod = bn_invmod,
 	.gcd = bn_gcd,
-	.test = bn_test
+	.test = bn_test,
+	.expmod2 = bn_expmod2,
+	.montinit = bn_montinit,
+	.montfini = bn_montfini,
+	.montset = bn_montset,
+	.montget = bn_montget,
+	.montmul = bn_montmul,
+	.montsquare = bn_montsquare,
+	.montexp = bn_montexp,
+	.montexp2 = bn_montexp2
 };
 
 static int bn_info(int op, void *p)
 {
 	switch (op) {
 		case DREW_BIGNUM_VERSION:
-			return CURRENT_ABI;
+			return DREW_BIGNUM_ABI_MONT;
 		case DREW_BIGNUM_INTSIZE:
 			return sizeof(struct bignum);
 		default:
@@ -446,6 +484,268 @@ static int bn_expmod(drew_bignum_t *res, const drew_bignum_t *g,
 	return 0;
 }
 
+static void mont_clear(struct drew_bignum_mont_s *m)
+{
+	mp_clear(&m->m);
+	mp_clear(&m->one);
+	mp_clear(&m->rr);
+}
+
+static int mont_setup(struct drew_bignum_mont_s *m, mp_int *mod)
+{
+	int res;
+
+	if (mp_iseven(mod) || mp_cmp_d(mod, 1) != MP_GT)
+		return MP_VAL;
+	if ((res = mp_init(&m->m)))
+		return res;
+	if ((res = mp_init(&m->one))) {
+		mp_clear(&m->m);
+		return res;
+	}
+	if ((res = mp_init(&m->rr))) {
+		mp_clear(&m->m);
+		mp_clear(&m->one);
+		return res;
+	}
+	if ((res = mp_copy(mod, &m->m)) ||
+			(res = mp_montgomery_setup(&m->m, &m->rho)) ||
+			(res = mp_montgomery_calc_normalization(&m->one,
+					&m->m)) ||
+			(res = mp_sqrmod(&m->one, &m->m, &m->rr)))
+		mont_clear(m);
+	return res;
+}
+
+static int mont_mul(const struct drew_bignum_mont_s *m, mp_int *c, mp_int *a,
+		mp_int *b)
+{
+	int res = (a == b) ? mp_sqr(a, c) : mp_mul(a, b, c);
+	return res ? res : mp_montgomery_reduce(c, (mp_int *)&m->m, m->rho);
+}
+
+static int mont_to(const struct drew_bignum_mont_s *m, mp_int *c, mp_int *a)
+{
+	int res = MP_OKAY;
+
+	// The product must be less than mR for the reduction to work.
+	if (a->sign == MP_NEG || mp_cmp_mag(a, (mp_int *)&m->m) != MP_LT)
+		res = mp_mod(a, (mp_int *)&m->m, c);
+	else if (a != c)
+		res = mp_copy(a, c);
+	return res ? res : mont_mul(m, c, c, (mp_int *)&m->rr);
+}
+
+static int mont_from(const struct drew_bignum_mont_s *m, mp_int *c, mp_int *a)
+{
+	int res = (a != c) ? mp_copy(a, c) : MP_OKAY;
+	return res ? res : mp_montgomery_reduce(c, (mp_int *)&m->m, m->rho);
+}
+
+// Returns the n bits of the nonnegative x starting at bit.
+static int get_bits(const mp_int *x, int bit, int n)
+{
+	int val = 0;
+
+	for (int i = bit + n - 1; i >= bit; i--) {
+		val <<= 1;
+		if (i / DIGIT_BIT < x->used)
+			val |= (x->dp[i / DIGIT_BIT] >> (i % DIGIT_BIT)) & 1;
+	}
+	return val;
+}
+
+/* A fixed-window exponentiation.  t[i] is g^i in Montgomery form, and every
+ * four bits of the exponent cost four squarings and at most one
+ * multiplication.
+ */
+static int mont_exp(const struct drew_bignum_mont_s *m, mp_int *r, mp_int *g,
+		mp_int *x)
+{
+	mp_int t[16], acc;
+	int res, ninit = 0;
+
+	if ((res = mp_init(&acc)))
+		return res;
+	for (; ninit < 16; ninit++)
+		if ((res = mp_init(t + ninit)))
+			goto out;
+
+	if ((res = mp_copy((mp_int *)&m->one, t+0)) ||
+			(res = mont_to(m, t+1, g)))
+		goto out;
+	for (int i = 2; i < 16; i++)
+		if ((res = mont_mul(m, t+i, t+i-1, t+1)))
+			goto out;
+
+	if ((res = mp_copy(t+0, &acc)))
+		goto out;
+	for (int bit = (mp_count_bits(x) + 3) & ~3; (bit -= 4) >= 0; ) {
+		const int index = get_bits(x, bit, 4);
+
+		for (int i = 0; i < 4; i++)
+			if ((res = mont_mul(m, &acc, &acc, &acc)))
+				goto out;
+		if (index && (res = mont_mul(m, &acc, &acc, t+index)))
+			goto out;
+	}
+	if (!(res = mont_from(m, &acc, &acc)))
+		mp_exch(&acc, r);
+out:
+	while (ninit--)
+		mp_clear(t + ninit);
+	mp_clear(&acc);
+	return res;
+}
+
+/* This is Straus's method with a two-bit window on each exponent.  t[4*i + j]
+ * is g1^i g2^j in Montgomery form, and every two bits of the exponents cost two
+ * squarings and at most one multiplication.
+ */
+static int mont_exp2(const struct drew_bignum_mont_s *m, mp_int *r,
+		mp_int *g1, mp_int *x1, mp_int *g2, mp_int *x2)
+{
+	mp_int t[16], acc;
+	int nbits, res, ninit = 0;
+
+	if ((res = mp_init(&acc)))
+		return res;
+	for (; ninit < 16; ninit++)
+		if ((res = mp_init(t + ninit)))
+			goto out;
+
+	if ((res = mp_copy((mp_int *)&m->one, t+0)) ||
+			(res = mont_to(m, t+4, g1)) ||
+			(res = mont_to(m, t+1, g2)) ||
+			(res = mont_mul(m, t+8, t+4, t+4)) ||
+			(res = mont_mul(m, t+12, t+8, t+4)) ||
+			(res = mont_mul(m, t+2, t+1, t+1)) ||
+			(res = mont_mul(m, t+3, t+2, t+1)))
+		goto out;
+	for (int i = 4; i < 16; i += 4)
+		for (int j = 1; j < 4; j++)
+			if ((res = mont_mul(m, t+i+j, t+i, t+j)))
+				goto out;
+
+	nbits = mp_count_bits(x1);
+	if (mp_count_bits(x2) > nbits)
+		nbits = mp_count_bits(x2);
+	if ((res = mp_copy(t+0, &acc)))
+		goto out;
+	for (int bit = (nbits + 1) & ~1; (bit -= 2) >= 0; ) {
+		const int index = (get_bits(x1, bit, 2) << 2) |
+			get_bits(x2, bit, 2);
+
+		if ((res = mont_mul(m, &acc, &acc, &acc)) ||
+				(res = mont_mul(m, &acc, &acc, &acc)))
+			goto out;
+		if (index && (res = mont_mul(m, &acc, &acc, t+index)))
+			goto out;
+	}
+	if (!(res = mont_from(m, &acc, &acc)))
+		mp_exch(&acc, r);
+out:
+	while (ninit--)
+		mp_clear(t + ninit);
+	mp_clear(&acc);
+	return res;
+}
+
+static int bn_expmod2(drew_bignum_t *r, const drew_bignum_t *g1,
+		const drew_bignum_t *x1, const drew_bignum_t *g2,
+		const drew_bignum_t *x2, const drew_bignum_t *mod)
+{
+	struct drew_bignum_mont_s m;
+	mp_int t;
+	int res;
+
+	// Montgomery reduction needs an odd modulus.
+	if (!mont_setup(&m, MPC(mod))) {
+		res = mont_exp2(&m, MP(r), MPC(g1), MPC(x1), MPC(g2), MPC(x2));
+		mont_clear(&m);
+		RETFAIL(res);
+		return 0;
+	}
+	RETFAIL(mp_init(&t));
+	if (!(res = mp_exptmod(MPC(g2), MPC(x2), MPC(mod), &t)) &&
+			!(res = mp_exptmod(MPC(g1), MPC(x1), MPC(mod), MP(r))))
+		res = mp_mulmod(MP(r), &t, MPC(mod), MP(r));
+	mp_clear(&t);
+	RETFAIL(res);
+	return 0;
+}
+
+static int bn_montinit(drew_bignum_mont_t **mp, const drew_bignum_t *mod)
+{
+	drew_bignum_mont_t *m;
+	int res;
+
+	if (!(m = drew_mem_malloc(sizeof(*m))))
+		return -ENOMEM;
+	if ((res = mont_setup(m, MPC(mod)))) {
+		drew_mem_free(m);
+		return fixup_return(res);
+	}
+	*mp = m;
+	return 0;
+}
+
+static int bn_montfini(drew_bignum_mont_t *m)
+{
+	if (m) {
+		mont_clear(m);
+		drew_mem_free(m);
+	}
+	return 0;
+}
+
+static int bn_montset(const drew_bignum_mont_t *m, drew_bignum_t *r,
+		const drew_bignum_t *a)
+{
+	RETFAIL(mont_to(m, MP(r), MPC(a)));
+	return 0;
+}
+
+static int bn_montget(const drew_bignum_mont_t *m, drew_bignum_t *r,
+		const drew_bignum_t *a)
+{
+	RETFAIL(mont_from(m, MP(r), MPC(a)));
+	return 0;
+}
+
+static int bn_montmul(const drew_bignum_mont_t *m, drew_bignum_t *r,
+		const drew_bignum_t *a, const drew_bignum_t *b)
+{
+	RETFAIL(mont_mul(m, MP(r), MPC(a), MPC(b)));
+	return 0;
+}
+
+static int bn_montsquare(const drew_bignum_mont_t *m, drew_bignum_t *r,
+		const drew_bignum_t *a)
+{
+	RETFAIL(mont_mul(m, MP(r), MPC(a), MPC(a)));
+	return 0;
+}
+
+static int bn_montexp(const drew_bignum_mont_t *m, drew_bignum_t *r,
+		const drew_bignum_t *g, const drew_bignum_t *x)
+{
+	// Negative exponents need an inverse, which mp_exptmod knows how to do.
+	if (MPC(x)->sign == MP_NEG)
+		RETFAIL(mp_exptmod(MPC(g), MPC(x), (mp_int *)&m->m, MP(r)));
+	else
+		RETFAIL(mont_exp(m, MP(r), MPC(g), MPC(x)));
+	return 0;
+}
+
+static int bn_montexp2(const drew_bignum_mont_t *m, drew_bignum_t *r,
+		const drew_bignum_t *g1, const drew_bignum_t *x1,
+		const drew_bignum_t *g2, const drew_bignum_t *x2)
+{
+	RETFAIL(mont_exp2(m, MP(r), MPC(g1), MPC(x1), MPC(g2), MPC(x2)));
+	return 0;
+}
+
 static int bn_invmod(drew_bignum_t *res, const drew_bignum_t *a,
 		const drew_bignum_t *mod)
 {
@@ -31,15 +31,10 @@
 #include "aes.hh"
 
 HIDE()
-inline bool HasAESNI()
+static bool use_aesni()
 {
 #if defined(__i386__) || defined(__amd64__)
-	int res = 0;
-	uint32_t a, b, c, d;
-	res = GetCpuid(1, a, b, c, d);
-	if (res)
-		return false;
-	return c & 0x02000000;
+	return HasAESNI();
 #else
 	return false;
 #endif
@@ -59,7 +54,7 @@ extern "C" {
 EXPORT()
 int DREW_PLUGIN_NAME(aesni)(void *ldr, int op, int id, void *p)
 {
-	int nplugins = HasAESNI() ? sizeof(plugin_data)/sizeof(plugin_data[0]) : 0;
+	int nplugins = use_aesni() ? sizeof(plugin_data)/sizeof(plugin_data[0]) : 0;
 	if (id < 0 || id >= nplugins) {
 		if (!id && !nplugins && op == DREW_LOADER_GET_NPLUGINS)
 			return 0;
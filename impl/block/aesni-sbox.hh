@@ -0,0 +1,123 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ *
+ * This file is part of the Drew Cryptography Suite.
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of your choice of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation or version 2.0 of the Apache
+ * License as published by the Apache Software Foundation.
+ *
+ * This file is distributed in the hope that it will be useful, but without
+ * any warranty; without even the implied warranty of merchantability or fitness
+ * for a particular purpose.
+ *
+ * Note that people who make modified versions of this file are not obligated to
+ * dual-license their modified versions; it is their choice whether to do so.
+ * If a modified version is not distributed under both licenses, the copyright
+ * and permission notices should be updated accordingly.
+ */
+#ifndef AESNI_SBOX_HH
+#define AESNI_SBOX_HH
+
+/* Helpers for evaluating byte S-boxes with the AES instructions.  Any S-box
+ * which is an affine transform of inversion in GF(2^8), such as those of
+ * Camellia and ARIA, can be computed as post(SubBytes(pre(x))), where pre and
+ * post are affine maps over GF(2), so aesenclast computes sixteen of them at
+ * once.  The affine maps are done with pshufb as two table lookups, one on each
+ * nibble.
+ *
+ * The block ciphers using this work on sixteen blocks at a time in byte-sliced
+ * form: after transpose16, vector i holds byte i of each of the sixteen blocks.
+ * Grøstl uses it as well, since its rounds are built from the AES S-box.
+ *
+ * Everything here has internal linkage, since this file is only used in
+ * translation units compiled with -maes -mssse3, and nothing in those may be
+ * called unless HasAESNI says the processor supports it.
+ */
+
+#if defined(__GNUC__) && defined(__AES__) && defined(__SSSE3__)
+#define FEATURE_AESNI_SBOX
+
+HIDE()
+namespace drew {
+namespace aesni {
+
+typedef uint8_t vector_t __attribute__((vector_size(16)));
+typedef char vector8_t __attribute__((vector_size(16)));
+typedef long long vector64_t __attribute__((vector_size(16)));
+
+struct AffineMap {
+	vector_t lo, hi;
+};
+
+static inline vector_t shuffle(vector_t x, vector_t mask)
+{
+	return vector_t(__builtin_ia32_pshufb128(vector8_t(x), vector8_t(mask)));
+}
+
+static inline vector_t splat(uint8_t x)
+{
+	vector_t v = {x, x, x, x, x, x, x, x, x, x, x, x, x, x, x, x};
+	return v;
+}
+
+/* Apply an affine map to each byte of x.  The constant is folded into the low
+ * table.
+ */
+static inline vector_t affine(vector_t x, const AffineMap &m)
+{
+	return shuffle(m.lo, x & 0x0f) ^ shuffle(m.hi, x >> 4);
+}
+
+/* SubBytes followed by ShiftRows, which is what aesenclast with a zero key
+ * does.  ShiftRows moves bytes between blocks, so callers must either undo it
+ * with unshift_rows or otherwise arrange for it not to matter.
+ */
+static inline vector_t sub_shift(vector_t x)
+{
+	const vector64_t zero = {0, 0};
+	return vector_t(__builtin_ia32_aesenclast128(vector64_t(x), zero));
+}
+
+static inline vector_t unshift_rows(vector_t x)
+{
+	const vector_t inv_shift_rows = {
+		0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3
+	};
+	return shuffle(x, inv_shift_rows);
+}
+
+static inline vector_t sbox(vector_t x, const AffineMap &pre,
+		const AffineMap &post)
+{
+	return affine(unshift_rows(sub_shift(affine(x, pre))), post);
+}
+
+/* Transpose a 16x16 matrix of bytes.  Each pass interleaves the first half of
+ * the rows with the second half, which rotates the bits of each byte's
+ * (row, column) index by one; four passes swap the row and column.
+ */
+static inline void transpose16(vector_t *x)
+{
+	const vector_t lo = {0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23};
+	const vector_t hi = {8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30,
+		15, 31};
+
+	for (int pass = 0; pass < 4; pass++) {
+		vector_t t[16];
+		for (int i = 0; i < 8; i++) {
+			t[2*i+0] = __builtin_shuffle(x[i], x[i+8], lo);
+			t[2*i+1] = __builtin_shuffle(x[i], x[i+8], hi);
+		}
+		for (int i = 0; i < 16; i++)
+			x[i] = t[i];
+	}
+}
+
+}
+}
+UNHIDE()
+
+#endif
+#endif
@@ -0,0 +1,159 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ *
+ * This file is part of the Drew Cryptography Suite.
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of your choice of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation or version 2.0 of the Apache
+ * License as published by the Apache Software Foundation.
+ *
+ * This file is distributed in the hope that it will be useful, but without
+ * any warranty; without even the implied warranty of merchantability or fitness
+ * for a particular purpose.
+ *
+ * Note that people who make modified versions of this file are not obligated to
+ * dual-license their modified versions; it is their choice whether to do so.
+ * If a modified version is not distributed under both licenses, the copyright
+ * and permission notices should be updated accordingly.
+ */
+/* This file is compiled with AES-NI and SSSE3 enabled.  Nothing in it may be
+ * called unless the processor has been checked for support, which is done in
+ * aria.cc.
+ */
+#include <internal.h>
+
+#include <string.h>
+
+#include "aria.hh"
+#include "aesni-sbox.hh"
+
+HIDE()
+#ifdef FEATURE_AESNI_SBOX
+using namespace drew::aesni;
+
+/* The affine maps which turn the AES S-box into sb2, sb3, and sb4.  sb1 is the
+ * AES S-box itself, and sb2 needs only a map on its output.
+ */
+static const AffineMap post_sb2 = {
+	{0x88, 0x0d, 0x37, 0xb2, 0x00, 0x85, 0xbf, 0x3a,
+	 0xa8, 0x2d, 0x17, 0x92, 0x20, 0xa5, 0x9f, 0x1a},
+	{0x00, 0x3e, 0xd4, 0xea, 0x84, 0xba, 0x50, 0x6e,
+	 0xcd, 0xf3, 0x19, 0x27, 0x49, 0x77, 0x9d, 0xa3}
+};
+static const AffineMap pre_sb3 = {
+	{0x31, 0x30, 0x33, 0x32, 0x09, 0x08, 0x0b, 0x0a,
+	 0x41, 0x40, 0x43, 0x42, 0x79, 0x78, 0x7b, 0x7a},
+	{0x00, 0xe0, 0xe7, 0x07, 0xd5, 0x35, 0x32, 0xd2,
+	 0x8d, 0x6d, 0x6a, 0x8a, 0x58, 0xb8, 0xbf, 0x5f}
+};
+static const AffineMap post_sb3 = pre_sb3;
+static const AffineMap pre_sb4 = {
+	{0x0b, 0x0a, 0x05, 0x04, 0xec, 0xed, 0xe2, 0xe3,
+	 0x81, 0x80, 0x8f, 0x8e, 0x66, 0x67, 0x68, 0x69},
+	{0x00, 0xea, 0xda, 0x30, 0xad, 0x47, 0x77, 0x9d,
+	 0x72, 0x98, 0xa8, 0x42, 0xdf, 0x35, 0x05, 0xef}
+};
+static const AffineMap post_sb4 = {
+	{0xa1, 0xa3, 0x1d, 0x1f, 0xc9, 0xcb, 0x75, 0x77,
+	 0x38, 0x3a, 0x84, 0x86, 0x50, 0x52, 0xec, 0xee},
+	{0x00, 0xdb, 0xb6, 0x6d, 0xa9, 0x72, 0x1f, 0xc4,
+	 0xc2, 0x19, 0x74, 0xaf, 0x6b, 0xb0, 0xdd, 0x06}
+};
+
+/* These leave the bytes shuffled by ShiftRows.  Since every vector goes through
+ * the S-boxes in every round and everything else treats all sixteen blocks
+ * alike, the shuffling is undone once at the end instead.
+ */
+static inline vector_t sb1(vector_t x)
+{
+	return sub_shift(x);
+}
+
+static inline vector_t sb2(vector_t x)
+{
+	return affine(sub_shift(x), post_sb2);
+}
+
+static inline vector_t sb3(vector_t x)
+{
+	return affine(sub_shift(affine(x, pre_sb3)), post_sb3);
+}
+
+static inline vector_t sb4(vector_t x)
+{
+	return affine(sub_shift(affine(x, pre_sb4)), post_sb4);
+}
+
+// x is in the order used by ARIA::Permute.
+static inline void substitute1(vector_t *x, const uint8_t *k)
+{
+	for (int i = 0; i < 16; i++)
+		x[i] ^= splat(k[i]);
+	for (int i = 0; i < 4; i++) {
+		x[i+ 0] = sb1(x[i+ 0]);
+		x[i+ 4] = sb2(x[i+ 4]);
+		x[i+ 8] = sb3(x[i+ 8]);
+		x[i+12] = sb4(x[i+12]);
+	}
+}
+
+static inline void substitute2(vector_t *x, const uint8_t *k)
+{
+	for (int i = 0; i < 16; i++)
+		x[i] ^= splat(k[i]);
+	for (int i = 0; i < 4; i++) {
+		x[i+ 0] = sb3(x[i+ 0]);
+		x[i+ 4] = sb4(x[i+ 4]);
+		x[i+ 8] = sb1(x[i+ 8]);
+		x[i+12] = sb2(x[i+12]);
+	}
+}
+
+static inline int permuted(int i)
+{
+	return 4 * (i % 4) + i / 4;
+}
+#endif
+
+size_t drew::ARIA::CryptFast16(FastBlock *bout, const FastBlock *bin,
+		size_t n, const AlignedData *sk) const
+{
+#ifdef FEATURE_AESNI_SBOX
+	const size_t nrounds = 12 + 2 * m_off;
+	size_t i;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		vector_t t[16], x[16];
+
+		memcpy(t, bin + i, sizeof(t));
+		transpose16(t);
+		for (int j = 0; j < 16; j++)
+			x[j] = t[permuted(j)];
+
+		for (size_t j = 0; j < nrounds - 2; j += 2) {
+			substitute1(x, sk[j].data);
+			diffuse(t, x);
+			substitute2(t, sk[j+1].data);
+			diffuse(x, t);
+		}
+		substitute1(x, sk[nrounds-2].data);
+		diffuse(t, x);
+		substitute2(t, sk[nrounds-1].data);
+		for (int j = 0; j < 16; j++)
+			t[j] ^= splat(sk[nrounds].data[j]);
+
+		for (size_t j = 0; j < nrounds % 4; j++)
+			for (int k = 0; k < 16; k++)
+				t[k] = unshift_rows(t[k]);
+		for (int j = 0; j < 16; j++)
+			x[j] = t[permuted(j)];
+		transpose16(x);
+		memcpy(bout + i, x, sizeof(x));
+	}
+	return i;
+#else
+	return 0;
+#endif
+}
+UNHIDE()
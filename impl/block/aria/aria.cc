@@ -176,6 +176,75 @@ int drew::ARIA::Decrypt(uint8_t *out, const uint8_t *in) const
 	}
 }
 
+// This processes N independent blocks at once.  The S-box lookups within a
+// block are independent, but each round has to wait for the diffusion layer of
+// the previous one, so interleaving the blocks keeps the load ports busy.
+template<size_t N>
+void drew::ARIA::CryptBlocks(FastBlock *bout, const FastBlock *bin,
+		const AlignedData *sk) const
+{
+	const size_t nrounds = 12 + 2 * m_off;
+	AlignedData buf0[N], buf1[N];
+
+	for (size_t j = 0; j < N; j++)
+		Permute(buf1[j].data, bin[j].data);
+
+	for (size_t i = 0; i < nrounds - 2; i += 2) {
+		for (size_t j = 0; j < N; j++)
+			fo(buf0[j], buf1[j], sk[i]);
+		for (size_t j = 0; j < N; j++)
+			fe(buf1[j], buf0[j], sk[i+1]);
+	}
+	for (size_t j = 0; j < N; j++)
+		fo(buf0[j], buf1[j], sk[nrounds-2]);
+	for (size_t j = 0; j < N; j++) {
+		sl2(buf1[j], buf0[j], sk[nrounds-1]);
+		XorAligned(buf0[j].data, buf1[j].data, sk[nrounds].data, 16);
+		Permute(bout[j].data, buf0[j].data);
+	}
+}
+
+static bool use_aesni()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	static const bool aesni = HasAESNI();
+	return aesni;
+#else
+	return false;
+#endif
+}
+
+void drew::ARIA::CryptFast(FastBlock *bout, const FastBlock *bin, size_t n,
+		const AlignedData *sk) const
+{
+	if (use_aesni()) {
+		size_t done = CryptFast16(bout, bin, n, sk);
+		n -= done, bout += done, bin += done;
+	}
+	for (; n >= 4; n -= 4, bout += 4, bin += 4)
+		CryptBlocks<4>(bout, bin, sk);
+	if (n >= 2) {
+		CryptBlocks<2>(bout, bin, sk);
+		n -= 2, bout += 2, bin += 2;
+	}
+	if (n)
+		CryptBlocks<1>(bout, bin, sk);
+}
+
+int drew::ARIA::EncryptFast(FastBlock *bout, const FastBlock *bin,
+		size_t n) const
+{
+	CryptFast(bout, bin, n, m_ek);
+	return 0;
+}
+
+int drew::ARIA::DecryptFast(FastBlock *bout, const FastBlock *bin,
+		size_t n) const
+{
+	CryptFast(bout, bin, n, m_dk);
+	return 0;
+}
+
 const uint8_t drew::ARIA::sb1[] = {
 	0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5,
 	0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
@@ -33,6 +33,46 @@
 HIDE()
 namespace drew {
 
+/* The diffusion layer.  This is written generically so that it can operate
+ * either on the bytes of one block or on vectors, each of which holds the
+ * corresponding byte of several blocks.
+ */
+template<class T>
+inline void diffuse(T *out, const T *in)
+{
+	const T p349e = in[12] ^ in[1] ^ in[6] ^ in[11];
+	const T p0b = in[0] ^ in[14];
+	const T p1a = in[4] ^ in[10];
+	const T p6d = in[9] ^ in[7];
+	const T p7c = in[13] ^ in[3];
+	out[11] = p349e ^ p0b ^ in[5];
+	out[ 5] = p349e ^ p1a ^ in[15];
+	out[ 0] = p349e ^ p6d ^ in[2];
+	out[14] = p349e ^ p7c ^ in[8];
+
+	const T p258f = in[8] ^ in[5] ^ in[2] ^ in[15];
+	out[ 1] = p258f ^ p0b ^ in[11];
+	out[15] = p258f ^ p1a ^ in[1];
+	out[10] = p258f ^ p6d ^ in[12];
+	out[ 4] = p258f ^ p7c ^ in[6];
+
+	const T p16bc = in[4] ^ in[9] ^ in[14] ^ in[3];
+	const T p29 = in[8] ^ in[6];
+	const T p38 = in[12] ^ in[2];
+	const T p4f = in[1] ^ in[15];
+	const T p5e = in[5] ^ in[11];
+	out[ 3] = p16bc ^ p29 ^ in[13];
+	out[13] = p16bc ^ p38 ^ in[7];
+	out[ 8] = p16bc ^ p4f ^ in[10];
+	out[ 6] = p16bc ^ p5e ^ in[0];
+
+	const T p07ad = in[0] ^ in[13] ^ in[10] ^ in[7];
+	out[ 9] = p07ad ^ p29 ^ in[3];
+	out[ 7] = p07ad ^ p38 ^ in[9];
+	out[ 2] = p07ad ^ p4f ^ in[4];
+	out[12] = p07ad ^ p5e ^ in[14];
+}
+
 class ARIA : public BlockCipher<16, BigEndian>
 {
 	public:
@@ -40,6 +80,8 @@ class ARIA : public BlockCipher<16, BigEndian>
 		~ARIA() {};
 		int Encrypt(uint8_t *out, const uint8_t *in) const;
 		int Decrypt(uint8_t *out, const uint8_t *in) const;
+		int EncryptFast(FastBlock *bout, const FastBlock *bin, size_t n) const;
+		int DecryptFast(FastBlock *bout, const FastBlock *bin, size_t n) const;
 	protected:
 		typedef AlignedBlock<uint8_t, 16> AlignedData;
 		virtual int SetKeyInternal(const uint8_t *key, size_t sz) = 0;
@@ -95,37 +137,7 @@ class ARIA : public BlockCipher<16, BigEndian>
 				unsigned v7) const;
 		inline void afunc(AlignedData &out, const AlignedData &in) const
 		{
-			const uint8_t p349e = in.data[12] ^ in.data[1] ^ in.data[6] ^ in.data[11];
-			const uint8_t p0b = in.data[0] ^ in.data[14];
-			const uint8_t p1a = in.data[4] ^ in.data[10];
-			const uint8_t p6d = in.data[9] ^ in.data[7];
-			const uint8_t p7c = in.data[13] ^ in.data[3];
-			out.data[11] = p349e ^ p0b ^ in.data[5];
-			out.data[ 5] = p349e ^ p1a ^ in.data[15];
-			out.data[ 0] = p349e ^ p6d ^ in.data[2];
-			out.data[14] = p349e ^ p7c ^ in.data[8];
-
-			const uint8_t p258f = in.data[8] ^ in.data[5] ^ in.data[2] ^ in.data[15];
-			out.data[ 1] = p258f ^ p0b ^ in.data[11];
-			out.data[15] = p258f ^ p1a ^ in.data[1];
-			out.data[10] = p258f ^ p6d ^ in.data[12];
-			out.data[ 4] = p258f ^ p7c ^ in.data[6];
-
-			const uint8_t p16bc = in.data[4] ^ in.data[9] ^ in.data[14] ^ in.data[3];
-			const uint8_t p29 = in.data[8] ^ in.data[6];
-			const uint8_t p38 = in.data[12] ^ in.data[2];
-			const uint8_t p4f = in.data[1] ^ in.data[15];
-			const uint8_t p5e = in.data[5] ^ in.data[11];
-			out.data[ 3] = p16bc ^ p29 ^ in.data[13];
-			out.data[13] = p16bc ^ p38 ^ in.data[7];
-			out.data[ 8] = p16bc ^ p4f ^ in.data[10];
-			out.data[ 6] = p16bc ^ p5e ^ in.data[0];
-
-			const uint8_t p07ad = in.data[0] ^ in.data[13] ^ in.data[10] ^ in.data[7];
-			out.data[ 9] = p07ad ^ p29 ^ in.data[3];
-			out.data[ 7] = p07ad ^ p38 ^ in.data[9];
-			out.data[ 2] = p07ad ^ p4f ^ in.data[4];
-			out.data[12] = p07ad ^ p5e ^ in.data[14];
+			diffuse(out.data, in.data);
 		}
 		inline void fo(AlignedData &out, const AlignedData &in,
 				const AlignedData &x) const
@@ -144,6 +156,16 @@ class ARIA : public BlockCipher<16, BigEndian>
 		int Encrypt128(uint8_t *, const uint8_t *, const AlignedData *) const;
 		int Encrypt192(uint8_t *, const uint8_t *, const AlignedData *) const;
 		int Encrypt256(uint8_t *, const uint8_t *, const AlignedData *) const;
+		template<size_t N>
+		void CryptBlocks(FastBlock *, const FastBlock *, const AlignedData *)
+			const;
+		void CryptFast(FastBlock *, const FastBlock *, size_t,
+				const AlignedData *) const;
+		// This processes sixteen blocks at a time using AES-NI and returns
+		// the number of blocks processed.  It must not be called unless the
+		// processor supports AES-NI.
+		size_t CryptFast16(FastBlock *, const FastBlock *, size_t,
+				const AlignedData *) const;
 		AlignedData m_ek[17], m_dk[17];
 		size_t m_off;
 		static const uint8_t sb1[], sb2[], sb3[], sb4[];
@@ -193,6 +215,13 @@ static int test(void *, const drew_loader_t *)
 	res <<= 2;
 	res |= BlockTestCase<T>(key, 32).Test(pt,
 			"f92bd7c79fb72e2f2b8f80c1972d24fc");
+	res <<= 3;
+	// This covers the sixteen-way, four-way, two-way, and single-block code.
+	res |= BlockTestCase<T>::FastTest(16, 16 * 2 + 4 * 3 + 3);
+	res <<= 3;
+	res |= BlockTestCase<T>::FastTest(24, 16 * 2 + 4 * 3 + 3);
+	res <<= 3;
+	res |= BlockTestCase<T>::FastTest(32, 16 * 2 + 4 * 3 + 3);
 
 	return res;
 }
@@ -34,6 +34,13 @@
 
 #include "blockcipher.hh"
 
+/* A plugin can handle info2 operations of its own, which aren't part of the
+ * public interface, by defining this before including this file.
+ */
+#ifndef BLOCK_PRIVATE_INFO2
+#define BLOCK_PRIVATE_INFO2(bname, ctx, op, out, in) (-DREW_ERR_INVALID)
+#endif
+
 #define PLUGIN_STRUCTURE(prefix, bname) \
 PLUGIN_STRUCTURE2(prefix, bname) \
 static int prefix ## info(int op, void *p) \
@@ -86,7 +93,7 @@ static int prefix ## info2(const drew_block_t *ctx, int op, drew_param_t *out, \
 		case DREW_BLOCK_INTSIZE: \
 			return sizeof(bname); \
 		default: \
-			return -DREW_ERR_INVALID; \
+			return BLOCK_PRIVATE_INFO2(bname, ctx, op, out, in); \
 	} \
 } \
 static int prefix ## init(drew_block_t *ctx, int flags, \
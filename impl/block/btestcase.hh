@@ -144,6 +144,61 @@ class BlockTestCase
 			delete[] input;
 			return res;
 		}
+		// Check that EncryptFast and DecryptFast produce the same results as
+		// Encrypt and Decrypt.  nblocks should be large enough to exercise all
+		// of the multi-block code paths, including any leftover blocks; for
+		// 64-bit block ciphers, it must be even.
+		static int FastTest(size_t keysz, size_t nblocks)
+		{
+			typedef typename T::FastBlock FastBlock;
+			typedef AlignedBlock<uint8_t, 16> Chunk;
+			const size_t blksz = T::block_size;
+			const size_t len = nblocks * blksz;
+			const size_t nchunks = DivideAndRoundUp(len, 16);
+			T *algo = new T;
+			uint8_t *key = new uint8_t[keysz];
+			Chunk *in = new Chunk[nchunks];
+			Chunk *fast = new Chunk[nchunks];
+			Chunk *slow = new Chunk[nchunks];
+			uint8_t *inp = in->data, *fastp = fast->data, *slowp = slow->data;
+			int res = 0;
+
+			for (size_t i = 0; i < keysz; i++)
+				key[i] = 0x5a ^ (i * 0x3b);
+			for (size_t i = 0; i < len; i++)
+				inp[i] = i * 0x95 + (i >> 8);
+			algo->SetKey(key, keysz);
+
+			for (size_t i = 0; i < len; i += blksz)
+				algo->Encrypt(slowp+i, inp+i);
+			algo->EncryptFast(reinterpret_cast<FastBlock *>(fastp),
+					reinterpret_cast<const FastBlock *>(inp), nblocks);
+			res |= !!memcmp(slowp, fastp, len);
+			res <<= 1;
+
+			for (size_t i = 0; i < len; i += blksz)
+				algo->Decrypt(slowp+i, inp+i);
+			algo->DecryptFast(reinterpret_cast<FastBlock *>(fastp),
+					reinterpret_cast<const FastBlock *>(inp), nblocks);
+			res |= !!memcmp(slowp, fastp, len);
+			res <<= 1;
+
+			// In place, as the modes use it.
+			memcpy(fastp, inp, len);
+			algo->EncryptFast(reinterpret_cast<FastBlock *>(fastp),
+					reinterpret_cast<const FastBlock *>(fastp), nblocks);
+			algo->DecryptFast(reinterpret_cast<FastBlock *>(fastp),
+					reinterpret_cast<const FastBlock *>(fastp), nblocks);
+			res |= !!memcmp(inp, fastp, len);
+
+			delete[] slow;
+			delete[] fast;
+			delete[] in;
+			delete[] key;
+			delete algo;
+
+			return res;
+		}
 	protected:
 		static int MaintenanceTest(T *algo, const uint8_t *output,
 				const uint8_t *input, size_t keysz, size_t blksz)
@@ -0,0 +1,222 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ *
+ * This file is part of the Drew Cryptography Suite.
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of your choice of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation or version 2.0 of the Apache
+ * License as published by the Apache Software Foundation.
+ *
+ * This file is distributed in the hope that it will be useful, but without
+ * any warranty; without even the implied warranty of merchantability or fitness
+ * for a particular purpose.
+ *
+ * Note that people who make modified versions of this file are not obligated to
+ * dual-license their modified versions; it is their choice whether to do so.
+ * If a modified version is not distributed under both licenses, the copyright
+ * and permission notices should be updated accordingly.
+ */
+/* This file is compiled with AES-NI and SSSE3 enabled.  Nothing in it may be
+ * called unless the processor has been checked for support, which is done in
+ * camellia.cc.
+ */
+#include <internal.h>
+
+#include <string.h>
+
+#include "camellia.hh"
+#include "aesni-sbox.hh"
+
+HIDE()
+#ifdef FEATURE_AESNI_SBOX
+using namespace drew::aesni;
+
+/* The affine maps which turn the AES S-box into s1 through s4.  s2 and s3 are
+ * rotations of the output of s1 and s4 a rotation of its input, so only the
+ * maps on that side differ.
+ */
+static const AffineMap pre_s1 = {
+	{0x08, 0x09, 0x11, 0x10, 0xb9, 0xb8, 0xa0, 0xa1,
+	 0xa3, 0xa2, 0xba, 0xbb, 0x12, 0x13, 0x0b, 0x0a},
+	{0x00, 0xa7, 0x93, 0x34, 0x61, 0xc6, 0xf2, 0x55,
+	 0xd9, 0x7e, 0x4a, 0xed, 0xb8, 0x1f, 0x2b, 0x8c}
+};
+static const AffineMap pre_s4 = {
+	{0x58, 0x59, 0x1f, 0x1e, 0xb4, 0xb5, 0xf3, 0xf2,
+	 0xfa, 0xfb, 0xbd, 0xbc, 0x16, 0x17, 0x51, 0x50},
+	{0x00, 0x38, 0x24, 0x1c, 0x19, 0x21, 0x3d, 0x05,
+	 0x22, 0x1a, 0x06, 0x3e, 0x3b, 0x03, 0x1f, 0x27}
+};
+static const AffineMap post_s1 = {
+	{0x11, 0x82, 0x84, 0x17, 0x3e, 0xad, 0xab, 0x38,
+	 0x71, 0xe2, 0xe4, 0x77, 0x5e, 0xcd, 0xcb, 0x58},
+	{0x00, 0xb8, 0xd9, 0x61, 0xa0, 0x18, 0x79, 0xc1,
+	 0xa8, 0x10, 0x71, 0xc9, 0x08, 0xb0, 0xd1, 0x69}
+};
+static const AffineMap post_s2 = {
+	{0x22, 0x05, 0x09, 0x2e, 0x7c, 0x5b, 0x57, 0x70,
+	 0xe2, 0xc5, 0xc9, 0xee, 0xbc, 0x9b, 0x97, 0xb0},
+	{0x00, 0x71, 0xb3, 0xc2, 0x41, 0x30, 0xf2, 0x83,
+	 0x51, 0x20, 0xe2, 0x93, 0x10, 0x61, 0xa3, 0xd2}
+};
+static const AffineMap post_s3 = {
+	{0x88, 0x41, 0x42, 0x8b, 0x1f, 0xd6, 0xd5, 0x1c,
+	 0xb8, 0x71, 0x72, 0xbb, 0x2f, 0xe6, 0xe5, 0x2c},
+	{0x00, 0x5c, 0xec, 0xb0, 0x50, 0x0c, 0xbc, 0xe0,
+	 0x54, 0x08, 0xb8, 0xe4, 0x04, 0x58, 0xe8, 0xb4}
+};
+static const AffineMap post_s4 = {
+	{0xbe, 0x25, 0x3f, 0xa4, 0xf4, 0x6f, 0x75, 0xee,
+	 0x3b, 0xa0, 0xba, 0x21, 0x71, 0xea, 0xf0, 0x6b},
+	{0x00, 0x35, 0xc9, 0xfc, 0x03, 0x36, 0xca, 0xff,
+	 0x0e, 0x3b, 0xc7, 0xf2, 0x0d, 0x38, 0xc4, 0xf1}
+};
+
+static inline uint8_t key_byte(uint64_t k, int i)
+{
+	return k >> (56 - 8 * i);
+}
+
+static inline void add_key(vector_t *x, uint64_t k)
+{
+	for (int i = 0; i < 8; i++)
+		x[i] ^= splat(key_byte(k, i));
+}
+
+/* y ^= F(x, k) for sixteen blocks.  x and y each point to eight vectors, one
+ * for each byte of the half-block, most significant first.
+ */
+static inline void f16(const vector_t *x, vector_t *y, uint64_t k)
+{
+	vector_t t[8];
+
+	for (int i = 0; i < 8; i++)
+		t[i] = x[i] ^ splat(key_byte(k, i));
+
+	t[0] = sbox(t[0], pre_s1, post_s1);
+	t[1] = sbox(t[1], pre_s1, post_s2);
+	t[2] = sbox(t[2], pre_s1, post_s3);
+	t[3] = sbox(t[3], pre_s4, post_s4);
+	t[4] = sbox(t[4], pre_s1, post_s2);
+	t[5] = sbox(t[5], pre_s1, post_s3);
+	t[6] = sbox(t[6], pre_s4, post_s4);
+	t[7] = sbox(t[7], pre_s1, post_s1);
+
+	// The P function.  This leaves the two halves of the output swapped.
+	t[0] ^= t[5]; t[1] ^= t[6]; t[2] ^= t[7]; t[3] ^= t[4];
+	t[4] ^= t[2]; t[5] ^= t[3]; t[6] ^= t[0]; t[7] ^= t[1];
+	t[0] ^= t[7]; t[1] ^= t[4]; t[2] ^= t[5]; t[3] ^= t[6];
+	t[4] ^= t[3]; t[5] ^= t[0]; t[6] ^= t[1]; t[7] ^= t[2];
+
+	for (int i = 0; i < 4; i++) {
+		y[i+0] ^= t[i+4];
+		y[i+4] ^= t[i+0];
+	}
+}
+
+/* x[4..7] ^= (x[0..3] & k) <<< 1, where the 32-bit words are stored as four
+ * byte vectors, most significant first.
+ */
+static inline void and_rotate(vector_t *x, uint64_t k)
+{
+	vector_t t[4];
+
+	for (int i = 0; i < 4; i++)
+		t[i] = x[i] & splat(key_byte(k, i));
+	for (int i = 0; i < 4; i++)
+		x[i+4] ^= (t[i] + t[i]) | (t[(i+1) % 4] >> 7);
+}
+
+static inline void fl16(vector_t *x, uint64_t k)
+{
+	and_rotate(x, k);
+	for (int i = 0; i < 4; i++)
+		x[i] ^= x[i+4] | splat(key_byte(k, i+4));
+}
+
+static inline void flinv16(vector_t *y, uint64_t k)
+{
+	for (int i = 0; i < 4; i++)
+		y[i] ^= y[i+4] | splat(key_byte(k, i+4));
+	and_rotate(y, k);
+}
+
+static inline void load(vector_t *x, const drew::Camellia::FastBlock *in)
+{
+	memcpy(x, in, 16 * sizeof(*x));
+	transpose16(x);
+}
+
+// The halves are swapped on output.
+static inline void store(drew::Camellia::FastBlock *out, vector_t *x)
+{
+	vector_t t[16];
+
+	memcpy(t, x+8, 8 * sizeof(*t));
+	memcpy(t+8, x, 8 * sizeof(*t));
+	transpose16(t);
+	memcpy(out, t, sizeof(t));
+}
+#endif
+
+size_t drew::Camellia::EncryptFast16(FastBlock *bout, const FastBlock *bin,
+		size_t n, unsigned nrounds) const
+{
+#ifdef FEATURE_AESNI_SBOX
+	size_t i;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		vector_t x[16];
+
+		load(x, bin + i);
+		add_key(x+0, kw[0]);
+		add_key(x+8, kw[1]);
+		for (unsigned j = 0; j < nrounds; j += 2) {
+			if (j && !(j % 6)) {
+				fl16(x+0, kl[j/3 - 2]);
+				flinv16(x+8, kl[j/3 - 1]);
+			}
+			f16(x+0, x+8, ku[j]);
+			f16(x+8, x+0, ku[j+1]);
+		}
+		add_key(x+8, kw[2]);
+		add_key(x+0, kw[3]);
+		store(bout + i, x);
+	}
+	return i;
+#else
+	return 0;
+#endif
+}
+
+size_t drew::Camellia::DecryptFast16(FastBlock *bout, const FastBlock *bin,
+		size_t n, unsigned nrounds) const
+{
+#ifdef FEATURE_AESNI_SBOX
+	size_t i;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		vector_t x[16];
+
+		load(x, bin + i);
+		add_key(x+0, kw[2]);
+		add_key(x+8, kw[3]);
+		for (unsigned j = nrounds - 2; j < nrounds; j -= 2) {
+			f16(x+0, x+8, ku[j+1]);
+			f16(x+8, x+0, ku[j]);
+			if (j && !(j % 6)) {
+				fl16(x+0, kl[j/3 - 1]);
+				flinv16(x+8, kl[j/3 - 2]);
+			}
+		}
+		add_key(x+8, kw[0]);
+		add_key(x+0, kw[1]);
+		store(bout + i, x);
+	}
+	return i;
+#else
+	return 0;
+#endif
+}
+UNHIDE()
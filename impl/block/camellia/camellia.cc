@@ -83,6 +83,19 @@ static int camellia_maintenance_test(void)
 	return res;
 }
 
+static int camellia_fast_test(void)
+{
+	using namespace drew;
+	int res = 0;
+
+	// This covers the sixteen-way, four-way, two-way, and single-block code for
+	// both the 18-round and 24-round variants.
+	res |= BlockTestCase<Camellia>::FastTest(16, 16 * 2 + 4 * 3 + 3);
+	res <<= 3;
+	res |= BlockTestCase<Camellia>::FastTest(32, 16 * 2 + 4 * 3 + 3);
+	return res;
+}
+
 static int camelliatest(void *, const drew_loader_t *)
 {
 	int res = 0;
@@ -92,6 +105,8 @@ static int camelliatest(void *, const drew_loader_t *)
 	res |= camellia_big_test();
 	res <<= 12;
 	res |= camellia_maintenance_test();
+	res <<= 6;
+	res |= camellia_fast_test();
 
 	return res;
 }
@@ -398,5 +413,128 @@ void drew::Camellia::Decrypt256(uint64_t d[2]) const
 	std::swap(x, y);
 }
 
+// These process N independent blocks at once using R rounds (18 or 24).  Each
+// round is latency-bound on the eight S-box lookups, so interleaving the blocks
+// lets the lookups for one block proceed while the others are still waiting.
+template<size_t N, unsigned R>
+void drew::Camellia::EncryptBlocks(FastBlock *bout, const FastBlock *bin) const
+{
+	uint64_t x[N], y[N];
+
+	for (size_t j = 0; j < N; j++) {
+		x[j] = E::Convert<uint64_t>(bin[j].data) ^ kw[0];
+		y[j] = E::Convert<uint64_t>(bin[j].data + 8) ^ kw[1];
+	}
+	for (unsigned i = 0; i < R; i += 2) {
+		if (i && !(i % 6)) {
+			for (size_t j = 0; j < N; j++) {
+				x[j] = fl(x[j], kl[i/3 - 2]);
+				y[j] = flinv(y[j], kl[i/3 - 1]);
+			}
+		}
+		for (size_t j = 0; j < N; j++)
+			y[j] ^= f(x[j], ku[i]);
+		for (size_t j = 0; j < N; j++)
+			x[j] ^= f(y[j], ku[i+1]);
+	}
+	for (size_t j = 0; j < N; j++) {
+		E::Convert(bout[j].data, y[j] ^ kw[2]);
+		E::Convert(bout[j].data + 8, x[j] ^ kw[3]);
+	}
+}
+
+template<size_t N, unsigned R>
+void drew::Camellia::DecryptBlocks(FastBlock *bout, const FastBlock *bin) const
+{
+	uint64_t x[N], y[N];
+
+	for (size_t j = 0; j < N; j++) {
+		x[j] = E::Convert<uint64_t>(bin[j].data) ^ kw[2];
+		y[j] = E::Convert<uint64_t>(bin[j].data + 8) ^ kw[3];
+	}
+	for (unsigned i = R - 2; i < R; i -= 2) {
+		for (size_t j = 0; j < N; j++)
+			y[j] ^= f(x[j], ku[i+1]);
+		for (size_t j = 0; j < N; j++)
+			x[j] ^= f(y[j], ku[i]);
+		if (i && !(i % 6)) {
+			for (size_t j = 0; j < N; j++) {
+				x[j] = fl(x[j], kl[i/3 - 1]);
+				y[j] = flinv(y[j], kl[i/3 - 2]);
+			}
+		}
+	}
+	for (size_t j = 0; j < N; j++) {
+		E::Convert(bout[j].data, y[j] ^ kw[0]);
+		E::Convert(bout[j].data + 8, x[j] ^ kw[1]);
+	}
+}
+
+static bool use_aesni()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	static const bool aesni = HasAESNI();
+	return aesni;
+#else
+	return false;
+#endif
+}
+
+template<unsigned R>
+void drew::Camellia::EncryptMany(FastBlock *bout, const FastBlock *bin,
+		size_t n) const
+{
+	if (use_aesni()) {
+		size_t done = EncryptFast16(bout, bin, n, R);
+		n -= done, bout += done, bin += done;
+	}
+	for (; n >= 4; n -= 4, bout += 4, bin += 4)
+		EncryptBlocks<4, R>(bout, bin);
+	if (n >= 2) {
+		EncryptBlocks<2, R>(bout, bin);
+		n -= 2, bout += 2, bin += 2;
+	}
+	if (n)
+		EncryptBlocks<1, R>(bout, bin);
+}
+
+template<unsigned R>
+void drew::Camellia::DecryptMany(FastBlock *bout, const FastBlock *bin,
+		size_t n) const
+{
+	if (use_aesni()) {
+		size_t done = DecryptFast16(bout, bin, n, R);
+		n -= done, bout += done, bin += done;
+	}
+	for (; n >= 4; n -= 4, bout += 4, bin += 4)
+		DecryptBlocks<4, R>(bout, bin);
+	if (n >= 2) {
+		DecryptBlocks<2, R>(bout, bin);
+		n -= 2, bout += 2, bin += 2;
+	}
+	if (n)
+		DecryptBlocks<1, R>(bout, bin);
+}
+
+int drew::Camellia::EncryptFast(FastBlock *bout, const FastBlock *bin,
+		size_t n) const
+{
+	if (fenc == &Camellia::Encrypt256)
+		EncryptMany<24>(bout, bin, n);
+	else
+		EncryptMany<18>(bout, bin, n);
+	return 0;
+}
+
+int drew::Camellia::DecryptFast(FastBlock *bout, const FastBlock *bin,
+		size_t n) const
+{
+	if (fdec == &Camellia::Decrypt256)
+		DecryptMany<24>(bout, bin, n);
+	else
+		DecryptMany<18>(bout, bin, n);
+	return 0;
+}
+
 #include "tables.cc"
 UNHIDE()
@@ -36,6 +36,8 @@ class Camellia : public BlockCipher<16, BigEndian>
 		~Camellia() {};
 		int Encrypt(uint8_t *out, const uint8_t *in) const;
 		int Decrypt(uint8_t *out, const uint8_t *in) const;
+		int EncryptFast(FastBlock *bout, const FastBlock *bin, size_t n) const;
+		int DecryptFast(FastBlock *bout, const FastBlock *bin, size_t n) const;
 	protected:
 		int SetKeyInternal(const uint8_t *key, size_t sz);
 		void SetKey128(uint64_t k[4]);
@@ -45,6 +47,14 @@ class Camellia : public BlockCipher<16, BigEndian>
 		void Encrypt256(uint64_t d[2]) const;
 		void Decrypt128(uint64_t d[2]) const;
 		void Decrypt256(uint64_t d[2]) const;
+		template<size_t N, unsigned R>
+		void EncryptBlocks(FastBlock *bout, const FastBlock *bin) const;
+		template<size_t N, unsigned R>
+		void DecryptBlocks(FastBlock *bout, const FastBlock *bin) const;
+		template<unsigned R>
+		void EncryptMany(FastBlock *bout, const FastBlock *bin, size_t n) const;
+		template<unsigned R>
+		void DecryptMany(FastBlock *bout, const FastBlock *bin, size_t n) const;
 		inline void EncryptPair(uint64_t &, uint64_t &, unsigned) const;
 		inline void DecryptPair(uint64_t &, uint64_t &, unsigned) const;
 		uint64_t f(uint64_t x, uint64_t k) const;
@@ -58,6 +68,13 @@ class Camellia : public BlockCipher<16, BigEndian>
 		void (Camellia::*fdec)(uint64_t d[2]) const;
 		static const uint64_t s[8][256];
 	private:
+		// These process sixteen blocks at a time using AES-NI and return the
+		// number of blocks processed.  They must not be called unless the
+		// processor supports AES-NI.
+		size_t EncryptFast16(FastBlock *bout, const FastBlock *bin, size_t n,
+				unsigned nrounds) const;
+		size_t DecryptFast16(FastBlock *bout, const FastBlock *bin, size_t n,
+				unsigned nrounds) const;
 };
 
 }
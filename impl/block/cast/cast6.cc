@@ -54,6 +54,14 @@ static int cast6_maintenance_test(void)
 	return result;
 }
 
+static int cast6_fast_test(void)
+{
+	using namespace drew;
+
+	// This covers the four-way, two-way, and single-block code.
+	return BlockTestCase<CAST6>::FastTest(32, 4 * 3 + 3);
+}
+
 static int cast6test(void *, const drew_loader_t *)
 {
 	using namespace drew;
@@ -99,6 +107,8 @@ static int cast6test(void *, const drew_loader_t *)
 			"4f6a2038286897b9c9870136553317fa", 16);
 	res <<= 2;
 	res |= cast6_maintenance_test();
+	res <<= 3;
+	res |= cast6_fast_test();
 
 	return res;
 }
@@ -228,4 +238,90 @@ int drew::CAST6::Decrypt(uint8_t *out, const uint8_t *in) const
 
 	return 0;
 }
+
+// These process N independent blocks at once.  Each quad-round is a chain of
+// dependent S-box lookups, so interleaving the blocks lets the lookups for one
+// block proceed while the others are still waiting.
+#define QN(d, i) do { \
+	for (size_t j = 0; j < N; j++) \
+		d[j][2] ^= f1(d[j][3], m_km[0][i], m_kr[0][i]); \
+	for (size_t j = 0; j < N; j++) \
+		d[j][1] ^= f2(d[j][2], m_km[1][i], m_kr[1][i]); \
+	for (size_t j = 0; j < N; j++) \
+		d[j][0] ^= f3(d[j][1], m_km[2][i], m_kr[2][i]); \
+	for (size_t j = 0; j < N; j++) \
+		d[j][3] ^= f1(d[j][0], m_km[3][i], m_kr[3][i]); \
+} while (0)
+#define QbarN(d, i) do { \
+	for (size_t j = 0; j < N; j++) \
+		d[j][3] ^= f1(d[j][0], m_km[3][i], m_kr[3][i]); \
+	for (size_t j = 0; j < N; j++) \
+		d[j][0] ^= f3(d[j][1], m_km[2][i], m_kr[2][i]); \
+	for (size_t j = 0; j < N; j++) \
+		d[j][1] ^= f2(d[j][2], m_km[1][i], m_kr[1][i]); \
+	for (size_t j = 0; j < N; j++) \
+		d[j][2] ^= f1(d[j][3], m_km[0][i], m_kr[0][i]); \
+} while (0)
+
+template<size_t N>
+void drew::CAST6::EncryptBlocks(FastBlock *bout, const FastBlock *bin) const
+{
+	uint32_t data[N][4];
+
+	for (size_t j = 0; j < N; j++)
+		E::Copy(data[j], bin[j].data, sizeof(data[j]));
+
+	for (size_t i = 0; i < 6; i++)
+		QN(data, i);
+	for (size_t i = 6; i < 12; i++)
+		QbarN(data, i);
+
+	for (size_t j = 0; j < N; j++)
+		E::Copy(bout[j].data, data[j], sizeof(data[j]));
+}
+
+template<size_t N>
+void drew::CAST6::DecryptBlocks(FastBlock *bout, const FastBlock *bin) const
+{
+	uint32_t data[N][4];
+
+	for (size_t j = 0; j < N; j++)
+		E::Copy(data[j], bin[j].data, sizeof(data[j]));
+
+	for (size_t i = 11; i >= 6; i--)
+		QN(data, i);
+	for (size_t i = 6; i-- > 0; )
+		QbarN(data, i);
+
+	for (size_t j = 0; j < N; j++)
+		E::Copy(bout[j].data, data[j], sizeof(data[j]));
+}
+
+int drew::CAST6::EncryptFast(FastBlock *bout, const FastBlock *bin,
+		size_t n) const
+{
+	for (; n >= 4; n -= 4, bout += 4, bin += 4)
+		EncryptBlocks<4>(bout, bin);
+	if (n >= 2) {
+		EncryptBlocks<2>(bout, bin);
+		n -= 2, bout += 2, bin += 2;
+	}
+	if (n)
+		Encrypt(bout->data, bin->data);
+	return 0;
+}
+
+int drew::CAST6::DecryptFast(FastBlock *bout, const FastBlock *bin,
+		size_t n) const
+{
+	for (; n >= 4; n -= 4, bout += 4, bin += 4)
+		DecryptBlocks<4>(bout, bin);
+	if (n >= 2) {
+		DecryptBlocks<2>(bout, bin);
+		n -= 2, bout += 2, bin += 2;
+	}
+	if (n)
+		Decrypt(bout->data, bin->data);
+	return 0;
+}
 UNHIDE()
@@ -37,9 +37,15 @@ class CAST6 : public CAST, public BlockCipher<16, BigEndian>
 		~CAST6() {};
 		int Encrypt(uint8_t *out, const uint8_t *in) const;
 		int Decrypt(uint8_t *out, const uint8_t *in) const;
+		int EncryptFast(FastBlock *bout, const FastBlock *bin, size_t n) const;
+		int DecryptFast(FastBlock *bout, const FastBlock *bin, size_t n) const;
 	protected:
 		int SetKeyInternal(const uint8_t *key, size_t sz);
 	private:
+		template<size_t N>
+		void EncryptBlocks(FastBlock *bout, const FastBlock *bin) const;
+		template<size_t N>
+		void DecryptBlocks(FastBlock *bout, const FastBlock *bin) const;
 		uint32_t m_km[4][12];
 		uint8_t m_kr[4][12];
 };
@@ -0,0 +1,51 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ *
+ * This file is part of the Drew Cryptography Suite.
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of your choice of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation or version 2.0 of the Apache
+ * License as published by the Apache Software Foundation.
+ *
+ * This file is distributed in the hope that it will be useful, but without
+ * any warranty; without even the implied warranty of merchantability or fitness
+ * for a particular purpose.
+ *
+ * Note that people who make modified versions of this file are not obligated to
+ * dual-license their modified versions; it is their choice whether to do so.
+ * If a modified version is not distributed under both licenses, the copyright
+ * and permission notices should be updated accordingly.
+ */
+/* This file is compiled with AVX2 enabled.  Nothing in it may be called unless
+ * the processor has been checked for AVX2 support, which is done in des.cc.
+ */
+#include <internal.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <drew/block.h>
+#include "des.hh"
+#include "des-bitslice.hh"
+
+#if defined(DES_VECTOR) && defined(__AVX2__)
+#define FEATURE_AVX2
+#endif
+
+HIDE()
+#ifdef FEATURE_AVX2
+// 256 blocks per batch.
+typedef uint64_t vector_t __attribute__((vector_size(32)));
+#endif
+
+size_t drew::DES::CryptBitsliceAVX2(uint8_t *out, const uint8_t *in, size_t n,
+		const uint32_t *const *ks, size_t nks)
+{
+#ifdef FEATURE_AVX2
+	return bs_crypt<vector_t>(out, in, n, ks, nks);
+#else
+	return 0;
+#endif
+}
+UNHIDE()
@@ -0,0 +1,729 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ *
+ * This file is part of the Drew Cryptography Suite.
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of your choice of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation or version 2.0 of the Apache
+ * License as published by the Apache Software Foundation.
+ *
+ * This file is distributed in the hope that it will be useful, but without
+ * any warranty; without even the implied warranty of merchantability or fitness
+ * for a particular purpose.
+ *
+ * Note that people who make modified versions of this file are not obligated to
+ * dual-license their modified versions; it is their choice whether to do so.
+ * If a modified version is not distributed under both licenses, the copyright
+ * and permission notices should be updated accordingly.
+ */
+#ifndef DES_BITSLICE_HH
+#define DES_BITSLICE_HH
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "util.hh"
+
+/* A bitsliced implementation of DES.  The state is kept as 64 words of type T,
+ * where word i holds bit i (counting from the most significant bit, as the DES
+ * standard does) of every block in the batch.  T is either a uint64_t, which
+ * holds 64 blocks, or a vector of uint64_t, which holds 64 blocks per element.
+ * The permutations then cost nothing but a change of index, and each S-box is
+ * a fixed sequence of logical operations.
+ *
+ * Everything here has internal linkage, since this file is compiled with
+ * different instruction set flags in different translation units.
+ */
+
+#if defined(VECTOR_T) && !defined(__clang__) && DREW_GCC_VERSION >= 0x040700
+#define DES_VECTOR
+#endif
+
+HIDE()
+/* The initial permutation, zero-based. */
+static const uint8_t bs_ip[64] = {
+	57, 49, 41, 33, 25, 17,  9,  1,
+	59, 51, 43, 35, 27, 19, 11,  3,
+	61, 53, 45, 37, 29, 21, 13,  5,
+	63, 55, 47, 39, 31, 23, 15,  7,
+	56, 48, 40, 32, 24, 16,  8,  0,
+	58, 50, 42, 34, 26, 18, 10,  2,
+	60, 52, 44, 36, 28, 20, 12,  4,
+	62, 54, 46, 38, 30, 22, 14,  6
+};
+
+/* The final permutation, zero-based. */
+static const uint8_t bs_fp[64] = {
+	39,  7, 47, 15, 55, 23, 63, 31,
+	38,  6, 46, 14, 54, 22, 62, 30,
+	37,  5, 45, 13, 53, 21, 61, 29,
+	36,  4, 44, 12, 52, 20, 60, 28,
+	35,  3, 43, 11, 51, 19, 59, 27,
+	34,  2, 42, 10, 50, 18, 58, 26,
+	33,  1, 41,  9, 49, 17, 57, 25,
+	32,  0, 40,  8, 48, 16, 56, 24
+};
+
+/* The inverse of P: the position in the output of f of each S-box output bit.
+ */
+static const uint8_t bs_pinv[32] = {
+	 8, 16, 22, 30, 12, 27,  1, 17,
+	23, 15, 29,  5, 25, 19,  9,  0,
+	 7, 13, 24,  2,  3, 28, 10, 18,
+	31, 11, 21,  6,  4, 26, 14, 20
+};
+
+/* The S-boxes as circuits, derived from the standard tables by Shannon
+ * expansion.  a[0] through a[5] are the input bits and o[0] through o[3] the
+ * output bits, most significant first in both cases.
+ */
+template<class T>
+static inline void s1(T *o, const T *a)
+{
+	const T x0 = ~a[3];
+	const T x1 = a[5] ^ x0;
+	const T x2 = a[5] | x0;
+	const T x3 = x1 ^ (~a[4] & x2);
+	const T x4 = a[0] ^ a[3];
+	const T x5 = a[0] | a[3];
+	const T x6 = x4 ^ x5;
+	const T x7 = x4 ^ (a[4] & x6);
+	const T x8 = x3 ^ (~a[1] & x7);
+	const T x9 = a[0] | x0;
+	const T x10 = a[5] | x9;
+	const T x11 = x10 ^ (a[4] & x5);
+	const T x12 = a[0] & x0;
+	const T x13 = x0 ^ (~a[5] & x12);
+	const T x14 = a[5] & a[0];
+	const T x15 = x13 ^ (~a[4] & x14);
+	const T x16 = x11 ^ (a[1] & x15);
+	const T x17 = x8 ^ (~a[2] & x16);
+	const T x18 = ~x5;
+	const T x19 = a[0] ^ (~a[5] & x18);
+	const T x20 = x19 ^ (a[4] & x1);
+	const T x21 = ~x6;
+	const T x22 = ~x4;
+	const T x23 = x21 ^ (~a[5] & x22);
+	const T x24 = x9 ^ (~a[5] & a[0]);
+	const T x25 = x23 ^ (~a[4] & x24);
+	const T x26 = x20 ^ (~a[1] & x25);
+	const T x27 = ~x12;
+	const T x28 = a[5] | x27;
+	const T x29 = ~a[5] & x27;
+	const T x30 = x28 ^ (~a[4] & x29);
+	const T x31 = ~x28;
+	const T x32 = ~a[0];
+	const T x33 = a[5] & x32;
+	const T x34 = x31 ^ (~a[4] & x33);
+	const T x35 = x30 ^ (~a[1] & x34);
+	const T x36 = x26 ^ (a[2] & x35);
+	const T x37 = x6 ^ (~a[5] & x9);
+	const T x38 = a[5] | x18;
+	const T x39 = x37 ^ (~a[4] & x38);
+	const T x40 = x21 ^ (a[5] & x4);
+	const T x41 = a[3] ^ (a[5] & x12);
+	const T x42 = x40 ^ (~a[4] & x41);
+	const T x43 = x39 ^ (a[1] & x42);
+	const T x44 = ~x29;
+	const T x45 = ~(a[5] & x18);
+	const T x46 = x44 ^ (~a[4] & x45);
+	const T x47 = a[5] | x6;
+	const T x48 = x44 ^ x47;
+	const T x49 = x44 ^ (a[4] & x48);
+	const T x50 = x46 ^ (a[1] & x49);
+	const T x51 = x43 ^ (~a[2] & x50);
+	const T x52 = a[5] & x22;
+	const T x53 = a[5] | x22;
+	const T x54 = x52 ^ (~a[4] & x53);
+	const T x55 = a[5] | x5;
+	const T x56 = a[5] ^ x22;
+	const T x57 = x55 ^ x56;
+	const T x58 = x55 ^ (a[4] & x57);
+	const T x59 = x54 ^ (a[1] & x58);
+	const T x60 = x32 ^ (a[5] & x12);
+	const T x61 = a[4] | x60;
+	const T x62 = ~x55;
+	const T x63 = ~x48;
+	const T x64 = x62 ^ (a[4] & x63);
+	const T x65 = x61 ^ (~a[1] & x64);
+	const T x66 = x59 ^ (a[2] & x65);
+
+	o[0] = x17;
+	o[1] = x51;
+	o[2] = x66;
+	o[3] = x36;
+}
+
+template<class T>
+static inline void s2(T *o, const T *a)
+{
+	const T x0 = ~a[5];
+	const T x1 = a[4] ^ x0;
+	const T x2 = ~a[4] & x0;
+	const T x3 = x1 ^ x2;
+	const T x4 = x1 ^ (a[0] & x3);
+	const T x5 = a[3] ^ x4;
+	const T x6 = a[4] | x0;
+	const T x7 = a[5] ^ (a[0] & x6);
+	const T x8 = x5 ^ (~a[2] & x7);
+	const T x9 = a[0] | x1;
+	const T x10 = ~a[4];
+	const T x11 = ~x3;
+	const T x12 = x10 ^ x11;
+	const T x13 = x10 ^ (a[0] & x12);
+	const T x14 = x9 ^ (~a[3] & x13);
+	const T x15 = ~a[0] & x0;
+	const T x16 = x14 ^ (a[2] & x15);
+	const T x17 = x8 ^ (~a[1] & x16);
+	const T x18 = x0 ^ (~a[0] & x12);
+	const T x19 = a[0] | x11;
+	const T x20 = x18 ^ (~a[3] & x19);
+	const T x21 = x3 ^ (~a[0] & x2);
+	const T x22 = x20 ^ (~a[2] & x21);
+	const T x23 = ~x12;
+	const T x24 = a[5] ^ (a[0] & x23);
+	const T x25 = ~x2;
+	const T x26 = a[0] | x25;
+	const T x27 = x24 ^ x26;
+	const T x28 = x24 ^ (a[3] & x27);
+	const T x29 = ~x6;
+	const T x30 = x12 ^ (a[0] & x29);
+	const T x31 = x28 ^ (a[2] & x30);
+	const T x32 = x22 ^ (a[1] & x31);
+	const T x33 = a[0] ^ x25;
+	const T x34 = x33 ^ (~a[3] & x11);
+	const T x35 = a[5] ^ (a[3] & x3);
+	const T x36 = x34 ^ (a[2] & x35);
+	const T x37 = a[0] & x12;
+	const T x38 = x2 ^ (~a[0] & x12);
+	const T x39 = x37 ^ (a[3] & x38);
+	const T x40 = ~x37;
+	const T x41 = x39 ^ (~a[2] & x40);
+	const T x42 = x36 ^ (a[1] & x41);
+	const T x43 = x11 ^ (~a[0] & x23);
+	const T x44 = ~(a[0] & a[4]);
+	const T x45 = x43 ^ (~a[3] & x44);
+	const T x46 = x40 ^ x21;
+	const T x47 = x40 ^ (a[3] & x46);
+	const T x48 = x45 ^ x47;
+	const T x49 = x45 ^ (a[2] & x48);
+	const T x50 = a[0] | x6;
+	const T x51 = a[3] | x50;
+	const T x52 = ~x38;
+	const T x53 = x52 ^ (~a[3] & a[0]);
+	const T x54 = x51 ^ (~a[2] & x53);
+	const T x55 = x49 ^ (a[1] & x54);
+
+	o[0] = x17;
+	o[1] = x42;
+	o[2] = x55;
+	o[3] = x32;
+}
+
+template<class T>
+static inline void s3(T *o, const T *a)
+{
+	const T x0 = ~a[0];
+	const T x1 = a[1] & x0;
+	const T x2 = a[4] ^ x1;
+	const T x3 = a[2] ^ x2;
+	const T x4 = a[1] | a[0];
+	const T x5 = a[4] | x4;
+	const T x6 = ~a[1];
+	const T x7 = x6 ^ (a[4] & x0);
+	const T x8 = x5 ^ (~a[2] & x7);
+	const T x9 = x3 ^ (~a[5] & x8);
+	const T x10 = a[0] ^ x6;
+	const T x11 = a[0] ^ (a[4] & x10);
+	const T x12 = ~x2;
+	const T x13 = x11 ^ (~a[2] & x12);
+	const T x14 = a[1] | x0;
+	const T x15 = ~a[4] & x14;
+	const T x16 = ~x4;
+	const T x17 = x16 ^ (a[4] & x0);
+	const T x18 = x15 ^ (a[2] & x17);
+	const T x19 = x13 ^ (a[5] & x18);
+	const T x20 = x9 ^ (a[3] & x19);
+	const T x21 = x0 ^ (a[4] & x4);
+	const T x22 = a[4] | a[1];
+	const T x23 = x21 ^ (a[2] & x22);
+	const T x24 = ~x10;
+	const T x25 = a[4] ^ x24;
+	const T x26 = x25 ^ (~a[2] & a[1]);
+	const T x27 = x23 ^ x26;
+	const T x28 = x23 ^ (a[5] & x27);
+	const T x29 = x5 ^ (a[2] & x16);
+	const T x30 = x16 ^ (~a[4] & x1);
+	const T x31 = a[4] & x0;
+	const T x32 = x30 ^ (~a[2] & x31);
+	const T x33 = x29 ^ (a[5] & x32);
+	const T x34 = x28 ^ (~a[3] & x33);
+	const T x35 = ~a[4];
+	const T x36 = x10 ^ (a[2] & x35);
+	const T x37 = ~x1;
+	const T x38 = a[4] | x37;
+	const T x39 = a[2] | x38;
+	const T x40 = x36 ^ (~a[5] & x39);
+	const T x41 = x2 ^ (a[2] & x1);
+	const T x42 = a[4] ^ x6;
+	const T x43 = a[4] & a[0];
+	const T x44 = x42 ^ (~a[2] & x43);
+	const T x45 = x41 ^ (a[5] & x44);
+	const T x46 = x40 ^ (a[3] & x45);
+	const T x47 = ~(a[1] & a[0]);
+	const T x48 = x16 ^ (a[4] & x47);
+	const T x49 = ~x15;
+	const T x50 = x48 ^ (a[2] & x49);
+	const T x51 = a[4] | x47;
+	const T x52 = x50 ^ (a[5] & x51);
+	const T x53 = ~x31;
+	const T x54 = ~x14;
+	const T x55 = ~x47;
+	const T x56 = x54 ^ (~a[2] & x55);
+	const T x57 = x53 ^ (a[5] & x56);
+	const T x58 = x52 ^ (~a[3] & x57);
+
+	o[0] = x34;
+	o[1] = x46;
+	o[2] = x20;
+	o[3] = x58;
+}
+
+template<class T>
+static inline void s4(T *o, const T *a)
+{
+	const T x0 = a[4] | a[2];
+	const T x1 = ~a[4] & a[2];
+	const T x2 = x0 ^ (a[0] & x1);
+	const T x3 = a[4] ^ a[2];
+	const T x4 = a[0] | x3;
+	const T x5 = x2 ^ (~a[3] & x4);
+	const T x6 = ~a[2];
+	const T x7 = ~x3;
+	const T x8 = ~(a[0] & x7);
+	const T x9 = x6 ^ x8;
+	const T x10 = x6 ^ (a[3] & x9);
+	const T x11 = x5 ^ (~a[1] & x10);
+	const T x12 = a[4] & x6;
+	const T x13 = x3 ^ (a[0] & x12);
+	const T x14 = ~a[4];
+	const T x15 = ~x1;
+	const T x16 = x14 ^ (a[0] & x15);
+	const T x17 = x13 ^ (a[3] & x16);
+	const T x18 = ~x12;
+	const T x19 = a[0] | x18;
+	const T x20 = x19 ^ (a[3] & x3);
+	const T x21 = x17 ^ (a[1] & x20);
+	const T x22 = x11 ^ (a[5] & x21);
+	const T x23 = ~x21;
+	const T x24 = x11 ^ (~a[5] & x23);
+	const T x25 = x18 ^ (~a[0] & x15);
+	const T x26 = x25 ^ (~a[3] & x14);
+	const T x27 = x14 ^ (a[0] & x12);
+	const T x28 = x27 ^ (a[3] & x8);
+	const T x29 = x26 ^ x28;
+	const T x30 = x26 ^ (a[1] & x29);
+	const T x31 = a[0] ^ x3;
+	const T x32 = x31 ^ (a[3] & x2);
+	const T x33 = x6 ^ (a[0] & x1);
+	const T x34 = x33 ^ (~a[3] & x9);
+	const T x35 = x32 ^ (~a[1] & x34);
+	const T x36 = x30 ^ x35;
+	const T x37 = x30 ^ (a[5] & x36);
+	const T x38 = ~x30;
+	const T x39 = ~x36;
+	const T x40 = x38 ^ (~a[5] & x39);
+
+	o[0] = x24;
+	o[1] = x22;
+	o[2] = x40;
+	o[3] = x37;
+}
+
+template<class T>
+static inline void s5(T *o, const T *a)
+{
+	const T x0 = ~a[1];
+	const T x1 = a[4] | x0;
+	const T x2 = a[1] ^ x1;
+	const T x3 = a[1] ^ (a[5] & x2);
+	const T x4 = ~x2;
+	const T x5 = a[4] ^ (a[5] & x4);
+	const T x6 = x3 ^ (a[3] & x5);
+	const T x7 = a[4] & x0;
+	const T x8 = ~(a[5] & x7);
+	const T x9 = x8 ^ x3;
+	const T x10 = x8 ^ (a[3] & x9);
+	const T x11 = x6 ^ (a[2] & x10);
+	const T x12 = a[4] | a[1];
+	const T x13 = x12 ^ (~a[5] & x1);
+	const T x14 = x13 ^ x2;
+	const T x15 = x13 ^ (a[3] & x14);
+	const T x16 = a[4] ^ x0;
+	const T x17 = ~a[5] & x16;
+	const T x18 = ~x16;
+	const T x19 = x17 ^ (~a[3] & x18);
+	const T x20 = x15 ^ (~a[2] & x19);
+	const T x21 = x11 ^ (~a[0] & x20);
+	const T x22 = x12 ^ (a[5] & a[4]);
+	const T x23 = ~x1;
+	const T x24 = x7 ^ (~a[5] & x23);
+	const T x25 = x22 ^ (~a[3] & x24);
+	const T x26 = a[5] | a[4];
+	const T x27 = x2 ^ (~a[3] & x26);
+	const T x28 = x25 ^ (a[2] & x27);
+	const T x29 = ~x12;
+	const T x30 = x13 ^ (~a[3] & x29);
+	const T x31 = ~a[5] & x1;
+	const T x32 = x0 ^ (~a[5] & x12);
+	const T x33 = x31 ^ x32;
+	const T x34 = x31 ^ (a[3] & x33);
+	const T x35 = x30 ^ (a[2] & x34);
+	const T x36 = x28 ^ (a[0] & x35);
+	const T x37 = a[5] ^ x16;
+	const T x38 = x37 ^ (~a[3] & x0);
+	const T x39 = ~(a[5] & x16);
+	const T x40 = a[3] | x39;
+	const T x41 = x38 ^ (a[2] & x40);
+	const T x42 = ~(a[5] & x0);
+	const T x43 = x37 ^ (~a[3] & x42);
+	const T x44 = x9 ^ (a[3] & x33);
+	const T x45 = x43 ^ (~a[2] & x44);
+	const T x46 = x41 ^ x45;
+	const T x47 = x41 ^ (a[0] & x46);
+	const T x48 = ~x31;
+	const T x49 = x7 ^ (~a[3] & x48);
+	const T x50 = x49 ^ (a[2] & x1);
+	const T x51 = x2 ^ (a[5] & x16);
+	const T x52 = x29 ^ (~a[5] & x4);
+	const T x53 = x51 ^ (a[3] & x52);
+	const T x54 = a[5] ^ x12;
+	const T x55 = a[5] & x29;
+	const T x56 = x54 ^ (~a[3] & x55);
+	const T x57 = x53 ^ x56;
+	const T x58 = x53 ^ (a[2] & x57);
+	const T x59 = x50 ^ (~a[0] & x58);
+
+	o[0] = x21;
+	o[1] = x47;
+	o[2] = x59;
+	o[3] = x36;
+}
+
+template<class T>
+static inline void s6(T *o, const T *a)
+{
+	const T x0 = ~a[2];
+	const T x1 = a[3] ^ x0;
+	const T x2 = a[4] ^ x1;
+	const T x3 = ~a[3];
+	const T x4 = ~x1;
+	const T x5 = x3 ^ (a[4] & x4);
+	const T x6 = x2 ^ x5;
+	const T x7 = x2 ^ (a[0] & x6);
+	const T x8 = ~(a[4] & x3);
+	const T x9 = x8 ^ (a[0] & x0);
+	const T x10 = x7 ^ (~a[5] & x9);
+	const T x11 = a[2] ^ (a[4] & x4);
+	const T x12 = x1 ^ (~a[4] & a[3]);
+	const T x13 = x11 ^ (a[0] & x12);
+	const T x14 = a[4] & x1;
+	const T x15 = a[4] ^ x14;
+	const T x16 = a[4] ^ (a[0] & x15);
+	const T x17 = x13 ^ (a[5] & x16);
+	const T x18 = x10 ^ (~a[1] & x17);
+	const T x19 = a[4] & a[2];
+	const T x20 = x6 ^ (~a[0] & x19);
+	const T x21 = a[3] & x0;
+	const T x22 = a[3] ^ (~a[4] & x21);
+	const T x23 = a[0] | x22;
+	const T x24 = x20 ^ (~a[5] & x23);
+	const T x25 = a[3] | a[2];
+	const T x26 = a[3] & a[2];
+	const T x27 = x26 ^ (a[4] & a[3]);
+	const T x28 = ~x25;
+	const T x29 = x27 ^ x28;
+	const T x30 = x27 ^ (a[0] & x29);
+	const T x31 = x25 ^ (a[5] & x30);
+	const T x32 = x24 ^ (a[1] & x31);
+	const T x33 = a[3] ^ (a[4] & x1);
+	const T x34 = x0 ^ (a[4] & x21);
+	const T x35 = x33 ^ (~a[0] & x34);
+	const T x36 = ~(a[0] & x11);
+	const T x37 = x35 ^ (a[5] & x36);
+	const T x38 = x3 ^ (a[0] & x11);
+	const T x39 = a[4] | x3;
+	const T x40 = x39 ^ (a[0] & x27);
+	const T x41 = x38 ^ x40;
+	const T x42 = x38 ^ (a[5] & x41);
+	const T x43 = x37 ^ (a[1] & x42);
+	const T x44 = x26 ^ (a[4] & x25);
+	const T x45 = a[4] | a[2];
+	const T x46 = x44 ^ (~a[0] & x45);
+	const T x47 = ~x26;
+	const T x48 = x47 ^ (~a[4] & a[2]);
+	const T x49 = x1 ^ (~a[0] & x48);
+	const T x50 = x46 ^ x49;
+	const T x51 = x46 ^ (a[5] & x50);
+	const T x52 = x25 ^ (a[4] & x4);
+	const T x53 = x26 ^ (a[0] & x52);
+	const T x54 = x0 ^ (a[5] & x53);
+	const T x55 = x51 ^ (~a[1] & x54);
+
+	o[0] = x55;
+	o[1] = x43;
+	o[2] = x18;
+	o[3] = x32;
+}
+
+template<class T>
+static inline void s7(T *o, const T *a)
+{
+	const T x0 = ~a[4];
+	const T x1 = a[3] ^ x0;
+	const T x2 = a[1] & x0;
+	const T x3 = ~(a[3] & x2);
+	const T x4 = x1 ^ (a[5] & x3);
+	const T x5 = x2 ^ (a[3] & a[1]);
+	const T x6 = ~(a[5] & x5);
+	const T x7 = x4 ^ (a[0] & x6);
+	const T x8 = a[1] ^ a[4];
+	const T x9 = x8 ^ (~a[3] & x0);
+	const T x10 = ~x9;
+	const T x11 = a[5] & x10;
+	const T x12 = x9 ^ (a[0] & x11);
+	const T x13 = x7 ^ (~a[2] & x12);
+	const T x14 = a[4] ^ (a[3] & a[1]);
+	const T x15 = a[5] ^ x14;
+	const T x16 = ~x2;
+	const T x17 = a[1] ^ x16;
+	const T x18 = a[1] ^ (a[3] & x17);
+	const T x19 = ~a[3] & a[4];
+	const T x20 = x18 ^ (a[5] & x19);
+	const T x21 = x15 ^ x20;
+	const T x22 = x15 ^ (a[0] & x21);
+	const T x23 = x0 ^ (~a[3] & x8);
+	const T x24 = a[5] | x23;
+	const T x25 = a[1] | x0;
+	const T x26 = x25 ^ (~a[5] & x23);
+	const T x27 = x24 ^ (a[0] & x26);
+	const T x28 = x22 ^ (a[2] & x27);
+	const T x29 = ~x23;
+	const T x30 = a[1] | a[4];
+	const T x31 = x30 ^ (~a[3] & x16);
+	const T x32 = x29 ^ (~a[5] & x31);
+	const T x33 = a[3] | x16;
+	const T x34 = a[3] & x25;
+	const T x35 = x33 ^ x34;
+	const T x36 = x33 ^ (a[5] & x35);
+	const T x37 = x32 ^ (a[0] & x36);
+	const T x38 = ~x8;
+	const T x39 = ~(a[3] & x38);
+	const T x40 = ~(a[5] & x39);
+	const T x41 = a[5] | x30;
+	const T x42 = x40 ^ x41;
+	const T x43 = x40 ^ (a[0] & x42);
+	const T x44 = x37 ^ (~a[2] & x43);
+	const T x45 = x14 ^ x38;
+	const T x46 = x14 ^ (a[5] & x45);
+	const T x47 = ~a[1];
+	const T x48 = a[3] ^ x47;
+	const T x49 = x48 ^ (a[5] & x3);
+	const T x50 = x46 ^ (~a[0] & x49);
+	const T x51 = a[3] & a[4];
+	const T x52 = a[1] ^ (a[5] & x51);
+	const T x53 = ~(a[3] & x8);
+	const T x54 = x53 ^ (a[5] & a[1]);
+	const T x55 = x52 ^ (a[0] & x54);
+	const T x56 = x50 ^ (a[2] & x55);
+
+	o[0] = x28;
+	o[1] = x56;
+	o[2] = x44;
+	o[3] = x13;
+}
+
+template<class T>
+static inline void s8(T *o, const T *a)
+{
+	const T x0 = ~a[0] & a[4];
+	const T x1 = ~a[4];
+	const T x2 = a[0] ^ x1;
+	const T x3 = x0 ^ x2;
+	const T x4 = x0 ^ (a[3] & x3);
+	const T x5 = a[2] ^ x4;
+	const T x6 = a[0] | a[4];
+	const T x7 = ~(a[3] & x6);
+	const T x8 = ~x3;
+	const T x9 = x7 ^ (a[2] & x8);
+	const T x10 = x5 ^ (~a[1] & x9);
+	const T x11 = x2 ^ (~a[3] & x1);
+	const T x12 = a[3] | a[4];
+	const T x13 = x11 ^ (~a[2] & x12);
+	const T x14 = ~a[3] & x6;
+	const T x15 = ~a[0];
+	const T x16 = a[3] | x15;
+	const T x17 = x14 ^ (~a[2] & x16);
+	const T x18 = x13 ^ (~a[1] & x17);
+	const T x19 = x10 ^ x18;
+	const T x20 = x10 ^ (a[5] & x19);
+	const T x21 = ~x0;
+	const T x22 = x14 ^ (a[2] & x21);
+	const T x23 = ~(a[0] & a[4]);
+	const T x24 = a[2] | x23;
+	const T x25 = x22 ^ (a[1] & x24);
+	const T x26 = x8 ^ (~a[3] & x2);
+	const T x27 = ~x2;
+	const T x28 = a[4] ^ (a[3] & x27);
+	const T x29 = x26 ^ x28;
+	const T x30 = x26 ^ (a[2] & x29);
+	const T x31 = ~x23;
+	const T x32 = x31 ^ (~a[3] & x21);
+	const T x33 = x32 ^ (a[2] & x29);
+	const T x34 = x30 ^ (~a[1] & x33);
+	const T x35 = x25 ^ (a[5] & x34);
+	const T x36 = a[3] ^ x8;
+	const T x37 = x36 ^ (~a[2] & x27);
+	const T x38 = x7 ^ (a[2] & x1);
+	const T x39 = x37 ^ x38;
+	const T x40 = x37 ^ (a[1] & x39);
+	const T x41 = x3 ^ (~a[3] & a[0]);
+	const T x42 = x41 ^ (a[2] & x31);
+	const T x43 = a[3] & a[0];
+	const T x44 = a[2] & x43;
+	const T x45 = x42 ^ (~a[1] & x44);
+	const T x46 = x40 ^ (~a[5] & x45);
+	const T x47 = x2 ^ (~a[3] & x21);
+	const T x48 = x47 ^ (~a[2] & x23);
+	const T x49 = a[3] & x15;
+	const T x50 = x12 ^ (a[2] & x49);
+	const T x51 = x48 ^ (~a[1] & x50);
+	const T x52 = ~x10;
+	const T x53 = x51 ^ x52;
+	const T x54 = x51 ^ (a[5] & x53);
+
+	o[0] = x54;
+	o[1] = x46;
+	o[2] = x35;
+	o[3] = x20;
+}
+
+/* Transpose each 64×64 bit matrix held in the elements of a. */
+template<class T>
+static inline void bs_transpose(T *a)
+{
+	uint64_t m = 0x00000000ffffffff;
+
+	for (unsigned j = 32; j; j >>= 1, m ^= m << j)
+		for (unsigned k = 0; k < 64; k = (k + j + 1) & ~j) {
+			T t = (a[k] ^ (a[k+j] >> j)) & m;
+			a[k] ^= t;
+			a[k+j] ^= t << j;
+		}
+}
+
+/* Element e of word j holds block 64e + j before transposition. */
+template<class T>
+static inline void bs_load(T *a, const uint8_t *in)
+{
+	const size_t lanes = sizeof(T) / sizeof(uint64_t);
+	uint64_t buf[64 * lanes];
+
+	for (size_t j = 0; j < 64; j++)
+		for (size_t e = 0; e < lanes; e++)
+			buf[j*lanes + e] =
+				BigEndian::Convert<uint64_t>(in + 8*(64*e + j));
+	memcpy(a, buf, sizeof(buf));
+	bs_transpose(a);
+}
+
+template<class T>
+static inline void bs_store(uint8_t *out, T *a)
+{
+	const size_t lanes = sizeof(T) / sizeof(uint64_t);
+	uint64_t buf[64 * lanes];
+
+	bs_transpose(a);
+	memcpy(buf, a, sizeof(buf));
+	for (size_t j = 0; j < 64; j++)
+		for (size_t e = 0; e < lanes; e++)
+			BigEndian::Convert(out + 8*(64*e + j), buf[j*lanes + e]);
+}
+
+/* Apply S-box s to the expansion of r and XOR the permuted result into l.  k
+ * points to the pair of round key words in the format used by ProcessBlock;
+ * the six key bits for S-box s are in bits 24 through 29 of one of them.
+ */
+template<class T>
+static inline void bs_sbox(T *l, const T *r, const uint32_t *k, unsigned s,
+		void (*sbox)(T *, const T *))
+{
+	const uint32_t kw = k[s & 1] >> (24 - 8 * (s >> 1));
+	T a[6], o[4];
+
+	for (unsigned i = 0; i < 6; i++)
+		a[i] = r[(4*s + i + 31) & 31] ^ -(uint64_t)((kw >> (5 - i)) & 1);
+	sbox(o, a);
+	for (unsigned i = 0; i < 4; i++)
+		l[bs_pinv[4*s + i]] ^= o[i];
+}
+
+template<class T>
+static inline void bs_feistel(T *l, const T *r, const uint32_t *k)
+{
+	bs_sbox(l, r, k, 0, s1);
+	bs_sbox(l, r, k, 1, s2);
+	bs_sbox(l, r, k, 2, s3);
+	bs_sbox(l, r, k, 3, s4);
+	bs_sbox(l, r, k, 4, s5);
+	bs_sbox(l, r, k, 5, s6);
+	bs_sbox(l, r, k, 6, s7);
+	bs_sbox(l, r, k, 7, s8);
+}
+
+/* Sixteen rounds with the key schedule k, which is m_k or m_kd. */
+template<class T>
+static inline void bs_rounds(T *l, T *r, const uint32_t *k)
+{
+	for (unsigned i = 0; i < 8; i++, k += 4) {
+		bs_feistel(l, r, k);
+		bs_feistel(r, l, k+2);
+	}
+}
+
+/* Process as many whole batches of blocks as possible, applying each of the
+ * nks key schedules in ks in turn, and return the number of blocks processed.
+ * Since the final and initial permutations cancel out between the DES
+ * operations of TripleDES, they are done only once per batch.
+ */
+template<class T>
+static size_t bs_crypt(uint8_t *out, const uint8_t *in, size_t n,
+		const uint32_t *const *ks, size_t nks)
+{
+	const size_t batch = 64 * sizeof(T) / sizeof(uint64_t);
+	size_t done;
+
+	for (done = 0; done + batch <= n; done += batch) {
+		T b[64], lr[64];
+		T *l = lr, *r = lr + 32;
+
+		bs_load(b, in + 8*done);
+		for (unsigned i = 0; i < 32; i++) {
+			l[i] = b[bs_ip[i]];
+			r[i] = b[bs_ip[i + 32]];
+		}
+		for (size_t i = 0; i < nks; i++) {
+			bs_rounds(l, r, ks[i]);
+			std::swap(l, r);
+		}
+		for (unsigned i = 0; i < 64; i++)
+			b[i] = bs_fp[i] < 32 ? l[bs_fp[i]] : r[bs_fp[i] - 32];
+		bs_store(out + 8*done, b);
+	}
+	return done;
+}
+UNHIDE()
+
+#endif
@@ -15,7 +15,9 @@
 
 #include <drew/block.h>
 #include "block-plugin.hh"
+#include "btestcase.hh"
 #include "des.hh"
+#include "des-bitslice.hh"
 
 static void str2bytes(uint8_t *bytes, const char *s, size_t len = 0)
 {
@@ -53,6 +55,16 @@ static bool test(const char *key, const char *plain, const char *cipher,
 }
 
 
+static int fast_test(size_t keysz)
+{
+	using namespace drew;
+
+	// Enough blocks to exercise each batch size plus the odd blocks at the end.
+	if (keysz == 8)
+		return BlockTestCase<DES>::FastTest(keysz, 64 * 5 + 6);
+	return BlockTestCase<TripleDES>::FastTest(keysz, 64 * 5 + 6);
+}
+
 extern "C" {
 
 static const int deskeysz[] =
@@ -100,6 +112,10 @@ static int desedetest(void *, const drew_loader_t *)
 	res <<= 1;
 	res |= test3("0123456789abcdeffedcba987654321089abcdef01234567",
 			"0123456789abcde7", "de0b7c06ae5e0ed5", 24);
+	res <<= 3;
+	res |= fast_test(16);
+	res <<= 3;
+	res |= fast_test(24);
 
 	return res;
 }
@@ -419,6 +435,8 @@ static int destest(void *, const drew_loader_t *)
 	res |= testd("49E95D6D4CA229BF", "02FE55778117F12A", "5A6B612CC26CCE4A");
 	res |= testd("018310DC409B26D6", "1D9D5C5018F728C2", "5F4C038ED12B2E41");
 	res |= testd("1C587F1C13924FEF", "305532286D6F295A", "63FAC0D034D9F793");
+	res <<= 3;
+	res |= fast_test(8);
 
 	return res;
 }
@@ -672,6 +690,85 @@ int drew::TripleDES::Decrypt(uint8_t *out, const uint8_t *in) const
 	return 0;
 }
 
+#ifdef DES_VECTOR
+typedef uint64_t vector_t __attribute__((vector_size(16)));
+#endif
+
+static bool use_avx2()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	static const bool avx2 = HasAVX2();
+	return avx2;
+#else
+	return false;
+#endif
+}
+
+/* Process as many blocks as possible in bitsliced batches of 64 or more and
+ * return the number processed.
+ */
+size_t drew::DES::CryptBitslice(uint8_t *out, const uint8_t *in, size_t n,
+		const uint32_t *const *ks, size_t nks)
+{
+	size_t done = 0;
+
+	if (use_avx2())
+		done = CryptBitsliceAVX2(out, in, n, ks, nks);
+#ifdef DES_VECTOR
+	done += bs_crypt<vector_t>(out+8*done, in+8*done, n-done, ks, nks);
+#endif
+	done += bs_crypt<uint64_t>(out+8*done, in+8*done, n-done, ks, nks);
+	return done;
+}
+
+int drew::DES::EncryptFast(FastBlock *bout, const FastBlock *bin,
+		size_t n) const
+{
+	const uint32_t *ks[] = {m_k};
+	uint8_t *out = bout->data;
+	const uint8_t *in = bin->data;
+
+	for (size_t i = CryptBitslice(out, in, n, ks, DIM(ks)); i < n; i++)
+		Encrypt(out+8*i, in+8*i);
+	return 0;
+}
+
+int drew::DES::DecryptFast(FastBlock *bout, const FastBlock *bin,
+		size_t n) const
+{
+	const uint32_t *ks[] = {m_kd};
+	uint8_t *out = bout->data;
+	const uint8_t *in = bin->data;
+
+	for (size_t i = CryptBitslice(out, in, n, ks, DIM(ks)); i < n; i++)
+		Decrypt(out+8*i, in+8*i);
+	return 0;
+}
+
+int drew::TripleDES::EncryptFast(FastBlock *bout, const FastBlock *bin,
+		size_t n) const
+{
+	const uint32_t *ks[] = {m_des1.m_k, m_des2.m_kd, m_des3.m_k};
+	uint8_t *out = bout->data;
+	const uint8_t *in = bin->data;
+
+	for (size_t i = DES::CryptBitslice(out, in, n, ks, DIM(ks)); i < n; i++)
+		Encrypt(out+8*i, in+8*i);
+	return 0;
+}
+
+int drew::TripleDES::DecryptFast(FastBlock *bout, const FastBlock *bin,
+		size_t n) const
+{
+	const uint32_t *ks[] = {m_des3.m_kd, m_des2.m_k, m_des1.m_kd};
+	uint8_t *out = bout->data;
+	const uint8_t *in = bin->data;
+
+	for (size_t i = DES::CryptBitslice(out, in, n, ks, DIM(ks)); i < n; i++)
+		Decrypt(out+8*i, in+8*i);
+	return 0;
+}
+
 const uint32_t drew::DES::Spbox[8][64] = {
 {
 0x01010400,0x00000000,0x00010000,0x01010404, 0x01010004,0x00010404,0x00000004,0x00010000,
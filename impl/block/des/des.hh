@@ -25,10 +25,16 @@ class DES : public BlockCipher<8, BigEndian>
 		~DES() {};
 		int Encrypt(uint8_t *out, const uint8_t *in) const;
 		int Decrypt(uint8_t *out, const uint8_t *in) const;
+		int EncryptFast(FastBlock *bout, const FastBlock *bin, size_t n) const;
+		int DecryptFast(FastBlock *bout, const FastBlock *bin, size_t n) const;
 		void ProcessBlock(const uint32_t *, uint32_t &, uint32_t &) const;
 	protected:
 		int SetKeyInternal(const uint8_t *key, size_t sz);
 	private:
+		static size_t CryptBitslice(uint8_t *out, const uint8_t *in, size_t n,
+				const uint32_t *const *ks, size_t nks);
+		static size_t CryptBitsliceAVX2(uint8_t *out, const uint8_t *in,
+				size_t n, const uint32_t *const *ks, size_t nks);
 		uint32_t m_k[32], m_kd[32];
 		static const uint32_t Spbox[8][64];
 		friend class TripleDES;
@@ -41,6 +47,8 @@ class TripleDES : public BlockCipher<8, BigEndian>
 		~TripleDES() {};
 		int Encrypt(uint8_t *out, const uint8_t *in) const;
 		int Decrypt(uint8_t *out, const uint8_t *in) const;
+		int EncryptFast(FastBlock *bout, const FastBlock *bin, size_t n) const;
+		int DecryptFast(FastBlock *bout, const FastBlock *bin, size_t n) const;
 	protected:
 		int SetKeyInternal(const uint8_t *key, size_t sz);
 	private:
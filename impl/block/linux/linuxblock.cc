@@ -193,6 +193,7 @@ static int twofishtest(void *p, const drew_loader_t *ldr)
 drew::LinuxAES::LinuxAES()
 {
 	ecbname = "ecb(aes)";
+	algname = "aes";
 }
 
 drew::LinuxAES::LinuxAES(const LinuxAES &other)
@@ -220,6 +221,7 @@ int drew::LinuxAES::SetKeyInternal(const uint8_t *key, size_t len)
 drew::LinuxCAST6::LinuxCAST6()
 {
 	ecbname = "ecb(cast6)";
+	algname = "cast6";
 }
 
 drew::LinuxCAST6::LinuxCAST6(const LinuxCAST6 &other)
@@ -246,6 +248,7 @@ int drew::LinuxCAST6::SetKeyInternal(const uint8_t *key, size_t len)
 drew::LinuxCAST5::LinuxCAST5()
 {
 	ecbname = "ecb(cast5)";
+	algname = "cast5";
 }
 
 drew::LinuxCAST5::LinuxCAST5(const LinuxCAST5 &other)
@@ -264,6 +267,7 @@ int drew::LinuxCAST5::SetKeyInternal(const uint8_t *key, size_t len)
 drew::LinuxTwofish::LinuxTwofish()
 {
 	ecbname = "ecb(twofish)";
+	algname = "twofish";
 }
 
 drew::LinuxTwofish::LinuxTwofish(const LinuxTwofish &other)
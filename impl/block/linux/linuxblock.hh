@@ -25,11 +25,14 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "../../multi/linux/af-alg.h"
+
+#define BLOCK_PRIVATE_INFO2(bname, ctx, op, out, in) \
+	drew::LinuxPrivateInfo2<bname>(ctx, op, in)
+
 #include "block-plugin.hh"
 #include "util.hh"
 
-#include "../../multi/linux/af-alg.h"
-
 namespace drew {
 
 template<int size, class E>
@@ -39,16 +42,11 @@ class LinuxCryptoImplementation : public BlockCipher<size, E>
 		typedef typename BlockCipher<size, E>::FastBlock FastBlock;
 		LinuxCryptoImplementation()
 		{
-			memset(&alg, 0, sizeof(alg));
-			alg.fd = -1;
-			alg.sockfd = -1;
+			af_alg_initialize(&alg);
 		}
 		virtual ~LinuxCryptoImplementation()
 		{
-			if (alg.fd >= 0)
-				close(alg.fd);
-			if (alg.sockfd >= 0)
-				close(alg.sockfd);
+			af_alg_close(&alg);
 			memset(keybak, 0, sizeof(keybak));
 		}
 		int Encrypt(uint8_t *out, const uint8_t *in) const
@@ -78,29 +76,36 @@ class LinuxCryptoImplementation : public BlockCipher<size, E>
 			int res = 0;
 			if (!(res = af_alg_initialize(&alg)))
 				res = af_alg_open_socket(&alg, "skcipher", ecbname);
-			if (alg.fd >= 0)
-				close(alg.fd);
-			if (alg.sockfd >= 0)
-				close(alg.sockfd);
-			memset(&alg, 0, sizeof(alg));
-			alg.fd = -1;
-			alg.sockfd = -1;
+			af_alg_close(&alg);
+			return res;
+		}
+		// Set up a socket for one of the kernel modes with our key.
+		int KeySocket(const struct af_alg_keyreq *req) const
+		{
+			uint8_t key[sizeof(keybak) * 2];
+			const size_t len = this->keysz + req->extralen;
+			int res;
+
+			if (len > sizeof(key))
+				return -DREW_ERR_INVALID;
+			memcpy(key, keybak, this->keysz);
+			memcpy(key+this->keysz, req->extra, req->extralen);
+			res = af_alg_open_keyed(req->alg, req->type, req->tmpl,
+					algname, key, len, req->taglen);
+			memset(key, 0, sizeof(key));
 			return res;
 		}
 	protected:
 		void Clone(const LinuxCryptoImplementation &other)
 		{
 			this->ecbname = other.ecbname;
+			this->algname = other.algname;
+			this->keysz = other.keysz;
 			this->SetKeyInternal(other.keybak, other.keysz);
 		}
 		virtual int SetKeyInternal(const uint8_t *key, size_t len)
 		{
-			if (alg.fd >= 0)
-				close(alg.fd);
-			if (alg.sockfd >= 0)
-				close(alg.sockfd);
-
-			RETFAIL(af_alg_initialize(&alg));
+			af_alg_close(&alg);
 			RETFAIL(af_alg_open_socket(&alg, "skcipher", ecbname));
 
 			memcpy(keybak, key, len);
@@ -112,9 +117,26 @@ class LinuxCryptoImplementation : public BlockCipher<size, E>
 		struct af_alg alg;
 		uint8_t keybak[32];
 		const char *ecbname;
+		const char *algname;
 	private:
 };
 
+template<class T>
+int LinuxPrivateInfo2(const drew_block_t *ctx, int op, const drew_param_t *in)
+{
+	if (op != AF_ALG_BLOCK_KEY_SOCKET)
+		return -DREW_ERR_INVALID;
+	for (; in; in = in->next)
+		if (!strcmp(in->name, "request")) {
+			if (!ctx || !ctx->ctx)
+				return -DREW_ERR_MORE_INFO;
+			const T *ctxp = (const T *)ctx->ctx;
+			return ctxp->KeySocket((const struct af_alg_keyreq *)
+					in->param.value);
+		}
+	return 0;
+}
+
 class LinuxAES : public LinuxCryptoImplementation<16, BigEndian>
 {
 	public:
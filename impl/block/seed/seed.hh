@@ -36,6 +36,8 @@ class SEED : public BlockCipher<16, BigEndian>
 		~SEED() {};
 		int Encrypt(uint8_t *out, const uint8_t *in) const;
 		int Decrypt(uint8_t *out, const uint8_t *in) const;
+		int EncryptFast(FastBlock *bout, const FastBlock *bin, size_t n) const;
+		int DecryptFast(FastBlock *bout, const FastBlock *bin, size_t n) const;
 	protected:
 		int SetKeyInternal(const uint8_t *key, size_t sz);
 		static inline uint64_t GenerateSubkey(uint32_t k[4], uint32_t kci);
@@ -45,6 +47,10 @@ class SEED : public BlockCipher<16, BigEndian>
 		static inline uint32_t g(uint32_t x);
 		static const uint32_t ss0[], ss1[], ss2[], ss3[];
 	private:
+		template<size_t N>
+		void EncryptBlocks(FastBlock *bout, const FastBlock *bin) const;
+		template<size_t N>
+		void DecryptBlocks(FastBlock *bout, const FastBlock *bin) const;
 		uint64_t m_k[16];
 
 };
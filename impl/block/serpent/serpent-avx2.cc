@@ -0,0 +1,91 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ *
+ * This file is part of the Drew Cryptography Suite.
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of your choice of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation or version 2.0 of the Apache
+ * License as published by the Apache Software Foundation.
+ *
+ * This file is distributed in the hope that it will be useful, but without
+ * any warranty; without even the implied warranty of merchantability or fitness
+ * for a particular purpose.
+ *
+ * Note that people who make modified versions of this file are not obligated to
+ * dual-license their modified versions; it is their choice whether to do so.
+ * If a modified version is not distributed under both licenses, the copyright
+ * and permission notices should be updated accordingly.
+ */
+/* This file is compiled with AVX2 enabled.  Nothing in it may be called unless
+ * the processor has been checked for AVX2 support, which is done in
+ * serpent-impl.cc.
+ */
+#include <internal.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <drew/block.h>
+#include "serpent.hh"
+#include "serpent-sboxes.hh"
+
+#if defined(SERPENT_VECTOR) && defined(__AVX2__)
+#define FEATURE_AVX2
+#endif
+
+HIDE()
+#ifdef FEATURE_AVX2
+typedef uint32_t vector_t __attribute__((vector_size(32)));
+typedef int32_t mask_t __attribute__((vector_size(32)));
+
+static const mask_t lo32 = {0, 8, 1, 9, 4, 12, 5, 13};
+static const mask_t hi32 = {2, 10, 3, 11, 6, 14, 7, 15};
+static const mask_t lo64 = {0, 1, 8, 9, 4, 5, 12, 13};
+static const mask_t hi64 = {2, 3, 10, 11, 6, 7, 14, 15};
+
+/* Process eight blocks at a time.  Each 256-bit vector holds two blocks, so the
+ * low lanes hold the even blocks and the high lanes the odd ones.
+ */
+template<bool Enc>
+static inline size_t crypt8(uint8_t *out, const uint8_t *in, size_t n,
+		const uint32_t *k)
+{
+	const size_t total = n & ~7;
+
+	for (size_t i = 0; i < total; i += 8, in += 128, out += 128) {
+		vector_t b[4];
+
+		memcpy(b, in, sizeof(b));
+		transpose(b[0], b[1], b[2], b[3], lo32, hi32, lo64, hi64);
+		if (Enc)
+			encrypt_rounds(b, k);
+		else
+			decrypt_rounds(b, k);
+		transpose(b[0], b[1], b[2], b[3], lo32, hi32, lo64, hi64);
+		memcpy(out, b, sizeof(b));
+	}
+	return total;
+}
+#endif
+
+size_t drew::Serpent::EncryptFast8(FastBlock *bout, const FastBlock *bin,
+		size_t n) const
+{
+#ifdef FEATURE_AVX2
+	return crypt8<true>(bout->data, bin->data, n, m_key);
+#else
+	return 0;
+#endif
+}
+
+size_t drew::Serpent::DecryptFast8(FastBlock *bout, const FastBlock *bin,
+		size_t n) const
+{
+#ifdef FEATURE_AVX2
+	return crypt8<false>(bout->data, bin->data, n, m_key);
+#else
+	return 0;
+#endif
+}
+UNHIDE()
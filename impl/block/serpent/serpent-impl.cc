@@ -27,6 +27,7 @@
 
 #include <drew/block.h>
 #include "serpent.hh"
+#include "serpent-sboxes.hh"
 
 HIDE()
 typedef drew::Serpent::endian_t E;
@@ -41,435 +42,6 @@ drew::Serpent::Serpent(const Serpent &other)
 	memcpy(m_keybuf, other.m_keybuf, sizeof(m_keybuf));
 }
 
-#define SBOX_OUT(a, b, c, d) \
-	do { x[0] = r##a; x[1] = r##b; x[2] = r##c; x[3] = r##d; } while (0)
-
-static inline void s0(uint32_t *x)
-{
-	uint32_t r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
-
-	r3 ^= r0;
-	r4 = r1;
-	r1 &= r3;
-	r4 ^= r2;
-	r1 ^= r0;
-	r0 |= r3;
-	r0 ^= r4;
-	r4 ^= r3;
-	r3 ^= r2;
-	r2 |= r1;
-	r2 ^= r4;
-	r4 = ~r4;
-	r4 |= r1;
-	r1 ^= r3;
-	r1 ^= r4;
-	r3 |= r0;
-	r1 ^= r3;
-	r4 ^= r3;
-
-	SBOX_OUT(1, 4, 2, 0);
-}
-
-static inline void s1(uint32_t *x)
-{
-	uint32_t r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
-
-	r0 = ~r0;
-	r2 = ~r2;
-	r4 = r0;
-	r0 &= r1;
-	r2 ^= r0;
-	r0 |= r3;
-	r3 ^= r2;
-	r1 ^= r0;
-	r0 ^= r4;
-	r4 |= r1;
-	r1 ^= r3;
-	r2 |= r0;
-	r2 &= r4;
-	r0 ^= r1;
-	r1 &= r2;
-	r1 ^= r0;
-	r0 &= r2;
-	r0 ^= r4;
-
-	SBOX_OUT(2, 0, 3, 1);
-}
-
-static inline void s2(uint32_t *x)
-{
-	uint32_t r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
-
-	r4 = r0;
-	r0 &= r2;
-	r0 ^= r3;
-	r2 ^= r1;
-	r2 ^= r0;
-	r3 |= r4;
-	r3 ^= r1;
-	r4 ^= r2;
-	r1 = r3;
-	r3 |= r4;
-	r3 ^= r0;
-	r0 &= r1;
-	r4 ^= r0;
-	r1 ^= r3;
-	r1 ^= r4;
-	r4 = ~r4;
-
-	SBOX_OUT(2, 3, 1, 4);
-}
-
-static inline void s3(uint32_t *x)
-{
-	uint32_t r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
-
-	r4 = r0;
-	r0 |= r3;
-	r3 ^= r1;
-	r1 &= r4;
-	r4 ^= r2;
-	r2 ^= r3;
-	r3 &= r0;
-	r4 |= r1;
-	r3 ^= r4;
-	r0 ^= r1;
-	r4 &= r0;
-	r1 ^= r3;
-	r4 ^= r2;
-	r1 |= r0;
-	r1 ^= r2;
-	r0 ^= r3;
-	r2 = r1;
-	r1 |= r3;
-	r1 ^= r0;
-
-	SBOX_OUT(1, 2, 3, 4);
-}
-
-static inline void s4(uint32_t *x)
-{
-	uint32_t r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
-
-	r1 ^= r3;
-	r3 = ~r3;
-	r2 ^= r3;
-	r3 ^= r0;
-	r4 = r1;
-	r1 &= r3;
-	r1 ^= r2;
-	r4 ^= r3;
-	r0 ^= r4;
-	r2 &= r4;
-	r2 ^= r0;
-	r0 &= r1;
-	r3 ^= r0;
-	r4 |= r1;
-	r4 ^= r0;
-	r0 |= r3;
-	r0 ^= r2;
-	r2 &= r3;
-	r0 = ~r0;
-	r4 ^= r2;
-
-	SBOX_OUT(1, 4, 0, 3);
-}
-
-static inline void s5(uint32_t *x)
-{
-	uint32_t r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
-
-	r0 ^= r1;
-	r1 ^= r3;
-	r3 = ~r3;
-	r4 = r1;
-	r1 &= r0;
-	r2 ^= r3;
-	r1 ^= r2;
-	r2 |= r4;
-	r4 ^= r3;
-	r3 &= r1;
-	r3 ^= r0;
-	r4 ^= r1;
-	r4 ^= r2;
-	r2 ^= r0;
-	r0 &= r3;
-	r2 = ~r2;
-	r0 ^= r4;
-	r4 |= r3;
-	r2 ^= r4;
-
-	SBOX_OUT(1, 3, 0, 2);
-}
-
-static inline void s6(uint32_t *x)
-{
-	uint32_t r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
-
-	r2 = ~r2;
-	r4 = r3;
-	r3 &= r0;
-	r0 ^= r4;
-	r3 ^= r2;
-	r2 |= r4;
-	r1 ^= r3;
-	r2 ^= r0;
-	r0 |= r1;
-	r2 ^= r1;
-	r4 ^= r0;
-	r0 |= r3;
-	r0 ^= r2;
-	r4 ^= r3;
-	r4 ^= r0;
-	r3 =~ r3;
-	r2 &= r4;
-	r2 ^= r3;
-
-	SBOX_OUT(0, 1, 4, 2);
-}
-
-static inline void s7(uint32_t *x)
-{
-	uint32_t r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
-
-	r4 = r1;
-	r1 |= r2;
-	r1 ^= r3;
-	r4 ^= r2;
-	r2 ^= r1;
-	r3 |= r4;
-	r3 &= r0;
-	r4 ^= r2;
-	r3 ^= r1;
-	r1 |= r4;
-	r1 ^= r0;
-	r0 |= r4;
-	r0 ^= r2;
-	r1 ^= r4;
-	r2 ^= r1;
-	r1 &= r0;
-	r1 ^= r4;
-	r2 = ~r2;
-	r2 |= r0;
-	r4 ^= r2;
-
-	SBOX_OUT(4, 3, 1, 0);
-}
-
-static inline void si0(uint32_t *x)
-{
-	uint32_t r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
-
-	r2 = ~r2;
-	r4 = r1;
-	r1 |= r0;
-	r4 = ~r4;
-	r1 ^= r2;
-	r2 |= r4;
-	r1 ^= r3;
-	r0 ^= r4;
-	r2 ^= r0;
-	r0 &= r3;
-	r4 ^= r0;
-	r0 |= r1;
-	r0 ^= r2;
-	r3 ^= r4;
-	r2 ^= r1;
-	r3 ^= r0;
-	r3 ^= r1;
-	r2 &= r3;
-	r4 ^= r2;
-
-	SBOX_OUT(0, 4, 1, 3);
-}
-
-static inline void si1(uint32_t *x)
-{
-	uint32_t r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
-
-	r4 = r1;
-	r1 ^= r3;
-	r3 &= r1;
-	r4 ^= r2;
-	r3 ^= r0;
-	r0 |= r1;
-	r2 ^= r3;
-	r0 ^= r4;
-	r0 |= r2;
-	r1 ^= r3;
-	r0 ^= r1;
-	r1 |= r3;
-	r1 ^= r0;
-	r4 = ~r4;
-	r4 ^= r1;
-	r1 |= r0;
-	r1 ^= r0;
-	r1 |= r4;
-	r3 ^= r1;
-
-	SBOX_OUT(4, 0, 3, 2);
-}
-
-static inline void si2(uint32_t *x)
-{
-	uint32_t r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
-
-	r2 ^= r3;
-	r3 ^= r0;
-	r4 = r3;
-	r3 &= r2;
-	r3 ^= r1;
-	r1 |= r2;
-	r1 ^= r4;
-	r4 &= r3;
-	r2 ^= r3;
-	r4 &= r0;
-	r4 ^= r2;
-	r2 &= r1;
-	r2 |= r0;
-	r3 = ~r3;
-	r2 ^= r3;
-	r0 ^= r3;
-	r0 &= r1;
-	r3 ^= r4;
-	r3 ^= r0;
-
-	SBOX_OUT(1, 4, 2, 3);
-}
-
-static inline void si3(uint32_t *x)
-{
-	uint32_t r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
-
-	r4 = r2;
-	r2 ^= r1;
-	r0 ^= r2;
-	r4 &= r2;
-	r4 ^= r0;
-	r0 &= r1;
-	r1 ^= r3;
-	r3 |= r4;
-	r2 ^= r3;
-	r0 ^= r3;
-	r1 ^= r4;
-	r3 &= r2;
-	r3 ^= r1;
-	r1 ^= r0;
-	r1 |= r2;
-	r0 ^= r3;
-	r1 ^= r4;
-	r0 ^= r1;
-
-	SBOX_OUT(2, 1, 3, 0);
-}
-
-static inline void si4(uint32_t *x)
-{
-	uint32_t r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
-
-	r4 = r2;
-	r2 &= r3;
-	r2 ^= r1;
-	r1 |= r3;
-	r1 &= r0;
-	r4 ^= r2;
-	r4 ^= r1;
-	r1 &= r2;
-	r0 = ~r0;
-	r3 ^= r4;
-	r1 ^= r3;
-	r3 &= r0;
-	r3 ^= r2;
-	r0 ^= r1;
-	r2 &= r0;
-	r3 ^= r0;
-	r2 ^= r4;
-	r2 |= r3;
-	r3 ^= r0;
-	r2 ^= r1;
-
-	SBOX_OUT(0, 3, 2, 4);
-}
-
-static inline void si5(uint32_t *x)
-{
-	uint32_t r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
-
-	r1 = ~r1;
-	r4 = r3;
-	r2 ^= r1;
-	r3 |= r0;
-	r3 ^= r2;
-	r2 |= r1;
-	r2 &= r0;
-	r4 ^= r3;
-	r2 ^= r4;
-	r4 |= r0;
-	r4 ^= r1;
-	r1 &= r2;
-	r1 ^= r3;
-	r4 ^= r2;
-	r3 &= r4;
-	r4 ^= r1;
-	r3 ^= r4;
-	r4 = ~r4;
-	r3 ^= r0;
-
-	SBOX_OUT(1, 4, 3, 2);
-}
-
-static inline void si6(uint32_t *x)
-{
-	uint32_t r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
-
-	r0 ^= r2;
-	r4 = r2;
-	r2 &= r0;
-	r4 ^= r3;
-	r2 = ~r2;
-	r3 ^= r1;
-	r2 ^= r3;
-	r4 |= r0;
-	r0 ^= r2;
-	r3 ^= r4;
-	r4 ^= r1;
-	r1 &= r3;
-	r1 ^= r0;
-	r0 ^= r3;
-	r0 |= r2;
-	r3 ^= r1;
-	r4 ^= r0;
-
-	SBOX_OUT(1, 2, 4, 3);
-}
-
-static inline void si7(uint32_t *x)
-{
-	uint32_t r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
-
-	r4 = r2;
-	r2 ^= r0;
-	r0 &= r3;
-	r4 |= r3;
-	r2 = ~r2;
-	r3 ^= r1;
-	r1 |= r0;
-	r0 ^= r2;
-	r2 &= r4;
-	r3 &= r4;
-	r1 ^= r2;
-	r2 ^= r0;
-	r0 |= r2;
-	r4 ^= r1;
-	r0 ^= r3;
-	r3 ^= r4;
-	r4 |= r0;
-	r3 ^= r2;
-	r4 ^= r2;
-
-	SBOX_OUT(3, 0, 1, 4);
-}
-
 int drew::Serpent::SetKeyInternal(const uint8_t *key, size_t len)
 {
 	uint32_t *w = m_key = m_keybuf + 8;
@@ -496,63 +68,12 @@ int drew::Serpent::SetKeyInternal(const uint8_t *key, size_t len)
 }
 
 
-static inline void eround(uint32_t *b, const uint32_t *k,
-		void (*s)(uint32_t *x))
-{
-	for (size_t i = 0; i < 4; i++)
-		b[i] ^= k[i];
-	s(b);
-	b[0] = RotateLeft(b[0], 13);
-	b[2] = RotateLeft(b[2], 3);
-	b[1] = RotateLeft(b[1] ^ b[2] ^ b[0], 1);
-	b[3] = RotateLeft(b[3] ^ b[2] ^ (b[0] << 3), 7);
-	b[0] = RotateLeft(b[0] ^ b[3] ^ b[1], 5);
-	b[2] = RotateLeft(b[2] ^ b[3] ^ (b[1] << 7), 22);
-}
-
-static inline void dround(uint32_t *b, const uint32_t *k,
-		void (*s)(uint32_t *x))
-{
-	b[2] = RotateRight(b[2], 22);
-	b[0] = RotateRight(b[0], 5);
-	b[2] ^= b[3] ^ (b[1] << 7);
-	b[0] ^= b[1] ^ b[3];
-	b[3] = RotateRight(b[3], 7);
-	b[1] = RotateRight(b[1], 1);
-	b[3] ^= b[2] ^ (b[0] << 3);
-	b[1] ^= b[0] ^ b[2];
-	b[2] = RotateRight(b[2], 3);
-	b[0] = RotateRight(b[0], 13);
-	s(b);
-	for (size_t i = 0; i < 4; i++)
-		b[i] ^= k[i];
-}
-
 int drew::Serpent::Encrypt(uint8_t *out, const uint8_t *in) const
 {
 	uint32_t b[4];
 	E::Copy(b, in, sizeof(b));
 
-	const uint32_t *k = m_key;
-	for (size_t i = 0; i < 4; i++, k += 32) {
-		eround(b, k+ 0, s0);
-		eround(b, k+ 4, s1);
-		eround(b, k+ 8, s2);
-		eround(b, k+12, s3);
-		eround(b, k+16, s4);
-		eround(b, k+20, s5);
-		eround(b, k+24, s6);
-		if (i == 3)
-			break;
-		eround(b, k+28, s7);
-	}
-	k += 28;
-	for (size_t i = 0; i < 4; i++)
-		b[i] ^= *k++;
-	s7(b);
-	for (size_t i = 0; i < 4; i++) {
-		b[i] ^= *k++;
-	}
+	encrypt_rounds(b, m_key);
 
 	E::Copy(out, b, sizeof(b));
 	return 0;
@@ -563,28 +84,75 @@ int drew::Serpent::Decrypt(uint8_t *out, const uint8_t *in) const
 	uint32_t b[4];
 	E::Copy(b, in, sizeof(b));
 
-	for (size_t j = 0; j < 4; j++)
-		b[j] ^= m_key[128+j];
-	si7(b);
-	for (size_t j = 0; j < 4; j++)
-		b[j] ^= m_key[124+j];
-	const uint32_t *k = m_key + (128 - 32);
-	for (size_t i = 0; i < 4; i++, k -= 32) {
-		if (i)
-			dround(b, k+28, si7);
-		dround(b, k+24, si6);
-		dround(b, k+20, si5);
-		dround(b, k+16, si4);
-		dround(b, k+12, si3);
-		dround(b, k+ 8, si2);
-		dround(b, k+ 4, si1);
-		dround(b, k+ 0, si0);
-	}
+	decrypt_rounds(b, m_key);
 
 	E::Copy(out, b, sizeof(b));
 	return 0;
 }
 
+#ifdef SERPENT_VECTOR
+typedef uint32_t vector_t __attribute__((vector_size(16)));
+typedef int32_t mask_t __attribute__((vector_size(16)));
+
+static const mask_t lo32 = {0, 4, 1, 5}, hi32 = {2, 6, 3, 7};
+static const mask_t lo64 = {0, 1, 4, 5}, hi64 = {2, 3, 6, 7};
+
+static bool use_avx2()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	static const bool avx2 = HasAVX2();
+	return avx2;
+#else
+	return false;
+#endif
+}
+
+/* Process four blocks at a time, one block in each vector element. */
+template<bool Enc>
+static inline void crypt4(uint8_t *out, const uint8_t *in, size_t n,
+		const uint32_t *k)
+{
+	for (size_t i = 0; i < n; i += 4, in += 64, out += 64) {
+		vector_t b[4];
+
+		memcpy(b, in, sizeof(b));
+		transpose(b[0], b[1], b[2], b[3], lo32, hi32, lo64, hi64);
+		if (Enc)
+			encrypt_rounds(b, k);
+		else
+			decrypt_rounds(b, k);
+		transpose(b[0], b[1], b[2], b[3], lo32, hi32, lo64, hi64);
+		memcpy(out, b, sizeof(b));
+	}
+}
+
+int drew::Serpent::EncryptFast(FastBlock *bout, const FastBlock *bin,
+		size_t n) const
+{
+	size_t done = 0;
+
+	if (use_avx2())
+		done = EncryptFast8(bout, bin, n);
+	crypt4<true>(bout[done].data, bin[done].data, (n - done) & ~3, m_key);
+	for (done += (n - done) & ~3; done < n; done++)
+		Encrypt(bout[done].data, bin[done].data);
+	return 0;
+}
+
+int drew::Serpent::DecryptFast(FastBlock *bout, const FastBlock *bin,
+		size_t n) const
+{
+	size_t done = 0;
+
+	if (use_avx2())
+		done = DecryptFast8(bout, bin, n);
+	crypt4<false>(bout[done].data, bin[done].data, (n - done) & ~3, m_key);
+	for (done += (n - done) & ~3; done < n; done++)
+		Decrypt(bout[done].data, bin[done].data);
+	return 0;
+}
+#endif
+
 void drew::Serpent::Serpent1(uint32_t *blk)
 {
 	s2(blk);
@@ -0,0 +1,586 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ *
+ * This file is part of the Drew Cryptography Suite.
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of your choice of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation or version 2.0 of the Apache
+ * License as published by the Apache Software Foundation.
+ *
+ * This file is distributed in the hope that it will be useful, but without
+ * any warranty; without even the implied warranty of merchantability or fitness
+ * for a particular purpose.
+ *
+ * Note that people who make modified versions of this file are not obligated to
+ * dual-license their modified versions; it is their choice whether to do so.
+ * If a modified version is not distributed under both licenses, the copyright
+ * and permission notices should be updated accordingly.
+ */
+#ifndef SERPENT_SBOXES_HH
+#define SERPENT_SBOXES_HH
+
+/* The S-boxes and rounds are written in terms of a generic word type T, which
+ * is either a uint32_t (one block) or a vector of uint32_t, in which case each
+ * element of the vector holds the corresponding word of a different block.
+ * Everything here has internal linkage, since this file is compiled with
+ * different instruction set flags in different translation units.
+ */
+
+HIDE()
+#define SBOX_OUT(a, b, c, d) \
+	do { x[0] = r##a; x[1] = r##b; x[2] = r##c; x[3] = r##d; } while (0)
+
+template<class T>
+static inline void s0(T *x)
+{
+	T r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
+
+	r3 ^= r0;
+	r4 = r1;
+	r1 &= r3;
+	r4 ^= r2;
+	r1 ^= r0;
+	r0 |= r3;
+	r0 ^= r4;
+	r4 ^= r3;
+	r3 ^= r2;
+	r2 |= r1;
+	r2 ^= r4;
+	r4 = ~r4;
+	r4 |= r1;
+	r1 ^= r3;
+	r1 ^= r4;
+	r3 |= r0;
+	r1 ^= r3;
+	r4 ^= r3;
+
+	SBOX_OUT(1, 4, 2, 0);
+}
+
+template<class T>
+static inline void s1(T *x)
+{
+	T r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
+
+	r0 = ~r0;
+	r2 = ~r2;
+	r4 = r0;
+	r0 &= r1;
+	r2 ^= r0;
+	r0 |= r3;
+	r3 ^= r2;
+	r1 ^= r0;
+	r0 ^= r4;
+	r4 |= r1;
+	r1 ^= r3;
+	r2 |= r0;
+	r2 &= r4;
+	r0 ^= r1;
+	r1 &= r2;
+	r1 ^= r0;
+	r0 &= r2;
+	r0 ^= r4;
+
+	SBOX_OUT(2, 0, 3, 1);
+}
+
+template<class T>
+static inline void s2(T *x)
+{
+	T r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
+
+	r4 = r0;
+	r0 &= r2;
+	r0 ^= r3;
+	r2 ^= r1;
+	r2 ^= r0;
+	r3 |= r4;
+	r3 ^= r1;
+	r4 ^= r2;
+	r1 = r3;
+	r3 |= r4;
+	r3 ^= r0;
+	r0 &= r1;
+	r4 ^= r0;
+	r1 ^= r3;
+	r1 ^= r4;
+	r4 = ~r4;
+
+	SBOX_OUT(2, 3, 1, 4);
+}
+
+template<class T>
+static inline void s3(T *x)
+{
+	T r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
+
+	r4 = r0;
+	r0 |= r3;
+	r3 ^= r1;
+	r1 &= r4;
+	r4 ^= r2;
+	r2 ^= r3;
+	r3 &= r0;
+	r4 |= r1;
+	r3 ^= r4;
+	r0 ^= r1;
+	r4 &= r0;
+	r1 ^= r3;
+	r4 ^= r2;
+	r1 |= r0;
+	r1 ^= r2;
+	r0 ^= r3;
+	r2 = r1;
+	r1 |= r3;
+	r1 ^= r0;
+
+	SBOX_OUT(1, 2, 3, 4);
+}
+
+template<class T>
+static inline void s4(T *x)
+{
+	T r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
+
+	r1 ^= r3;
+	r3 = ~r3;
+	r2 ^= r3;
+	r3 ^= r0;
+	r4 = r1;
+	r1 &= r3;
+	r1 ^= r2;
+	r4 ^= r3;
+	r0 ^= r4;
+	r2 &= r4;
+	r2 ^= r0;
+	r0 &= r1;
+	r3 ^= r0;
+	r4 |= r1;
+	r4 ^= r0;
+	r0 |= r3;
+	r0 ^= r2;
+	r2 &= r3;
+	r0 = ~r0;
+	r4 ^= r2;
+
+	SBOX_OUT(1, 4, 0, 3);
+}
+
+template<class T>
+static inline void s5(T *x)
+{
+	T r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
+
+	r0 ^= r1;
+	r1 ^= r3;
+	r3 = ~r3;
+	r4 = r1;
+	r1 &= r0;
+	r2 ^= r3;
+	r1 ^= r2;
+	r2 |= r4;
+	r4 ^= r3;
+	r3 &= r1;
+	r3 ^= r0;
+	r4 ^= r1;
+	r4 ^= r2;
+	r2 ^= r0;
+	r0 &= r3;
+	r2 = ~r2;
+	r0 ^= r4;
+	r4 |= r3;
+	r2 ^= r4;
+
+	SBOX_OUT(1, 3, 0, 2);
+}
+
+template<class T>
+static inline void s6(T *x)
+{
+	T r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
+
+	r2 = ~r2;
+	r4 = r3;
+	r3 &= r0;
+	r0 ^= r4;
+	r3 ^= r2;
+	r2 |= r4;
+	r1 ^= r3;
+	r2 ^= r0;
+	r0 |= r1;
+	r2 ^= r1;
+	r4 ^= r0;
+	r0 |= r3;
+	r0 ^= r2;
+	r4 ^= r3;
+	r4 ^= r0;
+	r3 =~ r3;
+	r2 &= r4;
+	r2 ^= r3;
+
+	SBOX_OUT(0, 1, 4, 2);
+}
+
+template<class T>
+static inline void s7(T *x)
+{
+	T r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
+
+	r4 = r1;
+	r1 |= r2;
+	r1 ^= r3;
+	r4 ^= r2;
+	r2 ^= r1;
+	r3 |= r4;
+	r3 &= r0;
+	r4 ^= r2;
+	r3 ^= r1;
+	r1 |= r4;
+	r1 ^= r0;
+	r0 |= r4;
+	r0 ^= r2;
+	r1 ^= r4;
+	r2 ^= r1;
+	r1 &= r0;
+	r1 ^= r4;
+	r2 = ~r2;
+	r2 |= r0;
+	r4 ^= r2;
+
+	SBOX_OUT(4, 3, 1, 0);
+}
+
+template<class T>
+static inline void si0(T *x)
+{
+	T r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
+
+	r2 = ~r2;
+	r4 = r1;
+	r1 |= r0;
+	r4 = ~r4;
+	r1 ^= r2;
+	r2 |= r4;
+	r1 ^= r3;
+	r0 ^= r4;
+	r2 ^= r0;
+	r0 &= r3;
+	r4 ^= r0;
+	r0 |= r1;
+	r0 ^= r2;
+	r3 ^= r4;
+	r2 ^= r1;
+	r3 ^= r0;
+	r3 ^= r1;
+	r2 &= r3;
+	r4 ^= r2;
+
+	SBOX_OUT(0, 4, 1, 3);
+}
+
+template<class T>
+static inline void si1(T *x)
+{
+	T r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
+
+	r4 = r1;
+	r1 ^= r3;
+	r3 &= r1;
+	r4 ^= r2;
+	r3 ^= r0;
+	r0 |= r1;
+	r2 ^= r3;
+	r0 ^= r4;
+	r0 |= r2;
+	r1 ^= r3;
+	r0 ^= r1;
+	r1 |= r3;
+	r1 ^= r0;
+	r4 = ~r4;
+	r4 ^= r1;
+	r1 |= r0;
+	r1 ^= r0;
+	r1 |= r4;
+	r3 ^= r1;
+
+	SBOX_OUT(4, 0, 3, 2);
+}
+
+template<class T>
+static inline void si2(T *x)
+{
+	T r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
+
+	r2 ^= r3;
+	r3 ^= r0;
+	r4 = r3;
+	r3 &= r2;
+	r3 ^= r1;
+	r1 |= r2;
+	r1 ^= r4;
+	r4 &= r3;
+	r2 ^= r3;
+	r4 &= r0;
+	r4 ^= r2;
+	r2 &= r1;
+	r2 |= r0;
+	r3 = ~r3;
+	r2 ^= r3;
+	r0 ^= r3;
+	r0 &= r1;
+	r3 ^= r4;
+	r3 ^= r0;
+
+	SBOX_OUT(1, 4, 2, 3);
+}
+
+template<class T>
+static inline void si3(T *x)
+{
+	T r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
+
+	r4 = r2;
+	r2 ^= r1;
+	r0 ^= r2;
+	r4 &= r2;
+	r4 ^= r0;
+	r0 &= r1;
+	r1 ^= r3;
+	r3 |= r4;
+	r2 ^= r3;
+	r0 ^= r3;
+	r1 ^= r4;
+	r3 &= r2;
+	r3 ^= r1;
+	r1 ^= r0;
+	r1 |= r2;
+	r0 ^= r3;
+	r1 ^= r4;
+	r0 ^= r1;
+
+	SBOX_OUT(2, 1, 3, 0);
+}
+
+template<class T>
+static inline void si4(T *x)
+{
+	T r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
+
+	r4 = r2;
+	r2 &= r3;
+	r2 ^= r1;
+	r1 |= r3;
+	r1 &= r0;
+	r4 ^= r2;
+	r4 ^= r1;
+	r1 &= r2;
+	r0 = ~r0;
+	r3 ^= r4;
+	r1 ^= r3;
+	r3 &= r0;
+	r3 ^= r2;
+	r0 ^= r1;
+	r2 &= r0;
+	r3 ^= r0;
+	r2 ^= r4;
+	r2 |= r3;
+	r3 ^= r0;
+	r2 ^= r1;
+
+	SBOX_OUT(0, 3, 2, 4);
+}
+
+template<class T>
+static inline void si5(T *x)
+{
+	T r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
+
+	r1 = ~r1;
+	r4 = r3;
+	r2 ^= r1;
+	r3 |= r0;
+	r3 ^= r2;
+	r2 |= r1;
+	r2 &= r0;
+	r4 ^= r3;
+	r2 ^= r4;
+	r4 |= r0;
+	r4 ^= r1;
+	r1 &= r2;
+	r1 ^= r3;
+	r4 ^= r2;
+	r3 &= r4;
+	r4 ^= r1;
+	r3 ^= r4;
+	r4 = ~r4;
+	r3 ^= r0;
+
+	SBOX_OUT(1, 4, 3, 2);
+}
+
+template<class T>
+static inline void si6(T *x)
+{
+	T r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
+
+	r0 ^= r2;
+	r4 = r2;
+	r2 &= r0;
+	r4 ^= r3;
+	r2 = ~r2;
+	r3 ^= r1;
+	r2 ^= r3;
+	r4 |= r0;
+	r0 ^= r2;
+	r3 ^= r4;
+	r4 ^= r1;
+	r1 &= r3;
+	r1 ^= r0;
+	r0 ^= r3;
+	r0 |= r2;
+	r3 ^= r1;
+	r4 ^= r0;
+
+	SBOX_OUT(1, 2, 4, 3);
+}
+
+template<class T>
+static inline void si7(T *x)
+{
+	T r0 = x[0], r1 = x[1], r2 = x[2], r3 = x[3], r4;
+
+	r4 = r2;
+	r2 ^= r0;
+	r0 &= r3;
+	r4 |= r3;
+	r2 = ~r2;
+	r3 ^= r1;
+	r1 |= r0;
+	r0 ^= r2;
+	r2 &= r4;
+	r3 &= r4;
+	r1 ^= r2;
+	r2 ^= r0;
+	r0 |= r2;
+	r4 ^= r1;
+	r0 ^= r3;
+	r3 ^= r4;
+	r4 |= r0;
+	r3 ^= r2;
+	r4 ^= r2;
+
+	SBOX_OUT(3, 0, 1, 4);
+}
+
+template<class T>
+static inline T rotl(T x, size_t n)
+{
+	return (x << n) | (x >> (32 - n));
+}
+
+template<class T>
+static inline T rotr(T x, size_t n)
+{
+	return (x >> n) | (x << (32 - n));
+}
+
+template<class T>
+static inline void eround(T *b, const uint32_t *k, void (*s)(T *x))
+{
+	for (size_t i = 0; i < 4; i++)
+		b[i] ^= k[i];
+	s(b);
+	b[0] = rotl(b[0], 13);
+	b[2] = rotl(b[2], 3);
+	b[1] = rotl(b[1] ^ b[2] ^ b[0], 1);
+	b[3] = rotl(b[3] ^ b[2] ^ (b[0] << 3), 7);
+	b[0] = rotl(b[0] ^ b[3] ^ b[1], 5);
+	b[2] = rotl(b[2] ^ b[3] ^ (b[1] << 7), 22);
+}
+
+template<class T>
+static inline void dround(T *b, const uint32_t *k, void (*s)(T *x))
+{
+	b[2] = rotr(b[2], 22);
+	b[0] = rotr(b[0], 5);
+	b[2] ^= b[3] ^ (b[1] << 7);
+	b[0] ^= b[1] ^ b[3];
+	b[3] = rotr(b[3], 7);
+	b[1] = rotr(b[1], 1);
+	b[3] ^= b[2] ^ (b[0] << 3);
+	b[1] ^= b[0] ^ b[2];
+	b[2] = rotr(b[2], 3);
+	b[0] = rotr(b[0], 13);
+	s(b);
+	for (size_t i = 0; i < 4; i++)
+		b[i] ^= k[i];
+}
+
+template<class T>
+static inline void encrypt_rounds(T *b, const uint32_t *k)
+{
+	for (size_t i = 0; i < 4; i++, k += 32) {
+		eround(b, k+ 0, s0);
+		eround(b, k+ 4, s1);
+		eround(b, k+ 8, s2);
+		eround(b, k+12, s3);
+		eround(b, k+16, s4);
+		eround(b, k+20, s5);
+		eround(b, k+24, s6);
+		if (i == 3)
+			break;
+		eround(b, k+28, s7);
+	}
+	k += 28;
+	for (size_t i = 0; i < 4; i++)
+		b[i] ^= *k++;
+	s7(b);
+	for (size_t i = 0; i < 4; i++)
+		b[i] ^= *k++;
+}
+
+template<class T>
+static inline void decrypt_rounds(T *b, const uint32_t *key)
+{
+	for (size_t j = 0; j < 4; j++)
+		b[j] ^= key[128+j];
+	si7(b);
+	for (size_t j = 0; j < 4; j++)
+		b[j] ^= key[124+j];
+	const uint32_t *k = key + (128 - 32);
+	for (size_t i = 0; i < 4; i++, k -= 32) {
+		if (i)
+			dround(b, k+28, si7);
+		dround(b, k+24, si6);
+		dround(b, k+20, si5);
+		dround(b, k+16, si4);
+		dround(b, k+12, si3);
+		dround(b, k+ 8, si2);
+		dround(b, k+ 4, si1);
+		dround(b, k+ 0, si0);
+	}
+}
+
+/* Transpose four blocks (a, b, c, and d) so that each vector holds one word
+ * from each block.  The operation is its own inverse.  For vectors wider than
+ * 128 bits, this operates on each 128-bit lane independently, so the blocks are
+ * interleaved between the lanes, which is harmless as long as the same
+ * transposition is used for both loading and storing.
+ */
+template<class V, class M>
+static inline void transpose(V &a, V &b, V &c, V &d, const M &lo32,
+		const M &hi32, const M &lo64, const M &hi64)
+{
+	V t0 = __builtin_shuffle(a, b, lo32);
+	V t1 = __builtin_shuffle(a, b, hi32);
+	V t2 = __builtin_shuffle(c, d, lo32);
+	V t3 = __builtin_shuffle(c, d, hi32);
+	a = __builtin_shuffle(t0, t2, lo64);
+	b = __builtin_shuffle(t0, t2, hi64);
+	c = __builtin_shuffle(t1, t3, lo64);
+	d = __builtin_shuffle(t1, t3, hi64);
+}
+UNHIDE()
+
+#endif
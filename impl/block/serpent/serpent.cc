@@ -86,6 +86,14 @@ static int serpent_big_test(void)
 	return res;
 }
 
+static int serpent_fast_test(void)
+{
+	using namespace drew;
+
+	// This covers the eight-way, four-way, and single-block code.
+	return BlockTestCase<Serpent>::FastTest(32, 31);
+}
+
 static int serpenttest(void *, const drew_loader_t *)
 {
 	int res = 0;
@@ -93,6 +101,8 @@ static int serpenttest(void *, const drew_loader_t *)
 	res |= serpent128_test();
 	res <<= 4;
 	res |= serpent_big_test();
+	res <<= 3;
+	res |= serpent_fast_test();
 
 	return res;
 }
@@ -26,6 +26,14 @@
 #include "block-plugin.hh"
 #include "util.hh"
 
+/* The vector implementation loads blocks directly into vectors of words, so it
+ * is only usable on little-endian machines.
+ */
+#if defined(VECTOR_T) && !defined(__clang__) && DREW_GCC_VERSION >= 0x040700 && \
+	DREW_BYTE_ORDER == DREW_LITTLE_ENDIAN
+#define SERPENT_VECTOR
+#endif
+
 HIDE()
 namespace drew {
 
@@ -37,12 +45,22 @@ class Serpent : public BlockCipher<16, LittleEndian>
 		~Serpent() {};
 		int Encrypt(uint8_t *out, const uint8_t *in) const;
 		int Decrypt(uint8_t *out, const uint8_t *in) const;
+#ifdef SERPENT_VECTOR
+		int EncryptFast(FastBlock *bout, const FastBlock *bin, size_t n) const;
+		int DecryptFast(FastBlock *bout, const FastBlock *bin, size_t n) const;
+#endif
 		// This functionality is exposed for Sosemanuk.
 		static void Serpent1(uint32_t *blk);
 		void Serpent24(uint32_t *out, const uint8_t *in);
 	protected:
 		int SetKeyInternal(const uint8_t *key, size_t sz);
 	private:
+		// These process eight blocks at a time using AVX2 and return the
+		// number of blocks processed, which is zero if AVX2 is not available.
+		size_t EncryptFast8(FastBlock *bout, const FastBlock *bin,
+				size_t n) const;
+		size_t DecryptFast8(FastBlock *bout, const FastBlock *bin,
+				size_t n) const;
 		uint32_t m_keybuf[140];
 		uint32_t *m_key;
 
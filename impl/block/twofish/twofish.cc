@@ -28,6 +28,7 @@
 #include <internal.h>
 #include "twofish.hh"
 #include "block-plugin.hh"
+#include "btestcase.hh"
 
 HIDE()
 extern "C" {
@@ -73,11 +74,21 @@ static int twofish128_test(void)
 	return !!memcmp(final, pt, sizeof(pt)) << 1;
 }
 
+static int twofish_fast_test(void)
+{
+	using namespace drew;
+
+	// This covers the four-way, two-way, and single-block code.
+	return BlockTestCase<Twofish>::FastTest(32, 4 * 3 + 3);
+}
+
 static int twofishtest(void *, const drew_loader_t *)
 {
 	int res = 0;
 
 	res |= twofish128_test();
+	res <<= 3;
+	res |= twofish_fast_test();
 
 	return res;
 }
@@ -262,6 +273,99 @@ int drew::Twofish::Decrypt(uint8_t *out, const uint8_t *in) const
 	return 0;
 }
 
+// These process N independent blocks at once.  Each round is latency-bound on
+// the chain of key-dependent S-box lookups, so interleaving the blocks lets
+// the lookups for one block proceed while the others are still waiting.
+template<size_t N>
+void drew::Twofish::EncryptBlocks(FastBlock *bout, const FastBlock *bin) const
+{
+	uint32_t a[N], b[N], c[N], d[N];
+
+	for (size_t j = 0; j < N; j++) {
+		const uint8_t *in = bin[j].data;
+		a[j] = endian_t::Convert<uint32_t>(in +  0) ^ m_k[0];
+		b[j] = endian_t::Convert<uint32_t>(in +  4) ^ m_k[1];
+		c[j] = endian_t::Convert<uint32_t>(in +  8) ^ m_k[2];
+		d[j] = endian_t::Convert<uint32_t>(in + 12) ^ m_k[3];
+	}
+
+	const uint32_t *k = m_k + 8;
+	for (size_t i = 0; i < 16; i+=2, k+=4) {
+		for (size_t j = 0; j < N; j++)
+			f(k, a[j], b[j], c[j], d[j]);
+		for (size_t j = 0; j < N; j++)
+			f(k+2, c[j], d[j], a[j], b[j]);
+	}
+
+	k = m_k + 4;
+	for (size_t j = 0; j < N; j++) {
+		uint8_t *out = bout[j].data;
+		endian_t::Convert(out +  0, c[j] ^ k[0]);
+		endian_t::Convert(out +  4, d[j] ^ k[1]);
+		endian_t::Convert(out +  8, a[j] ^ k[2]);
+		endian_t::Convert(out + 12, b[j] ^ k[3]);
+	}
+}
+
+template<size_t N>
+void drew::Twofish::DecryptBlocks(FastBlock *bout, const FastBlock *bin) const
+{
+	uint32_t a[N], b[N], c[N], d[N];
+
+	const uint32_t *k = m_k + 4;
+	for (size_t j = 0; j < N; j++) {
+		const uint8_t *in = bin[j].data;
+		c[j] = endian_t::Convert<uint32_t>(in +  0) ^ k[0];
+		d[j] = endian_t::Convert<uint32_t>(in +  4) ^ k[1];
+		a[j] = endian_t::Convert<uint32_t>(in +  8) ^ k[2];
+		b[j] = endian_t::Convert<uint32_t>(in + 12) ^ k[3];
+	}
+
+	k = m_k + 38;
+	for (int i = 15; i >= 0; i-=2, k-=4) {
+		for (size_t j = 0; j < N; j++)
+			finv(k, c[j], d[j], a[j], b[j]);
+		for (size_t j = 0; j < N; j++)
+			finv(k-2, a[j], b[j], c[j], d[j]);
+	}
+
+	for (size_t j = 0; j < N; j++) {
+		uint8_t *out = bout[j].data;
+		endian_t::Convert(out +  0, a[j] ^ m_k[0]);
+		endian_t::Convert(out +  4, b[j] ^ m_k[1]);
+		endian_t::Convert(out +  8, c[j] ^ m_k[2]);
+		endian_t::Convert(out + 12, d[j] ^ m_k[3]);
+	}
+}
+
+int drew::Twofish::EncryptFast(FastBlock *bout, const FastBlock *bin,
+		size_t n) const
+{
+	for (; n >= 4; n -= 4, bout += 4, bin += 4)
+		EncryptBlocks<4>(bout, bin);
+	if (n >= 2) {
+		EncryptBlocks<2>(bout, bin);
+		n -= 2, bout += 2, bin += 2;
+	}
+	if (n)
+		Encrypt(bout->data, bin->data);
+	return 0;
+}
+
+int drew::Twofish::DecryptFast(FastBlock *bout, const FastBlock *bin,
+		size_t n) const
+{
+	for (; n >= 4; n -= 4, bout += 4, bin += 4)
+		DecryptBlocks<4>(bout, bin);
+	if (n >= 2) {
+		DecryptBlocks<2>(bout, bin);
+		n -= 2, bout += 2, bin += 2;
+	}
+	if (n)
+		Decrypt(bout->data, bin->data);
+	return 0;
+}
+
 const uint8_t drew::Twofish::q0[] = {
 	0xa9, 0x67, 0xb3, 0xe8, 0x04, 0xfd, 0xa3, 0x76,
 	0x9a, 0x92, 0x80, 0x78, 0xe4, 0xdd, 0xd1, 0x38,
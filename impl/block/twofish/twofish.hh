@@ -36,6 +36,8 @@ class Twofish : public BlockCipher<16, LittleEndian>
 		~Twofish() {};
 		int Encrypt(uint8_t *out, const uint8_t *in) const;
 		int Decrypt(uint8_t *out, const uint8_t *in) const;
+		int EncryptFast(FastBlock *bout, const FastBlock *bin, size_t n) const;
+		int DecryptFast(FastBlock *bout, const FastBlock *bin, size_t n) const;
 	protected:
 		int SetKeyInternal(const uint8_t *key, size_t sz);
 		inline uint32_t Mod(uint32_t) const;
@@ -48,6 +50,10 @@ class Twofish : public BlockCipher<16, LittleEndian>
 				uint32_t &) const;
 		inline uint32_t g0(uint32_t) const;
 		inline uint32_t g1(uint32_t) const;
+		template<size_t N>
+		void EncryptBlocks(FastBlock *bout, const FastBlock *bin) const;
+		template<size_t N>
+		void DecryptBlocks(FastBlock *bout, const FastBlock *bin) const;
 	private:
 		static const uint8_t q0[256], q1[256];
 		static const uint32_t mds[4][256];
@@ -0,0 +1,761 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "internal.h"
+#include "util.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <drew/mem.h>
+
+#include "nist.h"
+
+typedef uint64_t felem[NIST_MAX_LIMBS];
+
+/* One term of a fast reduction: coeff times the number whose 32-bit words,
+ * most significant first, are the given words of the double-length product.  A
+ * word of -1 is zero.
+ */
+struct solinas_term {
+	int coeff;
+	signed char w[NIST_MAX_LIMBS * 2];
+};
+
+struct nist_field {
+	const char *name;
+	size_t nlimbs;
+	felem p;
+	const struct solinas_term *terms;
+	size_t nterms;
+	void (*invert)(const struct nist_field *, uint64_t *, const uint64_t *);
+};
+
+// A point in Jacobian coordinates, (x/z^2, y/z^3).  z is zero at infinity.
+struct jacobian {
+	felem x, y, z;
+};
+
+static inline void mul64(uint64_t *hi, uint64_t *lo, uint64_t a, uint64_t b)
+{
+#if defined(FEATURE_128_BIT_INTEGERS)
+	uint128_t t = (uint128_t)a * b;
+	*hi = t >> 64;
+	*lo = t;
+#else
+	const uint64_t al = a & 0xffffffff, ah = a >> 32;
+	const uint64_t bl = b & 0xffffffff, bh = b >> 32;
+	const uint64_t ll = al * bl, lh = al * bh, hl = ah * bl, hh = ah * bh;
+	const uint64_t mid = (ll >> 32) + (lh & 0xffffffff) + (hl & 0xffffffff);
+	*lo = (mid << 32) | (ll & 0xffffffff);
+	*hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+#endif
+}
+
+static uint64_t add_n(uint64_t *r, const uint64_t *a, const uint64_t *b,
+		size_t n)
+{
+	uint64_t carry = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		const uint64_t t = a[i] + carry;
+		carry = t < carry;
+		r[i] = t + b[i];
+		carry += r[i] < t;
+	}
+	return carry;
+}
+
+static uint64_t sub_n(uint64_t *r, const uint64_t *a, const uint64_t *b,
+		size_t n)
+{
+	uint64_t borrow = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		const uint64_t t = a[i] - b[i];
+		const uint64_t under = a[i] < b[i];
+		r[i] = t - borrow;
+		borrow = under | (t < borrow);
+	}
+	return borrow;
+}
+
+static int cmp_n(const uint64_t *a, const uint64_t *b, size_t n)
+{
+	for (size_t i = n; i-- > 0; )
+		if (a[i] != b[i])
+			return a[i] < b[i] ? -1 : 1;
+	return 0;
+}
+
+/* r holds r + top * 2^(64n), which is reduced modulo p.  top need only be
+ * small, since each pass of the loops moves it by one.
+ */
+static void normalize(const struct nist_field *f, uint64_t *r, int64_t top)
+{
+	const size_t n = f->nlimbs;
+
+	while (top < 0)
+		top += add_n(r, r, f->p, n);
+	while (top > 0)
+		top -= sub_n(r, r, f->p, n);
+	if (cmp_n(r, f->p, n) >= 0)
+		sub_n(r, r, f->p, n);
+}
+
+static void fe_add(const struct nist_field *f, uint64_t *r, const uint64_t *a,
+		const uint64_t *b)
+{
+	normalize(f, r, add_n(r, a, b, f->nlimbs));
+}
+
+static void fe_sub(const struct nist_field *f, uint64_t *r, const uint64_t *a,
+		const uint64_t *b)
+{
+	normalize(f, r, -(int64_t)sub_n(r, a, b, f->nlimbs));
+}
+
+static void reduce(const struct nist_field *f, uint64_t *r, const uint64_t *t)
+{
+	const size_t nwords = f->nlimbs * 2;
+	int64_t c[NIST_MAX_LIMBS * 4], acc[NIST_MAX_LIMBS * 2] = {0}, carry = 0;
+
+	for (size_t i = 0; i < nwords * 2; i++)
+		c[i] = (t[i / 2] >> (32 * (i & 1))) & 0xffffffff;
+	for (size_t i = 0; i < f->nterms; i++) {
+		const struct solinas_term *term = f->terms + i;
+		for (size_t j = 0; j < nwords; j++) {
+			const int w = term->w[nwords - 1 - j];
+			if (w >= 0)
+				acc[j] += term->coeff * c[w];
+		}
+	}
+	for (size_t j = 0; j < nwords; j++) {
+		acc[j] += carry;
+		carry = acc[j] >> 32;
+		acc[j] &= 0xffffffff;
+	}
+	for (size_t i = 0; i < f->nlimbs; i++)
+		r[i] = acc[2*i] | (uint64_t)acc[2*i + 1] << 32;
+	normalize(f, r, carry);
+}
+
+static void fe_mul(const struct nist_field *f, uint64_t *r, const uint64_t *a,
+		const uint64_t *b)
+{
+	const size_t n = f->nlimbs;
+	uint64_t t[NIST_MAX_LIMBS * 2];
+
+	memset(t, 0, sizeof(t));
+	for (size_t i = 0; i < n; i++) {
+		uint64_t carry = 0;
+		for (size_t j = 0; j < n; j++) {
+			uint64_t hi, lo;
+			mul64(&hi, &lo, a[i], b[j]);
+			lo += t[i+j];
+			hi += lo < t[i+j];
+			lo += carry;
+			hi += lo < carry;
+			t[i+j] = lo;
+			carry = hi;
+		}
+		t[i+n] = carry;
+	}
+	reduce(f, r, t);
+}
+
+static void fe_sqr(const struct nist_field *f, uint64_t *r, const uint64_t *a)
+{
+	fe_mul(f, r, a, a);
+}
+
+// r = a^(2^n)
+static void fe_sqr_n(const struct nist_field *f, uint64_t *r,
+		const uint64_t *a, size_t n)
+{
+	memmove(r, a, f->nlimbs * sizeof(*r));
+	while (n--)
+		fe_sqr(f, r, r);
+}
+
+static bool fe_iszero(const struct nist_field *f, const uint64_t *a)
+{
+	uint64_t x = 0;
+
+	for (size_t i = 0; i < f->nlimbs; i++)
+		x |= a[i];
+	return !x;
+}
+
+static void fe_setone(const struct nist_field *f, uint64_t *r)
+{
+	memset(r, 0, f->nlimbs * sizeof(*r));
+	r[0] = 1;
+}
+
+/* The inverses are computed as a^(p-2) with addition chains.  x<n> is
+ * a^(2^n - 1), that is, n one bits; p - 2 is made of runs of those and of
+ * zeros.
+ */
+static void fe_inv_common(const struct nist_field *f, uint64_t *x2,
+		uint64_t *x3, uint64_t *x15, uint64_t *x30, const uint64_t *a)
+{
+	felem x6, x12;
+
+	fe_sqr(f, x2, a);
+	fe_mul(f, x2, x2, a);
+	fe_sqr(f, x3, x2);
+	fe_mul(f, x3, x3, a);
+	fe_sqr_n(f, x6, x3, 3);
+	fe_mul(f, x6, x6, x3);
+	fe_sqr_n(f, x12, x6, 6);
+	fe_mul(f, x12, x12, x6);
+	fe_sqr_n(f, x15, x12, 3);
+	fe_mul(f, x15, x15, x3);
+	fe_sqr_n(f, x30, x15, 15);
+	fe_mul(f, x30, x30, x15);
+}
+
+// p - 2 is 1^32 0^31 1 0^96 1^94 0 1.
+static void fe_inv256(const struct nist_field *f, uint64_t *r,
+		const uint64_t *a)
+{
+	felem x2, x3, x15, x30, x32, x64, x94, t;
+
+	fe_inv_common(f, x2, x3, x15, x30, a);
+	fe_sqr_n(f, x32, x30, 2);
+	fe_mul(f, x32, x32, x2);
+	fe_sqr_n(f, x64, x32, 32);
+	fe_mul(f, x64, x64, x32);
+	fe_sqr_n(f, x94, x64, 30);
+	fe_mul(f, x94, x94, x30);
+
+	fe_sqr_n(f, t, x32, 32);
+	fe_mul(f, t, t, a);
+	fe_sqr_n(f, t, t, 96);
+	fe_sqr_n(f, t, t, 94);
+	fe_mul(f, t, t, x94);
+	fe_sqr_n(f, t, t, 2);
+	fe_mul(f, r, t, a);
+}
+
+// p - 2 is 1^255 0 1^32 0^64 1^30 0 1.
+static void fe_inv384(const struct nist_field *f, uint64_t *r,
+		const uint64_t *a)
+{
+	felem x2, x3, x15, x30, x32, x60, x120, x255, t;
+
+	fe_inv_common(f, x2, x3, x15, x30, a);
+	fe_sqr_n(f, x32, x30, 2);
+	fe_mul(f, x32, x32, x2);
+	fe_sqr_n(f, x60, x30, 30);
+	fe_mul(f, x60, x60, x30);
+	fe_sqr_n(f, x120, x60, 60);
+	fe_mul(f, x120, x120, x60);
+	fe_sqr_n(f, x255, x120, 120);
+	fe_mul(f, x255, x255, x120);
+	fe_sqr_n(f, x255, x255, 15);
+	fe_mul(f, x255, x255, x15);
+
+	fe_sqr_n(f, t, x255, 33);
+	fe_mul(f, t, t, x32);
+	fe_sqr_n(f, t, t, 64);
+	fe_sqr_n(f, t, t, 30);
+	fe_mul(f, t, t, x30);
+	fe_sqr_n(f, t, t, 2);
+	fe_mul(f, r, t, a);
+}
+
+static void fe_inv(const struct nist_field *f, uint64_t *r, const uint64_t *a)
+{
+	f->invert(f, r, a);
+}
+
+// From FIPS 186-3, D.2.3 and D.2.4.
+static const struct solinas_term p256_terms[] = {
+	{ 1, {  7,  6,  5,  4,  3,  2,  1,  0}},
+	{ 2, { 15, 14, 13, 12, 11, -1, -1, -1}},
+	{ 2, { -1, 15, 14, 13, 12, -1, -1, -1}},
+	{ 1, { 15, 14, -1, -1, -1, 10,  9,  8}},
+	{ 1, {  8, 13, 15, 14, 13, 11, 10,  9}},
+	{-1, { 10,  8, -1, -1, -1, 13, 12, 11}},
+	{-1, { 11,  9, -1, -1, 15, 14, 13, 12}},
+	{-1, { 12, -1, 10,  9,  8, 15, 14, 13}},
+	{-1, { 13, -1, 11, 10,  9, -1, 15, 14}}
+};
+
+static const struct solinas_term p384_terms[] = {
+	{ 1, { 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1,  0}},
+	{ 2, { -1, -1, -1, -1, -1, 23, 22, 21, -1, -1, -1, -1}},
+	{ 1, { 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12}},
+	{ 1, { 20, 19, 18, 17, 16, 15, 14, 13, 12, 23, 22, 21}},
+	{ 1, { 19, 18, 17, 16, 15, 14, 13, 12, 20, -1, 23, -1}},
+	{ 1, { -1, -1, -1, -1, 23, 22, 21, 20, -1, -1, -1, -1}},
+	{ 1, { -1, -1, -1, -1, -1, -1, 23, 22, 21, -1, -1, 20}},
+	{-1, { 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 23}},
+	{-1, { -1, -1, -1, -1, -1, -1, -1, 23, 22, 21, 20, -1}},
+	{-1, { -1, -1, -1, -1, -1, -1, -1, 23, 23, -1, -1, -1}}
+};
+
+static const struct nist_field fields[] = {
+	{
+		"secp256r1", 4,
+		{
+			0xffffffffffffffff, 0x00000000ffffffff,
+			0x0000000000000000, 0xffffffff00000001
+		},
+		p256_terms, DIM(p256_terms), fe_inv256
+	},
+	{
+		"secp384r1", 6,
+		{
+			0x00000000ffffffff, 0xffffffff00000000,
+			0xfffffffffffffffe, 0xffffffffffffffff,
+			0xffffffffffffffff, 0xffffffffffffffff
+		},
+		p384_terms, DIM(p384_terms), fe_inv384
+	}
+};
+
+static void fe_frombytes(const struct nist_field *f, uint64_t *r,
+		const uint8_t *b)
+{
+	const size_t n = f->nlimbs;
+
+	for (size_t i = 0; i < n; i++) {
+		const uint8_t *p = b + (n - 1 - i) * 8;
+		r[i] = 0;
+		for (size_t j = 0; j < 8; j++)
+			r[i] = (r[i] << 8) | p[j];
+	}
+	if (cmp_n(r, f->p, n) >= 0)
+		sub_n(r, r, f->p, n);
+}
+
+static void fe_tobytes(const struct nist_field *f, uint8_t *b,
+		const uint64_t *a)
+{
+	const size_t n = f->nlimbs;
+
+	for (size_t i = 0; i < n; i++) {
+		uint8_t *p = b + (n - 1 - i) * 8;
+		for (size_t j = 0; j < 8; j++)
+			p[j] = a[i] >> (56 - 8 * j);
+	}
+}
+
+/* The formulas are from the Explicit-Formulas Database: dbl-2001-b,
+ * add-2007-bl, and madd-2007-bl.  Both curves have a = -3.
+ */
+static void jac_dbl(const struct nist_field *f, struct jacobian *r,
+		const struct jacobian *a)
+{
+	felem delta, gamma, beta, alpha, t;
+
+	if (fe_iszero(f, a->z)) {
+		*r = *a;
+		return;
+	}
+	fe_sqr(f, delta, a->z);
+	fe_sqr(f, gamma, a->y);
+	fe_mul(f, beta, a->x, gamma);
+	// alpha = 3(x - delta)(x + delta)
+	fe_sub(f, t, a->x, delta);
+	fe_add(f, alpha, a->x, delta);
+	fe_mul(f, alpha, alpha, t);
+	fe_add(f, t, alpha, alpha);
+	fe_add(f, alpha, alpha, t);
+	// z3 = (y + z)^2 - gamma - delta
+	fe_add(f, t, a->y, a->z);
+	fe_sqr(f, t, t);
+	fe_sub(f, t, t, gamma);
+	fe_sub(f, r->z, t, delta);
+	// x3 = alpha^2 - 8beta
+	fe_add(f, beta, beta, beta);
+	fe_add(f, beta, beta, beta);
+	fe_sqr(f, t, alpha);
+	fe_sub(f, t, t, beta);
+	fe_sub(f, r->x, t, beta);
+	// y3 = alpha(4beta - x3) - 8gamma^2
+	fe_sub(f, t, beta, r->x);
+	fe_mul(f, t, t, alpha);
+	fe_sqr(f, gamma, gamma);
+	fe_add(f, gamma, gamma, gamma);
+	fe_add(f, gamma, gamma, gamma);
+	fe_add(f, gamma, gamma, gamma);
+	fe_sub(f, r->y, t, gamma);
+}
+
+static void jac_setinf(const struct nist_field *f, struct jacobian *r)
+{
+	memset(r, 0, sizeof(*r));
+	fe_setone(f, r->x);
+	fe_setone(f, r->y);
+}
+
+/* Finishes an addition given u1 = x1 z2^2, s1 = y1 z2^3, h = u2 - u1, and
+ * rr = s2 - s1, where z3 has already been computed.
+ */
+static void jac_add_finish(const struct nist_field *f, struct jacobian *r,
+		const uint64_t *u1, uint64_t *s1, const uint64_t *h, uint64_t *rr)
+{
+	felem i, j, v, t;
+
+	// i = (2h)^2, j = hi, v = u1 i
+	fe_add(f, i, h, h);
+	fe_sqr(f, i, i);
+	fe_mul(f, j, h, i);
+	fe_mul(f, v, u1, i);
+	fe_add(f, rr, rr, rr);
+	// x3 = rr^2 - j - 2v
+	fe_sqr(f, t, rr);
+	fe_sub(f, t, t, j);
+	fe_sub(f, t, t, v);
+	fe_sub(f, r->x, t, v);
+	// y3 = rr(v - x3) - 2 s1 j
+	fe_sub(f, t, v, r->x);
+	fe_mul(f, t, t, rr);
+	fe_mul(f, s1, s1, j);
+	fe_add(f, s1, s1, s1);
+	fe_sub(f, r->y, t, s1);
+}
+
+static void jac_add(const struct nist_field *f, struct jacobian *r,
+		const struct jacobian *a, const struct jacobian *b)
+{
+	felem z1z1, z2z2, u1, u2, s1, s2, h, rr, t;
+
+	if (fe_iszero(f, a->z)) {
+		*r = *b;
+		return;
+	}
+	if (fe_iszero(f, b->z)) {
+		*r = *a;
+		return;
+	}
+	fe_sqr(f, z1z1, a->z);
+	fe_sqr(f, z2z2, b->z);
+	fe_mul(f, u1, a->x, z2z2);
+	fe_mul(f, u2, b->x, z1z1);
+	fe_mul(f, s1, a->y, b->z);
+	fe_mul(f, s1, s1, z2z2);
+	fe_mul(f, s2, b->y, a->z);
+	fe_mul(f, s2, s2, z1z1);
+	fe_sub(f, h, u2, u1);
+	fe_sub(f, rr, s2, s1);
+	if (fe_iszero(f, h)) {
+		if (fe_iszero(f, rr))
+			jac_dbl(f, r, a);
+		else
+			jac_setinf(f, r);
+		return;
+	}
+	// z3 = ((z1 + z2)^2 - z1z1 - z2z2) h
+	fe_add(f, t, a->z, b->z);
+	fe_sqr(f, t, t);
+	fe_sub(f, t, t, z1z1);
+	fe_sub(f, t, t, z2z2);
+	fe_mul(f, r->z, t, h);
+	jac_add_finish(f, r, u1, s1, h, rr);
+}
+
+// As jac_add, where b has z = 1.
+static void jac_add_affine(const struct nist_field *f, struct jacobian *r,
+		const struct jacobian *a, const struct nist_affine *b)
+{
+	felem z1z1, u1, u2, s1, s2, h, rr, t;
+
+	if (b->inf) {
+		*r = *a;
+		return;
+	}
+	if (fe_iszero(f, a->z)) {
+		memcpy(r->x, b->x, sizeof(r->x));
+		memcpy(r->y, b->y, sizeof(r->y));
+		fe_setone(f, r->z);
+		return;
+	}
+	fe_sqr(f, z1z1, a->z);
+	memcpy(u1, a->x, sizeof(u1));
+	fe_mul(f, u2, b->x, z1z1);
+	memcpy(s1, a->y, sizeof(s1));
+	fe_mul(f, s2, b->y, a->z);
+	fe_mul(f, s2, s2, z1z1);
+	fe_sub(f, h, u2, u1);
+	fe_sub(f, rr, s2, s1);
+	if (fe_iszero(f, h)) {
+		if (fe_iszero(f, rr))
+			jac_dbl(f, r, a);
+		else
+			jac_setinf(f, r);
+		return;
+	}
+	// z3 = 2 z1 h, which is ((z1 + h)^2 - z1z1 - h^2) in the formulas.
+	fe_mul(f, t, a->z, h);
+	fe_add(f, r->z, t, t);
+	jac_add_finish(f, r, u1, s1, h, rr);
+}
+
+static void jac_from_affine(const struct nist_field *f, struct jacobian *r,
+		const struct nist_affine *a)
+{
+	if (a->inf) {
+		jac_setinf(f, r);
+		return;
+	}
+	memcpy(r->x, a->x, sizeof(r->x));
+	memcpy(r->y, a->y, sizeof(r->y));
+	fe_setone(f, r->z);
+}
+
+// zinv is 1/z, or anything if a is infinity.
+static void jac_to_affine(const struct nist_field *f, struct nist_affine *r,
+		const struct jacobian *a, const uint64_t *zinv)
+{
+	felem t;
+
+	memset(r, 0, sizeof(*r));
+	if ((r->inf = fe_iszero(f, a->z)))
+		return;
+	fe_sqr(f, t, zinv);
+	fe_mul(f, r->x, a->x, t);
+	fe_mul(f, t, t, zinv);
+	fe_mul(f, r->y, a->y, t);
+}
+
+static void jac_normalize(const struct nist_field *f, struct nist_affine *r,
+		const struct jacobian *a)
+{
+	felem zinv;
+
+	fe_inv(f, zinv, a->z);
+	jac_to_affine(f, r, a, zinv);
+}
+
+/* Converts n points with one inversion, using Montgomery's trick.  scratch
+ * must have room for n field elements.
+ */
+static void jac_normalize_many(const struct nist_field *f,
+		struct nist_affine *r, const struct jacobian *a, size_t n,
+		felem *scratch)
+{
+	felem acc, zinv;
+
+	fe_setone(f, acc);
+	for (size_t i = 0; i < n; i++) {
+		memcpy(scratch[i], acc, sizeof(acc));
+		if (!fe_iszero(f, a[i].z))
+			fe_mul(f, acc, acc, a[i].z);
+	}
+	fe_inv(f, acc, acc);
+	for (size_t i = n; i-- > 0; ) {
+		if (fe_iszero(f, a[i].z)) {
+			jac_to_affine(f, r + i, a + i, acc);
+			continue;
+		}
+		fe_mul(f, zinv, acc, scratch[i]);
+		fe_mul(f, acc, acc, a[i].z);
+		jac_to_affine(f, r + i, a + i, zinv);
+	}
+}
+
+static inline unsigned scalar_bit(const uint8_t *k, size_t len, size_t i)
+{
+	return i < len * 8 ? (k[len - 1 - i / 8] >> (i % 8)) & 1 : 0;
+}
+
+static inline unsigned scalar_nibble(const uint8_t *k, size_t len, size_t i)
+{
+	return i < len * 2 ? (k[len - 1 - i / 2] >> (4 * (i % 2))) & 0xf : 0;
+}
+
+static size_t scalar_nbits(const uint8_t *k, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		if (k[i])
+			return (len - i) * 8 - __builtin_clz(k[i]) + 24;
+	return 0;
+}
+
+const struct nist_field *nist_lookup(const char *name)
+{
+	for (size_t i = 0; i < DIM(fields); i++)
+		if (!strcmp(name, fields[i].name))
+			return fields + i;
+	return NULL;
+}
+
+size_t nist_nbytes(const struct nist_field *f)
+{
+	return f->nlimbs * 8;
+}
+
+void nist_load(const struct nist_field *f, struct nist_affine *r,
+		const uint8_t *x, const uint8_t *y)
+{
+	memset(r, 0, sizeof(*r));
+	fe_frombytes(f, r->x, x);
+	fe_frombytes(f, r->y, y);
+}
+
+void nist_store(const struct nist_field *f, uint8_t *x, uint8_t *y,
+		const struct nist_affine *a)
+{
+	fe_tobytes(f, x, a->x);
+	fe_tobytes(f, y, a->y);
+}
+
+void nist_add(const struct nist_field *f, struct nist_affine *r,
+		const struct nist_affine *a, const struct nist_affine *b)
+{
+	struct jacobian t;
+
+	jac_from_affine(f, &t, a);
+	jac_add_affine(f, &t, &t, b);
+	jac_normalize(f, r, &t);
+}
+
+void nist_dbl(const struct nist_field *f, struct nist_affine *r,
+		const struct nist_affine *a)
+{
+	struct jacobian t;
+
+	jac_from_affine(f, &t, a);
+	jac_dbl(f, &t, &t);
+	jac_normalize(f, r, &t);
+}
+
+// t[i] = iP for i < 16.
+static void window_table(const struct nist_field *f, struct jacobian *t,
+		const struct nist_affine *p)
+{
+	jac_setinf(f, t);
+	jac_from_affine(f, t+1, p);
+	for (size_t i = 2; i < 16; i++) {
+		if (i & 1)
+			jac_add_affine(f, t+i, t+i-1, p);
+		else
+			jac_dbl(f, t+i, t+i/2);
+	}
+}
+
+/* This is Straus's method with four-bit windows: the doublings are shared
+ * between the two scalars.
+ */
+void nist_mul2(const struct nist_field *f, struct nist_affine *r,
+		const struct nist_affine *p, const uint8_t *a, size_t alen,
+		const struct nist_affine *q, const uint8_t *b, size_t blen)
+{
+	struct jacobian tp[16], tq[16], acc;
+	const size_t nnibbles = (q && blen > alen ? blen : alen) * 2;
+
+	window_table(f, tp, p);
+	if (q)
+		window_table(f, tq, q);
+	jac_setinf(f, &acc);
+	for (size_t i = nnibbles; i-- > 0; ) {
+		unsigned d;
+
+		for (int j = 0; j < 4; j++)
+			jac_dbl(f, &acc, &acc);
+		if ((d = scalar_nibble(a, alen, i)))
+			jac_add(f, &acc, &acc, tp + d);
+		if (q && (d = scalar_nibble(b, blen, i)))
+			jac_add(f, &acc, &acc, tq + d);
+	}
+	jac_normalize(f, r, &acc);
+}
+
+#define COMB_TEETH 8
+
+struct nist_comb {
+	size_t spacing;
+	struct nist_affine g;
+	// table[i] is the sum of 2^(j * spacing) g over the bits j set in i.
+	struct nist_affine table[1 << COMB_TEETH];
+};
+
+struct nist_comb *nist_comb_new(const struct nist_field *f,
+		const struct nist_affine *g, size_t nbits)
+{
+	const size_t n = 1 << COMB_TEETH;
+	struct nist_comb *comb;
+	struct jacobian *t;
+	felem *scratch;
+
+	comb = drew_mem_malloc(sizeof(*comb));
+	t = drew_mem_malloc(n * sizeof(*t));
+	scratch = drew_mem_malloc(n * sizeof(*scratch));
+	if (!comb || !t || !scratch || !nbits) {
+		drew_mem_free(comb);
+		comb = NULL;
+		goto out;
+	}
+
+	comb->g = *g;
+	comb->spacing = (nbits + COMB_TEETH - 1) / COMB_TEETH;
+	jac_setinf(f, t);
+	jac_from_affine(f, t+1, g);
+	for (size_t j = 1; j < COMB_TEETH; j++) {
+		struct jacobian *tooth = t + (1 << j);
+		*tooth = t[1 << (j-1)];
+		for (size_t i = 0; i < comb->spacing; i++)
+			jac_dbl(f, tooth, tooth);
+	}
+	for (size_t i = 3; i < n; i++)
+		if (i & (i-1))
+			jac_add(f, t+i, t + (i & (i-1)), t + (i & -i));
+	jac_normalize_many(f, comb->table, t, n, scratch);
+out:
+	drew_mem_free(t);
+	drew_mem_free(scratch);
+	return comb;
+}
+
+void nist_comb_free(struct nist_comb *comb)
+{
+	drew_mem_free(comb);
+}
+
+void nist_comb_mul(const struct nist_field *f, const struct nist_comb *comb,
+		struct nist_affine *r, const uint8_t *k, size_t len)
+{
+	const size_t nbits = scalar_nbits(k, len);
+	struct jacobian acc;
+
+	if (nbits > comb->spacing * COMB_TEETH) {
+		nist_mul2(f, r, &comb->g, k, len, NULL, NULL, 0);
+		return;
+	}
+
+	jac_setinf(f, &acc);
+	for (size_t i = comb->spacing; i-- > 0; ) {
+		size_t index = 0;
+
+		jac_dbl(f, &acc, &acc);
+		for (size_t j = 0; j < COMB_TEETH; j++)
+			index |= scalar_bit(k, len, j * comb->spacing + i) << j;
+		if (index)
+			jac_add_affine(f, &acc, &acc, comb->table + index);
+	}
+	jac_normalize(f, r, &acc);
+}
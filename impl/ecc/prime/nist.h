@@ -0,0 +1,71 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* Arithmetic for secp256r1 and secp384r1 on fixed-size arrays of 64-bit limbs.
+ * Field elements are reduced with the fast reductions from FIPS 186-3, D.2, and
+ * inverted by exponentiation to p - 2.  Points are kept in Jacobian coordinates
+ * internally.  None of this allocates memory except nist_comb_new.
+ *
+ * Coordinates and scalars are passed in and out as big-endian bytes; the
+ * coordinates are nist_nbytes long.
+ */
+#ifndef DREW_ECC_NIST_H
+#define DREW_ECC_NIST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define NIST_MAX_LIMBS 6
+#define NIST_MAX_BYTES (NIST_MAX_LIMBS * 8)
+
+struct nist_field;
+struct nist_comb;
+
+struct nist_affine {
+	bool inf;
+	uint64_t x[NIST_MAX_LIMBS];
+	uint64_t y[NIST_MAX_LIMBS];
+};
+
+// Returns NULL if there is no fixed-width implementation for the curve.
+const struct nist_field *nist_lookup(const char *name);
+size_t nist_nbytes(const struct nist_field *f);
+void nist_load(const struct nist_field *f, struct nist_affine *r,
+		const uint8_t *x, const uint8_t *y);
+void nist_store(const struct nist_field *f, uint8_t *x, uint8_t *y,
+		const struct nist_affine *a);
+void nist_add(const struct nist_field *f, struct nist_affine *r,
+		const struct nist_affine *a, const struct nist_affine *b);
+void nist_dbl(const struct nist_field *f, struct nist_affine *r,
+		const struct nist_affine *a);
+// r = aP + bQ.  Q and b may be NULL.
+void nist_mul2(const struct nist_field *f, struct nist_affine *r,
+		const struct nist_affine *p, const uint8_t *a, size_t alen,
+		const struct nist_affine *q, const uint8_t *b, size_t blen);
+// A fixed-base comb for g, for scalars of up to nbits bits.
+struct nist_comb *nist_comb_new(const struct nist_field *f,
+		const struct nist_affine *g, size_t nbits);
+void nist_comb_free(struct nist_comb *comb);
+void nist_comb_mul(const struct nist_field *f, const struct nist_comb *comb,
+		struct nist_affine *r, const uint8_t *k, size_t len);
+
+#endif
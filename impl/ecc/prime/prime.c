@@ -38,6 +38,7 @@
 #include <drew/plugin.h>
 
 #include "util.h"
+#include "nist.h"
 
 struct point {
 	bool inf;
@@ -46,7 +47,39 @@ struct point {
 	struct curve *curve;
 };
 
+/* The number of teeth in the comb used for multiplying the base point.  The
+ * table holds 2^COMB_TEETH points and a multiplication takes about n/COMB_TEETH
+ * doublings and as many additions, where n is the size of the group order.
+ */
+#define COMB_TEETH 8
+
+/* table[i] is the sum of 2^(j * spacing) G over the bits j set in i. */
+struct comb {
+	size_t spacing;
+	struct point table[1 << COMB_TEETH];
+};
+
+/* The constants for arithmetic in Jacobian coordinates: the Montgomery context
+ * for p, and a and 1 in Montgomery form.
+ */
+struct mont_field {
+	drew_bignum_mont_t *mont;
+	drew_bignum_t a;
+	drew_bignum_t one;
+};
+
+/* A set of curve parameters and the values computed from them.  These are
+ * shared by a context and all of its clones, and each named curve is parsed
+ * once for them and kept until the last of them is freed, so a curve is only
+ * modified in place when a single context holds it.  Points hold a reference
+ * to the curve, not the context.
+ *
+ * The combs and the Montgomery constants are built the first time they are
+ * needed and do not change after that.  Changing any of the parameters drops
+ * them and the fixed-width field, so that is only used for named curves.
+ */
 struct curve {
+	int refs;
 	const char *name;
 	drew_bignum_t p;
 	drew_bignum_t a;
@@ -54,8 +87,22 @@ struct curve {
 	struct point g;
 	drew_bignum_t n;
 	drew_bignum_t h;
+	const struct nist_field *field;
+	struct comb *comb;
+	struct nist_comb *nist_comb;
+	struct mont_field *mont;
 };
 
+struct named_cache;
+
+struct ecc {
+	struct curve *curve;
+	struct named_cache *named;
+};
+
+static struct named_cache *named_ref(struct named_cache *n);
+static void named_release(struct named_cache *n);
+
 static int ecp_info(int op, void *p);
 static int ecp_info2(const drew_ecc_t *ctx, int op, drew_param_t *out,
 		const drew_param_t *in);
@@ -111,6 +158,7 @@ static int ecpt_mul2(drew_ecc_point_t *r, const drew_ecc_point_t *ptp,
 static int ecpt_mul(drew_ecc_point_t *ptr, const drew_ecc_point_t *pta,
 		const drew_bignum_t *b);
 static int ecpt_test(void *p, DrewLoader *ldr);
+static int ecpt_mulbase(drew_ecc_point_t *ptr, const drew_bignum_t *b);
 
 static drew_ecc_functbl_t ecp_functbl = {
 	ecp_info, ecp_info2, ecp_init, ecp_clone, ecp_fini, ecp_setcurvename,
@@ -122,7 +170,7 @@ static drew_ecc_point_functbl_t ecpt_functbl = {
 	ecpt_info, ecpt_info2, ecpt_init, ecpt_clone, ecpt_fini, ecpt_setinf,
 	ecpt_isinf, ecpt_compare, ecpt_setcoordbytes, ecpt_coordbytes,
 	ecpt_ncoordbytes, ecpt_setcoordbignum, ecpt_coordbignum, ecpt_inv, ecpt_add,
-	ecpt_mul, ecpt_mul2, ecpt_dbl, ecpt_test
+	ecpt_mul, ecpt_mul2, ecpt_dbl, ecpt_test, ecpt_mulbase
 };
 
 
@@ -133,7 +181,7 @@ static int ecp_info(int op, void *p)
 		case DREW_ECC_VERSION:
 			return CURRENT_ABI;
 		case DREW_ECC_INTSIZE:
-			return sizeof(struct curve);
+			return sizeof(struct ecc);
 		default:
 			return -DREW_ERR_INVALID;
 	}
@@ -145,6 +193,108 @@ static int ecp_info2(const drew_ecc_t *ctx, int op, drew_param_t *out,
 	return ecp_info(op, NULL);
 }
 
+static struct curve *ctx_curve(const drew_ecc_t *ctx)
+{
+	const struct ecc *e = ctx->ctx;
+	return e->curve;
+}
+
+static void comb_free(struct comb *comb)
+{
+	for (size_t i = 0; i < DIM(comb->table); i++) {
+		struct point *pt = comb->table + i;
+		pt->x.functbl->fini(&pt->x, 0);
+		pt->y.functbl->fini(&pt->y, 0);
+	}
+	drew_mem_free(comb);
+}
+
+static void mont_field_free(struct mont_field *mf)
+{
+	mf->a.functbl->montfini(mf->mont);
+	mf->a.functbl->fini(&mf->a, 0);
+	mf->one.functbl->fini(&mf->one, 0);
+	drew_mem_free(mf);
+}
+
+static void curve_drop_precomp(struct curve *c)
+{
+	if (c->comb)
+		comb_free(c->comb);
+	if (c->nist_comb)
+		nist_comb_free(c->nist_comb);
+	if (c->mont)
+		mont_field_free(c->mont);
+	c->field = NULL;
+	c->comb = NULL;
+	c->nist_comb = NULL;
+	c->mont = NULL;
+}
+
+// Creates a curve with the parameters of old, or empty ones if old is NULL.
+static struct curve *curve_new(const drew_bignum_t *bn, const struct curve *old)
+{
+	struct curve *c;
+
+	if (!(c = drew_mem_malloc(sizeof(*c))))
+		return NULL;
+	c->refs = 1;
+	c->name = old ? old->name : NULL;
+	bn->functbl->clone(&c->p, old ? &old->p : bn, 0);
+	bn->functbl->clone(&c->a, old ? &old->a : bn, 0);
+	bn->functbl->clone(&c->b, old ? &old->b : bn, 0);
+	bn->functbl->clone(&c->n, old ? &old->n : bn, 0);
+	bn->functbl->clone(&c->h, old ? &old->h : bn, 0);
+	bn->functbl->clone(&c->g.x, old ? &old->g.x : bn, 0);
+	bn->functbl->clone(&c->g.y, old ? &old->g.y : bn, 0);
+	c->g.inf = old ? old->g.inf : false;
+	c->g.curve = c;
+	c->field = NULL;
+	c->comb = NULL;
+	c->nist_comb = NULL;
+	c->mont = NULL;
+	return c;
+}
+
+static struct curve *curve_ref(struct curve *c)
+{
+	__atomic_add_fetch(&c->refs, 1, __ATOMIC_RELAXED);
+	return c;
+}
+
+static void curve_release(struct curve *c)
+{
+	if (!c || __atomic_sub_fetch(&c->refs, 1, __ATOMIC_ACQ_REL))
+		return;
+	c->p.functbl->fini(&c->p, 0);
+	c->a.functbl->fini(&c->a, 0);
+	c->b.functbl->fini(&c->b, 0);
+	c->n.functbl->fini(&c->n, 0);
+	c->h.functbl->fini(&c->h, 0);
+	c->g.x.functbl->fini(&c->g.x, 0);
+	c->g.y.functbl->fini(&c->g.y, 0);
+	curve_drop_precomp(c);
+	drew_mem_free(c);
+}
+
+/* Called before the curve parameters change.  If anything else holds the
+ * curve, the context gets its own copy.
+ */
+static int curve_modify(struct ecc *e)
+{
+	struct curve *c = e->curve;
+
+	if (__atomic_load_n(&c->refs, __ATOMIC_ACQUIRE) == 1) {
+		curve_drop_precomp(c);
+		return 0;
+	}
+	if (!(c = curve_new(&e->curve->p, e->curve)))
+		return -ENOMEM;
+	curve_release(e->curve);
+	e->curve = c;
+	return 0;
+}
+
 static int ecp_init(drew_ecc_t *ctx, int flags, DrewLoader *ldr,
 		const drew_param_t *param)
 {
@@ -158,63 +308,49 @@ static int ecp_init(drew_ecc_t *ctx, int flags, DrewLoader *ldr,
 	if (!bn)
 		return -DREW_ERR_MORE_INFO;
 
+	if (!(c = curve_new(bn, NULL)))
+		return -ENOMEM;
+
 	if (!(flags & DREW_ECC_FIXED))
-		if (!(ctx->ctx = drew_mem_malloc(sizeof(struct curve))))
+		if (!(ctx->ctx = drew_mem_malloc(sizeof(struct ecc)))) {
+			curve_release(c);
 			return -ENOMEM;
+		}
 
-	c = ctx->ctx;
 	ctx->functbl = &ecp_functbl;
-	c->name = NULL;
-	bn->functbl->clone(&c->p, bn, 0);
-	bn->functbl->clone(&c->a, bn, 0);
-	bn->functbl->clone(&c->b, bn, 0);
-	bn->functbl->clone(&c->n, bn, 0);
-	bn->functbl->clone(&c->h, bn, 0);
-	bn->functbl->clone(&c->g.x, bn, 0);
-	bn->functbl->clone(&c->g.y, bn, 0);
-	c->g.curve = c;
-
+	((struct ecc *)ctx->ctx)->curve = c;
+	((struct ecc *)ctx->ctx)->named = NULL;
 	return 0;
 }
 
 static int ecp_clone(drew_ecc_t *new, const drew_ecc_t *old, int flags)
 {
-	struct curve *cn, *co = old->ctx;
-	int flg = flags & DREW_ECC_COPY ? DREW_BIGNUM_COPY : 0;
+	struct ecc *en;
+	struct curve *c = ctx_curve(old);
 
 	if (!(flags & (DREW_ECC_FIXED | DREW_ECC_COPY)))
-		if (!(new->ctx = drew_mem_malloc(sizeof(struct curve))))
+		if (!(new->ctx = drew_mem_malloc(sizeof(struct ecc))))
 			return -ENOMEM;
 
 	new->functbl = &ecp_functbl;
-	cn = new->ctx;
-	cn->name = co->name;
-	memcpy(cn, co, sizeof(*cn));
-	cn->p.functbl->clone(&cn->p, &co->p, flg);
-	cn->a.functbl->clone(&cn->a, &co->a, flg);
-	cn->b.functbl->clone(&cn->b, &co->b, flg);
-	cn->n.functbl->clone(&cn->n, &co->n, flg);
-	cn->h.functbl->clone(&cn->h, &co->h, flg);
-	cn->g.x.functbl->clone(&cn->g.x, &co->g.x, flg);
-	cn->g.y.functbl->clone(&cn->g.y, &co->g.y, flg);
-	cn->g.curve = cn;
+	en = new->ctx;
+	curve_ref(c);
+	if (flags & DREW_ECC_COPY) {
+		curve_release(en->curve);
+		named_release(en->named);
+	}
+	en->curve = c;
+	en->named = named_ref(((const struct ecc *)old->ctx)->named);
 	return 0;
 }
 
 static int ecp_fini(drew_ecc_t *ctx, int flags)
 {
-	struct curve *c = ctx->ctx;
-
-	c->p.functbl->fini(&c->p, 0);
-	c->a.functbl->fini(&c->a, 0);
-	c->b.functbl->fini(&c->b, 0);
-	c->n.functbl->fini(&c->n, 0);
-	c->h.functbl->fini(&c->h, 0);
-	c->g.x.functbl->fini(&c->g.x, 0);
-	c->g.y.functbl->fini(&c->g.y, 0);
+	curve_release(ctx_curve(ctx));
+	named_release(((struct ecc *)ctx->ctx)->named);
 
 	if (!(flags & DREW_ECC_FIXED)) {
-		drew_mem_free(c);
+		drew_mem_free(ctx->ctx);
 		ctx->ctx = NULL;
 	}
 
@@ -398,36 +534,92 @@ static int load_curve_bignum(drew_bignum_t *b, const char *p)
 	return 0;
 }
 
-static int load_curve(struct curve *c, const char *name)
+static int load_curve(struct curve *c, const struct curve_vals *vals)
 {
 	int len = 0;
 	uint8_t buf[((MAX_CURVE_BYTES + 1) * 2) + 1];
 
-	for (size_t i = 0; i < DIM(curves); i++) {
-		if (!strcmp(name, curves[i].name)) {
-			c->name = curves[i].name;
-			RETFAIL(load_curve_bignum(&c->p, curves[i].p));
-			RETFAIL(load_curve_bignum(&c->a, curves[i].a));
-			RETFAIL(load_curve_bignum(&c->b, curves[i].b));
-			RETFAIL(load_curve_bignum(&c->n, curves[i].n));
-			RETFAIL(load_curve_bignum(&c->h, curves[i].h));
-			if ((len = strtobytes(buf, sizeof(buf), curves[i].g)) < 0)
-				return len;
-			RETFAIL(load_point(&c->g, buf, len));
-			return 0;
-		}
-	}
-	return -DREW_ERR_NOT_IMPL;
+	c->name = vals->name;
+	RETFAIL(load_curve_bignum(&c->p, vals->p));
+	RETFAIL(load_curve_bignum(&c->a, vals->a));
+	RETFAIL(load_curve_bignum(&c->b, vals->b));
+	RETFAIL(load_curve_bignum(&c->n, vals->n));
+	RETFAIL(load_curve_bignum(&c->h, vals->h));
+	if ((len = strtobytes(buf, sizeof(buf), vals->g)) < 0)
+		return len;
+	RETFAIL(load_point(&c->g, buf, len));
+	c->field = nist_lookup(vals->name);
+	return 0;
+}
+
+/* The named curves which a context and its clones have loaded, each of which
+ * holds a reference.  This belongs to the contexts rather than the process, so
+ * that no curve outlives the bignum implementation its values come from.
+ */
+struct named_cache {
+	int refs;
+	struct curve *curves[DIM(curves)];
+};
+
+static struct named_cache *named_ref(struct named_cache *n)
+{
+	if (n)
+		__atomic_add_fetch(&n->refs, 1, __ATOMIC_RELAXED);
+	return n;
+}
+
+static void named_release(struct named_cache *n)
+{
+	if (!n || __atomic_sub_fetch(&n->refs, 1, __ATOMIC_ACQ_REL))
+		return;
+	for (size_t i = 0; i < DIM(n->curves); i++)
+		curve_release(n->curves[i]);
+	drew_mem_free(n);
 }
 
 static int ecp_setcurvename(drew_ecc_t *ctx, const char *name)
 {
-	return load_curve(ctx->ctx, name);
+	struct ecc *e = ctx->ctx;
+	struct curve *c, *none = NULL;
+	size_t i;
+	int res;
+
+	for (i = 0; i < DIM(curves); i++)
+		if (!strcmp(name, curves[i].name))
+			break;
+	if (i == DIM(curves))
+		return -DREW_ERR_NOT_IMPL;
+
+	if (!e->named) {
+		if (!(e->named = drew_mem_calloc(1, sizeof(*e->named))))
+			return -ENOMEM;
+		e->named->refs = 1;
+	}
+
+	c = __atomic_load_n(e->named->curves + i, __ATOMIC_ACQUIRE);
+	if (c)
+		curve_ref(c);
+	else {
+		if (!(c = curve_new(&e->curve->p, NULL)))
+			return -ENOMEM;
+		if ((res = load_curve(c, curves + i))) {
+			curve_release(c);
+			return res;
+		}
+		c->refs = 2;
+		if (!__atomic_compare_exchange_n(e->named->curves + i, &none, c,
+					false, __ATOMIC_ACQ_REL,
+					__ATOMIC_ACQUIRE))
+			c->refs = 1;
+	}
+	curve_release(e->curve);
+	e->curve = c;
+	return 0;
 }
 
 static int ecp_curvename(drew_ecc_t *ctx, const char **namep)
 {
-	struct curve *c = ctx->ctx;
+	struct curve *c = ctx_curve(ctx);
 
 	*namep = c->name;
 
@@ -437,8 +629,10 @@ static int ecp_curvename(drew_ecc_t *ctx, const char **namep)
 static int ecp_setval(drew_ecc_t *ctx, const char *name, const uint8_t *data,
 		size_t len, int coord)
 {
-	struct curve *c = ctx->ctx;
+	struct curve *c;
 
+	RETFAIL(curve_modify(ctx->ctx));
+	c = ctx_curve(ctx);
 	if (!strcmp(name, "p"))
 		return load_bignum(&c->p, data, len);
 	else if (!strcmp(name, "a"))
@@ -466,7 +660,7 @@ static int ecp_setval(drew_ecc_t *ctx, const char *name, const uint8_t *data,
 static int ecp_val(const drew_ecc_t *ctx, const char *name, uint8_t *data,
 		size_t len, int coord)
 {
-	struct curve *c = ctx->ctx;
+	struct curve *c = ctx_curve(ctx);
 	const drew_bignum_functbl_t *ft = c->p.functbl;
 
 	if (!strcmp(name, "p"))
@@ -480,7 +674,6 @@ static int ecp_val(const drew_ecc_t *ctx, const char *name, uint8_t *data,
 	else if (!strcmp(name, "h"))
 		return ft->bytes(&c->h, data, len);
 	else if (!strcmp(name, "g")) {
-		c->g.inf = false;
 		if (coord == DREW_ECC_POINT_SEC)
 			return store_point(&c->g, data, len);
 		else if (coord == DREW_ECC_POINT_SEC_COMPRESSED)
@@ -496,7 +689,7 @@ static int ecp_val(const drew_ecc_t *ctx, const char *name, uint8_t *data,
 
 static int ecp_valsize(const drew_ecc_t *ctx, const char *name, int coord)
 {
-	struct curve *c = ctx->ctx;
+	struct curve *c = ctx_curve(ctx);
 	const drew_bignum_functbl_t *ft = c->p.functbl;
 
 	if (!strcmp(name, "p"))
@@ -532,8 +725,10 @@ static int copy(drew_bignum_t *r, const drew_bignum_t *a)
 static int ecp_setvalbignum(drew_ecc_t *ctx, const char *name,
 		const drew_bignum_t *bn, int coord)
 {
-	struct curve *c = ctx->ctx;
+	struct curve *c;
 
+	RETFAIL(curve_modify(ctx->ctx));
+	c = ctx_curve(ctx);
 	if (!strcmp(name, "p"))
 		return copy(&c->p, bn);
 	else if (!strcmp(name, "a"))
@@ -557,7 +752,7 @@ static int ecp_setvalbignum(drew_ecc_t *ctx, const char *name,
 static int ecp_valbignum(const drew_ecc_t *ctx , const char *name,
 		drew_bignum_t *bn, int coord)
 {
-	struct curve *c = ctx->ctx;
+	struct curve *c = ctx_curve(ctx);
 
 	if (!strcmp(name, "p"))
 		return copy(bn, &c->p);
@@ -582,22 +777,25 @@ static int ecp_valbignum(const drew_ecc_t *ctx , const char *name,
 static int ecp_setvalpoint(drew_ecc_t *ctx, const char *name,
 		const drew_ecc_point_t *pt)
 {
-	struct curve *c = ctx->ctx;
+	struct curve *c;
 	drew_ecc_point_t g;
 
 	if (strcmp(name, "g"))
 		return -DREW_ERR_INVALID;
+	RETFAIL(curve_modify(ctx->ctx));
+	c = ctx_curve(ctx);
 	g.ctx = &c->g;
 	g.functbl = &ecpt_functbl;
 	g.functbl->fini(&g, DREW_ECC_FIXED);
-	g.functbl->clone(&g, pt, 0);
+	g.functbl->clone(&g, pt, DREW_ECC_FIXED);
+	c->g.curve = c;
 	return 0;
 }
 
 static int ecp_valpoint(const drew_ecc_t *ctx, const char *name,
 		drew_ecc_point_t *pt)
 {
-	struct curve *c = ctx->ctx;
+	struct curve *c = ctx_curve(ctx);
 	drew_ecc_point_t g;
 
 	if (strcmp(name, "g"))
@@ -622,10 +820,102 @@ static int ecp_point(const drew_ecc_t *ctx, drew_ecc_point_t *pt)
 	return ecpt_init(pt, 0, NULL, &param);
 }
 
+/* Multiples of the base point.  If k is 0, the multiplier is instead given in
+ * hex in scalar.  The first three entries for each curve must be for 1, 2, and
+ * 3, since they're also used to check doubling and addition.
+ */
 struct ecp_testcase {
 	int k;
 	const char *x;
 	const char *y;
+	const char *scalar;
+};
+
+// The full-sized scalars are the RFC 6979 private keys and n-1.
+static struct ecp_testcase p256_testcases[] = {
+	{
+		1,
+		"6b17d1f2e12c4247f8bce6e563a440f277037d812deb33a0f4a13945d898c296",
+		"4fe342e2fe1a7f9b8ee7eb4a7c0f9e162bce33576b315ececbb6406837bf51f5"
+	},
+	{
+		2,
+		"7cf27b188d034f7e8a52380304b51ac3c08969e277f21b35a60b48fc47669978",
+		"07775510db8ed040293d9ac69f7430dbba7dade63ce982299e04b79d227873d1"
+	},
+	{
+		3,
+		"5ecbe4d1a6330a44c8f7ef951d4bf165e6c6b721efada985fb41661bc6e7fd6c",
+		"8734640c4998ff7e374b06ce1a64a2ecd82ab036384fb83d9a79b127a27d5032"
+	},
+	{
+		0,
+		"339150844ec15234807fe862a86be77977dbfb3ae3d96f4c22795513aeaab82f",
+		"b1c14ddfdc8ec1b2583f51e85a5eb3a155840f2034730e9b5ada38b674336a21",
+		"018ebbb95eed0e13"
+	},
+	{
+		0,
+		"60fed4ba255a9d31c961eb74c6356d68c049b8923b61fa6ce669622e60f29fb6",
+		"7903fe1008b8bc99a41ae9e95628bc64f2f1b20c2d7e9f5177a3c294d4462299",
+		"c9afa9d845ba75166b5c215767b1d6934e50c3db36e89b127b8a622b120f6721"
+	},
+	{
+		0,
+		"6b17d1f2e12c4247f8bce6e563a440f277037d812deb33a0f4a13945d898c296",
+		"b01cbd1c01e58065711814b583f061e9d431cca994cea1313449bf97c840ae0a",
+		"ffffffff00000000ffffffffffffffffbce6faada7179e84f3b9cac2fc632550"
+	}
+};
+
+static struct ecp_testcase p384_testcases[] = {
+	{
+		1,
+		"aa87ca22be8b05378eb1c71ef320ad746e1d3b628ba79b98"
+			"59f741e082542a385502f25dbf55296c3a545e3872760ab7",
+		"3617de4a96262c6f5d9e98bf9292dc29f8f41dbd289a147c"
+			"e9da3113b5f0b8c00a60b1ce1d7e819d7a431d7c90ea0e5f"
+	},
+	{
+		2,
+		"08d999057ba3d2d969260045c55b97f089025959a6f434d6"
+			"51d207d19fb96e9e4fe0e86ebe0e64f85b96a9c75295df61",
+		"8e80f1fa5b1b3cedb7bfe8dffd6dba74b275d875bc6cc43e"
+			"904e505f256ab4255ffd43e94d39e22d61501e700a940e80"
+	},
+	{
+		3,
+		"077a41d4606ffa1464793c7e5fdc7d98cb9d3910202dcd06"
+			"bea4f240d3566da6b408bbae5026580d02d7e5c70500c831",
+		"c995f7ca0b0c42837d0bbe9602a9fc998520b41c85115aa5"
+			"f7684c0edc111eacc24abd6be4b5d298b65f28600a2f1df1"
+	},
+	{
+		0,
+		"a499efe48839bc3abcd1c5cedbdd51904f9514db44f4686d"
+			"b918983b0c9dc3aee05a88b72433e9515f91a329f5f4fa60",
+		"3b7ca28ef31f809c2f1ba24aaed847d0f8b406a4b8968542"
+			"de139db5828ca410e615d1182e25b91b1131e230b727d36a",
+		"018ebbb95eed0e13"
+	},
+	{
+		0,
+		"ec3a4e415b4e19a4568618029f427fa5da9a8bc4ae92e02e"
+			"06aae5286b300c64def8f0ea9055866064a254515480bc13",
+		"8015d9b72d7d57244ea8ef9ac0c621896708a59367f9dfb9"
+			"f54ca84b3f1c9db1288b231c3ae0d4fe7344fd2533264720",
+		"6b9d3dad2e1b8c1c05b19875b6659f4de23c3b667bf297ba"
+			"9aa47740787137d896d5724e4c70a825f872c9ea60d2edf5"
+	},
+	{
+		0,
+		"aa87ca22be8b05378eb1c71ef320ad746e1d3b628ba79b98"
+			"59f741e082542a385502f25dbf55296c3a545e3872760ab7",
+		"c9e821b569d9d390a26167406d6d23d6070be242d765eb83"
+			"1625ceec4a0f473ef59f4e30e2817e6285bce2846f15f1a0",
+		"ffffffffffffffffffffffffffffffffffffffffffffffff"
+			"c7634d81f4372ddf581a0db248b0a77aecec196accc52972"
+	}
 };
 
 static struct ecp_testcase p521_testcases[] = {
@@ -750,56 +1040,134 @@ static struct ecp_testcase p521_testcases[] = {
 	}
 };
 
-static int ecp_test(void *p, DrewLoader *ldr)
+static void ecp_test_point(drew_ecc_point_t *pt,
+		const struct ecp_testcase *tc)
 {
-	drew_ecc_t curve;
-	drew_ecc_point_t p1, pres, pcur;
-	drew_bignum_t bn;
-	drew_param_t param;
-	const void *bnfunctbl;
-	int id = 0, res = 0, len = 0;
 	uint8_t buf[128];
+	int len;
 
-	if ((id = drew_loader_lookup_by_name(ldr, "Bignum", 0, -1)) < 0)
-		return id;
-	drew_loader_get_functbl(ldr, id, &bnfunctbl);
+	ecpt_setinf(pt, false);
+	len = strtobytes(buf, sizeof(buf), tc->x);
+	ecpt_setcoordbytes(pt, buf, len, DREW_ECC_POINT_X);
+	len = strtobytes(buf, sizeof(buf), tc->y);
+	ecpt_setcoordbytes(pt, buf, len, DREW_ECC_POINT_Y);
+}
 
-	bn.functbl = bnfunctbl;
-	bn.functbl->init(&bn, 0, ldr, NULL);
+static int ecp_test_curve(DrewLoader *ldr, drew_bignum_t *bn, const char *name,
+		const struct ecp_testcase *testcases, size_t ntests)
+{
+	drew_ecc_t curve;
+	drew_ecc_point_t p1, p2, p3, pres, pcur;
+	drew_bignum_t one;
+	drew_param_t param;
+	int res = 0, len = 0;
+	uint8_t buf[128];
 
 	param.name = "bignum";
-	param.param.value = &bn;
+	param.param.value = bn;
 	param.next = NULL;
 
 	ecp_init(&curve, 0, ldr, &param);
-	ecp_setcurvename(&curve, "secp521r1");
+	if (ecp_setcurvename(&curve, name)) {
+		ecp_fini(&curve, 0);
+		return -DREW_ERR_BUG;
+	}
 	ecp_point(&curve, &p1);
+	ecp_point(&curve, &p2);
+	ecp_point(&curve, &p3);
 	ecp_point(&curve, &pres);
 	ecp_point(&curve, &pcur);
 
-	ecpt_setinf(&p1, false);
-	len = strtobytes(buf, sizeof(buf), p521_testcases[0].x);
-	ecpt_setcoordbytes(&p1, buf, len, DREW_ECC_POINT_X);
-	len = strtobytes(buf, sizeof(buf), p521_testcases[0].y);
-	ecpt_setcoordbytes(&p1, buf, len, DREW_ECC_POINT_Y);
+	ecp_test_point(&p1, testcases+0);
+	ecp_test_point(&p2, testcases+1);
+	ecp_test_point(&p3, testcases+2);
+
+	res <<= 1;
+	ecpt_dbl(&pres, &p1);
+	res |= !!ecpt_compare(&pres, &p2);
+	res <<= 1;
+	ecpt_add(&pres, &p1, &p2);
+	res |= !!ecpt_compare(&pres, &p3);
+	ecpt_add(&pres, &p2, &p1);
+	res |= !!ecpt_compare(&pres, &p3);
 
-	for (size_t i = 0; i < DIM(p521_testcases); i++) {
+	for (size_t i = 0; i < ntests; i++) {
 		res <<= 1;
 
-		ecpt_setinf(&pcur, false);
-		len = strtobytes(buf, sizeof(buf), p521_testcases[i].x);
-		ecpt_setcoordbytes(&pcur, buf, len, DREW_ECC_POINT_X);
-		len = strtobytes(buf, sizeof(buf), p521_testcases[i].y);
-		ecpt_setcoordbytes(&pcur, buf, len, DREW_ECC_POINT_Y);
+		ecp_test_point(&pcur, testcases+i);
+		if (testcases[i].k)
+			bn->functbl->setsmall(bn, testcases[i].k);
+		else {
+			len = strtobytes(buf, sizeof(buf), testcases[i].scalar);
+			bn->functbl->setbytes(bn, buf, len);
+		}
+		ecpt_mul(&pres, &p1, bn);
 
-		bn.functbl->setsmall(&bn, p521_testcases[i].k);
-		ecpt_mul(&pres, &p1, &bn);
+		res |= !!ecpt_compare(&pres, &pcur);
 
+		ecpt_mulbase(&pres, bn);
 		res |= !!ecpt_compare(&pres, &pcur);
 	}
 
+	// G + 2G, using simultaneous multiplication.
+	res <<= 1;
+	bn->functbl->clone(&one, bn, 0);
+	one.functbl->setsmall(&one, 1);
+	ecpt_mul2(&pres, &p1, &one, &p2, &one);
+	res |= !!ecpt_compare(&pres, &p3);
+
+	// A full-sized scalar, which uses every tooth of the comb.
+	res <<= 1;
+	ecp_valbignum(&curve, "n", bn, 0);
+	bn->functbl->sub(bn, bn, &one);
+	ecpt_mul(&pcur, &p1, bn);
+	ecpt_mulbase(&pres, bn);
+	res |= !!ecpt_compare(&pres, &pcur);
+
+	// A point keeps its curve after the context has let go of it.
+	res <<= 1;
+	ecp_setvalbignum(&curve, "h", &one, 0);
+	ecpt_fini(&pcur, 0);
+	ecp_point(&curve, &pcur);
+	ecp_test_point(&pcur, testcases+0);
+	ecp_setcurvename(&curve, name);
+	ecpt_dbl(&pres, &pcur);
+	res |= !!ecpt_compare(&pres, &p2);
+	one.functbl->fini(&one, 0);
+
+	ecpt_fini(&p1, 0);
+	ecpt_fini(&p2, 0);
+	ecpt_fini(&p3, 0);
+	ecpt_fini(&pres, 0);
+	ecpt_fini(&pcur, 0);
 	ecp_fini(&curve, 0);
 
+	return res;
+}
+
+static int ecp_test(void *p, DrewLoader *ldr)
+{
+	drew_bignum_t bn;
+	const void *bnfunctbl;
+	int id = 0, res = 0;
+
+	if ((id = drew_loader_lookup_by_name(ldr, "Bignum", 0, -1)) < 0)
+		return id;
+	drew_loader_get_functbl(ldr, id, &bnfunctbl);
+
+	bn.functbl = bnfunctbl;
+	bn.functbl->init(&bn, 0, ldr, NULL);
+
+	// secp256r1 and secp384r1 use the fixed-width arithmetic in nist.c.
+	res |= !!ecp_test_curve(ldr, &bn, "secp521r1", p521_testcases,
+			DIM(p521_testcases));
+	res <<= 1;
+	res |= !!ecp_test_curve(ldr, &bn, "secp256r1", p256_testcases,
+			DIM(p256_testcases));
+	res <<= 1;
+	res |= !!ecp_test_curve(ldr, &bn, "secp384r1", p384_testcases,
+			DIM(p384_testcases));
+
 	bn.functbl->fini(&bn, 0);
 
 	return res;
@@ -807,13 +1175,20 @@ static int ecp_test(void *p, DrewLoader *ldr)
 
 static int ecpt_info(int op, void *p)
 {
-	return -DREW_ERR_INVALID;
+	switch (op) {
+		case DREW_ECC_VERSION:
+			return DREW_ECC_ABI_MULBASE;
+		case DREW_ECC_INTSIZE:
+			return sizeof(struct point);
+		default:
+			return -DREW_ERR_INVALID;
+	}
 }
 
 static int ecpt_info2(const drew_ecc_point_t *ctx, int op, drew_param_t *out,
 		const drew_param_t *in)
 {
-	return -DREW_ERR_INVALID;
+	return ecpt_info(op, NULL);
 }
 
 static int ecpt_init(drew_ecc_point_t *ctx, int flags,
@@ -836,7 +1211,7 @@ static int ecpt_init(drew_ecc_point_t *ctx, int flags,
 
 	ctx->functbl = &ecpt_functbl;
 	pt = ctx->ctx;
-	pt->curve = curve = curvectx->ctx;
+	pt->curve = curve = curve_ref(ctx_curve(curvectx));
 	curve->p.functbl->clone(&pt->x, &curve->p, 0);
 	curve->p.functbl->clone(&pt->y, &curve->p, 0);
 	pt->inf = true;
@@ -855,7 +1230,7 @@ static int ecpt_clone(drew_ecc_point_t *new, const drew_ecc_point_t *old,
 
 	new->functbl = &ecpt_functbl;
 	pn = new->ctx;
-	pn->curve = po->curve;
+	pn->curve = curve_ref(po->curve);
 	po->x.functbl->clone(&pn->x, &po->x, 0);
 	po->y.functbl->clone(&pn->y, &po->y, 0);
 	pn->inf = po->inf;
@@ -868,6 +1243,8 @@ static int ecpt_fini(drew_ecc_point_t *ctx, int flags)
 
 	pt->x.functbl->fini(&pt->x, 0);
 	pt->y.functbl->fini(&pt->y, 0);
+	curve_release(pt->curve);
+	pt->curve = NULL;
 
 	if (!(flags & DREW_ECC_FIXED)) {
 		drew_mem_free(pt);
@@ -877,6 +1254,19 @@ static int ecpt_fini(drew_ecc_point_t *ctx, int flags)
 	return 0;
 }
 
+/* Makes the point refer to the curve c.  Points made by ecpt_init and
+ * ecpt_clone hold a reference to their curve; the base point and the comb
+ * entries belong to the curve and are only ever stored into with results on
+ * that same curve, so they never get here with a different one.
+ */
+static void point_set_curve(struct point *pt, struct curve *c)
+{
+	if (pt->curve == c)
+		return;
+	curve_release(pt->curve);
+	pt->curve = curve_ref(c);
+}
+
 static int ecpt_setinf(drew_ecc_point_t *ctx, bool val)
 {
 	struct point *pt = ctx->ctx;
@@ -985,7 +1375,7 @@ static int ecpt_inv(drew_ecc_point_t *r, const drew_ecc_point_t *a)
 	struct point *ptr = r->ctx, *pta = a->ctx;
 
 	ptr->inf = pta->inf;
-	ptr->curve = pta->curve;
+	point_set_curve(ptr, pta->curve);
 	if (pta->inf)
 		return 0;
 	ptr->x.functbl->clone(&ptr->x, &pta->x, DREW_ECC_FIXED);
@@ -993,12 +1383,69 @@ static int ecpt_inv(drew_ecc_point_t *r, const drew_ecc_point_t *a)
 	return 0;
 }
 
+/* Returns the fixed-width arithmetic for the point's curve, or NULL if the
+ * generic code has to be used.
+ */
+static const struct nist_field *point_field(const struct point *pt)
+{
+	return pt->curve ? pt->curve->field : NULL;
+}
+
+// Stores a nonnegative bignum as exactly len big-endian bytes.
+static int bignum_to_bytes(const drew_bignum_t *b, uint8_t *buf, size_t len)
+{
+	const size_t nbytes = b->functbl->nbytes(b);
+
+	if (nbytes > len)
+		return -DREW_ERR_INVALID;
+	memset(buf, 0, len);
+	if (nbytes && b->functbl->bytes(b, buf + (len - nbytes), nbytes))
+		return -DREW_ERR_INVALID;
+	return 0;
+}
+
+static int point_to_nist(const struct nist_field *f, struct nist_affine *r,
+		const struct point *pt)
+{
+	const size_t len = nist_nbytes(f);
+	uint8_t x[NIST_MAX_BYTES], y[NIST_MAX_BYTES];
+
+	if (pt->inf) {
+		r->inf = true;
+		return 0;
+	}
+	RETFAIL(bignum_to_bytes(&pt->x, x, len));
+	RETFAIL(bignum_to_bytes(&pt->y, y, len));
+	nist_load(f, r, x, y);
+	return 0;
+}
+
+static int point_from_nist(const struct nist_field *f, struct point *r,
+		const struct nist_affine *a)
+{
+	const size_t len = nist_nbytes(f);
+	uint8_t x[NIST_MAX_BYTES], y[NIST_MAX_BYTES];
+
+	if ((r->inf = a->inf))
+		return 0;
+	nist_store(f, x, y, a);
+	RETFAIL(r->x.functbl->setbytes(&r->x, x, len));
+	RETFAIL(r->y.functbl->setbytes(&r->y, y, len));
+	return 0;
+}
+
 static int ecpt_dbl(drew_ecc_point_t *ptr, const drew_ecc_point_t *pta)
 {
 	struct point *r = ptr->ctx, *a = pta->ctx;
 	const drew_bignum_functbl_t *ft = r->y.functbl;
+	const struct nist_field *f = point_field(a);
+	struct nist_affine na;
 
-	r->curve = a->curve;
+	point_set_curve(r, a->curve);
+	if (f && !point_to_nist(f, &na, a)) {
+		nist_dbl(f, &na, &na);
+		return point_from_nist(f, r, &na);
+	}
 	if (a->inf)
 		r->inf = true;
 	else {
@@ -1048,8 +1495,14 @@ static int ecpt_add(drew_ecc_point_t *ptr, const drew_ecc_point_t *pta,
 {
 	struct point *r = ptr->ctx, *a = pta->ctx, *b = ptb->ctx;
 	const drew_bignum_functbl_t *ft = r->y.functbl;
+	const struct nist_field *f = point_field(a);
+	struct nist_affine na, nb;
 
-	r->curve = a->curve;
+	point_set_curve(r, a->curve);
+	if (f && !point_to_nist(f, &na, a) && !point_to_nist(f, &nb, b)) {
+		nist_add(f, &na, &na, &nb);
+		return point_from_nist(f, r, &na);
+	}
 	if (a->inf && b->inf)
 		r->inf = true;
 	else if (a->inf) {
@@ -1100,22 +1553,285 @@ static int ecpt_add(drew_ecc_point_t *ptr, const drew_ecc_point_t *pta,
 	return 0;
 }
 
+/* Computes aP + bQ with the fixed-width code, if the curve has it and the
+ * scalars are small enough.  Otherwise, returns nonzero and leaves res alone.
+ */
+static int nist_mul2_point(drew_ecc_point_t *res, const drew_ecc_point_t *ptp,
+		const drew_bignum_t *a, const drew_ecc_point_t *ptq,
+		const drew_bignum_t *b)
+{
+	struct point *r = res->ctx, *p = ptp->ctx, *q = ptq ? ptq->ctx : NULL;
+	const struct nist_field *f = point_field(p);
+	uint8_t abuf[NIST_MAX_BYTES * 2], bbuf[NIST_MAX_BYTES * 2];
+	size_t len = a->functbl->nbytes(a);
+	struct nist_affine np, nq;
+
+	// Both scalars are made the same length so no doublings are wasted.
+	if (b && (size_t)b->functbl->nbytes(b) > len)
+		len = b->functbl->nbytes(b);
+	if (!f || len > sizeof(abuf))
+		return -DREW_ERR_NOT_IMPL;
+	RETFAIL(point_to_nist(f, &np, p));
+	RETFAIL(bignum_to_bytes(a, abuf, len));
+	if (q) {
+		RETFAIL(point_to_nist(f, &nq, q));
+		RETFAIL(bignum_to_bytes(b, bbuf, len));
+	}
+	nist_mul2(f, &np, &np, abuf, len, q ? &nq : NULL, bbuf, q ? len : 0);
+	point_set_curve(r, p->curve);
+	return point_from_nist(f, r, &np);
+}
+
+static struct mont_field *mont_field_new(const struct curve *c)
+{
+	const drew_bignum_functbl_t *ft = c->p.functbl;
+	struct mont_field *mf;
+
+	if (ft->info(DREW_BIGNUM_VERSION, NULL) < DREW_BIGNUM_ABI_MONT)
+		return NULL;
+	if (!(mf = drew_mem_malloc(sizeof(*mf))))
+		return NULL;
+	// This fails if p is even, and then the affine code is used.
+	if (ft->montinit(&mf->mont, &c->p)) {
+		drew_mem_free(mf);
+		return NULL;
+	}
+	ft->clone(&mf->a, &c->a, 0);
+	ft->clone(&mf->one, &c->p, 0);
+	ft->montset(mf->mont, &mf->a, &c->a);
+	ft->setsmall(&mf->one, 1);
+	ft->montset(mf->mont, &mf->one, &mf->one);
+	return mf;
+}
+
+// As get_comb, but for the Montgomery constants.
+static const struct mont_field *get_mont_field(struct curve *c)
+{
+	struct mont_field *mf, *none = NULL;
+
+	if ((mf = __atomic_load_n(&c->mont, __ATOMIC_ACQUIRE)))
+		return mf;
+	if (!(mf = mont_field_new(c)))
+		return NULL;
+	if (__atomic_compare_exchange_n(&c->mont, &none, mf, false,
+				__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		return mf;
+	mont_field_free(mf);
+	return none;
+}
+
+/* A point in Jacobian coordinates, which is (x/z^2, y/z^3) in affine
+ * coordinates, with x, y, and z in Montgomery form.  This is used as the
+ * accumulator when multiplying points with the generic code, so that only the
+ * final conversion back needs an inversion.  t holds temporaries.
+ */
+struct jacobian {
+	bool inf;
+	drew_bignum_t x;
+	drew_bignum_t y;
+	drew_bignum_t z;
+	drew_bignum_t t[7];
+	const struct mont_field *mf;
+	const drew_bignum_t *p;
+};
+
+// Sets j to the point at infinity on c.
+static int jac_init(struct jacobian *j, struct curve *c)
+{
+	const drew_bignum_functbl_t *ft = c->p.functbl;
+
+	if (!(j->mf = get_mont_field(c)))
+		return -DREW_ERR_NOT_IMPL;
+	j->p = &c->p;
+	j->inf = true;
+	ft->clone(&j->x, &c->p, 0);
+	ft->clone(&j->y, &c->p, 0);
+	ft->clone(&j->z, &c->p, 0);
+	for (size_t i = 0; i < DIM(j->t); i++)
+		ft->clone(j->t+i, &c->p, 0);
+	return 0;
+}
+
+static void jac_fini(struct jacobian *j)
+{
+	const drew_bignum_functbl_t *ft = j->x.functbl;
+
+	ft->fini(&j->x, 0);
+	ft->fini(&j->y, 0);
+	ft->fini(&j->z, 0);
+	for (size_t i = 0; i < DIM(j->t); i++)
+		ft->fini(j->t+i, 0);
+}
+
+// r = a + b mod p, for a and b already reduced.
+static void fadd(const struct jacobian *j, drew_bignum_t *r,
+		const drew_bignum_t *a, const drew_bignum_t *b)
+{
+	r->functbl->add(r, a, b);
+	if (r->functbl->compare(r, j->p, 0) >= 0)
+		r->functbl->sub(r, r, j->p);
+}
+
+// r = a - b mod p, for a and b already reduced.  r and b must differ.
+static void fsub(const struct jacobian *j, drew_bignum_t *r,
+		const drew_bignum_t *a, const drew_bignum_t *b)
+{
+	if (r->functbl->compare(a, b, 0) < 0) {
+		r->functbl->add(r, a, j->p);
+		r->functbl->sub(r, r, b);
+	}
+	else
+		r->functbl->sub(r, a, b);
+}
+
+/* j = 2j.  With s = 4xy^2 and m = 3x^2 + az^4, this is x' = m^2 - 2s,
+ * y' = m(s - x') - 8y^4, and z' = 2yz.
+ */
+static void jac_dbl(struct jacobian *j)
+{
+	const drew_bignum_functbl_t *ft = j->x.functbl;
+	const drew_bignum_mont_t *mont = j->mf->mont;
+	drew_bignum_t *xx = j->t+0, *yy = j->t+1, *s = j->t+2, *m = j->t+3;
+	drew_bignum_t *u = j->t+4;
+
+	if (j->inf || !ft->nbits(&j->y)) {
+		j->inf = true;
+		return;
+	}
+	ft->montsquare(mont, xx, &j->x);
+	ft->montsquare(mont, yy, &j->y);
+	ft->montmul(mont, s, &j->x, yy);
+	fadd(j, s, s, s);
+	fadd(j, s, s, s);
+	fadd(j, m, xx, xx);
+	fadd(j, m, m, xx);
+	if (ft->nbits(&j->mf->a)) {
+		ft->montsquare(mont, u, &j->z);
+		ft->montsquare(mont, u, u);
+		ft->montmul(mont, u, u, &j->mf->a);
+		fadd(j, m, m, u);
+	}
+	ft->montmul(mont, &j->z, &j->y, &j->z);
+	fadd(j, &j->z, &j->z, &j->z);
+	ft->montsquare(mont, &j->x, m);
+	fsub(j, &j->x, &j->x, s);
+	fsub(j, &j->x, &j->x, s);
+	fsub(j, s, s, &j->x);
+	ft->montmul(mont, &j->y, m, s);
+	ft->montsquare(mont, yy, yy);
+	fadd(j, yy, yy, yy);
+	fadd(j, yy, yy, yy);
+	fadd(j, yy, yy, yy);
+	fsub(j, &j->y, &j->y, yy);
+}
+
+/* j = j + pt, where pt is an affine point in normal form.  With u = pt.x z^2,
+ * s = pt.y z^3, h = u - x, and r = s - y, this is x' = r^2 - h^3 - 2xh^2,
+ * y' = r(xh^2 - x') - yh^3, and z' = zh.
+ */
+static void jac_add(struct jacobian *j, const struct point *pt)
+{
+	const drew_bignum_functbl_t *ft = j->x.functbl;
+	const drew_bignum_mont_t *mont = j->mf->mont;
+	drew_bignum_t *t = j->t;
+
+	if (pt->inf)
+		return;
+	ft->montset(mont, t+0, &pt->x);
+	ft->montset(mont, t+1, &pt->y);
+	if (j->inf) {
+		ft->clone(&j->x, t+0, DREW_BIGNUM_COPY);
+		ft->clone(&j->y, t+1, DREW_BIGNUM_COPY);
+		ft->clone(&j->z, &j->mf->one, DREW_BIGNUM_COPY);
+		j->inf = false;
+		return;
+	}
+	ft->montsquare(mont, t+2, &j->z);
+	ft->montmul(mont, t+3, t+0, t+2);
+	ft->montmul(mont, t+4, &j->z, t+2);
+	ft->montmul(mont, t+4, t+1, t+4);
+	fsub(j, t+5, t+3, &j->x);
+	fsub(j, t+6, t+4, &j->y);
+	if (!ft->nbits(t+5)) {
+		if (ft->nbits(t+6))
+			j->inf = true;
+		else
+			jac_dbl(j);
+		return;
+	}
+	// t[0] is h^2, t[1] is h^3, and t[2] is xh^2.
+	ft->montsquare(mont, t+0, t+5);
+	ft->montmul(mont, t+1, t+5, t+0);
+	ft->montmul(mont, t+2, &j->x, t+0);
+	ft->montmul(mont, &j->z, &j->z, t+5);
+	ft->montsquare(mont, &j->x, t+6);
+	fsub(j, &j->x, &j->x, t+1);
+	fsub(j, &j->x, &j->x, t+2);
+	fsub(j, &j->x, &j->x, t+2);
+	fsub(j, t+2, t+2, &j->x);
+	ft->montmul(mont, t+3, t+6, t+2);
+	ft->montmul(mont, t+1, &j->y, t+1);
+	fsub(j, &j->y, t+3, t+1);
+}
+
+// Stores j in r in affine coordinates and normal form.
+static int jac_get(struct jacobian *j, struct point *r)
+{
+	const drew_bignum_functbl_t *ft = j->x.functbl;
+	const drew_bignum_mont_t *mont = j->mf->mont;
+	drew_bignum_t *zinv = j->t+0, *zinv2 = j->t+1;
+
+	if ((r->inf = j->inf))
+		return 0;
+	ft->montget(mont, zinv, &j->z);
+	RETFAIL(ft->invmod(zinv, zinv, j->p));
+	ft->montset(mont, zinv, zinv);
+	ft->montsquare(mont, zinv2, zinv);
+	ft->montmul(mont, zinv, zinv, zinv2);
+	ft->montmul(mont, &j->x, &j->x, zinv2);
+	ft->montmul(mont, &j->y, &j->y, zinv);
+	ft->montget(mont, &r->x, &j->x);
+	ft->montget(mont, &r->y, &j->y);
+	return 0;
+}
+
 // This uses Shamir's Trick.  The implementation is from Bouncy Castle.
 static int ecpt_mul2(drew_ecc_point_t *res, const drew_ecc_point_t *ptp,
 		const drew_bignum_t *a, const drew_ecc_point_t *ptq,
 		const drew_bignum_t *b)
 {
 	drew_ecc_point_t z, tmp, *r = &tmp;
+	const struct point *p = ptp->ctx, *q = ptq ? ptq->ctx : NULL;
 	size_t abits = a->functbl->nbits(a);
 	size_t bbits = b ? b->functbl->nbits(b) : 0;
 	size_t nbits = MAX(abits, bbits);
+	struct jacobian j;
+	int ret;
 
 	if (!!ptq != !!b)
 		return -DREW_ERR_INVALID;
 
+	if (!nist_mul2_point(res, ptp, a, ptq, b))
+		return 0;
+
 	ecpt_clone(&z, ptp, 0);
 	if (b)
 		ecpt_add(&z, ptp, ptq);
+	if (!jac_init(&j, p->curve)) {
+		for (int i = nbits - 1; i >= 0; i--) {
+			const bool abit = a->functbl->getbit(a, i);
+			const bool bbit = b && b->functbl->getbit(b, i);
+
+			jac_dbl(&j);
+			if (abit || bbit)
+				jac_add(&j, abit ? (bbit ? z.ctx : p) : q);
+		}
+		ecpt_fini(&z, 0);
+		point_set_curve(res->ctx, p->curve);
+		ret = jac_get(&j, res->ctx);
+		jac_fini(&j);
+		return ret;
+	}
 	ecpt_clone(r, ptp, 0);
 	ecpt_setinf(r, true);
 
@@ -1134,6 +1850,7 @@ static int ecpt_mul2(drew_ecc_point_t *res, const drew_ecc_point_t *ptp,
 	ecpt_fini(&z, 0);
 	ecpt_fini(res, 0);
 	ecpt_clone(res, r, 0);
+	ecpt_fini(r, 0);
 	return 0;
 }
 
@@ -1143,6 +1860,174 @@ static int ecpt_mul(drew_ecc_point_t *ptr, const drew_ecc_point_t *pta,
 	return ecpt_mul2(ptr, pta, b, NULL, NULL);
 }
 
+static void wrap_point(drew_ecc_point_t *w, const struct point *pt)
+{
+	w->ctx = (void *)pt;
+	w->functbl = &ecpt_functbl;
+}
+
+static struct comb *comb_new(struct curve *c)
+{
+	const size_t nbits = c->n.functbl->nbits(&c->n);
+	struct comb *comb;
+	drew_ecc_point_t r, s;
+
+	if (!nbits || !(comb = drew_mem_malloc(sizeof(*comb))))
+		return NULL;
+
+	comb->spacing = (nbits + COMB_TEETH - 1) / COMB_TEETH;
+	for (size_t i = 0; i < DIM(comb->table); i++) {
+		struct point *pt = comb->table + i;
+		c->p.functbl->clone(&pt->x, &c->p, 0);
+		c->p.functbl->clone(&pt->y, &c->p, 0);
+		pt->curve = c;
+		pt->inf = true;
+	}
+
+	// The single teeth: 2^(j * spacing) G.
+	wrap_point(&r, comb->table + 1);
+	wrap_point(&s, &c->g);
+	ecpt_add(&r, &r, &s);
+	for (size_t j = 1; j < COMB_TEETH; j++) {
+		wrap_point(&r, comb->table + (1 << j));
+		wrap_point(&s, comb->table + (1 << (j-1)));
+		ecpt_add(&r, &r, &s);
+		for (size_t i = 0; i < comb->spacing; i++)
+			ecpt_dbl(&r, &r);
+	}
+	// Everything else is a sum of two smaller entries.
+	for (size_t i = 3; i < DIM(comb->table); i++) {
+		drew_ecc_point_t t;
+
+		if (!(i & (i-1)))
+			continue;
+		wrap_point(&r, comb->table + i);
+		wrap_point(&s, comb->table + (i & (i-1)));
+		wrap_point(&t, comb->table + (i & -i));
+		ecpt_add(&r, &s, &t);
+	}
+	/* The table may outlive this curve context, and only the point being
+	 * multiplied needs a curve.
+	 */
+	for (size_t i = 0; i < DIM(comb->table); i++)
+		comb->table[i].curve = NULL;
+	return comb;
+}
+
+/* Returns the comb for the curve's base point, building it if necessary.  If
+ * two threads get here at the same time, both build a comb and one of them is
+ * thrown away.
+ */
+static const struct comb *get_comb(struct curve *c)
+{
+	struct comb *comb, *none = NULL;
+
+	if ((comb = __atomic_load_n(&c->comb, __ATOMIC_ACQUIRE)))
+		return comb;
+	if (!(comb = comb_new(c)))
+		return NULL;
+	if (__atomic_compare_exchange_n(&c->comb, &none, comb, false,
+				__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		return comb;
+	comb_free(comb);
+	return none;
+}
+
+// As get_comb, but for the fixed-width arithmetic.
+static const struct nist_comb *get_nist_comb(struct curve *c)
+{
+	struct nist_comb *comb, *none = NULL;
+	struct nist_affine g;
+	size_t nbits;
+
+	if (!c->field)
+		return NULL;
+	if ((comb = __atomic_load_n(&c->nist_comb, __ATOMIC_ACQUIRE)))
+		return comb;
+	if (point_to_nist(c->field, &g, &c->g))
+		return NULL;
+	nbits = c->n.functbl->nbits(&c->n);
+	if (!(comb = nist_comb_new(c->field, &g, nbits)))
+		return NULL;
+	if (__atomic_compare_exchange_n(&c->nist_comb, &none, comb, false,
+				__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		return comb;
+	nist_comb_free(comb);
+	return none;
+}
+
+// Returns the table index for column i of b.
+static size_t comb_index(const struct comb *comb, const drew_bignum_t *b,
+		size_t i, size_t nbits)
+{
+	size_t index = 0;
+
+	for (size_t j = 0, bit = i; j < COMB_TEETH && bit < nbits;
+			j++, bit += comb->spacing)
+		if (b->functbl->getbit(b, bit))
+			index |= 1 << j;
+	return index;
+}
+
+static int nist_mulbase(struct point *r, const drew_bignum_t *b)
+{
+	struct curve *c = r->curve;
+	const struct nist_comb *comb = get_nist_comb(c);
+	uint8_t buf[NIST_MAX_BYTES * 2];
+	const size_t len = b->functbl->nbytes(b);
+	struct nist_affine res;
+
+	if (!comb || len > sizeof(buf))
+		return -DREW_ERR_NOT_IMPL;
+	RETFAIL(bignum_to_bytes(b, buf, len));
+	nist_comb_mul(c->field, comb, &res, buf, len);
+	return point_from_nist(c->field, r, &res);
+}
+
+static int ecpt_mulbase(drew_ecc_point_t *ptr, const drew_bignum_t *b)
+{
+	struct point *r = ptr->ctx;
+	struct curve *c = r->curve;
+	const size_t nbits = b->functbl->nbits(b);
+	const struct comb *comb;
+	drew_ecc_point_t t;
+	struct jacobian j;
+	int ret;
+
+	if (!nist_mulbase(r, b))
+		return 0;
+	comb = get_comb(c);
+	if (!comb || nbits > comb->spacing * COMB_TEETH) {
+		wrap_point(&t, &c->g);
+		return ecpt_mul(ptr, &t, b);
+	}
+
+	if (!jac_init(&j, c)) {
+		for (size_t i = comb->spacing; i-- > 0; ) {
+			const size_t index = comb_index(comb, b, i, nbits);
+
+			jac_dbl(&j);
+			if (index)
+				jac_add(&j, comb->table + index);
+		}
+		ret = jac_get(&j, r);
+		jac_fini(&j);
+		return ret;
+	}
+
+	r->inf = true;
+	for (size_t i = comb->spacing; i-- > 0; ) {
+		const size_t index = comb_index(comb, b, i, nbits);
+
+		ecpt_dbl(ptr, ptr);
+		if (index) {
+			wrap_point(&t, comb->table + index);
+			ecpt_add(ptr, ptr, &t);
+		}
+	}
+	return 0;
+}
+
 static int ecpt_test(void *p, DrewLoader *ldr)
 {
 	return -DREW_ERR_NOT_IMPL;
@@ -0,0 +1,283 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ *
+ * This file is part of the Drew Cryptography Suite.
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of your choice of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation or version 2.0 of the Apache
+ * License as published by the Apache Software Foundation.
+ *
+ * This file is distributed in the hope that it will be useful, but without
+ * any warranty; without even the implied warranty of merchantability or fitness
+ * for a particular purpose.
+ *
+ * Note that people who make modified versions of this file are not obligated to
+ * dual-license their modified versions; it is their choice whether to do so.
+ * If a modified version is not distributed under both licenses, the copyright
+ * and permission notices should be updated accordingly.
+ */
+/* This file is compiled with AES-NI and SSSE3 enabled.  Nothing in it may be
+ * called unless the processor has been checked for support, which is done in
+ * grøstl.cc.
+ */
+
+#if !defined(__clang__)
+#include <internal.h>
+
+#include <string.h>
+
+#include "grøstl.hh"
+#include "aesni-sbox.hh"
+
+HIDE()
+#ifdef FEATURE_AESNI_SBOX
+using namespace drew::aesni;
+
+typedef BigEndian E;
+
+/* The state is kept with one row in each of eight vectors.  For Grøstl-256, P
+ * uses the low eight bytes of each vector and Q the high eight, so both
+ * permutations are computed at once; for Grøstl-512, each has its own eight
+ * vectors.
+ *
+ * These are ShiftBytes for each row, composed with the inverse of the ShiftRows
+ * done by aesenclast.
+ */
+static const vector_t shift256[8] = {
+	{ 0, 13, 10,  7,  4,  1, 14, 11,  5,  2, 15, 12,  9,  6,  3,  8},
+	{13, 10,  7,  4,  1, 14, 11,  0, 15, 12,  9,  6,  3,  8,  5,  2},
+	{10,  7,  4,  1, 14, 11,  0, 13,  9,  6,  3,  8,  5,  2, 15, 12},
+	{ 7,  4,  1, 14, 11,  0, 13, 10,  3,  8,  5,  2, 15, 12,  9,  6},
+	{ 4,  1, 14, 11,  0, 13, 10,  7,  8,  5,  2, 15, 12,  9,  6,  3},
+	{ 1, 14, 11,  0, 13, 10,  7,  4,  2, 15, 12,  9,  6,  3,  8,  5},
+	{14, 11,  0, 13, 10,  7,  4,  1, 12,  9,  6,  3,  8,  5,  2, 15},
+	{11,  0, 13, 10,  7,  4,  1, 14,  6,  3,  8,  5,  2, 15, 12,  9}
+};
+
+static const vector_t shift512p[8] = {
+	{ 0, 13, 10,  7,  4,  1, 14, 11,  8,  5,  2, 15, 12,  9,  6,  3},
+	{13, 10,  7,  4,  1, 14, 11,  8,  5,  2, 15, 12,  9,  6,  3,  0},
+	{10,  7,  4,  1, 14, 11,  8,  5,  2, 15, 12,  9,  6,  3,  0, 13},
+	{ 7,  4,  1, 14, 11,  8,  5,  2, 15, 12,  9,  6,  3,  0, 13, 10},
+	{ 4,  1, 14, 11,  8,  5,  2, 15, 12,  9,  6,  3,  0, 13, 10,  7},
+	{ 1, 14, 11,  8,  5,  2, 15, 12,  9,  6,  3,  0, 13, 10,  7,  4},
+	{14, 11,  8,  5,  2, 15, 12,  9,  6,  3,  0, 13, 10,  7,  4,  1},
+	{15, 12,  9,  6,  3,  0, 13, 10,  7,  4,  1, 14, 11,  8,  5,  2}
+};
+
+static const vector_t shift512q[8] = {
+	{13, 10,  7,  4,  1, 14, 11,  8,  5,  2, 15, 12,  9,  6,  3,  0},
+	{ 7,  4,  1, 14, 11,  8,  5,  2, 15, 12,  9,  6,  3,  0, 13, 10},
+	{ 1, 14, 11,  8,  5,  2, 15, 12,  9,  6,  3,  0, 13, 10,  7,  4},
+	{15, 12,  9,  6,  3,  0, 13, 10,  7,  4,  1, 14, 11,  8,  5,  2},
+	{ 0, 13, 10,  7,  4,  1, 14, 11,  8,  5,  2, 15, 12,  9,  6,  3},
+	{10,  7,  4,  1, 14, 11,  8,  5,  2, 15, 12,  9,  6,  3,  0, 13},
+	{ 4,  1, 14, 11,  8,  5,  2, 15, 12,  9,  6,  3,  0, 13, 10,  7},
+	{14, 11,  8,  5,  2, 15, 12,  9,  6,  3,  0, 13, 10,  7,  4,  1}
+};
+
+static inline vector_t xtime(vector_t x)
+{
+	return (x + x) ^ (vector_t(x > 0x7f) & 0x1b);
+}
+
+/* MixBytes multiplies each column by circ(02, 02, 03, 04, 05, 03, 05, 07).
+ * Splitting each coefficient into its 1, 2, and 4 parts, row i of the output is
+ * s1 ^ 2 * (s2 ^ 2 * s4), and most of the terms of those sums come in pairs of
+ * adjacent rows, which are shared.
+ */
+static inline void mix_bytes(vector_t *x)
+{
+	vector_t t[8], y[8];
+
+	for (int i = 0; i < 8; i++)
+		t[i] = x[i] ^ x[(i+1) % 8];
+	for (int i = 0; i < 8; i++) {
+		vector_t s1 = x[(i+2) % 8] ^ t[(i+4) % 8] ^ t[(i+6) % 8];
+		vector_t s2 = x[(i+5) % 8] ^ t[(i+1) % 8] ^ t[(i+7) % 8];
+		vector_t s4 = t[(i+3) % 8] ^ t[(i+6) % 8];
+		y[i] = s1 ^ xtime(s2 ^ xtime(s4));
+	}
+	for (int i = 0; i < 8; i++)
+		x[i] = y[i];
+}
+
+static inline void permute_round(vector_t *x, const vector_t *k,
+		const vector_t *shift)
+{
+	for (int i = 0; i < 8; i++)
+		x[i] = shuffle(sub_shift(x[i] ^ k[i]), shift[i]);
+	mix_bytes(x);
+}
+
+/* Each pass interleaves the first half of the vectors with the second half,
+ * which rotates the bits of each byte's index one place to the left.  Four
+ * passes take sixteen columns of eight bytes to eight rows of sixteen, and
+ * three more take them back.  Since the columns are stored as big-endian words,
+ * row i ends up in vector 7 - i.
+ */
+static inline void interleave(vector_t *x, int passes)
+{
+	const vector_t lo = {0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23};
+	const vector_t hi = {8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30,
+		15, 31};
+
+	for (int pass = 0; pass < passes; pass++) {
+		vector_t t[8];
+		for (int i = 0; i < 4; i++) {
+			t[2*i+0] = __builtin_shuffle(x[i], x[i+4], lo);
+			t[2*i+1] = __builtin_shuffle(x[i], x[i+4], hi);
+		}
+		for (int i = 0; i < 8; i++)
+			x[i] = t[i];
+	}
+}
+
+static inline void load(vector_t *x, const uint64_t *cols)
+{
+	vector_t t[8];
+
+	memcpy(t, cols, sizeof(t));
+	interleave(t, 4);
+	for (int i = 0; i < 8; i++)
+		x[i] = t[7-i];
+}
+
+static inline void store(uint64_t *cols, const vector_t *x)
+{
+	vector_t t[8];
+
+	for (int i = 0; i < 8; i++)
+		t[i] = x[7-i];
+	interleave(t, 3);
+	memcpy(cols, t, sizeof(t));
+}
+
+// P in the low half and Q in the high half.
+static void permute256(vector_t *x)
+{
+	const vector_t step_p = {1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0};
+	const vector_t step_q = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1};
+	const vector_t rest = {0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff, 0xff, 0xff,
+		0xff, 0xff, 0xff, 0xff};
+	vector_t k[8] = {
+		{0x00, 0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70,
+		 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff},
+		rest, rest, rest, rest, rest, rest,
+		{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		 0xff, 0xef, 0xdf, 0xcf, 0xbf, 0xaf, 0x9f, 0x8f}
+	};
+
+	for (int r = 0; r < 10; r++) {
+		permute_round(x, k, shift256);
+		k[0] += step_p;
+		k[7] -= step_q;
+	}
+}
+
+static void permute512(vector_t *p, vector_t *q)
+{
+	const vector_t zero = splat(0x00), ones = splat(0xff), step = splat(1);
+	vector_t kp[8] = {
+		{0x00, 0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70,
+		 0x80, 0x90, 0xa0, 0xb0, 0xc0, 0xd0, 0xe0, 0xf0},
+		zero, zero, zero, zero, zero, zero, zero
+	};
+	vector_t kq[8] = {
+		ones, ones, ones, ones, ones, ones, ones,
+		{0xff, 0xef, 0xdf, 0xcf, 0xbf, 0xaf, 0x9f, 0x8f,
+		 0x7f, 0x6f, 0x5f, 0x4f, 0x3f, 0x2f, 0x1f, 0x0f}
+	};
+
+	for (int r = 0; r < 14; r++) {
+		permute_round(p, kp, shift512p);
+		if (q)
+			permute_round(q, kq, shift512q);
+		kp[0] += step;
+		kq[7] -= step;
+	}
+}
+#endif
+
+bool drew::Gr\u00f8stl256::TransformAESNI(uint64_t *state, const uint8_t *block)
+{
+#ifdef FEATURE_AESNI_SBOX
+	uint64_t pq[16] ALIGNED_T;
+	vector_t x[8];
+
+	// P's input in the first eight columns and Q's in the last eight.
+	E::Copy(pq+8, block, 64);
+	for (int i = 0; i < 8; i++)
+		pq[i] = state[i] ^ pq[i+8];
+	load(x, pq);
+	permute256(x);
+	store(pq, x);
+	for (int i = 0; i < 8; i++)
+		state[i] ^= pq[i] ^ pq[i+8];
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool drew::Gr\u00f8stl256::OutputTransformAESNI(uint64_t *state)
+{
+#ifdef FEATURE_AESNI_SBOX
+	uint64_t pq[16] ALIGNED_T;
+	vector_t x[8];
+
+	memcpy(pq, state, 64);
+	memset(pq+8, 0, 64);
+	load(x, pq);
+	permute256(x);
+	store(pq, x);
+	for (int i = 0; i < 8; i++)
+		state[i] ^= pq[i];
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool drew::Gr\u00f8stl512::TransformAESNI(uint64_t *state, const uint8_t *block)
+{
+#ifdef FEATURE_AESNI_SBOX
+	uint64_t b[16] ALIGNED_T;
+	uint64_t h[16] ALIGNED_T;
+	vector_t p[8], q[8];
+
+	E::Copy(b, block, sizeof(b));
+	for (int i = 0; i < 16; i++)
+		h[i] = state[i] ^ b[i];
+	load(p, h);
+	load(q, b);
+	permute512(p, q);
+	store(h, p);
+	store(b, q);
+	for (int i = 0; i < 16; i++)
+		state[i] ^= h[i] ^ b[i];
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool drew::Gr\u00f8stl512::OutputTransformAESNI(uint64_t *state)
+{
+#ifdef FEATURE_AESNI_SBOX
+	uint64_t h[16] ALIGNED_T;
+	vector_t p[8];
+
+	load(p, state);
+	permute512(p, 0);
+	store(h, p);
+	for (int i = 0; i < 16; i++)
+		state[i] ^= h[i];
+	return true;
+#else
+	return false;
+#endif
+}
+UNHIDE()
+#endif
@@ -1241,6 +1241,16 @@ static inline uint64_t ComputeColumn(const uint64_t *x, int c0, int c1, int c2,
 		table[(7*256)+E::GetByte(x[c7], 0)];
 }
 
+static bool use_aesni()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	static const bool aesni = HasAESNI();
+	return aesni;
+#else
+	return false;
+#endif
+}
+
 drew::Gr\u00f8stl256::Gr\u00f8stl256(size_t sz)
 {
 	m_size = sz;
@@ -1311,6 +1321,9 @@ inline void drew::Gr\u00f8stl256::ComputeQ(uint64_t *out, uint64_t *in,
 
 void drew::Gr\u00f8stl256::Transform(uint64_t *state, const uint8_t *block)
 {
+	if (use_aesni() && TransformAESNI(state, block))
+		return;
+
 	uint64_t h[8] ALIGNED_T;
 	uint64_t b[8] ALIGNED_T;
 	uint64_t p[8] ALIGNED_T;
@@ -1355,6 +1368,9 @@ void drew::Gr\u00f8stl256::GetDigest(uint8_t *digest, size_t len, bool nopad)
 	if (!nopad)
 		Pad();
 
+	if (use_aesni() && OutputTransformAESNI(m_hash))
+		goto out;
+
 	memcpy(p, m_hash, sizeof(p));
 
 	ComputeP(x, p, 0x0000000000000000);
@@ -1370,6 +1386,7 @@ void drew::Gr\u00f8stl256::GetDigest(uint8_t *digest, size_t len, bool nopad)
 
 	XorAligned(m_hash, p, sizeof(p));
 
+out:
 	uint8_t buf[sizeof(p)];
 	E::Copy(buf, m_hash, sizeof(buf));
 	memcpy(digest, buf+off, len);
@@ -1467,6 +1484,9 @@ inline void drew::Gr\u00f8stl512::ComputeQ(uint64_t *out, uint64_t *in,
 
 void drew::Gr\u00f8stl512::Transform(uint64_t *state, const uint8_t *block)
 {
+	if (use_aesni() && TransformAESNI(state, block))
+		return;
+
 	uint64_t h[16] ALIGNED_T;
 	uint64_t b[16] ALIGNED_T;
 	uint64_t p[16] ALIGNED_T;
@@ -1519,6 +1539,9 @@ void drew::Gr\u00f8stl512::GetDigest(uint8_t *digest, size_t len, bool nopad)
 	if (!nopad)
 		Pad();
 
+	if (use_aesni() && OutputTransformAESNI(m_hash))
+		goto out;
+
 	memcpy(p, m_hash, sizeof(p));
 
 	ComputeP(x, p, 0x0000000000000000);
@@ -1538,6 +1561,7 @@ void drew::Gr\u00f8stl512::GetDigest(uint8_t *digest, size_t len, bool nopad)
 
 	XorAligned(m_hash, p, sizeof(p));
 
+out:
 	uint8_t buf[sizeof(p)];
 	E::Copy(buf, m_hash, sizeof(buf));
 	memcpy(digest, buf+off, len);
@@ -133,6 +133,10 @@ class Gr\u00f8stl256 : public Gr\u00f8stlImplementation
 			m_nblocks++;
 		}
 	private:
+		// These are in grøstl-aesni.cc and return false if it was built
+		// without AES-NI support.
+		static bool TransformAESNI(uint64_t *state, const uint8_t *data);
+		static bool OutputTransformAESNI(uint64_t *state);
 };
 
 class Gr\u00f8stl512: public Gr\u00f8stlImplementation
@@ -160,6 +164,10 @@ class Gr\u00f8stl512: public Gr\u00f8stlImplementation
 			m_nblocks++;
 		}
 	private:
+		// These are in grøstl-aesni.cc and return false if it was built
+		// without AES-NI support.
+		static bool TransformAESNI(uint64_t *state, const uint8_t *data);
+		static bool OutputTransformAESNI(uint64_t *state);
 };
 
 template<class T256, class T512>
@@ -0,0 +1,112 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ *
+ * This file is part of the Drew Cryptography Suite.
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of your choice of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation or version 2.0 of the Apache
+ * License as published by the Apache Software Foundation.
+ *
+ * This file is distributed in the hope that it will be useful, but without
+ * any warranty; without even the implied warranty of merchantability or fitness
+ * for a particular purpose.
+ *
+ * Note that people who make modified versions of this file are not obligated to
+ * dual-license their modified versions; it is their choice whether to do so.
+ * If a modified version is not distributed under both licenses, the copyright
+ * and permission notices should be updated accordingly.
+ */
+/* This file is compiled with AVX2 enabled.  Nothing in it may be called unless
+ * the processor has been checked for AVX2 support, which is done in keccak.cc.
+ */
+#include <internal.h>
+
+#include <string.h>
+
+#include "keccak.hh"
+
+#if defined(__GNUC__) && defined(__AVX2__)
+#define FEATURE_AVX2
+#endif
+
+HIDE()
+#ifdef FEATURE_AVX2
+// Lane i of each vector belongs to state i.
+typedef uint64_t vector_t __attribute__((vector_size(32)));
+
+static const uint64_t rc[] = {
+	0x0000000000000001, 0x0000000000008082,
+	0x800000000000808a, 0x8000000080008000,
+	0x000000000000808b, 0x0000000080000001,
+	0x8000000080008081, 0x8000000000008009,
+	0x000000000000008a, 0x0000000000000088,
+	0x0000000080008009, 0x000000008000000a,
+	0x000000008000808b, 0x800000000000008b,
+	0x8000000000008089, 0x8000000000008003,
+	0x8000000000008002, 0x8000000000000080,
+	0x000000000000800a, 0x800000008000000a,
+	0x8000000080008081, 0x8000000000008080,
+	0x0000000080000001, 0x8000000080008008
+};
+
+// The rotation for each word, indexed by x+5*y.
+static const int rotation[25] = {
+	 0,  1, 62, 28, 27,
+	36, 44,  6, 55, 20,
+	 3, 10, 43, 25, 39,
+	41, 45, 15, 21,  8,
+	18,  2, 61, 56, 14
+};
+
+static inline vector_t rotl(vector_t x, int n)
+{
+	return n ? (x << n) | (x >> (64 - n)) : x;
+}
+
+static inline void round4(vector_t *a, uint64_t k)
+{
+	vector_t b[25], c[5];
+
+	for (int x = 0; x < 5; x++)
+		c[x] = a[x] ^ a[x+5] ^ a[x+10] ^ a[x+15] ^ a[x+20];
+	for (int x = 0; x < 5; x++) {
+		const vector_t d = c[(x+4) % 5] ^ rotl(c[(x+1) % 5], 1);
+		for (int y = 0; y < 25; y += 5)
+			a[x+y] ^= d;
+	}
+	for (int x = 0; x < 5; x++)
+		for (int y = 0; y < 5; y++)
+			b[y+5*((2*x+3*y) % 5)] = rotl(a[x+5*y], rotation[x+5*y]);
+	for (int y = 0; y < 25; y += 5)
+		for (int x = 0; x < 5; x++)
+			a[x+y] = b[x+y] ^ (~b[(x+1) % 5 + y] & b[(x+2) % 5 + y]);
+	a[0] ^= k;
+}
+#endif
+
+size_t drew::Keccak::PermuteAVX2(uint64_t *const *states, size_t n)
+{
+#ifdef FEATURE_AVX2
+	const size_t total = n & ~3;
+
+	for (size_t i = 0; i < total; i += 4) {
+		uint64_t *const *s = states + i;
+		vector_t a[25];
+
+		for (int j = 0; j < 25; j++) {
+			vector_t t = {s[0][j], s[1][j], s[2][j], s[3][j]};
+			a[j] = t;
+		}
+		for (int j = 0; j < 24; j++)
+			round4(a, rc[j]);
+		for (int j = 0; j < 25; j++)
+			for (int k = 0; k < 4; k++)
+				s[k][j] = a[j][k];
+	}
+	return total;
+#else
+	return 0;
+#endif
+}
+UNHIDE()
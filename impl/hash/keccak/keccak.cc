@@ -86,6 +86,45 @@ static int keccak_test(void *, const drew_loader_t *)
 	return res;
 }
 
+/* Squeeze the output for "abc" out in uneven pieces and check the digest_size
+ * bytes starting at off.  Then do the same with four contexts at once, each
+ * starting at a different place in the block.
+ */
+template<class T>
+static int shake_test(size_t off, const char *hex)
+{
+	const size_t len = off + T::digest_size;
+	uint8_t expected[T::digest_size], buf[4][1024];
+	uint8_t *out[4];
+	T ctx[4];
+	drew::SHAKE<T::digest_size / 2> *ctxp[4];
+	int res = 0;
+
+	for (size_t i = 0; i < sizeof(expected); i++) {
+		unsigned int x;
+		if (sscanf(hex + (i*2), "%02x", &x) != 1)
+			return 1;
+		expected[i] = x;
+	}
+
+	ctx[0].Update((const uint8_t *)"abc", 3);
+	for (size_t i = 0, n = 1; i < len; i += n, n += 7)
+		ctx[0].GetDigest(buf[0] + i, std::min(n, len - i), false);
+	res |= !!memcmp(buf[0] + off, expected, sizeof(expected));
+
+	for (size_t i = 0; i < 4; i++) {
+		ctx[i].Reset();
+		ctx[i].Update((const uint8_t *)"abc", 3);
+		ctx[i].GetDigest(buf[i], i * 5, false);
+		ctxp[i] = ctx + i;
+		out[i] = buf[i] + (i * 5);
+	}
+	T::Squeeze4(ctxp, out, len);
+	for (size_t i = 0; i < 4; i++)
+		res |= !!memcmp(buf[i] + off, expected, sizeof(expected));
+	return res;
+}
+
 static int keccak_get_digest_size(const drew_param_t *param)
 {
 	size_t digestsizeval = 0, result = 0;
@@ -221,6 +260,8 @@ PLUGIN_STRUCTURE(sha3512, SHA3512)
 PLUGIN_STRUCTURE(sha3384, SHA3384)
 PLUGIN_STRUCTURE(sha3256, SHA3256)
 PLUGIN_STRUCTURE(sha3224, SHA3224)
+PLUGIN_STRUCTURE(shake128, SHAKE128)
+PLUGIN_STRUCTURE(shake256, SHAKE256)
 PLUGIN_DATA_START()
 PLUGIN_DATA(keccak, "Keccak")
 PLUGIN_DATA(keccakwln, "Keccak")
@@ -229,6 +270,8 @@ PLUGIN_DATA(sha3512, "SHA-3-512")
 PLUGIN_DATA(sha3384, "SHA-3-384")
 PLUGIN_DATA(sha3256, "SHA-3-256")
 PLUGIN_DATA(sha3224, "SHA-3-224")
+PLUGIN_DATA(shake128, "SHAKE128")
+PLUGIN_DATA(shake256, "SHAKE256")
 PLUGIN_DATA_END()
 PLUGIN_INTERFACE(keccak)
 
@@ -370,6 +413,37 @@ static int sha3512test(void *p, const drew_loader_t *ldr)
 	return res;
 }
 
+// Test vectors generated with Python's hashlib.
+static int shake128test(void *p, const drew_loader_t *ldr)
+{
+	int res = 0;
+
+	using namespace drew;
+
+	res |= !HashTestCase<SHAKE128>("", 0).Test("7f9c2ba4e88f827d616045507605853ed73b8093f6efbc88eb1a6eacfa66ef26");
+	res <<= 1;
+	res |= !HashTestCase<SHAKE128>("abc", 1).Test("5881092dd818bf5cf8a3ddb793fbcba74097d5c526a6d35f97b83351940f2cc8");
+	res <<= 1;
+	res |= shake_test<SHAKE128>(568, "da3fca753353cdb7053c02e11ac787fc575314ce37661adaef6b7e4419dcfef9");
+
+	return res;
+}
+
+static int shake256test(void *p, const drew_loader_t *ldr)
+{
+	int res = 0;
+
+	using namespace drew;
+
+	res |= !HashTestCase<SHAKE256>("", 0).Test("46b9dd2b0ba88d13233b3feb743eeb243fcd52ea62b81b82b50c27646ed5762fd75dc4ddd8c0f200cb05019d67b592f6fc821c49479ab48640292eacb3b7c4be");
+	res <<= 1;
+	res |= !HashTestCase<SHAKE256>("abc", 1).Test("483366601360a8771c6863080cc4114d8db44530f8f1e1ee4f94ea37e78b5739d5a15bef186a5386c75744c0527e1faa9f8726e462a12a4feb06bd8801e751e4");
+	res <<= 1;
+	res |= shake_test<SHAKE256>(536, "45b2ad6f3f204b965b75df1f86700afeb4406dd95d6b13eff9a7dda552c13ea8a5fe635d3ed1f8d61a91fa78e680d7effa2cfc73a676520e97795e45b66bb624");
+
+	return res;
+}
+
 }
 
 typedef drew::Keccak::endian_t E;
@@ -765,7 +839,7 @@ void drew::KeccakWithLimitedNots::Transform(uint64_t state[25],
 void drew::Keccak::Transform(uint64_t state[25], const uint8_t *block,
 		size_t r)
 {
-	uint64_t blk[1152/64];
+	uint64_t blk[1344/64];
 	const uint64_t *b;
 	const size_t nwords = r / sizeof(uint64_t);
 	b = E::CopyIfNeeded(blk, block, r);
@@ -787,18 +861,24 @@ void drew::KeccakWithLimitedNots::Reset()
 	m_len = 0;
 	memset(m_buf, 0, sizeof(m_buf));
 	memset(m_hash, 0, sizeof(m_hash));
-	m_hash[1+5*0] = ~0;
-	m_hash[2+5*0] = ~0;
-	m_hash[3+5*1] = ~0;
-	m_hash[2+5*2] = ~0;
-	m_hash[2+5*3] = ~0;
-	m_hash[0+5*4] = ~0;
+	Complement(m_hash);
+}
+
+// Switch between the standard and lane-complemented representations.
+void drew::KeccakWithLimitedNots::Complement(uint64_t state[25])
+{
+	state[1+5*0] = ~state[1+5*0];
+	state[2+5*0] = ~state[2+5*0];
+	state[3+5*1] = ~state[3+5*1];
+	state[2+5*2] = ~state[2+5*2];
+	state[2+5*3] = ~state[2+5*3];
+	state[0+5*4] = ~state[0+5*4];
 }
 
 void drew::KeccakWithLimitedNots::Transform(uint64_t state[25],
 		const uint8_t *block, size_t r)
 {
-	uint64_t blk[1152/64];
+	uint64_t blk[1344/64];
 	const uint64_t *b;
 	const size_t nwords = r / sizeof(uint64_t);
 	b = E::CopyIfNeeded(blk, block, r);
@@ -816,7 +896,7 @@ void drew::Keccak::GetDigest(uint8_t *digest, size_t len, bool nopad)
 	const size_t nwords = m_r / sizeof(uint64_t);
 	uint8_t *d = digest;
 	for (size_t i = 0; i < len; i += m_r, d += m_r) {
-		uint64_t b[1152/64];
+		uint64_t b[1344/64];
 		for (size_t y = 0; y < DivideAndRoundUp(nwords, 5); y++)
 			for (size_t x = 0; x < 5 && (x+(5*y)) < nwords; x++)
 				b[x + (5*y)] = m_hash[x+5*y];
@@ -830,16 +910,11 @@ void drew::KeccakWithLimitedNots::GetDigest(uint8_t *digest, size_t len,
 	if (!nopad)
 		Pad();
 
-	m_hash[1+5*0] = ~m_hash[1+5*0];
-	m_hash[2+5*0] = ~m_hash[2+5*0];
-	m_hash[3+5*1] = ~m_hash[3+5*1];
-	m_hash[2+5*2] = ~m_hash[2+5*2];
-	m_hash[2+5*3] = ~m_hash[2+5*3];
-	m_hash[0+5*4] = ~m_hash[0+5*4];
+	Complement(m_hash);
 	const size_t nwords = m_r / sizeof(uint64_t);
 	uint8_t *d = digest;
 	for (size_t i = 0; i < len; i += m_r, d += m_r) {
-		uint64_t b[1152/64];
+		uint64_t b[1344/64];
 		for (size_t y = 0; y < DivideAndRoundUp(nwords, 5); y++)
 			for (size_t x = 0; x < 5 && (x+(5*y)) < nwords; x++)
 				b[x + (5*y)] = m_hash[x+5*y];
@@ -850,7 +925,7 @@ void drew::KeccakWithLimitedNots::GetDigest(uint8_t *digest, size_t len,
 void drew::KeccakCompact::Transform(uint64_t state[25], const uint8_t *block,
 		size_t r)
 {
-	uint64_t blk[1152/64];
+	uint64_t blk[1344/64];
 	const uint64_t *b;
 	const size_t nwords = r / sizeof(uint64_t);
 	b = E::CopyIfNeeded(blk, block, r);
@@ -860,4 +935,59 @@ void drew::KeccakCompact::Transform(uint64_t state[25], const uint8_t *block,
 	keccak_f<2>(state);
 }
 
+void drew::Keccak::Permute()
+{
+	keccak_f<0>(m_hash);
+}
+
+void drew::Keccak::GetState(uint64_t state[25]) const
+{
+	memcpy(state, m_hash, sizeof(m_hash));
+}
+
+void drew::Keccak::SetState(const uint64_t state[25])
+{
+	memcpy(m_hash, state, sizeof(m_hash));
+}
+
+void drew::KeccakWithLimitedNots::Permute()
+{
+	keccak_f<1>(m_hash);
+}
+
+void drew::KeccakWithLimitedNots::GetState(uint64_t state[25]) const
+{
+	memcpy(state, m_hash, sizeof(m_hash));
+	Complement(state);
+}
+
+void drew::KeccakWithLimitedNots::SetState(const uint64_t state[25])
+{
+	memcpy(m_hash, state, sizeof(m_hash));
+	Complement(m_hash);
+}
+
+void drew::KeccakCompact::Permute()
+{
+	keccak_f<2>(m_hash);
+}
+
+static bool use_avx2()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	static const bool avx2 = HasAVX2();
+	return avx2;
+#else
+	return false;
+#endif
+}
+
+void drew::Keccak::PermuteMany(uint64_t *const *states, size_t n)
+{
+	size_t done = use_avx2() ? PermuteAVX2(states, n) : 0;
+
+	for (size_t i = done; i < n; i++)
+		keccak_f<2>(states[i]);
+}
+
 UNHIDE()
@@ -91,20 +91,34 @@ class Keccak
 			return m_r;
 		}
 		static inline void Transform(uint64_t [25], const uint8_t *data);
+		/* Apply Keccak-f to n independent states, which must be in the
+		 * standard representation.  This does four at a time with AVX2 if
+		 * the processor supports it.
+		 */
+		static void PermuteMany(uint64_t *const *states, size_t n);
 	protected:
 		Keccak() {}
-		static inline void Transform(uint64_t [25], const uint8_t *data,
-				size_t);
+		static void Transform(uint64_t [25], const uint8_t *data, size_t);
 		virtual void Transform(const uint8_t *data)
 		{
 			return Transform(m_hash, data, m_r);
 		}
+		// These are used for squeezing more output out of the state.
+		// GetState and SetState convert to and from the standard
+		// representation, for implementations which use another one.
+		virtual void Permute();
+		virtual void GetState(uint64_t [25]) const;
+		virtual void SetState(const uint64_t [25]);
 		uint8_t m_pad, m_pad2;
 		size_t m_c, m_r;
 		size_t m_len;
 		uint64_t m_hash[25];
-		uint8_t m_buf[1152 / 8];
+		// Large enough for the rate of SHAKE128.
+		uint8_t m_buf[1344 / 8];
 	private:
+		// This is in keccak-avx2.cc and returns the number of states done,
+		// which is zero if it was built without AVX2 support.
+		static size_t PermuteAVX2(uint64_t *const *states, size_t n);
 };
 
 class KeccakWithLimitedNots : public Keccak
@@ -115,13 +129,16 @@ class KeccakWithLimitedNots : public Keccak
 		static inline void Transform(uint64_t [25], const uint8_t *data);
 		virtual void GetDigest(uint8_t *digest, size_t len, bool nopad);
 	protected:
-		static inline void Transform(uint64_t [25], const uint8_t *data,
-				size_t);
+		static void Transform(uint64_t [25], const uint8_t *data, size_t);
 		virtual void Transform(const uint8_t *data)
 		{
 			return Transform(m_hash, data, m_r);
 		}
+		virtual void Permute();
+		virtual void GetState(uint64_t [25]) const;
+		virtual void SetState(const uint64_t [25]);
 	private:
+		static void Complement(uint64_t [25]);
 };
 
 class KeccakCompact : public Keccak
@@ -130,12 +147,12 @@ class KeccakCompact : public Keccak
 		KeccakCompact(size_t);
 		static inline void Transform(uint64_t [25], const uint8_t *data);
 	protected:
-		static inline void Transform(uint64_t [25], const uint8_t *data,
-				size_t);
+		static void Transform(uint64_t [25], const uint8_t *data, size_t);
 		virtual void Transform(const uint8_t *data)
 		{
 			return Transform(m_hash, data, m_r);
 		}
+		virtual void Permute();
 	private:
 };
 
@@ -167,6 +184,107 @@ class SHA3384 : public SHA3<384 / 8>
 class SHA3512 : public SHA3<512 / 8>
 {
 };
+
+/* The SHAKE extendable-output functions.  The first call to GetDigest pads the
+ * input and each call after that continues the output where the last one left
+ * off, so any amount can be squeezed out piece by piece.  digest_size is only
+ * the customary output length.
+ */
+template<size_t Security>
+class SHAKE : public DREW_KECCAK_IMPL
+{
+	public:
+		typedef DREW_KECCAK_IMPL base_t;
+
+		SHAKE() : base_t(Security)
+		{
+			m_pad = 0x1f;
+			Reset();
+		}
+		virtual void Reset()
+		{
+			base_t::Reset();
+			m_avail = 0;
+			m_squeezing = false;
+		}
+		virtual void GetDigest(uint8_t *digest, size_t len, bool nopad)
+		{
+			if (!m_squeezing) {
+				if (!nopad)
+					Pad();
+				Refill();
+				m_squeezing = true;
+			}
+			for (;;) {
+				const size_t n = std::min(len, m_avail);
+				memcpy(digest, m_buf + m_r - m_avail, n);
+				digest += n;
+				len -= n;
+				m_avail -= n;
+				if (!len)
+					break;
+				Permute();
+				Refill();
+			}
+		}
+		size_t GetDigestSize() const
+		{
+			return digest_size;
+		}
+		/* Squeeze len more bytes out of each of four contexts, running the
+		 * permutations for all four together.
+		 */
+		static void Squeeze4(SHAKE **ctx, uint8_t **out, size_t len)
+		{
+			uint64_t s[4][25];
+			uint64_t *sp[4] = {s[0], s[1], s[2], s[3]};
+			size_t done[4];
+
+			// Finish off the current block of each.
+			for (size_t i = 0; i < 4; i++) {
+				ctx[i]->GetDigest(out[i], 0, false);
+				done[i] = std::min(len, ctx[i]->m_avail);
+				ctx[i]->GetDigest(out[i], done[i], false);
+			}
+			while (done[0] < len && done[1] < len && done[2] < len &&
+					done[3] < len) {
+				for (size_t i = 0; i < 4; i++)
+					ctx[i]->GetState(s[i]);
+				PermuteMany(sp, 4);
+				for (size_t i = 0; i < 4; i++) {
+					const size_t n = std::min(len - done[i], ctx[i]->m_r);
+					ctx[i]->SetState(s[i]);
+					ctx[i]->Refill();
+					ctx[i]->GetDigest(out[i] + done[i], n, false);
+					done[i] += n;
+				}
+			}
+			for (size_t i = 0; i < 4; i++)
+				ctx[i]->GetDigest(out[i] + done[i], len - done[i], false);
+		}
+		static const size_t digest_size = Security * 2;
+		static const size_t block_size = 1600 / 8;
+		static const size_t buffer_size = 1600 / 8;
+	protected:
+		// Fill the buffer with the next block of output.
+		void Refill()
+		{
+			uint64_t s[25];
+			GetState(s);
+			endian_t::CopyCarefully(m_buf, s, m_r);
+			m_avail = m_r;
+		}
+		size_t m_avail;
+		bool m_squeezing;
+};
+
+class SHAKE128 : public SHAKE<128 / 8>
+{
+};
+
+class SHAKE256 : public SHAKE<256 / 8>
+{
+};
 }
 UNHIDE()
 
@@ -39,6 +39,8 @@
 
 // This needs to be large enough to handle one block of the cipher.
 #define BUFFER_SIZE 16
+// The number of bytes passed to encryptfast at once when batching.
+#define BATCH_SIZE 4096
 
 /* Interfaces must not modify the functbl member of the context since the KDF
  * implementation casts its context to the MAC implementation to avoid
@@ -61,7 +63,7 @@ struct cmac {
 static int cmac_info(int op, void *p)
 {
 	if (op == DREW_MAC_VERSION)
-		return CURRENT_ABI;
+		return DREW_MAC_ABI_BATCH;
 	return -DREW_ERR_NOT_IMPL;
 }
 
@@ -70,7 +72,7 @@ static int cmac_info2(const drew_mac_t *ctx, int op, drew_param_t *out,
 {
 	switch (op) {
 		case DREW_MAC_VERSION:
-			return CURRENT_ABI;
+			return DREW_MAC_ABI_BATCH;
 		case DREW_MAC_ENDIAN:
 			return 0;
 		case DREW_MAC_INTSIZE:
@@ -144,6 +146,7 @@ static int cmac_clone(drew_mac_t *newctx, const drew_mac_t *oldctx, int flags)
 	memcpy(newctx->ctx, oldctx->ctx, sizeof(*h));
 	h = newctx->ctx;
 	oh = oldctx->ctx;
+	newctx->functbl = oldctx->functbl;
 
 	h->block.functbl = oh->block.functbl;
 	h->block.functbl->clone(&h->block, &oh->block, 0);
@@ -193,12 +196,13 @@ static int cmac_setkey(drew_mac_t *ctxt, const uint8_t *data, size_t len)
 	return 0;
 }
 
+/* The subkeys depend only on the key, so they are kept from setkey and the
+ * cipher is not touched here.
+ */
 static int cmac_reset(drew_mac_t *ctx)
 {
 	int res = 0;
 	struct cmac *c = ctx->ctx;
-	if (c->block.ctx)
-		c->block.functbl->reset(&c->block);
 	c->boff = 0;
 	c->nonzero_len = false;
 	memset(c->hash, 0, sizeof(c->hash));
@@ -230,7 +234,7 @@ static int cmac_update(drew_mac_t *ctx, const uint8_t *data, size_t len)
 				c->boff = 0;
 			}
 			else
-				c->boff = 16;
+				c->boff = c->blksize;
 		}
 		len -= b;
 		in += b;
@@ -276,6 +280,100 @@ static int cmac_final(drew_mac_t *ctx, uint8_t *digest, int flags)
 	return 0;
 }
 
+/* XOR a block of len bytes, which is 8 or 16, into buf. */
+static inline void xor_block(uint8_t *buf, const uint8_t *p, size_t len)
+{
+	uint64_t a, b;
+
+	for (size_t i = 0; i < len; i += sizeof(a)) {
+		memcpy(&a, buf+i, sizeof(a));
+		memcpy(&b, p+i, sizeof(b));
+		a ^= b;
+		memcpy(buf+i, &a, sizeof(a));
+	}
+}
+
+/* Load block r of message data, which is len bytes long and has nblocks
+ * blocks, XORing it into buf.  The last block is padded and has the subkey
+ * applied as in cmac_final.  bs is the block size, passed separately so that
+ * it is a constant once this is inlined.
+ */
+static inline void load_block(const struct cmac *c, size_t bs, uint8_t *buf,
+		const uint8_t *data, size_t len, size_t r, size_t nblocks)
+{
+	const size_t off = r * bs;
+
+	if (likely(r + 1 < nblocks))
+		xor_block(buf, data+off, bs);
+	else if (len && len-off == bs) {
+		xor_block(buf, data+off, bs);
+		xor_block(buf, c->k1, bs);
+	}
+	else {
+		for (size_t i = 0; i < len-off; i++)
+			buf[i] ^= data[off+i];
+		buf[len-off] ^= 0x80;
+		xor_block(buf, c->k2, bs);
+	}
+}
+
+/* CMAC is serial within a message, so instead the chaining values of up to
+ * BATCH_SIZE bytes' worth of messages are advanced together, one block from
+ * each message per call to encryptfast.  The chaining values of the messages
+ * still in progress are kept contiguous at the start of buf; when a message
+ * finishes, the last one is moved into its slot.
+ */
+static inline void batch(const struct cmac *c, size_t bs, uint8_t *out,
+		const uint8_t *const *data, const size_t *len, size_t n)
+{
+	const size_t maxmsgs = BATCH_SIZE / BUFFER_SIZE;
+	uint8_t buf[BATCH_SIZE] ALIGNED_T;
+	size_t nblocks[BATCH_SIZE / BUFFER_SIZE], idx[BATCH_SIZE / BUFFER_SIZE];
+
+	for (size_t base = 0; base < n; base += maxmsgs) {
+		size_t active = MIN(n - base, maxmsgs);
+
+		memset(buf, 0, active * bs);
+		for (size_t j = 0; j < active; j++) {
+			const size_t l = len[base+j];
+			nblocks[j] = l ? (l + bs - 1) / bs : 1;
+			idx[j] = j;
+		}
+
+		for (size_t r = 0; active; r++) {
+			for (size_t k = 0; k < active; k++) {
+				const size_t j = idx[k];
+				load_block(c, bs, buf+k*bs, data[base+j], len[base+j], r,
+						nblocks[j]);
+			}
+			c->block.functbl->encryptfast(&c->block, buf, buf, active);
+			for (size_t k = active; k-- > 0; ) {
+				const size_t j = idx[k];
+				if (r + 1 < nblocks[j])
+					continue;
+				memcpy(out+(base+j)*c->taglen, buf+k*bs, c->taglen);
+				if (k != --active) {
+					memcpy(buf+k*bs, buf+active*bs, bs);
+					idx[k] = idx[active];
+				}
+			}
+		}
+	}
+	memset(buf, 0, sizeof(buf));
+}
+
+static int cmac_batch(const drew_mac_t *ctx, uint8_t *out,
+		const uint8_t *const *data, const size_t *len, size_t n)
+{
+	const struct cmac *c = ctx->ctx;
+
+	if (c->blksize == 16)
+		batch(c, 16, out, data, len, n);
+	else
+		batch(c, 8, out, data, len, n);
+	return 0;
+}
+
 struct test {
 	const uint8_t *key;
 	size_t keysz;
@@ -319,8 +417,13 @@ static int cmac_test_generic(DrewLoader *ldr, const char *name,
 			for (size_t k = 0; k < t->datasz; k += 9)
 				cmac_update(&c, t->data+k, MIN(9, t->datasz-k));
 		cmac_final(&c, buf, 0);
-
 		result |= !!memcmp(buf, t->output, outputsz);
+
+		if (t->datarep == 1) {
+			memset(buf, 0, sizeof(buf));
+			cmac_batch(&c, buf, &t->data, &t->datasz, 1);
+			result |= !!memcmp(buf, t->output, outputsz);
+		}
 		cmac_fini(&c, 0);
 	}
 	block.functbl->fini(&block, 0);
@@ -374,6 +477,52 @@ static int cmac_test_aes128(DrewLoader *ldr, size_t *ntests)
 			DIM(testdata_aes128), 16);
 }
 
+/* Check that a batch of messages of every length up to 40 bytes matches the
+ * same messages processed one at a time.
+ */
+static int cmac_test_batch(DrewLoader *ldr, const char *name)
+{
+	const struct test *t = testdata_aes128 + 2;
+	const size_t nmsgs = 41;
+	int result = 0;
+	drew_mac_t c;
+	uint8_t buf[BUFFER_SIZE], out[41 * BUFFER_SIZE];
+	const uint8_t *data[41];
+	size_t len[41];
+	drew_param_t param;
+	drew_block_t block;
+	int id;
+
+	if ((id = drew_loader_lookup_by_name(ldr, name, 0, -1)) < 0)
+		return id;
+	drew_loader_get_functbl(ldr, id, (const void **)&block.functbl);
+
+	block.functbl->init(&block, 0, ldr, NULL);
+
+	param.name = "cipher";
+	param.next = NULL;
+	param.param.value = &block;
+
+	if ((result = cmac_init(&c, 0, ldr, &param)))
+		return result;
+	cmac_setkey(&c, t->key, t->keysz);
+	for (size_t i = 0; i < nmsgs; i++) {
+		data[i] = t->data;
+		len[i] = i;
+	}
+	cmac_batch(&c, out, data, len, nmsgs);
+	for (size_t i = 0; i < nmsgs; i++) {
+		cmac_reset(&c);
+		cmac_update(&c, t->data, i);
+		cmac_final(&c, buf, 0);
+		result |= !!memcmp(buf, out+i*BUFFER_SIZE, BUFFER_SIZE);
+	}
+	cmac_fini(&c, 0);
+	block.functbl->fini(&block, 0);
+
+	return result;
+}
+
 static int cmac_test(void *p, DrewLoader *ldr)
 {
 	int result = 0, tres;
@@ -385,6 +534,10 @@ static int cmac_test(void *p, DrewLoader *ldr)
 		result <<= ntests;
 		result |= tres;
 	}
+	if ((tres = cmac_test_batch(ldr, "AES128")) >= 0) {
+		result <<= 1;
+		result |= tres;
+	}
 
 	return result;
 }
@@ -541,7 +694,7 @@ static int cmack_test(void *p, DrewLoader *ldr)
 
 static drew_mac_functbl_t cmac_functbl = {
 	cmac_info, cmac_info2, cmac_init, cmac_clone, cmac_reset, cmac_fini,
-	cmac_setkey, cmac_update, cmac_update, cmac_final, cmac_test
+	cmac_setkey, cmac_update, cmac_update, cmac_final, cmac_test, cmac_batch
 };
 
 #if 0
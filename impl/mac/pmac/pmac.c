@@ -0,0 +1,594 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ *
+ * This file is part of the Drew Cryptography Suite.
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of your choice of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation or version 2.0 of the Apache
+ * License as published by the Apache Software Foundation.
+ *
+ * This file is distributed in the hope that it will be useful, but without
+ * any warranty; without even the implied warranty of merchantability or fitness
+ * for a particular purpose.
+ *
+ * Note that people who make modified versions of this file are not obligated to
+ * dual-license their modified versions; it is their choice whether to do so.
+ * If a modified version is not distributed under both licenses, the copyright
+ * and permission notices should be updated accordingly.
+ */
+/* This implements PMAC1 by Black and Rogaway for 128-bit block ciphers.  Unlike
+ * CMAC, the blocks of a message are independent, so whole runs of them are
+ * passed to encryptfast at once.
+ */
+#include "internal.h"
+#include "util.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <drew/drew.h>
+#include <drew/block.h>
+#include <drew/mac.h>
+#include <drew/mem.h>
+#include <drew/plugin.h>
+
+#define DIM(x) (sizeof(x)/sizeof((x)[0]))
+
+#define BLKSIZE 16
+// The number of bytes passed to encryptfast at once.
+#define CHUNKSIZE 4096
+// L(-1) and L(0) through L(63).
+#define NLVALUES (1 + 64)
+#define L_INV 0
+#define L_(i) (1 + (i))
+
+HIDE()
+struct pmac {
+	uint8_t buf[BLKSIZE] ALIGNED_T;
+	uint64_t offset[2];
+	uint64_t sum[2];
+	// The L values as 64-bit words in memory order, so they can be XORed
+	// directly into the offset.
+	uint64_t *l;
+	uint64_t nblocks;
+	size_t boff;
+	size_t taglen;
+	drew_block_t block;
+};
+
+static int pmac_info(int op, void *p)
+{
+	if (op == DREW_MAC_VERSION)
+		return DREW_MAC_ABI_BATCH;
+	return -DREW_ERR_NOT_IMPL;
+}
+
+static int pmac_info2(const drew_mac_t *ctx, int op, drew_param_t *out,
+		const drew_param_t *in)
+{
+	switch (op) {
+		case DREW_MAC_VERSION:
+			return DREW_MAC_ABI_BATCH;
+		case DREW_MAC_ENDIAN:
+			return 0;
+		case DREW_MAC_INTSIZE:
+			return sizeof(struct pmac);
+		case DREW_MAC_SIZE_CTX:
+			if (ctx && ctx->ctx) {
+				struct pmac *c = ctx->ctx;
+				return c->taglen;
+			}
+			return -DREW_ERR_MORE_INFO;
+		case DREW_MAC_BLKSIZE_CTX:
+			return BLKSIZE;
+		default:
+			return -DREW_ERR_INVALID;
+	}
+}
+
+static int pmac_init(drew_mac_t *ctx, int flags, DrewLoader *ldr,
+		const drew_param_t *param)
+{
+	drew_block_t *algo = NULL;
+	size_t taglen = 0;
+
+	for (; param; param = param->next) {
+		if (!strcmp(param->name, "cipher"))
+			algo = param->param.value;
+		if (!strcmp(param->name, "tagLength"))
+			taglen = param->param.number;
+	}
+
+	if (!algo)
+		return -DREW_ERR_INVALID;
+	// The doubling and halving are only defined here for 128-bit blocks.
+	if (algo->functbl->info(DREW_BLOCK_BLKSIZE, NULL) != BLKSIZE)
+		return -DREW_ERR_INVALID;
+	if (taglen > BLKSIZE)
+		return -DREW_ERR_INVALID;
+
+	struct pmac *p = drew_mem_smalloc(sizeof(*p));
+	if (!p)
+		return -ENOMEM;
+	memset(p, 0, sizeof(*p));
+	p->l = drew_mem_smalloc(NLVALUES * BLKSIZE);
+	if (!p->l) {
+		drew_mem_sfree(p);
+		return -ENOMEM;
+	}
+	memset(p->l, 0, NLVALUES * BLKSIZE);
+	p->block.functbl = algo->functbl;
+	p->block.functbl->clone(&p->block, algo, 0);
+	p->taglen = taglen ? taglen : BLKSIZE;
+
+	if (flags & DREW_MAC_FIXED) {
+		memcpy(ctx->ctx, p, sizeof(*p));
+		drew_mem_sfree(p);
+	}
+	else
+		ctx->ctx = p;
+	return 0;
+}
+
+static int pmac_clone(drew_mac_t *newctx, const drew_mac_t *oldctx, int flags)
+{
+	struct pmac *h, *oh;
+	if (!(flags & DREW_MAC_FIXED)) {
+		newctx->ctx = drew_mem_smalloc(sizeof(*h));
+	}
+	memcpy(newctx->ctx, oldctx->ctx, sizeof(*h));
+	h = newctx->ctx;
+	oh = oldctx->ctx;
+	newctx->functbl = oldctx->functbl;
+
+	h->l = drew_mem_smemdup(oh->l, NLVALUES * BLKSIZE);
+	h->block.functbl = oh->block.functbl;
+	h->block.functbl->clone(&h->block, &oh->block, 0);
+
+	return 0;
+}
+
+static int pmac_fini(drew_mac_t *ctx, int flags)
+{
+	struct pmac *h = ctx->ctx;
+	h->block.functbl->fini(&h->block, 0);
+	memset(h->l, 0, NLVALUES * BLKSIZE);
+	drew_mem_sfree(h->l);
+
+	if (!(flags & DREW_MAC_FIXED)) {
+		drew_mem_sfree(h);
+		ctx->ctx = NULL;
+	}
+	return 0;
+}
+
+/* Multiply a block by x, treating it as a big-endian integer. */
+static void dbl(uint8_t *out, const uint8_t *in)
+{
+	const uint8_t carry = (in[0] & 0x80) ? 0x87 : 0;
+
+	for (size_t i = 0; i < BLKSIZE-1; i++)
+		out[i] = (in[i] << 1) | (in[i+1] >> 7);
+	out[BLKSIZE-1] = (in[BLKSIZE-1] << 1) ^ carry;
+}
+
+/* Multiply a block by x^-1, treating it as a big-endian integer. */
+static void halve(uint8_t *out, const uint8_t *in)
+{
+	const bool carry = in[BLKSIZE-1] & 1;
+
+	for (size_t i = BLKSIZE-1; i > 0; i--)
+		out[i] = (in[i] >> 1) | (in[i-1] << 7);
+	out[0] = in[0] >> 1;
+	if (carry) {
+		out[0] ^= 0x80;
+		out[BLKSIZE-1] ^= 0x43;
+	}
+}
+
+static int pmac_reset(drew_mac_t *ctx)
+{
+	struct pmac *c = ctx->ctx;
+	c->boff = 0;
+	c->nblocks = 0;
+	memset(c->offset, 0, sizeof(c->offset));
+	memset(c->sum, 0, sizeof(c->sum));
+	return 0;
+}
+
+static int pmac_setkey(drew_mac_t *ctxt, const uint8_t *data, size_t len)
+{
+	struct pmac *ctx = ctxt->ctx;
+	uint8_t *l = (uint8_t *)ctx->l;
+	int res;
+
+	if ((res = ctx->block.functbl->setkey(&ctx->block, data, len, 0)))
+		return res;
+	memset(l + L_(0)*BLKSIZE, 0, BLKSIZE);
+	ctx->block.functbl->encrypt(&ctx->block, l + L_(0)*BLKSIZE,
+			l + L_(0)*BLKSIZE);
+	halve(l + L_INV*BLKSIZE, l + L_(0)*BLKSIZE);
+	for (size_t i = 1; i < 64; i++)
+		dbl(l + L_(i)*BLKSIZE, l + L_(i-1)*BLKSIZE);
+
+	return pmac_reset(ctxt);
+}
+
+static inline void xor_l(uint64_t *x, const struct pmac *c, size_t i)
+{
+	x[0] ^= c->l[2*i];
+	x[1] ^= c->l[2*i+1];
+}
+
+static inline void xor_block(uint64_t *x, const uint8_t *p)
+{
+	uint64_t t[2];
+
+	memcpy(t, p, sizeof(t));
+	x[0] ^= t[0];
+	x[1] ^= t[1];
+}
+
+/* Process n whole blocks, none of which is the last block of the message.  n
+ * must be at most CHUNKSIZE / BLKSIZE.
+ */
+static void process_blocks(struct pmac *c, const uint8_t *in, size_t n)
+{
+	uint8_t offs[CHUNKSIZE] ALIGNED_T, buf[CHUNKSIZE] ALIGNED_T;
+
+	for (size_t i = 0; i < n; i++) {
+		xor_l(c->offset, c, L_(__builtin_ctzll(++c->nblocks)));
+		memcpy(offs + i*BLKSIZE, c->offset, BLKSIZE);
+	}
+	xor_buffers(buf, in, offs, n * BLKSIZE);
+	c->block.functbl->encryptfast(&c->block, buf, buf, n);
+	for (size_t i = 0; i < n; i++)
+		xor_block(c->sum, buf + i*BLKSIZE);
+}
+
+static int pmac_update(drew_mac_t *ctx, const uint8_t *data, size_t len)
+{
+	struct pmac *c = ctx->ctx;
+	const uint8_t *in = data;
+
+	if (len == 0)
+		return 0;
+
+	if (c->boff) {
+		const size_t b = MIN(BLKSIZE - c->boff, len);
+		memcpy(c->buf+c->boff, in, b);
+		c->boff += b;
+		len -= b;
+		in += b;
+		if (c->boff == BLKSIZE && len) {
+			process_blocks(c, c->buf, 1);
+			c->boff = 0;
+		}
+	}
+
+	/* The last block must be treated specially, so make sure that this isn't it
+	 * by ensuring that there's at least one more byte than the block size.
+	 */
+	while (len > BLKSIZE) {
+		const size_t n = MIN((len - 1) / BLKSIZE, CHUNKSIZE / BLKSIZE);
+		process_blocks(c, in, n);
+		len -= n * BLKSIZE;
+		in += n * BLKSIZE;
+	}
+
+	if (len) {
+		memcpy(c->buf, in, len);
+		c->boff = len;
+	}
+
+	return 0;
+}
+
+static int pmac_final(drew_mac_t *ctx, uint8_t *digest, int flags)
+{
+	struct pmac *c = ctx->ctx;
+	uint8_t buf[BLKSIZE];
+
+	if (c->boff == BLKSIZE) {
+		xor_block(c->sum, c->buf);
+		xor_l(c->sum, c, L_INV);
+	}
+	else {
+		memset(c->buf+c->boff, 0, BLKSIZE-c->boff);
+		c->buf[c->boff] = 0x80;
+		xor_block(c->sum, c->buf);
+	}
+	c->block.functbl->encrypt(&c->block, buf, (const uint8_t *)c->sum);
+	memcpy(digest, buf, c->taglen);
+	memset(buf, 0, sizeof(buf));
+
+	return 0;
+}
+
+/* PMAC is already parallel within a message, so each message is simply run
+ * through a scratch copy of the keyed state.
+ */
+static int pmac_batch(const drew_mac_t *ctx, uint8_t *out,
+		const uint8_t *const *data, const size_t *len, size_t n)
+{
+	struct pmac tmp;
+	drew_mac_t tmpctx;
+
+	tmpctx.ctx = &tmp;
+	tmpctx.functbl = ctx->functbl;
+	for (size_t i = 0; i < n; i++) {
+		memcpy(&tmp, ctx->ctx, sizeof(tmp));
+		pmac_reset(&tmpctx);
+		pmac_update(&tmpctx, data[i], len[i]);
+		pmac_final(&tmpctx, out + i * tmp.taglen, 0);
+	}
+	memset(&tmp, 0, sizeof(tmp));
+
+	return 0;
+}
+
+struct test {
+	const uint8_t *key;
+	size_t keysz;
+	const uint8_t *data;
+	size_t datasz;
+	size_t datarep;
+	const uint8_t *output;
+};
+
+static int pmac_test_generic(DrewLoader *ldr, const char *name,
+		const struct test *testdata, size_t ntests, size_t outputsz)
+{
+	int result = 0;
+	drew_mac_t c;
+	uint8_t buf[BLKSIZE];
+	drew_param_t param;
+	drew_block_t block;
+	int id;
+
+	if ((id = drew_loader_lookup_by_name(ldr, name, 0, -1)) < 0)
+		return id;
+	drew_loader_get_functbl(ldr, id, (const void **)&block.functbl);
+
+	block.functbl->init(&block, 0, ldr, NULL);
+
+	param.name = "cipher";
+	param.next = NULL;
+	param.param.value = &block;
+
+	for (size_t i = 0; i < ntests; i++) {
+		const struct test *t = testdata + i;
+		int retval;
+
+		memset(buf, 0, sizeof(buf));
+		result <<= 1;
+
+		if ((retval = pmac_init(&c, 0, ldr, &param)))
+			return retval;
+		pmac_setkey(&c, t->key, t->keysz);
+		for (size_t j = 0; j < t->datarep; j++)
+			for (size_t k = 0; k < t->datasz; k += 9)
+				pmac_update(&c, t->data+k, MIN(9, t->datasz-k));
+		pmac_final(&c, buf, 0);
+		result |= !!memcmp(buf, t->output, outputsz);
+
+		if (t->datarep == 1) {
+			memset(buf, 0, sizeof(buf));
+			pmac_batch(&c, buf, &t->data, &t->datasz, 1);
+			result |= !!memcmp(buf, t->output, outputsz);
+		}
+		pmac_fini(&c, 0);
+	}
+	block.functbl->fini(&block, 0);
+
+	return result;
+}
+
+#define U8P (const uint8_t *)
+#define AES128_KEY U8P "\x00\x01\x02\x03\x04\x05\x06\x07" \
+	"\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f"
+#define COUNTING U8P "\x00\x01\x02\x03\x04\x05\x06\x07" \
+	"\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f" \
+	"\x10\x11\x12\x13\x14\x15\x16\x17" \
+	"\x18\x19\x1a\x1b\x1c\x1d\x1e\x1f" \
+	"\x20\x21"
+static const uint8_t zeros[1000];
+static const struct test testdata_aes128[] = {
+	{
+		AES128_KEY,
+		16,
+		COUNTING,
+		0,
+		1,
+		U8P "\x43\x99\x57\x2c\xd6\xea\x53\x41"
+			"\xb8\xd3\x58\x76\xa7\x09\x8a\xf7"
+	},
+	{
+		AES128_KEY,
+		16,
+		COUNTING,
+		3,
+		1,
+		U8P "\x25\x6b\xa5\x19\x3c\x1b\x99\x1b"
+			"\x4d\xf0\xc5\x1f\x38\x8a\x9e\x27"
+	},
+	{
+		AES128_KEY,
+		16,
+		COUNTING,
+		16,
+		1,
+		U8P "\xeb\xbd\x82\x2f\xa4\x58\xda\xf6"
+			"\xdf\xda\xd7\xc2\x7d\xa7\x63\x38"
+	},
+	{
+		AES128_KEY,
+		16,
+		COUNTING,
+		20,
+		1,
+		U8P "\x04\x12\xca\x15\x0b\xbf\x79\x05"
+			"\x8d\x8c\x75\xa5\x8c\x99\x3f\x55"
+	},
+	{
+		AES128_KEY,
+		16,
+		COUNTING,
+		32,
+		1,
+		U8P "\xe9\x7a\xc0\x4e\x9e\x5e\x33\x99"
+			"\xce\x53\x55\xcd\x74\x07\xbc\x75"
+	},
+	{
+		AES128_KEY,
+		16,
+		COUNTING,
+		34,
+		1,
+		U8P "\x5c\xba\x7d\x5e\xb2\x4f\x7c\x86"
+			"\xcc\xc5\x46\x04\xe5\x3d\x55\x12"
+	},
+	{
+		AES128_KEY,
+		16,
+		zeros,
+		1000,
+		1,
+		U8P "\xc2\xc9\xfa\x1d\x99\x85\xf6\xf0"
+			"\xd2\xaf\xf9\x15\xa0\xe8\xd9\x10"
+	},
+	{
+		AES128_KEY,
+		16,
+		zeros,
+		8,
+		125,
+		U8P "\xc2\xc9\xfa\x1d\x99\x85\xf6\xf0"
+			"\xd2\xaf\xf9\x15\xa0\xe8\xd9\x10"
+	}
+};
+
+static int pmac_test_aes128(DrewLoader *ldr, size_t *ntests)
+{
+	*ntests = DIM(testdata_aes128);
+
+	return pmac_test_generic(ldr, "AES128", testdata_aes128,
+			DIM(testdata_aes128), 16);
+}
+
+/* Check that a message long enough to take several chunks gives the same
+ * result in one call as in small pieces.
+ */
+static int pmac_test_long(DrewLoader *ldr, const char *name)
+{
+	const size_t len = 3 * CHUNKSIZE + 5 * BLKSIZE;
+	int result = 0;
+	drew_mac_t c;
+	uint8_t buf[BLKSIZE], buf2[BLKSIZE], *data;
+	drew_param_t param;
+	drew_block_t block;
+	int id;
+
+	if ((id = drew_loader_lookup_by_name(ldr, name, 0, -1)) < 0)
+		return id;
+	drew_loader_get_functbl(ldr, id, (const void **)&block.functbl);
+
+	block.functbl->init(&block, 0, ldr, NULL);
+
+	param.name = "cipher";
+	param.next = NULL;
+	param.param.value = &block;
+
+	if ((result = pmac_init(&c, 0, ldr, &param)))
+		return result;
+	data = drew_mem_malloc(len);
+	for (size_t i = 0; i < len; i++)
+		data[i] = i * 0x3d;
+	pmac_setkey(&c, AES128_KEY, 16);
+	pmac_update(&c, data, len);
+	pmac_final(&c, buf, 0);
+	pmac_reset(&c);
+	for (size_t k = 0; k < len; k += 9)
+		pmac_update(&c, data+k, MIN(9, len-k));
+	pmac_final(&c, buf2, 0);
+	result |= !!memcmp(buf, buf2, sizeof(buf));
+
+	drew_mem_free(data);
+	pmac_fini(&c, 0);
+	block.functbl->fini(&block, 0);
+
+	return result;
+}
+
+static int pmac_test(void *p, DrewLoader *ldr)
+{
+	int result = 0, tres;
+	size_t ntests = 0;
+	if (!ldr)
+		return -DREW_ERR_INVALID;
+
+	if ((tres = pmac_test_aes128(ldr, &ntests)) >= 0) {
+		result <<= ntests;
+		result |= tres;
+	}
+	if ((tres = pmac_test_long(ldr, "AES128")) >= 0) {
+		result <<= 1;
+		result |= tres;
+	}
+
+	return result;
+}
+
+static drew_mac_functbl_t pmac_functbl = {
+	pmac_info, pmac_info2, pmac_init, pmac_clone, pmac_reset, pmac_fini,
+	pmac_setkey, pmac_update, pmac_update, pmac_final, pmac_test, pmac_batch
+};
+
+struct plugin {
+	const char *name;
+	const void *functbl;
+	size_t functblsz;
+	int type;
+};
+
+static struct plugin plugin_data[] = {
+	{ "PMAC", &pmac_functbl, sizeof(drew_mac_functbl_t), DREW_TYPE_MAC },
+};
+
+EXPORT()
+int DREW_PLUGIN_NAME(pmac)(void *ldr, int op, int id, void *p)
+{
+	int nplugins = sizeof(plugin_data)/sizeof(plugin_data[0]);
+
+	if (id < 0 || id >= nplugins)
+		return -DREW_ERR_INVALID;
+
+	switch (op) {
+		case DREW_LOADER_LOOKUP_NAME:
+			return 0;
+		case DREW_LOADER_GET_NPLUGINS:
+			return nplugins;
+		case DREW_LOADER_GET_TYPE:
+			return plugin_data[id].type;
+		case DREW_LOADER_GET_FUNCTBL_SIZE:
+			return plugin_data[id].functblsz;
+		case DREW_LOADER_GET_FUNCTBL:
+			memcpy(p, plugin_data[id].functbl, plugin_data[id].functblsz);
+			return 0;
+		case DREW_LOADER_GET_NAME_SIZE:
+			return strlen(plugin_data[id].name) + 1;
+		case DREW_LOADER_GET_NAME:
+			memcpy(p, plugin_data[id].name, strlen(plugin_data[id].name)+1);
+			return 0;
+		default:
+			return -DREW_ERR_INVALID;
+	}
+}
+UNEXPORT()
+UNHIDE()
@@ -0,0 +1,1381 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ *
+ * This file is part of the Drew Cryptography Suite.
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of your choice of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation or version 2.0 of the Apache
+ * License as published by the Apache Software Foundation.
+ *
+ * This file is distributed in the hope that it will be useful, but without
+ * any warranty; without even the implied warranty of merchantability or fitness
+ * for a particular purpose.
+ *
+ * Note that people who make modified versions of this file are not obligated to
+ * dual-license their modified versions; it is their choice whether to do so.
+ * If a modified version is not distributed under both licenses, the copyright
+ * and permission notices should be updated accordingly.
+ */
+/* This runs whole modes in the kernel through the Linux crypto socket
+ * interface, so that a buffer costs a couple of system calls instead of a pair
+ * for every block as it does when a software mode drives linuxblock.  The block
+ * cipher passed to setblock must be one of the linuxblock implementations,
+ * which key our sockets for us; anything else gets -DREW_ERR_NOT_IMPL, so the
+ * caller can fall back to the software modes.  Because of that, the modes are
+ * registered under their own names, such as "CTR-kernel", so that looking up
+ * "CTR" never finds one that can't be used with the cipher at hand.
+ *
+ * The interface is the same as that of the software modes.  The IV or counter
+ * is kept here and sent with every request, so contexts can be cloned freely.
+ * GCM uses the kernel's gcm() when a whole message is passed to encryptfinal or
+ * decryptfinal.  Since an AEAD socket produces nothing until it has the entire
+ * message, the streaming interface is instead built from the kernel's ctr() and
+ * ghash.
+ */
+#ifdef __linux__
+#include "internal.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <drew/mem.h>
+#include <drew/mode.h>
+#include <drew/block.h>
+#include <drew/plugin.h>
+
+#include "util.hh"
+
+#include "../../multi/linux/af-alg.h"
+
+#define BLKSIZE 16
+
+HIDE()
+
+typedef BigEndian E;
+
+static const uint8_t zero[BLKSIZE] = {0};
+
+enum {
+	MODE_CBC,
+	MODE_CTR,
+	MODE_XTS,
+	MODE_GCM
+};
+
+struct linuxmode {
+	DrewLoader *ldr;
+	int type;
+	struct af_alg alg;
+	// The counter mode and GHASH sockets used for streaming GCM.
+	struct af_alg ctralg;
+	struct af_alg ghash;
+	// Our copy of the linuxblock cipher, which keys the sockets.
+	drew_block_t *algo;
+	size_t keysz;
+	size_t blksize;
+	size_t sectsize;
+	size_t taglen;
+	uint8_t *iv;
+	size_t ivlen;
+	// The CBC chaining value, the counter, or the XTS data unit number.
+	uint8_t state[BLKSIZE];
+	// Unused keystream from the last partial block.
+	uint8_t buf[BLKSIZE];
+	size_t boff;
+	uint8_t *aad;
+	size_t alen;
+	size_t clen;
+	uint8_t ekj0[BLKSIZE];
+	bool streaming;
+};
+
+extern "C" {
+static int linux_info2(const drew_mode_t *, int op, drew_param_t *,
+		const drew_param_t *);
+static int linux_reset(drew_mode_t *ctx);
+static int linux_resync(drew_mode_t *ctx);
+static int linux_setblock(drew_mode_t *ctx, const drew_block_t *algoctx);
+static int linux_setiv(drew_mode_t *ctx, const uint8_t *iv, size_t len);
+static int linux_setdata(drew_mode_t *, const uint8_t *, size_t);
+static int linux_fini(drew_mode_t *ctx, int flags);
+static int linux_clone(drew_mode_t *newctx, const drew_mode_t *oldctx,
+		int flags);
+static int linux_encryptfinal(drew_mode_t *ctx, uint8_t *out, size_t outlen,
+		const uint8_t *in, size_t inlen);
+static int linux_decryptfinal(drew_mode_t *ctx, uint8_t *out, size_t outlen,
+		const uint8_t *in, size_t inlen);
+
+static int cbc_info(int op, void *p);
+static int cbc_init(drew_mode_t *ctx, int flags, DrewLoader *ldr,
+		const drew_param_t *param);
+static int cbc_encrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len);
+static int cbc_decrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len);
+static int cbc_test(void *p, DrewLoader *ldr);
+
+static int ctr_info(int op, void *p);
+static int ctr_init(drew_mode_t *ctx, int flags, DrewLoader *ldr,
+		const drew_param_t *param);
+static int ctr_encrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len);
+static int ctr_test(void *p, DrewLoader *ldr);
+
+static int xts_info(int op, void *p);
+static int xts_init(drew_mode_t *ctx, int flags, DrewLoader *ldr,
+		const drew_param_t *param);
+static int xts_encrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len);
+static int xts_decrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len);
+static int xts_test(void *p, DrewLoader *ldr);
+
+static int gcm_info(int op, void *p);
+static int gcm_init(drew_mode_t *ctx, int flags, DrewLoader *ldr,
+		const drew_param_t *param);
+static int gcm_encrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len);
+static int gcm_decrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len);
+static int gcm_test(void *p, DrewLoader *ldr);
+}
+
+static const drew_mode_functbl_t cbc_functbl = {
+	cbc_info, linux_info2, cbc_init, linux_clone, linux_reset, linux_fini,
+	linux_setblock, linux_setiv, cbc_encrypt, cbc_decrypt,
+	cbc_encrypt, cbc_decrypt, linux_setdata,
+	linux_encryptfinal, linux_decryptfinal, linux_resync, cbc_test
+};
+
+static const drew_mode_functbl_t ctr_functbl = {
+	ctr_info, linux_info2, ctr_init, linux_clone, linux_reset, linux_fini,
+	linux_setblock, linux_setiv, ctr_encrypt, ctr_encrypt,
+	ctr_encrypt, ctr_encrypt, linux_setdata,
+	linux_encryptfinal, linux_decryptfinal, linux_resync, ctr_test
+};
+
+static const drew_mode_functbl_t xts_functbl = {
+	xts_info, linux_info2, xts_init, linux_clone, linux_reset, linux_fini,
+	linux_setblock, linux_setiv, xts_encrypt, xts_decrypt,
+	xts_encrypt, xts_decrypt, linux_setdata,
+	linux_encryptfinal, linux_decryptfinal, linux_resync, xts_test
+};
+
+static const drew_mode_functbl_t gcm_functbl = {
+	gcm_info, linux_info2, gcm_init, linux_clone, linux_reset, linux_fini,
+	linux_setblock, linux_setiv, gcm_encrypt, gcm_decrypt,
+	gcm_encrypt, gcm_decrypt, linux_setdata,
+	linux_encryptfinal, linux_decryptfinal, linux_resync, gcm_test
+};
+
+static int cbc_info(int op, void *p)
+{
+	switch (op) {
+		case DREW_MODE_VERSION:
+			return CURRENT_ABI;
+		case DREW_MODE_INTSIZE:
+			return sizeof(struct linuxmode);
+		case DREW_MODE_FINAL_INSIZE:
+		case DREW_MODE_FINAL_OUTSIZE:
+			return 0;
+		case DREW_MODE_QUANTUM:
+			return 1;
+		default:
+			return -DREW_ERR_INVALID;
+	}
+}
+
+static int ctr_info(int op, void *p)
+{
+	return cbc_info(op, p);
+}
+
+static int xts_info(int op, void *p)
+{
+	if (op == DREW_MODE_QUANTUM)
+		return BLKSIZE;
+	return cbc_info(op, p);
+}
+
+static int gcm_info(int op, void *p)
+{
+	switch (op) {
+		case DREW_MODE_FINAL_INSIZE:
+		case DREW_MODE_FINAL_OUTSIZE:
+			return BLKSIZE;
+		default:
+			return cbc_info(op, p);
+	}
+}
+
+static int linux_info2(const drew_mode_t *ctx, int op, drew_param_t *out,
+		const drew_param_t *in)
+{
+	const struct linuxmode *c = NULL;
+
+	if (ctx && ctx->ctx)
+		c = (const struct linuxmode *)ctx->ctx;
+
+	switch (op) {
+		case DREW_MODE_VERSION:
+			return CURRENT_ABI;
+		case DREW_MODE_INTSIZE:
+			return sizeof(struct linuxmode);
+		case DREW_MODE_FINAL_INSIZE_CTX:
+		case DREW_MODE_FINAL_OUTSIZE_CTX:
+			if (!c)
+				return -DREW_ERR_MORE_INFO;
+			return c->type == MODE_GCM ? c->taglen : 0;
+		case DREW_MODE_BLKSIZE_CTX:
+			if (!c || !c->blksize)
+				return -DREW_ERR_MORE_INFO;
+			return c->blksize;
+		case DREW_MODE_QUANTUM:
+			if (!c)
+				return -DREW_ERR_MORE_INFO;
+			return c->type == MODE_XTS ? BLKSIZE : 1;
+		default:
+			return -DREW_ERR_INVALID;
+	}
+}
+
+static int linux_resync(drew_mode_t *ctx)
+{
+	return -DREW_ERR_NOT_IMPL;
+}
+
+static int init(drew_mode_t *ctx, int flags, DrewLoader *ldr, int type,
+		const drew_mode_functbl_t *functbl)
+{
+	struct linuxmode *newctx = (struct linuxmode *)ctx->ctx;
+
+	if (!(flags & DREW_MODE_FIXED))
+		newctx = (struct linuxmode *)drew_mem_smalloc(sizeof(*newctx));
+	memset(newctx, 0, sizeof(*newctx));
+	newctx->ldr = ldr;
+	newctx->type = type;
+	newctx->taglen = BLKSIZE;
+	af_alg_initialize(&newctx->alg);
+	af_alg_initialize(&newctx->ctralg);
+	af_alg_initialize(&newctx->ghash);
+
+	ctx->ctx = newctx;
+	ctx->functbl = functbl;
+
+	return 0;
+}
+
+static int cbc_init(drew_mode_t *ctx, int flags, DrewLoader *ldr,
+		const drew_param_t *param)
+{
+	return init(ctx, flags, ldr, MODE_CBC, &cbc_functbl);
+}
+
+static int ctr_init(drew_mode_t *ctx, int flags, DrewLoader *ldr,
+		const drew_param_t *param)
+{
+	return init(ctx, flags, ldr, MODE_CTR, &ctr_functbl);
+}
+
+static int xts_init(drew_mode_t *ctx, int flags, DrewLoader *ldr,
+		const drew_param_t *param)
+{
+	size_t sectsize = 0;
+
+	for (; param; param = param->next)
+		if (!strcmp(param->name, "sectorSize"))
+			sectsize = param->param.number;
+
+	if (sectsize && sectsize < BLKSIZE)
+		return -DREW_ERR_INVALID;
+
+	RETFAIL(init(ctx, flags, ldr, MODE_XTS, &xts_functbl));
+	((struct linuxmode *)ctx->ctx)->sectsize = sectsize;
+	return 0;
+}
+
+static int gcm_init(drew_mode_t *ctx, int flags, DrewLoader *ldr,
+		const drew_param_t *param)
+{
+	size_t taglen = BLKSIZE;
+
+	for (; param; param = param->next)
+		if (!strcmp(param->name, "tagLength"))
+			taglen = param->param.number;
+
+	// These are the tag lengths the kernel accepts.
+	if (taglen != 4 && taglen != 8 && (taglen < 12 || taglen > BLKSIZE))
+		return -DREW_ERR_INVALID;
+
+	RETFAIL(init(ctx, flags, ldr, MODE_GCM, &gcm_functbl));
+	((struct linuxmode *)ctx->ctx)->taglen = taglen;
+	return 0;
+}
+
+static void close_sockets(struct linuxmode *c)
+{
+	af_alg_close(&c->alg);
+	af_alg_close(&c->ctralg);
+	af_alg_close(&c->ghash);
+	c->streaming = false;
+}
+
+/* Have algo bind a to tmpl(cipher) and key it with its own key followed by
+ * extra.  The tag length is only set if taglen is nonzero.  With a NULL a, this
+ * just checks that algo is a linuxblock cipher.
+ */
+static int open_alg(const drew_block_t *algo, struct af_alg *a,
+		const char *type, const char *tmpl, const uint8_t *extra,
+		size_t extralen, size_t taglen)
+{
+	struct af_alg_keyreq req = { a, type, tmpl, extra, extralen, taglen };
+	drew_param_t param;
+
+	param.next = NULL;
+	param.name = "request";
+	param.param.value = &req;
+
+	return algo->functbl->info2(algo, AF_ALG_BLOCK_KEY_SOCKET, NULL,
+			a ? &param : NULL);
+}
+
+static void free_algo(struct linuxmode *c)
+{
+	if (c->algo) {
+		c->algo->functbl->fini(c->algo, 0);
+		drew_mem_free(c->algo);
+		c->algo = NULL;
+	}
+}
+
+static int linux_setblock(drew_mode_t *ctx, const drew_block_t *algoctx)
+{
+	struct linuxmode *c = (struct linuxmode *)ctx->ctx;
+	int keysz, res;
+	size_t blksize;
+
+	if (!algoctx)
+		return -DREW_ERR_INVALID;
+
+	if (open_alg(algoctx, NULL, NULL, NULL, NULL, 0, 0))
+		return -DREW_ERR_NOT_IMPL;
+
+	blksize = algoctx->functbl->info2(algoctx, DREW_BLOCK_BLKSIZE_CTX, NULL,
+			NULL);
+	if (blksize > BLKSIZE ||
+			((c->type == MODE_XTS || c->type == MODE_GCM) &&
+			 blksize != BLKSIZE))
+		return -DREW_ERR_INVALID;
+	if ((keysz = algoctx->functbl->info2(algoctx, DREW_BLOCK_KEYSIZE_CTX,
+					NULL, NULL)) <= 0)
+		return -DREW_ERR_MORE_INFO;
+
+	close_sockets(c);
+	free_algo(c);
+	if (!(c->algo = (drew_block_t *)drew_mem_malloc(sizeof(*c->algo))))
+		return -ENOMEM;
+	c->algo->functbl = algoctx->functbl;
+	if ((res = c->algo->functbl->clone(c->algo, algoctx, 0))) {
+		drew_mem_free(c->algo);
+		c->algo = NULL;
+		return res;
+	}
+	c->keysz = keysz;
+	c->blksize = blksize;
+	c->boff = 0;
+
+	switch (c->type) {
+		case MODE_CBC:
+			return open_alg(c->algo, &c->alg, "skcipher", "cbc",
+					NULL, 0, 0);
+		case MODE_CTR:
+			return open_alg(c->algo, &c->alg, "skcipher", "ctr",
+					NULL, 0, 0);
+		case MODE_GCM:
+			return open_alg(c->algo, &c->alg, "aead", "gcm",
+					NULL, 0, c->taglen);
+		default:
+			// XTS needs the tweak key, which is passed to setdata.
+			return 0;
+	}
+}
+
+/* Start again on the GHASH socket if it has been left with part of a message,
+ * since there is no other way to discard its state.
+ */
+static int restart_ghash(struct linuxmode *c)
+{
+	if (!c->streaming)
+		return 0;
+	c->streaming = false;
+	if (c->ghash.fd < 0)
+		return 0;
+	close(c->ghash.fd);
+	c->ghash.fd = -1;
+	return af_alg_make_socket(&c->ghash);
+}
+
+static int linux_setiv(drew_mode_t *ctx, const uint8_t *iv, size_t len)
+{
+	struct linuxmode *c = (struct linuxmode *)ctx->ctx;
+
+	if (c->type == MODE_GCM) {
+		if (!len)
+			return -DREW_ERR_INVALID;
+		drew_mem_sfree(c->aad);
+		c->aad = NULL;
+		c->alen = 0;
+		c->clen = 0;
+		RETFAIL(restart_ghash(c));
+	}
+	else if (!c->blksize)
+		return -DREW_ERR_MORE_INFO;
+	else if (len != c->blksize)
+		return -DREW_ERR_INVALID;
+
+	if (iv != c->iv) {
+		drew_mem_sfree(c->iv);
+		c->iv = (uint8_t *)drew_mem_smemdup(iv, len);
+		c->ivlen = len;
+	}
+	if (c->type != MODE_GCM)
+		memcpy(c->state, iv, len);
+	c->boff = 0;
+	return 0;
+}
+
+static int linux_reset(drew_mode_t *ctx)
+{
+	struct linuxmode *c = (struct linuxmode *)ctx->ctx;
+
+	if (!c->iv)
+		return -DREW_ERR_MORE_INFO;
+	return linux_setiv(ctx, c->iv, c->ivlen);
+}
+
+/* For XTS, the tweak key.  For GCM, the associated data, which must be passed
+ * before any of the message.
+ */
+static int linux_setdata(drew_mode_t *ctx, const uint8_t *data, size_t len)
+{
+	struct linuxmode *c = (struct linuxmode *)ctx->ctx;
+
+	switch (c->type) {
+		case MODE_XTS:
+			if (!c->keysz)
+				return -DREW_ERR_MORE_INFO;
+			if (len != c->keysz)
+				return -DREW_ERR_INVALID;
+			af_alg_close(&c->alg);
+			return open_alg(c->algo, &c->alg, "skcipher", "xts",
+					data, len, 0);
+		case MODE_GCM:
+			if (c->streaming)
+				return -DREW_ERR_NOT_ALLOWED;
+			drew_mem_sfree(c->aad);
+			c->aad = NULL;
+			if (len)
+				c->aad = (uint8_t *)drew_mem_smemdup(data, len);
+			c->alen = len;
+			return 0;
+		default:
+			return -DREW_ERR_NOT_ALLOWED;
+	}
+}
+
+static int cbc_crypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len, int decrypt)
+{
+	struct linuxmode *c = (struct linuxmode *)ctx->ctx;
+	const size_t bs = c->blksize;
+
+	if (c->alg.fd < 0)
+		return -DREW_ERR_MORE_INFO;
+	if (len % bs)
+		return -DREW_ERR_INVALID;
+
+	while (len) {
+		// The request size is a multiple of every block size.
+		const size_t n = std::min<size_t>(len, AF_ALG_MAX_REQUEST);
+		const struct af_alg_op op = { c->state, bs, 0, decrypt, 0 };
+		const struct iovec iin = { (void *)in, n }, iout = { out, n };
+		uint8_t next[BLKSIZE];
+
+		// The input may be overwritten, so save the next IV first.
+		if (decrypt)
+			memcpy(next, in+n-bs, bs);
+		RETFAIL(af_alg_crypt(&c->alg, &op, &iin, 1, &iout, 1));
+		memcpy(c->state, decrypt ? next : out+n-bs, bs);
+
+		len -= n;
+		in += n;
+		out += n;
+	}
+	return 0;
+}
+
+static int cbc_encrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len)
+{
+	return cbc_crypt(ctx, out, in, len, 0);
+}
+
+static int cbc_decrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len)
+{
+	return cbc_crypt(ctx, out, in, len, 1);
+}
+
+// Add n to the big-endian counter in the len bytes at ctr.
+static void add_counter(uint8_t *ctr, size_t len, uint64_t n)
+{
+	for (size_t i = len; i-- > 0 && n; n >>= 8) {
+		n += ctr[i];
+		ctr[i] = n;
+	}
+}
+
+/* Run the counter in c->state through the ctr() socket a.  The kernel carries
+ * across the whole block; if inc32 is set, as GCM requires, no request is
+ * allowed to wrap the low 32 bits.  A trailing partial block is filled out with
+ * zeros in the same request, so that the rest of its keystream ends up in
+ * c->buf.
+ */
+static int ctr_crypt(struct linuxmode *c, struct af_alg *a, uint8_t *out,
+		const uint8_t *in, size_t len, bool inc32)
+{
+	const size_t bs = c->blksize;
+
+	if (a->fd < 0)
+		return -DREW_ERR_MORE_INFO;
+
+	if (c->boff) {
+		const size_t b = std::min(bs - c->boff, len);
+		xor_buffers(out, in, c->buf+c->boff, b);
+		if ((c->boff += b) == bs)
+			c->boff = 0;
+		len -= b;
+		out += b;
+		in += b;
+	}
+
+	while (len) {
+		const struct af_alg_op op = { c->state, bs, 0, 0, 0 };
+		uint64_t nblocks = std::min<uint64_t>((len + bs - 1) / bs,
+				AF_ALG_MAX_REQUEST / bs);
+		size_t n, rem;
+
+		if (inc32) {
+			const uint64_t left = (uint64_t(1) << 32) -
+				E::Convert<uint32_t>(c->state+bs-4);
+			nblocks = std::min(nblocks, left);
+		}
+		n = std::min<size_t>(len, nblocks * bs);
+		rem = n % bs;
+
+		const struct iovec iin[2] = {
+			{ (void *)in, n }, { (void *)zero, rem ? bs - rem : 0 }
+		};
+		const struct iovec iout[2] = {
+			{ out, n }, { c->buf+rem, rem ? bs - rem : 0 }
+		};
+		RETFAIL(af_alg_crypt(a, &op, iin, 2, iout, 2));
+		if (inc32)
+			add_counter(c->state+bs-4, 4, nblocks);
+		else
+			add_counter(c->state, bs, nblocks);
+		c->boff = rem;
+
+		len -= n;
+		in += n;
+		out += n;
+	}
+	return 0;
+}
+
+static int ctr_encrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len)
+{
+	struct linuxmode *c = (struct linuxmode *)ctx->ctx;
+
+	return ctr_crypt(c, &c->alg, out, in, len, false);
+}
+
+static void increment_unit(uint8_t *unit)
+{
+	for (size_t i = 0; i < BLKSIZE && !++unit[i]; i++);
+}
+
+/* Each data unit needs its own IV and so its own request, which limits a unit
+ * to AF_ALG_MAX_REQUEST bytes.
+ */
+static int xts_crypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len, int decrypt)
+{
+	struct linuxmode *c = (struct linuxmode *)ctx->ctx;
+	const size_t unitsz = c->sectsize ? c->sectsize : len;
+
+	if (c->alg.fd < 0)
+		return -DREW_ERR_MORE_INFO;
+	if (len < BLKSIZE || len % unitsz)
+		return -DREW_ERR_INVALID;
+	if (unitsz > AF_ALG_MAX_REQUEST)
+		return -DREW_ERR_NOT_IMPL;
+
+	for (size_t off = 0; off < len; off += unitsz) {
+		const struct af_alg_op op = {
+			c->state, BLKSIZE, 0, decrypt, 0
+		};
+		const struct iovec iin = { (void *)(in+off), unitsz };
+		const struct iovec iout = { out+off, unitsz };
+
+		RETFAIL(af_alg_crypt(&c->alg, &op, &iin, 1, &iout, 1));
+		increment_unit(c->state);
+	}
+	return 0;
+}
+
+static int xts_encrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len)
+{
+	return xts_crypt(ctx, out, in, len, 0);
+}
+
+static int xts_decrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len)
+{
+	return xts_crypt(ctx, out, in, len, 1);
+}
+
+// Encrypt the single block ctr with the ctr() socket.
+static int encrypt_counter(struct linuxmode *c, uint8_t *out,
+		const uint8_t *ctr)
+{
+	const struct af_alg_op op = { ctr, BLKSIZE, 0, 0, 0 };
+	const struct iovec iin = { (void *)zero, BLKSIZE };
+	const struct iovec iout = { out, BLKSIZE };
+
+	return af_alg_crypt(&c->ctralg, &op, &iin, 1, &iout, 1);
+}
+
+/* Set up the sockets for streaming GCM.  GHASH is keyed with H, the encryption
+ * of the zero block, which the kernel only allows before the first accept.
+ */
+static int gcm_open_stream(struct linuxmode *c)
+{
+	uint8_t h[BLKSIZE];
+	int res;
+
+	memset(h, 0, sizeof(h));
+	RETFAIL(open_alg(c->algo, &c->ctralg, "skcipher", "ctr", NULL, 0, 0));
+	if (!(res = encrypt_counter(c, h, h)))
+		res = af_alg_open_keyed(&c->ghash, "hash", NULL, "ghash", h,
+				sizeof(h), 0);
+	memset(h, 0, sizeof(h));
+	if (res)
+		af_alg_close(&c->ctralg);
+	return res;
+}
+
+// Pad what has been hashed so far, len bytes, out to a whole block.
+static int ghash_pad(struct linuxmode *c, size_t len)
+{
+	const size_t pad = (BLKSIZE - len % BLKSIZE) % BLKSIZE;
+
+	return pad ? af_alg_hash_update(&c->ghash, zero, pad) : 0;
+}
+
+static int gcm_start(struct linuxmode *c)
+{
+	uint8_t j0[BLKSIZE];
+
+	if (c->alg.fd < 0 || !c->iv)
+		return -DREW_ERR_MORE_INFO;
+	if (c->ghash.fd < 0)
+		RETFAIL(gcm_open_stream(c));
+
+	c->streaming = true;
+	if (c->ivlen == 12) {
+		memcpy(j0, c->iv, 12);
+		E::Convert<uint32_t>(j0+12, 1);
+	}
+	else {
+		uint8_t lenbuf[BLKSIZE];
+
+		memset(lenbuf, 0, 8);
+		E::Convert<uint64_t>(lenbuf+8, uint64_t(c->ivlen) << 3);
+		RETFAIL(af_alg_hash_update(&c->ghash, c->iv, c->ivlen));
+		RETFAIL(ghash_pad(c, c->ivlen));
+		RETFAIL(af_alg_hash_final(&c->ghash, j0, BLKSIZE, lenbuf,
+					sizeof(lenbuf)));
+	}
+	RETFAIL(encrypt_counter(c, c->ekj0, j0));
+	memcpy(c->state, j0, BLKSIZE);
+	add_counter(c->state+12, 4, 1);
+
+	if (c->alen)
+		RETFAIL(af_alg_hash_update(&c->ghash, c->aad, c->alen));
+	RETFAIL(ghash_pad(c, c->alen));
+	c->clen = 0;
+	c->boff = 0;
+	return 0;
+}
+
+/* Process part of a streamed message.  When decrypting, out may be in, so the
+ * ciphertext is hashed first.
+ */
+static int gcm_crypt(struct linuxmode *c, uint8_t *out, const uint8_t *in,
+		size_t len, bool decrypt)
+{
+	if (!c->streaming)
+		RETFAIL(gcm_start(c));
+	if (!len)
+		return 0;
+	c->clen += len;
+	if (decrypt)
+		RETFAIL(af_alg_hash_update(&c->ghash, in, len));
+	RETFAIL(ctr_crypt(c, &c->ctralg, out, in, len, true));
+	return decrypt ? 0 : af_alg_hash_update(&c->ghash, out, len);
+}
+
+static int gcm_encrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len)
+{
+	return gcm_crypt((struct linuxmode *)ctx->ctx, out, in, len, false);
+}
+
+static int gcm_decrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len)
+{
+	return gcm_crypt((struct linuxmode *)ctx->ctx, out, in, len, true);
+}
+
+// Finish a streamed message, leaving the full-length tag in tag.
+static int gcm_tag(struct linuxmode *c, uint8_t *tag)
+{
+	uint8_t buf[2*BLKSIZE];
+	const size_t pad = (BLKSIZE - c->clen % BLKSIZE) % BLKSIZE;
+
+	if (!c->streaming)
+		RETFAIL(gcm_start(c));
+
+	memset(buf, 0, pad);
+	E::Convert<uint64_t>(buf+pad, uint64_t(c->alen) << 3);
+	E::Convert<uint64_t>(buf+pad+8, uint64_t(c->clen) << 3);
+	RETFAIL(af_alg_hash_final(&c->ghash, tag, BLKSIZE, buf, pad+BLKSIZE));
+	c->streaming = false;
+	xor_buffers2(tag, c->ekj0, BLKSIZE);
+	return 0;
+}
+
+/* Whether a whole message can be handed to the kernel's gcm() in one request,
+ * which only takes a 96-bit IV.
+ */
+static bool gcm_oneshot(const struct linuxmode *c, size_t len)
+{
+	return !c->streaming && c->ivlen == 12 &&
+		c->alen + len + c->taglen <= AF_ALG_MAX_REQUEST;
+}
+
+static int gcm_encryptfinal(struct linuxmode *c, uint8_t *out, size_t outlen,
+		const uint8_t *in, size_t inlen)
+{
+	uint8_t tag[BLKSIZE];
+
+	if (outlen < inlen + c->taglen)
+		return -DREW_ERR_MORE_INFO;
+	if (c->alg.fd < 0 || !c->iv)
+		return -DREW_ERR_MORE_INFO;
+
+	if (gcm_oneshot(c, inlen)) {
+		const struct af_alg_op op = { c->iv, c->ivlen, c->alen, 0, 1 };
+		// The associated data is copied to the output too.
+		const struct iovec iin[2] = {
+			{ c->aad, c->alen }, { (void *)in, inlen }
+		};
+		const struct iovec iout[2] = {
+			{ c->aad, c->alen }, { out, inlen + c->taglen }
+		};
+		RETFAIL(af_alg_crypt(&c->alg, &op, iin, 2, iout, 2));
+		return outlen;
+	}
+
+	RETFAIL(gcm_crypt(c, out, in, inlen, false));
+	RETFAIL(gcm_tag(c, tag));
+	memcpy(out+inlen, tag, c->taglen);
+	return outlen;
+}
+
+static int gcm_decryptfinal(struct linuxmode *c, uint8_t *out, size_t outlen,
+		const uint8_t *in, size_t inlen)
+{
+	uint8_t tag[BLKSIZE];
+	int res;
+
+	if (inlen < outlen + c->taglen)
+		return -DREW_ERR_INVALID;
+	if (c->alg.fd < 0 || !c->iv)
+		return -DREW_ERR_MORE_INFO;
+
+	if (gcm_oneshot(c, outlen)) {
+		const struct af_alg_op op = { c->iv, c->ivlen, c->alen, 1, 1 };
+		const struct iovec iin[2] = {
+			{ c->aad, c->alen }, { (void *)in, outlen + c->taglen }
+		};
+		const struct iovec iout[2] = {
+			{ c->aad, c->alen }, { out, outlen }
+		};
+		res = af_alg_crypt(&c->alg, &op, iin, 2, iout, 2);
+		if (res == -EBADMSG)
+			return -DREW_ERR_VERIFY_FAILED;
+		return res ? res : outlen;
+	}
+
+	RETFAIL(gcm_crypt(c, out, in, outlen, true));
+	RETFAIL(gcm_tag(c, tag));
+	return memcmp(in+outlen, tag, c->taglen) ?
+		-DREW_ERR_VERIFY_FAILED : outlen;
+}
+
+static int linux_encryptfinal(drew_mode_t *ctx, uint8_t *out, size_t outlen,
+		const uint8_t *in, size_t inlen)
+{
+	struct linuxmode *c = (struct linuxmode *)ctx->ctx;
+
+	switch (c->type) {
+		case MODE_GCM:
+			return gcm_encryptfinal(c, out, outlen, in, inlen);
+		case MODE_XTS:
+			if (!inlen)
+				return 0;
+			break;
+	}
+	RETFAIL(ctx->functbl->encrypt(ctx, out, in, inlen));
+	return inlen;
+}
+
+static int linux_decryptfinal(drew_mode_t *ctx, uint8_t *out, size_t outlen,
+		const uint8_t *in, size_t inlen)
+{
+	struct linuxmode *c = (struct linuxmode *)ctx->ctx;
+
+	switch (c->type) {
+		case MODE_GCM:
+			return gcm_decryptfinal(c, out, outlen, in, inlen);
+		case MODE_XTS:
+			if (!inlen)
+				return 0;
+			break;
+	}
+	RETFAIL(ctx->functbl->decrypt(ctx, out, in, inlen));
+	return inlen;
+}
+
+static int linux_fini(drew_mode_t *ctx, int flags)
+{
+	struct linuxmode *c = (struct linuxmode *)ctx->ctx;
+
+	close_sockets(c);
+	free_algo(c);
+	drew_mem_sfree(c->iv);
+	drew_mem_sfree(c->aad);
+	memset(c, 0, sizeof(*c));
+
+	if (!(flags & DREW_MODE_FIXED)) {
+		drew_mem_sfree(c);
+		ctx->ctx = NULL;
+	}
+
+	return 0;
+}
+
+/* The kernel keeps the keys, so a clone gets its own request sockets from the
+ * same bound sockets.  Only the GHASH socket has state worth copying.  The
+ * block cipher is cloned first, so that if it fails nothing else of the new
+ * context needs freeing.
+ */
+static int linux_clone(drew_mode_t *newctx, const drew_mode_t *oldctx,
+		int flags)
+{
+	struct linuxmode *c = (struct linuxmode *)oldctx->ctx, *cn;
+	int res = 0;
+
+	if (!(flags & DREW_MODE_FIXED))
+		newctx->ctx = drew_mem_smalloc(sizeof(struct linuxmode));
+	cn = (struct linuxmode *)newctx->ctx;
+	memcpy(cn, c, sizeof(*cn));
+	if (c->algo) {
+		cn->algo = (drew_block_t *)drew_mem_malloc(sizeof(*cn->algo));
+		if (!cn->algo)
+			res = -ENOMEM;
+		else {
+			cn->algo->functbl = c->algo->functbl;
+			res = c->algo->functbl->clone(cn->algo, c->algo, 0);
+			if (res)
+				drew_mem_free(cn->algo);
+		}
+		if (res) {
+			memset(cn, 0, sizeof(*cn));
+			if (!(flags & DREW_MODE_FIXED)) {
+				drew_mem_sfree(cn);
+				newctx->ctx = NULL;
+			}
+			return res;
+		}
+	}
+	newctx->functbl = oldctx->functbl;
+	if (c->iv)
+		cn->iv = (uint8_t *)drew_mem_smemdup(c->iv, c->ivlen);
+	if (c->aad)
+		cn->aad = (uint8_t *)drew_mem_smemdup(c->aad, c->alen);
+
+	af_alg_initialize(&cn->alg);
+	af_alg_initialize(&cn->ctralg);
+	af_alg_initialize(&cn->ghash);
+	RETFAIL(af_alg_clone_socket(&cn->alg, &c->alg, 0));
+	RETFAIL(af_alg_clone_socket(&cn->ctralg, &c->ctralg, 0));
+	return af_alg_clone_socket(&cn->ghash, &c->ghash, c->streaming);
+}
+
+/* Find an AES128 implementation that runs in the kernel, keyed with key.  The
+ * software implementations are skipped, since the modes can't use them.
+ */
+static int get_block(DrewLoader *ldr, drew_block_t *algo, const uint8_t *key,
+		size_t keysz)
+{
+	const void *tmp;
+	int res;
+
+	for (int id = 0; (id = drew_loader_lookup_by_name(ldr, "AES128", id,
+					-1)) >= 0; id++) {
+		drew_loader_get_functbl(ldr, id, &tmp);
+		algo->functbl = (const drew_block_functbl_t *)tmp;
+		if (algo->functbl->init(algo, 0, ldr, NULL))
+			continue;
+		res = algo->functbl->setkey(algo, key, keysz,
+				DREW_BLOCK_MODE_BOTH);
+		if (!res)
+			res = open_alg(algo, NULL, NULL, NULL, NULL, 0, 0);
+		if (!res)
+			return 0;
+		algo->functbl->fini(algo, 0);
+	}
+	return -DREW_ERR_NOT_IMPL;
+}
+
+struct test {
+	const uint8_t *key;
+	const uint8_t *iv;
+	const uint8_t *input;
+	const uint8_t *output;
+	size_t datasz;
+};
+
+/* Encrypt and decrypt in one call and then in pieces of 9 bytes (or the block
+ * size for CBC), which exercises the leftover keystream in CTR.
+ */
+static int test_generic(DrewLoader *ldr, int (*initf)(drew_mode_t *, int,
+			DrewLoader *, const drew_param_t *),
+		const struct test *t, size_t piece)
+{
+	drew_block_t algo;
+	drew_mode_t c;
+	uint8_t buf[64];
+	int result = 0;
+
+	RETFAIL(get_block(ldr, &algo, t->key, 16));
+	initf(&c, 0, ldr, NULL);
+	if (linux_setblock(&c, &algo)) {
+		linux_fini(&c, 0);
+		algo.functbl->fini(&algo, 0);
+		return -DREW_ERR_NOT_IMPL;
+	}
+
+	linux_setiv(&c, t->iv, BLKSIZE);
+	c.functbl->encrypt(&c, buf, t->input, t->datasz);
+	result |= !!memcmp(buf, t->output, t->datasz);
+	result <<= 1;
+
+	linux_reset(&c);
+	c.functbl->decrypt(&c, buf, buf, t->datasz);
+	result |= !!memcmp(buf, t->input, t->datasz);
+	result <<= 1;
+
+	linux_reset(&c);
+	for (size_t i = 0; i < t->datasz; i += piece)
+		c.functbl->encrypt(&c, buf+i, t->input+i,
+				std::min(piece, t->datasz - i));
+	result |= !!memcmp(buf, t->output, t->datasz);
+
+	linux_fini(&c, 0);
+	algo.functbl->fini(&algo, 0);
+	return result;
+}
+
+// From NIST SP 800-38A.
+static const uint8_t sp800_38a_key[] = {
+	0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+	0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+static const uint8_t sp800_38a_pt[] = {
+	0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96,
+	0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+	0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c,
+	0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+	0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11,
+	0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+	0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17,
+	0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+};
+
+static int cbc_test(void *p, DrewLoader *ldr)
+{
+	// F.2.1.
+	const struct test t = {
+		sp800_38a_key,
+		(const uint8_t *)
+			"\x00\x01\x02\x03\x04\x05\x06\x07"
+			"\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f",
+		sp800_38a_pt,
+		(const uint8_t *)
+			"\x76\x49\xab\xac\x81\x19\xb2\x46"
+			"\xce\xe9\x8e\x9b\x12\xe9\x19\x7d"
+			"\x50\x86\xcb\x9b\x50\x72\x19\xee"
+			"\x95\xdb\x11\x3a\x91\x76\x78\xb2"
+			"\x73\xbe\xd6\xb8\xe3\xc1\x74\x3b"
+			"\x71\x16\xe6\x9e\x22\x22\x95\x16"
+			"\x3f\xf1\xca\xa1\x68\x1f\xac\x09"
+			"\x12\x0e\xca\x30\x75\x86\xe1\xa7",
+		64
+	};
+
+	if (!ldr)
+		return -DREW_ERR_INVALID;
+
+	return test_generic(ldr, cbc_init, &t, BLKSIZE);
+}
+
+static int ctr_test(void *p, DrewLoader *ldr)
+{
+	// F.5.1.
+	const struct test t = {
+		sp800_38a_key,
+		(const uint8_t *)
+			"\xf0\xf1\xf2\xf3\xf4\xf5\xf6\xf7"
+			"\xf8\xf9\xfa\xfb\xfc\xfd\xfe\xff",
+		sp800_38a_pt,
+		(const uint8_t *)
+			"\x87\x4d\x61\x91\xb6\x20\xe3\x26"
+			"\x1b\xef\x68\x64\x99\x0d\xb6\xce"
+			"\x98\x06\xf6\x6b\x79\x70\xfd\xff"
+			"\x86\x17\x18\x7b\xb9\xff\xfd\xff"
+			"\x5a\xe4\xdf\x3e\xdb\xd5\xd3\x5e"
+			"\x5b\x4f\x09\x02\x0d\xb0\x3e\xab"
+			"\x1e\x03\x1d\xda\x2f\xbe\x03\xd1"
+			"\x79\x21\x70\xa0\xf3\x00\x9c\xee",
+		64
+	};
+
+	if (!ldr)
+		return -DREW_ERR_INVALID;
+
+	return test_generic(ldr, ctr_init, &t, 9);
+}
+
+struct xts_test {
+	const uint8_t *key;
+	const uint8_t *tweakkey;
+	const uint8_t *unit;
+	const uint8_t *input;
+	const uint8_t *output;
+	size_t datasz;
+};
+
+static int xts_test(void *p, DrewLoader *ldr)
+{
+	// From IEEE 1619-2007, vectors 2 and 15.
+	const struct xts_test testdata[] = {
+		{
+			(const uint8_t *)
+				"\x11\x11\x11\x11\x11\x11\x11\x11"
+				"\x11\x11\x11\x11\x11\x11\x11\x11",
+			(const uint8_t *)
+				"\x22\x22\x22\x22\x22\x22\x22\x22"
+				"\x22\x22\x22\x22\x22\x22\x22\x22",
+			(const uint8_t *)
+				"\x33\x33\x33\x33\x33\x00\x00\x00"
+				"\x00\x00\x00\x00\x00\x00\x00\x00",
+			(const uint8_t *)
+				"\x44\x44\x44\x44\x44\x44\x44\x44"
+				"\x44\x44\x44\x44\x44\x44\x44\x44"
+				"\x44\x44\x44\x44\x44\x44\x44\x44"
+				"\x44\x44\x44\x44\x44\x44\x44\x44",
+			(const uint8_t *)
+				"\xc4\x54\x18\x5e\x6a\x16\x93\x6e"
+				"\x39\x33\x40\x38\xac\xef\x83\x8b"
+				"\xfb\x18\x6f\xff\x74\x80\xad\xc4"
+				"\x28\x93\x82\xec\xd6\xd3\x94\xf0",
+			32
+		},
+		{
+			(const uint8_t *)
+				"\xff\xfe\xfd\xfc\xfb\xfa\xf9\xf8"
+				"\xf7\xf6\xf5\xf4\xf3\xf2\xf1\xf0",
+			(const uint8_t *)
+				"\xbf\xbe\xbd\xbc\xbb\xba\xb9\xb8"
+				"\xb7\xb6\xb5\xb4\xb3\xb2\xb1\xb0",
+			(const uint8_t *)
+				"\x9a\x78\x56\x34\x12\x00\x00\x00"
+				"\x00\x00\x00\x00\x00\x00\x00\x00",
+			(const uint8_t *)
+				"\x00\x01\x02\x03\x04\x05\x06\x07"
+				"\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f"
+				"\x10",
+			(const uint8_t *)
+				"\x6c\x16\x25\xdb\x46\x71\x52\x2d"
+				"\x3d\x75\x99\x60\x1d\xe7\xca\x09"
+				"\xed",
+			17
+		}
+	};
+	int result = 0;
+
+	if (!ldr)
+		return -DREW_ERR_INVALID;
+
+	for (size_t i = 0; i < DIM(testdata); i++) {
+		const struct xts_test *t = testdata + i;
+		drew_block_t algo;
+		drew_mode_t c;
+		uint8_t buf[32];
+
+		RETFAIL(get_block(ldr, &algo, t->key, 16));
+		xts_init(&c, 0, ldr, NULL);
+		if (linux_setblock(&c, &algo) ||
+				linux_setdata(&c, t->tweakkey, 16)) {
+			linux_fini(&c, 0);
+			algo.functbl->fini(&algo, 0);
+			return -DREW_ERR_NOT_IMPL;
+		}
+
+		result <<= 1;
+		linux_setiv(&c, t->unit, BLKSIZE);
+		xts_encrypt(&c, buf, t->input, t->datasz);
+		result |= !!memcmp(buf, t->output, t->datasz);
+
+		result <<= 1;
+		linux_reset(&c);
+		xts_decrypt(&c, buf, buf, t->datasz);
+		result |= !!memcmp(buf, t->input, t->datasz);
+
+		linux_fini(&c, 0);
+		algo.functbl->fini(&algo, 0);
+	}
+
+	return result;
+}
+
+struct gcm_test {
+	const uint8_t *iv;
+	size_t ivsz;
+	const uint8_t *output;
+};
+
+/* Run a test case through the kernel's gcm() with the whole message and then
+ * through the streaming path in pieces of 9 bytes, and check that a damaged
+ * tag is rejected.
+ */
+static int gcm_test_one(DrewLoader *ldr, const uint8_t *key,
+		const uint8_t *aad, size_t aadsz, const uint8_t *input,
+		size_t insz, const struct gcm_test *t)
+{
+	drew_block_t algo;
+	drew_mode_t c;
+	uint8_t buf[128];
+	int result = 0;
+
+	RETFAIL(get_block(ldr, &algo, key, 16));
+	gcm_init(&c, 0, ldr, NULL);
+	if (linux_setblock(&c, &algo)) {
+		linux_fini(&c, 0);
+		algo.functbl->fini(&algo, 0);
+		return -DREW_ERR_NOT_IMPL;
+	}
+
+	memset(buf, 0, sizeof(buf));
+	linux_setiv(&c, t->iv, t->ivsz);
+	linux_setdata(&c, aad, aadsz);
+	linux_encryptfinal(&c, buf, insz + BLKSIZE, input, insz);
+	result |= !!memcmp(buf, t->output, insz + BLKSIZE);
+	result <<= 1;
+
+	memset(buf, 0, sizeof(buf));
+	linux_reset(&c);
+	linux_setdata(&c, aad, aadsz);
+	result |= linux_decryptfinal(&c, buf, insz, t->output,
+			insz + BLKSIZE) < 0;
+	result |= !!memcmp(buf, input, insz);
+	result <<= 1;
+
+	memset(buf, 0, sizeof(buf));
+	linux_reset(&c);
+	linux_setdata(&c, aad, aadsz);
+	for (size_t j = 0; j < insz; j += 9)
+		gcm_encrypt(&c, buf+j, input+j, std::min<size_t>(9, insz - j));
+	linux_encryptfinal(&c, buf+insz, BLKSIZE, NULL, 0);
+	result |= !!memcmp(buf, t->output, insz + BLKSIZE);
+	result <<= 1;
+
+	memset(buf, 0, sizeof(buf));
+	linux_reset(&c);
+	linux_setdata(&c, aad, aadsz);
+	for (size_t j = 0; j < insz; j += 9)
+		gcm_decrypt(&c, buf+j, t->output+j,
+				std::min<size_t>(9, insz - j));
+	result |= linux_decryptfinal(&c, NULL, 0, t->output+insz, BLKSIZE) < 0;
+	result |= !!memcmp(buf, input, insz);
+	result <<= 1;
+
+	memcpy(buf, t->output, insz + BLKSIZE);
+	buf[insz] ^= 0x01;
+	linux_reset(&c);
+	linux_setdata(&c, aad, aadsz);
+	result |= linux_decryptfinal(&c, buf, insz, buf, insz + BLKSIZE) !=
+		-DREW_ERR_VERIFY_FAILED;
+
+	linux_fini(&c, 0);
+	algo.functbl->fini(&algo, 0);
+	return result;
+}
+
+static int gcm_test(void *p, DrewLoader *ldr)
+{
+	// Test cases 4 and 6 from the GCM specification.
+	const uint8_t *key = (const uint8_t *)"\xfe\xff\xe9\x92\x86\x65\x73\x1c"
+		"\x6d\x6a\x8f\x94\x67\x30\x83\x08";
+	const uint8_t *input = (const uint8_t *)"\xd9\x31\x32\x25\xf8\x84\x06\xe5"
+		"\xa5\x59\x09\xc5\xaf\xf5\x26\x9a"
+		"\x86\xa7\xa9\x53\x15\x34\xf7\xda"
+		"\x2e\x4c\x30\x3d\x8a\x31\x8a\x72"
+		"\x1c\x3c\x0c\x95\x95\x68\x09\x53"
+		"\x2f\xcf\x0e\x24\x49\xa6\xb5\x25"
+		"\xb1\x6a\xed\xf5\xaa\x0d\xe6\x57"
+		"\xba\x63\x7b\x39";
+	const uint8_t *aad = (const uint8_t *)"\xfe\xed\xfa\xce\xde\xad\xbe\xef"
+		"\xfe\xed\xfa\xce\xde\xad\xbe\xef"
+		"\xab\xad\xda\xd2";
+	const struct gcm_test testdata[] = {
+		{
+			(const uint8_t *)"\xca\xfe\xba\xbe\xfa\xce\xdb\xad\xde\xca\xf8\x88",
+			12,
+			(const uint8_t *)
+				"\x42\x83\x1e\xc2\x21\x77\x74\x24"
+				"\x4b\x72\x21\xb7\x84\xd0\xd4\x9c"
+				"\xe3\xaa\x21\x2f\x2c\x02\xa4\xe0"
+				"\x35\xc1\x7e\x23\x29\xac\xa1\x2e"
+				"\x21\xd5\x14\xb2\x54\x66\x93\x1c"
+				"\x7d\x8f\x6a\x5a\xac\x84\xaa\x05"
+				"\x1b\xa3\x0b\x39\x6a\x0a\xac\x97"
+				"\x3d\x58\xe0\x91\x5b\xc9\x4f\xbc"
+				"\x32\x21\xa5\xdb\x94\xfa\xe9\x5a"
+				"\xe7\x12\x1a\x47"
+		},
+		{
+			(const uint8_t *)
+				"\x93\x13\x22\x5d\xf8\x84\x06\xe5"
+				"\x55\x90\x9c\x5a\xff\x52\x69\xaa"
+				"\x6a\x7a\x95\x38\x53\x4f\x7d\xa1"
+				"\xe4\xc3\x03\xd2\xa3\x18\xa7\x28"
+				"\xc3\xc0\xc9\x51\x56\x80\x95\x39"
+				"\xfc\xf0\xe2\x42\x9a\x6b\x52\x54"
+				"\x16\xae\xdb\xf5\xa0\xde\x6a\x57"
+				"\xa6\x37\xb3\x9b",
+			60,
+			(const uint8_t *)
+				"\x8c\xe2\x49\x98\x62\x56\x15\xb6"
+				"\x03\xa0\x33\xac\xa1\x3f\xb8\x94"
+				"\xbe\x91\x12\xa5\xc3\xa2\x11\xa8"
+				"\xba\x26\x2a\x3c\xca\x7e\x2c\xa7"
+				"\x01\xe4\xa9\xa4\xfb\xa4\x3c\x90"
+				"\xcc\xdc\xb2\x81\xd4\x8c\x7c\x6f"
+				"\xd6\x28\x75\xd2\xac\xa4\x17\x03"
+				"\x4c\x34\xae\xe5\x61\x9c\xc5\xae"
+				"\xff\xfe\x0b\xfa\x46\x2a\xf4\x3c"
+				"\x16\x99\xd0\x50"
+		}
+	};
+	int result = 0, tres;
+
+	if (!ldr)
+		return -DREW_ERR_INVALID;
+
+	for (size_t i = 0; i < DIM(testdata); i++) {
+		if ((tres = gcm_test_one(ldr, key, aad, 20, input, 60,
+						testdata + i)) < 0)
+			return tres;
+		result <<= 5;
+		result |= tres;
+	}
+
+	return result;
+}
+
+struct plugin {
+	const char *name;
+	const drew_mode_functbl_t *functbl;
+};
+
+static struct plugin plugin_data[] = {
+	{ "CBC-kernel", &cbc_functbl },
+	{ "CTR-kernel", &ctr_functbl },
+	{ "XTS-kernel", &xts_functbl },
+	{ "GCM-kernel", &gcm_functbl }
+};
+
+EXPORT()
+extern "C"
+int DREW_PLUGIN_NAME(linuxmode)(void *ldr, int op, int id, void *p)
+{
+	int nplugins = af_alg_available() ? DIM(plugin_data) : 0;
+
+	if (id < 0 || id >= nplugins) {
+		if (!id && !nplugins && op == DREW_LOADER_GET_NPLUGINS)
+			return 0;
+		else
+			return -DREW_ERR_INVALID;
+	}
+
+	switch (op) {
+		case DREW_LOADER_LOOKUP_NAME:
+			return 0;
+		case DREW_LOADER_GET_NPLUGINS:
+			return nplugins;
+		case DREW_LOADER_GET_TYPE:
+			return DREW_TYPE_MODE;
+		case DREW_LOADER_GET_FUNCTBL_SIZE:
+			return sizeof(drew_mode_functbl_t);
+		case DREW_LOADER_GET_FUNCTBL:
+			memcpy(p, plugin_data[id].functbl, sizeof(drew_mode_functbl_t));
+			return 0;
+		case DREW_LOADER_GET_NAME_SIZE:
+			return strlen(plugin_data[id].name) + 1;
+		case DREW_LOADER_GET_NAME:
+			memcpy(p, plugin_data[id].name, strlen(plugin_data[id].name)+1);
+			return 0;
+		default:
+			return -DREW_ERR_INVALID;
+	}
+}
+UNEXPORT()
+UNHIDE()
+
+#endif
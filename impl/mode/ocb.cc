@@ -0,0 +1,834 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ *
+ * This file is part of the Drew Cryptography Suite.
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of your choice of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation or version 2.0 of the Apache
+ * License as published by the Apache Software Foundation.
+ *
+ * This file is distributed in the hope that it will be useful, but without
+ * any warranty; without even the implied warranty of merchantability or fitness
+ * for a particular purpose.
+ *
+ * Note that people who make modified versions of this file are not obligated to
+ * dual-license their modified versions; it is their choice whether to do so.
+ * If a modified version is not distributed under both licenses, the copyright
+ * and permission notices should be updated accordingly.
+ */
+/* This implements OCB as specified in RFC 7253 (OCB3).
+ *
+ * The interface is the same as that of GCM: the nonce (1 to 15 bytes) is
+ * passed to setiv, the associated data is passed in one piece to setdata, and
+ * encryptfinal and decryptfinal produce and check the tag.  Every call to
+ * encrypt or decrypt except the last must be a multiple of the block size;
+ * a partial block ends the message, after which only the final functions may
+ * be called.
+ */
+
+#include "internal.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <drew/mem.h>
+#include <drew/mode.h>
+#include <drew/block.h>
+#include <drew/plugin.h>
+
+#include "util.hh"
+
+#define DIM(x) (sizeof(x)/sizeof((x)[0]))
+
+#define BLKSIZE 16
+// The number of bytes processed per call to encryptfast.
+#define CHUNKSIZE 4096
+// L_*, L_$, and L_0 through L_63.
+#define NLVALUES (2 + 64)
+#define L_STAR 0
+#define L_DOLLAR 1
+#define L_(i) (2 + (i))
+
+struct ocb {
+	DrewLoader *ldr;
+	drew_block_t *algo;
+	// The L values as 64-bit words in memory order, so they can be XORed
+	// directly into the offset.
+	uint64_t *l;
+	uint64_t offset[2];
+	uint64_t checksum[2];
+	uint64_t hash[2];
+	uint64_t nblocks;
+	uint8_t nonce[BLKSIZE];
+	uint8_t ktopnonce[BLKSIZE];
+	uint8_t ktop[BLKSIZE];
+	size_t noncelen;
+	size_t taglen;
+	bool ktopvalid;
+	bool finished;
+};
+
+extern "C" {
+static int ocb_info(int op, void *p);
+static int ocb_info2(const drew_mode_t *, int op, drew_param_t *,
+		const drew_param_t *);
+static int ocb_init(drew_mode_t *ctx, int flags, DrewLoader *ldr,
+		const drew_param_t *param);
+static int ocb_reset(drew_mode_t *ctx);
+static int ocb_resync(drew_mode_t *ctx);
+static int ocb_setblock(drew_mode_t *ctx, const drew_block_t *algoctx);
+static int ocb_setiv(drew_mode_t *ctx, const uint8_t *iv, size_t len);
+static int ocb_encrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len);
+static int ocb_decrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len);
+static int ocb_encryptfast(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len);
+static int ocb_decryptfast(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len);
+static int ocb_fini(drew_mode_t *ctx, int flags);
+static int ocb_test(void *p, DrewLoader *ldr);
+static int ocb_clone(drew_mode_t *newctx, const drew_mode_t *oldctx, int flags);
+static int ocb_setdata(drew_mode_t *, const uint8_t *, size_t);
+static int ocb_encryptfinal(drew_mode_t *ctx, uint8_t *out, size_t outlen,
+		const uint8_t *in, size_t inlen);
+static int ocb_decryptfinal(drew_mode_t *ctx, uint8_t *out, size_t outlen,
+		const uint8_t *in, size_t inlen);
+}
+
+static const drew_mode_functbl_t ocb_functbl = {
+	ocb_info, ocb_info2, ocb_init, ocb_clone, ocb_reset, ocb_fini,
+	ocb_setblock, ocb_setiv, ocb_encrypt, ocb_decrypt,
+	ocb_encryptfast, ocb_decryptfast, ocb_setdata,
+	ocb_encryptfinal, ocb_decryptfinal, ocb_resync, ocb_test
+};
+
+typedef BigEndian E;
+
+static int ocb_info(int op, void *p)
+{
+	switch (op) {
+		case DREW_MODE_VERSION:
+			return CURRENT_ABI;
+		case DREW_MODE_INTSIZE:
+			return sizeof(struct ocb);
+		case DREW_MODE_FINAL_INSIZE:
+		case DREW_MODE_FINAL_OUTSIZE:
+			return 16;
+		case DREW_MODE_QUANTUM:
+			return BLKSIZE;
+		default:
+			return -DREW_ERR_INVALID;
+	}
+}
+
+static int ocb_info2(const drew_mode_t *ctx, int op, drew_param_t *out,
+		const drew_param_t *in)
+{
+	switch (op) {
+		case DREW_MODE_VERSION:
+			return CURRENT_ABI;
+		case DREW_MODE_INTSIZE:
+			return sizeof(struct ocb);
+		case DREW_MODE_FINAL_INSIZE_CTX:
+		case DREW_MODE_FINAL_OUTSIZE_CTX:
+			if (ctx && ctx->ctx) {
+				const struct ocb *c = (const struct ocb *)ctx->ctx;
+				return c->taglen;
+			}
+			return -DREW_ERR_MORE_INFO;
+		case DREW_MODE_BLKSIZE_CTX:
+			return BLKSIZE;
+		default:
+			return -DREW_ERR_INVALID;
+	}
+}
+
+static int ocb_init(drew_mode_t *ctx, int flags, DrewLoader *ldr,
+		const drew_param_t *param)
+{
+	struct ocb *newctx = (struct ocb *)ctx->ctx;
+	size_t taglen = 16;
+
+	for (; param; param = param->next)
+		if (!strcmp(param->name, "tagLength"))
+			taglen = param->param.number;
+
+	if (!taglen || taglen > BLKSIZE)
+		return -DREW_ERR_INVALID;
+
+	if (!(flags & DREW_MODE_FIXED))
+		newctx = (struct ocb *)drew_mem_smalloc(sizeof(*newctx));
+	memset(newctx, 0, sizeof(*newctx));
+	newctx->l = (uint64_t *)drew_mem_smalloc(NLVALUES * BLKSIZE);
+	if (!newctx->l) {
+		if (!(flags & DREW_MODE_FIXED))
+			drew_mem_sfree(newctx);
+		return -ENOMEM;
+	}
+	newctx->ldr = ldr;
+	newctx->algo = NULL;
+	newctx->taglen = taglen;
+
+	ctx->ctx = newctx;
+	ctx->functbl = &ocb_functbl;
+
+	return 0;
+}
+
+static void free_block(drew_block_t *algo)
+{
+	if (algo) {
+		algo->functbl->fini(algo, 0);
+		drew_mem_free(algo);
+	}
+}
+
+/* Double a block in GF(2^128), treating it as a big-endian integer. */
+static inline void dbl(uint8_t *out, const uint8_t *in)
+{
+	uint64_t hi = E::Convert<uint64_t>(in), lo = E::Convert<uint64_t>(in+8);
+	const uint64_t carry = -(hi >> 63) & 0x87;
+
+	hi = (hi << 1) | (lo >> 63);
+	lo = (lo << 1) ^ carry;
+	E::Convert(out, hi);
+	E::Convert(out+8, lo);
+}
+
+static int ocb_setblock(drew_mode_t *ctx, const drew_block_t *algoctx)
+{
+	struct ocb *c = (struct ocb *)ctx->ctx;
+	uint8_t *l = (uint8_t *)c->l;
+
+	if (!algoctx)
+		return -DREW_ERR_INVALID;
+
+	// The doubling and the nonce stretching are only defined for 128-bit
+	// blocks.
+	if (algoctx->functbl->info(DREW_BLOCK_BLKSIZE, NULL) != BLKSIZE)
+		return -DREW_ERR_INVALID;
+
+	free_block(c->algo);
+	c->algo = (drew_block_t *)drew_mem_malloc(sizeof(*c->algo));
+	c->algo->functbl = algoctx->functbl;
+	c->algo->functbl->clone(c->algo, algoctx, 0);
+
+	memset(l, 0, BLKSIZE);
+	c->algo->functbl->encrypt(c->algo, l, l);
+	for (size_t i = 1; i < NLVALUES; i++)
+		dbl(l + i*BLKSIZE, l + (i-1)*BLKSIZE);
+	c->ktopvalid = false;
+
+	return 0;
+}
+
+static inline void xor_l(uint64_t *x, const struct ocb *c, size_t i)
+{
+	x[0] ^= c->l[2*i];
+	x[1] ^= c->l[2*i+1];
+}
+
+static inline void xor_block(uint64_t *x, const uint8_t *p)
+{
+	uint64_t t[2];
+
+	memcpy(t, p, sizeof(t));
+	x[0] ^= t[0];
+	x[1] ^= t[1];
+}
+
+static inline size_t ntz(uint64_t i)
+{
+	return __builtin_ctzll(i);
+}
+
+static int ocb_setiv(drew_mode_t *ctx, const uint8_t *iv, size_t len)
+{
+	struct ocb *c = (struct ocb *)ctx->ctx;
+	uint8_t nonce[BLKSIZE], stretch[BLKSIZE+8], off[BLKSIZE];
+	size_t bottom, shift, bits;
+
+	if (!c->algo)
+		return -DREW_ERR_MORE_INFO;
+	if (!len || len >= BLKSIZE)
+		return -DREW_ERR_INVALID;
+
+	if (iv != c->nonce)
+		memcpy(c->nonce, iv, len);
+	c->noncelen = len;
+
+	memset(nonce, 0, sizeof(nonce));
+	nonce[0] = ((c->taglen * 8) % 128) << 1;
+	nonce[BLKSIZE-1-len] |= 1;
+	memcpy(nonce+BLKSIZE-len, iv, len);
+	bottom = nonce[BLKSIZE-1] & 0x3f;
+	nonce[BLKSIZE-1] &= 0xc0;
+
+	// Nonces which differ only in their low six bits share Ktop, so a counter
+	// nonce costs one block encryption every 64 messages.
+	if (!c->ktopvalid || memcmp(nonce, c->ktopnonce, BLKSIZE)) {
+		memcpy(c->ktopnonce, nonce, BLKSIZE);
+		c->algo->functbl->encrypt(c->algo, c->ktop, nonce);
+		c->ktopvalid = true;
+	}
+
+	memcpy(stretch, c->ktop, BLKSIZE);
+	for (size_t i = 0; i < 8; i++)
+		stretch[BLKSIZE+i] = c->ktop[i] ^ c->ktop[i+1];
+
+	shift = bottom / 8;
+	bits = bottom % 8;
+	for (size_t i = 0; i < BLKSIZE; i++)
+		off[i] = (stretch[i+shift] << bits) |
+			(bits ? stretch[i+shift+1] >> (8-bits) : 0);
+	memcpy(c->offset, off, sizeof(c->offset));
+
+	memset(c->checksum, 0, sizeof(c->checksum));
+	memset(c->hash, 0, sizeof(c->hash));
+	c->nblocks = 0;
+	c->finished = false;
+
+	return 0;
+}
+
+static int ocb_reset(drew_mode_t *ctx)
+{
+	struct ocb *c = (struct ocb *)ctx->ctx;
+
+	if (!c->noncelen)
+		return 0;
+	return ocb_setiv(ctx, c->nonce, c->noncelen);
+}
+
+static int ocb_resync(drew_mode_t *ctx)
+{
+	return -DREW_ERR_NOT_IMPL;
+}
+
+/* Store the offsets for the next n blocks into buf, starting from the block
+ * after block number *i, and leave off as the last of them.
+ */
+static inline void fill_offsets(const struct ocb *c, uint8_t *buf,
+		uint64_t *off, uint64_t *i, size_t n)
+{
+	for (size_t j = 0; j < n; j++, buf += BLKSIZE) {
+		xor_l(off, c, L_(ntz(++*i)));
+		memcpy(buf, off, BLKSIZE);
+	}
+}
+
+static inline void sum_blocks(uint64_t *sum, const uint8_t *p, size_t n)
+{
+	for (size_t j = 0; j < n; j++, p += BLKSIZE)
+		xor_block(sum, p);
+}
+
+/* The associated data is hashed in one piece, like GCM. */
+static int ocb_setdata(drew_mode_t *ctx, const uint8_t *data, size_t len)
+{
+	struct ocb *c = (struct ocb *)ctx->ctx;
+	const drew_block_t *algo = c->algo;
+	uint8_t offs[CHUNKSIZE] ALIGNED_T, buf[CHUNKSIZE] ALIGNED_T;
+	uint64_t off[2] = {0, 0}, i = 0;
+	size_t nblocks = len / BLKSIZE;
+	const size_t rem = len % BLKSIZE;
+
+	if (!algo)
+		return -DREW_ERR_MORE_INFO;
+
+	memset(c->hash, 0, sizeof(c->hash));
+	while (nblocks) {
+		const size_t n = std::min<size_t>(nblocks, CHUNKSIZE / BLKSIZE);
+		const size_t nbytes = n * BLKSIZE;
+
+		fill_offsets(c, offs, off, &i, n);
+		xor_buffers(buf, data, offs, nbytes);
+		algo->functbl->encryptfast(algo, buf, buf, n);
+		sum_blocks(c->hash, buf, n);
+
+		nblocks -= n;
+		data += nbytes;
+	}
+
+	if (rem) {
+		xor_l(off, c, L_STAR);
+		memcpy(buf, off, BLKSIZE);
+		xor_buffers(buf, buf, data, rem);
+		buf[rem] ^= 0x80;
+		algo->functbl->encrypt(algo, buf, buf);
+		xor_block(c->hash, buf);
+	}
+
+	return 0;
+}
+
+/* Process len bytes.  The whole blocks are processed in chunks through
+ * encryptfast or decryptfast; a partial block at the end is the final block of
+ * the message.  If aligned is true, in and out are suitably aligned for the
+ * aligned XOR routines.
+ */
+template<bool Aligned>
+static int crypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len, bool enc)
+{
+	struct ocb *c = (struct ocb *)ctx->ctx;
+	const drew_block_t *algo = c->algo;
+	uint8_t offs[CHUNKSIZE] ALIGNED_T, buf[CHUNKSIZE] ALIGNED_T;
+	size_t nblocks = len / BLKSIZE;
+	const size_t rem = len % BLKSIZE;
+
+	if (!algo || !c->noncelen)
+		return -DREW_ERR_MORE_INFO;
+	if (c->finished && len)
+		return -DREW_ERR_INVALID;
+
+	while (nblocks) {
+		const size_t n = std::min<size_t>(nblocks, CHUNKSIZE / BLKSIZE);
+		const size_t nbytes = n * BLKSIZE;
+
+		fill_offsets(c, offs, c->offset, &c->nblocks, n);
+		if (enc)
+			sum_blocks(c->checksum, in, n);
+		if (Aligned)
+			xor_aligned(buf, in, offs, nbytes);
+		else
+			xor_buffers(buf, in, offs, nbytes);
+		if (enc)
+			algo->functbl->encryptfast(algo, buf, buf, n);
+		else
+			algo->functbl->decryptfast(algo, buf, buf, n);
+		if (Aligned)
+			xor_aligned(out, buf, offs, nbytes);
+		else
+			xor_buffers(out, buf, offs, nbytes);
+		if (!enc)
+			sum_blocks(c->checksum, out, n);
+
+		nblocks -= n;
+		in += nbytes;
+		out += nbytes;
+	}
+
+	if (rem) {
+		uint8_t pad[BLKSIZE];
+
+		xor_l(c->offset, c, L_STAR);
+		algo->functbl->encrypt(algo, pad, (const uint8_t *)c->offset);
+		// The checksum covers the plaintext, and in and out may overlap.
+		memset(buf, 0, BLKSIZE);
+		if (enc)
+			memcpy(buf, in, rem);
+		xor_buffers(out, in, pad, rem);
+		if (!enc)
+			memcpy(buf, out, rem);
+		buf[rem] = 0x80;
+		xor_block(c->checksum, buf);
+		c->finished = true;
+	}
+
+	return 0;
+}
+
+static int ocb_encrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len)
+{
+	return crypt<false>(ctx, out, in, len, true);
+}
+
+static int ocb_decrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len)
+{
+	return crypt<false>(ctx, out, in, len, false);
+}
+
+static int ocb_encryptfast(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len)
+{
+	return crypt<true>(ctx, out, in, len, true);
+}
+
+static int ocb_decryptfast(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len)
+{
+	return crypt<true>(ctx, out, in, len, false);
+}
+
+static void compute_tag(struct ocb *c, uint8_t *tag)
+{
+	uint64_t x[2];
+
+	x[0] = c->checksum[0] ^ c->offset[0];
+	x[1] = c->checksum[1] ^ c->offset[1];
+	xor_l(x, c, L_DOLLAR);
+	c->algo->functbl->encrypt(c->algo, tag, (const uint8_t *)x);
+	xor_buffers(tag, tag, (const uint8_t *)c->hash, BLKSIZE);
+	c->finished = true;
+}
+
+static int ocb_encryptfinal(drew_mode_t *ctx, uint8_t *out, size_t outlen,
+		const uint8_t *in, size_t inlen)
+{
+	struct ocb *c = (struct ocb *)ctx->ctx;
+	uint8_t tag[BLKSIZE];
+	int res;
+
+	if (outlen < inlen + c->taglen)
+		return -DREW_ERR_MORE_INFO;
+
+	if ((res = ocb_encrypt(ctx, out, in, inlen)))
+		return res;
+
+	compute_tag(c, tag);
+	memcpy(out+inlen, tag, c->taglen);
+
+	return inlen + c->taglen;
+}
+
+static int ocb_decryptfinal(drew_mode_t *ctx, uint8_t *out, size_t outlen,
+		const uint8_t *in, size_t inlen)
+{
+	struct ocb *c = (struct ocb *)ctx->ctx;
+	uint8_t tag[BLKSIZE], diff = 0;
+	int res;
+
+	if (inlen < outlen + c->taglen)
+		return -DREW_ERR_MORE_INFO;
+
+	if ((res = ocb_decrypt(ctx, out, in, outlen)))
+		return res;
+
+	compute_tag(c, tag);
+	for (size_t i = 0; i < c->taglen; i++)
+		diff |= tag[i] ^ in[outlen+i];
+
+	// The checksum needs the plaintext, so it can't be withheld until the tag
+	// is checked; instead, don't hand back unauthenticated data.
+	if (diff) {
+		memset(out, 0, outlen);
+		return -DREW_ERR_VERIFY_FAILED;
+	}
+	return outlen;
+}
+
+struct test {
+	const uint8_t *nonce;
+	const uint8_t *aad;
+	const uint8_t *input;
+	const uint8_t *output;
+	size_t noncesz;
+	size_t aadsz;
+	size_t insz;
+};
+
+static int ocb_test_generic(DrewLoader *ldr, const char *name,
+		const uint8_t *key, size_t keysz, const struct test *testdata,
+		size_t ntests)
+{
+	int id, result = 0;
+	const drew_block_functbl_t *functbl;
+	drew_block_t algo;
+	drew_mode_t c;
+	const void *tmp;
+
+	id = drew_loader_lookup_by_name(ldr, name, 0, -1);
+	if (id < 0)
+		return id;
+
+	drew_loader_get_functbl(ldr, id, &tmp);
+	functbl = (const drew_block_functbl_t *)tmp;
+
+	for (size_t i = 0; i < ntests; i++) {
+		const struct test *t = testdata + i;
+		uint8_t buf[64];
+
+		result <<= 1;
+
+		algo.functbl = functbl;
+		algo.functbl->init(&algo, 0, ldr, NULL);
+		algo.functbl->setkey(&algo, key, keysz, DREW_BLOCK_MODE_BOTH);
+		ocb_init(&c, 0, ldr, NULL);
+		ocb_setblock(&c, &algo);
+
+		ocb_setiv(&c, t->nonce, t->noncesz);
+		ocb_setdata(&c, t->aad, t->aadsz);
+		ocb_encryptfinal(&c, buf, sizeof(buf), t->input, t->insz);
+		result |= !!memcmp(buf, t->output, t->insz + 16);
+
+		ocb_reset(&c);
+		ocb_setdata(&c, t->aad, t->aadsz);
+		result |= ocb_decryptfinal(&c, buf, t->insz, t->output,
+				t->insz + 16) != int(t->insz);
+		result |= !!memcmp(buf, t->input, t->insz);
+
+		ocb_reset(&c);
+		memcpy(buf, t->output, t->insz + 16);
+		buf[t->insz] ^= 0x01;
+		result |= ocb_decryptfinal(&c, buf, t->insz, buf, t->insz + 16) !=
+			-DREW_ERR_VERIFY_FAILED;
+		for (size_t i = 0; i < t->insz; i++)
+			result |= !!buf[i];
+
+		ocb_fini(&c, 0);
+		algo.functbl->fini(&algo, 0);
+	}
+
+	return result;
+}
+
+/* Check that a long message processed in pieces through the fast functions
+ * matches the same message processed in one call, which exercises the
+ * chunking and the higher L values.
+ */
+static int ocb_test_long(DrewLoader *ldr, const char *name)
+{
+	const size_t len = 3 * CHUNKSIZE + 5 * BLKSIZE + 7;
+	const size_t split = CHUNKSIZE + 3 * BLKSIZE;
+	int id, result = 0;
+	const drew_block_functbl_t *functbl;
+	drew_block_t algo;
+	drew_mode_t c;
+	const void *tmp;
+	uint8_t key[16], nonce[12], aad[37];
+	uint8_t *in, *out, *out2;
+
+	id = drew_loader_lookup_by_name(ldr, name, 0, -1);
+	if (id < 0)
+		return id;
+
+	drew_loader_get_functbl(ldr, id, &tmp);
+	functbl = (const drew_block_functbl_t *)tmp;
+
+	in = (uint8_t *)drew_mem_malloc(len);
+	out = (uint8_t *)drew_mem_malloc(len + BLKSIZE);
+	out2 = (uint8_t *)drew_mem_malloc(len + BLKSIZE);
+	for (size_t i = 0; i < len; i++)
+		in[i] = i * 0x3d;
+	for (size_t i = 0; i < sizeof(key); i++)
+		key[i] = i;
+	for (size_t i = 0; i < sizeof(nonce); i++)
+		nonce[i] = 0xa0 + i;
+	for (size_t i = 0; i < sizeof(aad); i++)
+		aad[i] = i * 7;
+
+	algo.functbl = functbl;
+	algo.functbl->init(&algo, 0, ldr, NULL);
+	algo.functbl->setkey(&algo, key, sizeof(key), DREW_BLOCK_MODE_BOTH);
+	ocb_init(&c, 0, ldr, NULL);
+	ocb_setblock(&c, &algo);
+	ocb_setiv(&c, nonce, sizeof(nonce));
+	ocb_setdata(&c, aad, sizeof(aad));
+	ocb_encryptfinal(&c, out, len + BLKSIZE, in, len);
+
+	ocb_reset(&c);
+	ocb_setdata(&c, aad, sizeof(aad));
+	ocb_encryptfast(&c, out2, in, split);
+	ocb_encrypt(&c, out2+split, in+split, BLKSIZE);
+	ocb_encryptfinal(&c, out2+split+BLKSIZE, len - split,
+			in+split+BLKSIZE, len - split - BLKSIZE);
+	result |= !!memcmp(out, out2, len + BLKSIZE);
+	result <<= 1;
+
+	ocb_reset(&c);
+	ocb_setdata(&c, aad, sizeof(aad));
+	ocb_decryptfast(&c, out2, out2, split);
+	result |= ocb_decryptfinal(&c, out2+split, len - split, out+split,
+			len - split + BLKSIZE) != int(len - split);
+	result |= !!memcmp(out2, in, len);
+
+	ocb_fini(&c, 0);
+	algo.functbl->fini(&algo, 0);
+	drew_mem_free(in);
+	drew_mem_free(out);
+	drew_mem_free(out2);
+
+	return result;
+}
+
+static int ocb_test_aes128(DrewLoader *ldr, size_t *ntests)
+{
+	const uint8_t *key = (const uint8_t *)
+		"\x00\x01\x02\x03\x04\x05\x06\x07"
+		"\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f";
+	const uint8_t *nonce = (const uint8_t *)
+		"\xbb\xaa\x99\x88\x77\x66\x55\x44\x33\x22\x11\x00"
+		"\xbb\xaa\x99\x88\x77\x66\x55\x44\x33\x22\x11\x01"
+		"\xbb\xaa\x99\x88\x77\x66\x55\x44\x33\x22\x11\x02"
+		"\xbb\xaa\x99\x88\x77\x66\x55\x44\x33\x22\x11\x03"
+		"\xbb\xaa\x99\x88\x77\x66\x55\x44\x33\x22\x11\x04"
+		"\xbb\xaa\x99\x88\x77\x66\x55\x44\x33\x22\x11\x0d";
+	const uint8_t *data = (const uint8_t *)
+		"\x00\x01\x02\x03\x04\x05\x06\x07"
+		"\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f"
+		"\x10\x11\x12\x13\x14\x15\x16\x17"
+		"\x18\x19\x1a\x1b\x1c\x1d\x1e\x1f"
+		"\x20\x21\x22\x23\x24\x25\x26\x27";
+	// From RFC 7253, appendix A.
+	struct test testdata[] = {
+		{
+			nonce, data, data,
+			(const uint8_t *)
+				"\x78\x54\x07\xbf\xff\xc8\xad\x9e"
+				"\xdc\xc5\x52\x0a\xc9\x11\x1e\xe6",
+			12, 0, 0
+		},
+		{
+			nonce+12, data, data,
+			(const uint8_t *)
+				"\x68\x20\xb3\x65\x7b\x6f\x61\x5a"
+				"\x57\x25\xbd\xa0\xd3\xb4\xeb\x3a"
+				"\x25\x7c\x9a\xf1\xf8\xf0\x30\x09",
+			12, 8, 8
+		},
+		{
+			nonce+24, data, data,
+			(const uint8_t *)
+				"\x81\x01\x7f\x82\x03\xf0\x81\x27"
+				"\x71\x52\xfa\xde\x69\x4a\x0a\x00",
+			12, 8, 0
+		},
+		{
+			nonce+36, data, data,
+			(const uint8_t *)
+				"\x45\xdd\x69\xf8\xf5\xaa\xe7\x24"
+				"\x14\x05\x4c\xd1\xf3\x5d\x82\x76"
+				"\x0b\x2c\xd0\x0d\x2f\x99\xbf\xa9",
+			12, 0, 8
+		},
+		{
+			nonce+48, data, data,
+			(const uint8_t *)
+				"\x57\x1d\x53\x5b\x60\xb2\x77\x18"
+				"\x8b\xe5\x14\x71\x70\xa9\xa2\x2c"
+				"\x3a\xd7\xa4\xff\x38\x35\xb8\xc5"
+				"\x70\x1c\x1c\xce\xc8\xfc\x33\x58",
+			12, 16, 16
+		},
+		{
+			nonce+60, data, data,
+			(const uint8_t *)
+				"\xd5\xca\x91\x74\x84\x10\xc1\x75"
+				"\x1f\xf8\xa2\xf6\x18\x25\x5b\x68"
+				"\xa0\xa1\x2e\x09\x3f\xf4\x54\x60"
+				"\x6e\x59\xf9\xc1\xd0\xdd\xc5\x4b"
+				"\x65\xe8\x62\x8e\x56\x8b\xad\x7a"
+				"\xed\x07\xba\x06\xa4\xa6\x94\x83"
+				"\xa7\x03\x54\x90\xc5\x76\x9e\x60",
+			12, 40, 40
+		}
+	};
+
+	*ntests = DIM(testdata);
+
+	return ocb_test_generic(ldr, "AES128", key, 16, testdata, DIM(testdata));
+}
+
+static int ocb_test(void *p, DrewLoader *ldr)
+{
+	int result = 0, tres;
+	size_t ntests = 0;
+	if (!ldr)
+		return -DREW_ERR_INVALID;
+
+	if ((tres = ocb_test_aes128(ldr, &ntests)) >= 0) {
+		result <<= ntests;
+		result |= tres;
+	}
+	if ((tres = ocb_test_long(ldr, "AES128")) >= 0) {
+		result <<= 2;
+		result |= tres;
+	}
+
+	return result;
+}
+
+static int ocb_fini(drew_mode_t *ctx, int flags)
+{
+	struct ocb *c = (struct ocb *)ctx->ctx;
+
+	free_block(c->algo);
+	if (c->l) {
+		memset(c->l, 0, NLVALUES * BLKSIZE);
+		drew_mem_sfree(c->l);
+	}
+	memset(c, 0, sizeof(*c));
+
+	if (!(flags & DREW_MODE_FIXED)) {
+		drew_mem_sfree(c);
+		ctx->ctx = NULL;
+	}
+
+	return 0;
+}
+
+static drew_block_t *clone_block(const drew_block_t *algo)
+{
+	drew_block_t *p;
+
+	if (!algo)
+		return NULL;
+	p = (drew_block_t *)drew_mem_memdup(algo, sizeof(*p));
+	p->functbl->clone(p, algo, 0);
+	return p;
+}
+
+static int ocb_clone(drew_mode_t *newctx, const drew_mode_t *oldctx, int flags)
+{
+	struct ocb *c = (struct ocb *)oldctx->ctx, *cn;
+
+	if (!(flags & DREW_MODE_FIXED))
+		newctx->ctx = drew_mem_smalloc(sizeof(struct ocb));
+	cn = (struct ocb *)newctx->ctx;
+	memcpy(newctx->ctx, oldctx->ctx, sizeof(struct ocb));
+	cn->algo = clone_block(c->algo);
+	cn->l = (uint64_t *)drew_mem_smemdup(c->l, NLVALUES * BLKSIZE);
+	newctx->functbl = oldctx->functbl;
+	return 0;
+}
+
+struct plugin {
+	const char *name;
+	const drew_mode_functbl_t *functbl;
+};
+
+static struct plugin plugin_data[] = {
+	{ "OCB", &ocb_functbl }
+};
+
+EXPORT()
+extern "C"
+int DREW_PLUGIN_NAME(ocb)(void *ldr, int op, int id, void *p)
+{
+	int nplugins = sizeof(plugin_data)/sizeof(plugin_data[0]);
+
+	if (id < 0 || id >= nplugins)
+		return -DREW_ERR_INVALID;
+
+	switch (op) {
+		case DREW_LOADER_LOOKUP_NAME:
+			return 0;
+		case DREW_LOADER_GET_NPLUGINS:
+			return nplugins;
+		case DREW_LOADER_GET_TYPE:
+			return DREW_TYPE_MODE;
+		case DREW_LOADER_GET_FUNCTBL_SIZE:
+			return sizeof(drew_mode_functbl_t);
+		case DREW_LOADER_GET_FUNCTBL:
+			memcpy(p, plugin_data[id].functbl, sizeof(drew_mode_functbl_t));
+			return 0;
+		case DREW_LOADER_GET_NAME_SIZE:
+			return strlen(plugin_data[id].name) + 1;
+		case DREW_LOADER_GET_NAME:
+			memcpy(p, plugin_data[id].name, strlen(plugin_data[id].name)+1);
+			return 0;
+		default:
+			return -DREW_ERR_INVALID;
+	}
+}
+UNEXPORT()
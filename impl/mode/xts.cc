@@ -0,0 +1,743 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ *
+ * This file is part of the Drew Cryptography Suite.
+ *
+ * This file is free software; you can redistribute it and/or modify it under
+ * the terms of your choice of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation or version 2.0 of the Apache
+ * License as published by the Apache Software Foundation.
+ *
+ * This file is distributed in the hope that it will be useful, but without
+ * any warranty; without even the implied warranty of merchantability or fitness
+ * for a particular purpose.
+ *
+ * Note that people who make modified versions of this file are not obligated to
+ * dual-license their modified versions; it is their choice whether to do so.
+ * If a modified version is not distributed under both licenses, the copyright
+ * and permission notices should be updated accordingly.
+ */
+/* This implements XTS as specified in IEEE 1619-2007 and NIST SP 800-38E.
+ *
+ * The block cipher passed to setblock is keyed with the data key (Key1).  The
+ * tweak key (Key2) is passed to setdata and keys a second instance of the same
+ * cipher.  The IV is the data unit (sector) number, encoded as a 16-byte
+ * little-endian integer as IEEE 1619 requires, so any sector can be processed
+ * on its own by setting the IV to its number.
+ *
+ * Each call to encrypt or decrypt processes one complete data unit, using
+ * ciphertext stealing if its length is not a multiple of the block size.  If
+ * the sectorSize parameter is passed to init, each call instead processes as
+ * many whole sectors of that size as are in the buffer.  Either way, the data
+ * unit number is incremented after each data unit.
+ */
+
+#include "internal.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <drew/mem.h>
+#include <drew/mode.h>
+#include <drew/block.h>
+#include <drew/plugin.h>
+
+#include "util.hh"
+
+#define DIM(x) (sizeof(x)/sizeof((x)[0]))
+
+#define BLKSIZE 16
+// The number of bytes processed per call to encryptfast.
+#define CHUNKSIZE 4096
+
+struct xts {
+	DrewLoader *ldr;
+	drew_block_t *algo;
+	drew_block_t *tweak;
+	uint8_t unit[BLKSIZE];
+	uint8_t iv[BLKSIZE];
+	size_t blksize;
+	size_t sectsize;
+};
+
+extern "C" {
+static int xts_info(int op, void *p);
+static int xts_info2(const drew_mode_t *, int op, drew_param_t *,
+		const drew_param_t *);
+static int xts_init(drew_mode_t *ctx, int flags, DrewLoader *ldr,
+		const drew_param_t *param);
+static int xts_reset(drew_mode_t *ctx);
+static int xts_resync(drew_mode_t *ctx);
+static int xts_setblock(drew_mode_t *ctx, const drew_block_t *algoctx);
+static int xts_setiv(drew_mode_t *ctx, const uint8_t *iv, size_t len);
+static int xts_encrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len);
+static int xts_decrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len);
+static int xts_encryptfast(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len);
+static int xts_decryptfast(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len);
+static int xts_fini(drew_mode_t *ctx, int flags);
+static int xts_test(void *p, DrewLoader *ldr);
+static int xts_clone(drew_mode_t *newctx, const drew_mode_t *oldctx, int flags);
+static int xts_setdata(drew_mode_t *, const uint8_t *, size_t);
+static int xts_encryptfinal(drew_mode_t *ctx, uint8_t *out, size_t outlen,
+		const uint8_t *in, size_t inlen);
+static int xts_decryptfinal(drew_mode_t *ctx, uint8_t *out, size_t outlen,
+		const uint8_t *in, size_t inlen);
+}
+
+static const drew_mode_functbl_t xts_functbl = {
+	xts_info, xts_info2, xts_init, xts_clone, xts_reset, xts_fini,
+	xts_setblock, xts_setiv, xts_encrypt, xts_decrypt,
+	xts_encryptfast, xts_decryptfast, xts_setdata,
+	xts_encryptfinal, xts_decryptfinal, xts_resync, xts_test
+};
+
+typedef LittleEndian E;
+
+static int xts_info(int op, void *p)
+{
+	switch (op) {
+		case DREW_MODE_VERSION:
+			return CURRENT_ABI;
+		case DREW_MODE_INTSIZE:
+			return sizeof(struct xts);
+		case DREW_MODE_FINAL_INSIZE:
+		case DREW_MODE_FINAL_OUTSIZE:
+			return 0;
+		case DREW_MODE_QUANTUM:
+			return BLKSIZE;
+		default:
+			return -DREW_ERR_INVALID;
+	}
+}
+
+static int xts_info2(const drew_mode_t *ctx, int op, drew_param_t *out,
+		const drew_param_t *in)
+{
+	switch (op) {
+		case DREW_MODE_VERSION:
+			return CURRENT_ABI;
+		case DREW_MODE_INTSIZE:
+			return sizeof(struct xts);
+		case DREW_MODE_FINAL_INSIZE_CTX:
+		case DREW_MODE_FINAL_OUTSIZE_CTX:
+			return 0;
+		case DREW_MODE_BLKSIZE_CTX:
+			return BLKSIZE;
+		default:
+			return -DREW_ERR_INVALID;
+	}
+}
+
+static int xts_reset(drew_mode_t *ctx)
+{
+	struct xts *c = (struct xts *)ctx->ctx;
+
+	memcpy(c->unit, c->iv, sizeof(c->unit));
+	return 0;
+}
+
+static int xts_resync(drew_mode_t *ctx)
+{
+	return -DREW_ERR_NOT_IMPL;
+}
+
+static int xts_init(drew_mode_t *ctx, int flags, DrewLoader *ldr,
+		const drew_param_t *param)
+{
+	struct xts *newctx = (struct xts *)ctx->ctx;
+	size_t sectsize = 0;
+
+	for (; param; param = param->next)
+		if (!strcmp(param->name, "sectorSize"))
+			sectsize = param->param.number;
+
+	if (sectsize && sectsize < BLKSIZE)
+		return -DREW_ERR_INVALID;
+
+	if (!(flags & DREW_MODE_FIXED))
+		newctx = (struct xts *)drew_mem_smalloc(sizeof(*newctx));
+	memset(newctx, 0, sizeof(*newctx));
+	newctx->ldr = ldr;
+	newctx->algo = NULL;
+	newctx->tweak = NULL;
+	newctx->sectsize = sectsize;
+
+	ctx->ctx = newctx;
+	ctx->functbl = &xts_functbl;
+
+	return 0;
+}
+
+static void free_block(drew_block_t *algo)
+{
+	if (algo) {
+		algo->functbl->fini(algo, 0);
+		drew_mem_free(algo);
+	}
+}
+
+static int xts_setblock(drew_mode_t *ctx, const drew_block_t *algoctx)
+{
+	struct xts *c = (struct xts *)ctx->ctx;
+
+	if (!algoctx)
+		return -DREW_ERR_INVALID;
+
+	// The multiplication by α is only defined for 128-bit blocks.
+	if (algoctx->functbl->info(DREW_BLOCK_BLKSIZE, NULL) != BLKSIZE)
+		return -DREW_ERR_INVALID;
+
+	free_block(c->algo);
+	c->algo = (drew_block_t *)drew_mem_malloc(sizeof(*c->algo));
+	c->algo->functbl = algoctx->functbl;
+	c->algo->functbl->clone(c->algo, algoctx, 0);
+	c->blksize = BLKSIZE;
+
+	return 0;
+}
+
+static int xts_setiv(drew_mode_t *ctx, const uint8_t *iv, size_t len)
+{
+	struct xts *c = (struct xts *)ctx->ctx;
+
+	if (len != BLKSIZE)
+		return -DREW_ERR_INVALID;
+
+	memcpy(c->unit, iv, len);
+	if (iv != c->iv)
+		memcpy(c->iv, iv, len);
+	return 0;
+}
+
+/* The tweak key. */
+static int xts_setdata(drew_mode_t *ctx, const uint8_t *data, size_t len)
+{
+	struct xts *c = (struct xts *)ctx->ctx;
+	int res = 0;
+
+	if (!c->algo)
+		return -DREW_ERR_MORE_INFO;
+
+	free_block(c->tweak);
+	c->tweak = (drew_block_t *)drew_mem_malloc(sizeof(*c->tweak));
+	c->tweak->functbl = c->algo->functbl;
+	if ((res = c->tweak->functbl->init(c->tweak, 0, c->ldr, NULL)))
+		return res;
+	return c->tweak->functbl->setkey(c->tweak, data, len,
+			DREW_BLOCK_MODE_ENCRYPT);
+}
+
+/* Multiply the tweak by α, treating it as a little-endian integer. */
+static inline void multiply_alpha(uint64_t *t)
+{
+	const uint64_t carry = -(t[1] >> 63) & 0x87;
+
+	t[1] = (t[1] << 1) | (t[0] >> 63);
+	t[0] = (t[0] << 1) ^ carry;
+}
+
+/* Store n consecutive tweaks into buf, leaving t as the next one. */
+static inline void fill_tweaks(uint8_t *buf, uint64_t *t, size_t n)
+{
+	for (size_t i = 0; i < n; i++, buf += BLKSIZE) {
+		E::Convert(buf, t[0]);
+		E::Convert(buf+8, t[1]);
+		multiply_alpha(t);
+	}
+}
+
+static void increment_unit(uint8_t *unit)
+{
+	for (size_t i = 0; i < BLKSIZE && !++unit[i]; i++);
+}
+
+static inline void crypt_block(const drew_block_t *algo, uint8_t *out,
+		const uint8_t *in, const uint8_t *tweak, bool enc)
+{
+	uint8_t buf[BLKSIZE] ALIGNED_T;
+
+	xor_buffers(buf, in, tweak, BLKSIZE);
+	if (enc)
+		algo->functbl->encrypt(algo, buf, buf);
+	else
+		algo->functbl->decrypt(algo, buf, buf);
+	xor_buffers(out, buf, tweak, BLKSIZE);
+}
+
+/* Process one data unit.  All of the whole blocks, except the last one if
+ * ciphertext stealing is required, are processed in chunks through
+ * encryptfast or decryptfast.  If aligned is true, in and out are suitably
+ * aligned for the aligned XOR routines.
+ */
+template<bool Aligned>
+static void crypt_unit(struct xts *c, uint8_t *out, const uint8_t *in,
+		size_t len, bool enc)
+{
+	const drew_block_t *algo = c->algo;
+	const size_t rem = len % BLKSIZE;
+	size_t nblocks = len / BLKSIZE - !!rem;
+	uint8_t tweaks[CHUNKSIZE] ALIGNED_T, buf[CHUNKSIZE] ALIGNED_T;
+	uint64_t t[2];
+
+	c->tweak->functbl->encrypt(c->tweak, buf, c->unit);
+	t[0] = E::Convert<uint64_t>(buf);
+	t[1] = E::Convert<uint64_t>(buf+8);
+	increment_unit(c->unit);
+
+	while (nblocks) {
+		const size_t n = std::min<size_t>(nblocks, CHUNKSIZE / BLKSIZE);
+		const size_t nbytes = n * BLKSIZE;
+
+		fill_tweaks(tweaks, t, n);
+		if (Aligned)
+			xor_aligned(buf, in, tweaks, nbytes);
+		else
+			xor_buffers(buf, in, tweaks, nbytes);
+		if (enc)
+			algo->functbl->encryptfast(algo, buf, buf, n);
+		else
+			algo->functbl->decryptfast(algo, buf, buf, n);
+		if (Aligned)
+			xor_aligned(out, buf, tweaks, nbytes);
+		else
+			xor_buffers(out, buf, tweaks, nbytes);
+
+		nblocks -= n;
+		in += nbytes;
+		out += nbytes;
+	}
+
+	if (rem) {
+		// Ciphertext stealing.  The last whole block is processed with the
+		// final tweak when decrypting and the partial block is moved to the
+		// end.  in and out may overlap, so the partial block is copied first.
+		uint8_t tw[2][BLKSIZE], last[BLKSIZE];
+
+		fill_tweaks(tw[0], t, 2);
+		memcpy(last, in+BLKSIZE, rem);
+		crypt_block(algo, buf, in, tw[!enc], enc);
+		memcpy(last+rem, buf+rem, BLKSIZE-rem);
+		memcpy(out+BLKSIZE, buf, rem);
+		crypt_block(algo, out, last, tw[enc], enc);
+	}
+}
+
+template<bool Aligned>
+static int crypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len, bool enc)
+{
+	struct xts *c = (struct xts *)ctx->ctx;
+	const size_t unitsz = c->sectsize ? c->sectsize : len;
+
+	if (!c->algo || !c->tweak)
+		return -DREW_ERR_MORE_INFO;
+	if (len < BLKSIZE || len % unitsz)
+		return -DREW_ERR_INVALID;
+
+	for (size_t off = 0; off < len; off += unitsz)
+		crypt_unit<Aligned>(c, out+off, in+off, unitsz, enc);
+
+	return 0;
+}
+
+static int xts_encrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len)
+{
+	return crypt<false>(ctx, out, in, len, true);
+}
+
+static int xts_decrypt(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len)
+{
+	return crypt<false>(ctx, out, in, len, false);
+}
+
+static int xts_encryptfast(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len)
+{
+	return crypt<true>(ctx, out, in, len, true);
+}
+
+static int xts_decryptfast(drew_mode_t *ctx, uint8_t *out, const uint8_t *in,
+		size_t len)
+{
+	return crypt<true>(ctx, out, in, len, false);
+}
+
+static int xts_encryptfinal(drew_mode_t *ctx, uint8_t *out, size_t outlen,
+		const uint8_t *in, size_t inlen)
+{
+	int res;
+
+	if (!inlen)
+		return 0;
+	if ((res = xts_encrypt(ctx, out, in, inlen)))
+		return res;
+	return inlen;
+}
+
+static int xts_decryptfinal(drew_mode_t *ctx, uint8_t *out, size_t outlen,
+		const uint8_t *in, size_t inlen)
+{
+	int res;
+
+	if (!inlen)
+		return 0;
+	if ((res = xts_decrypt(ctx, out, in, inlen)))
+		return res;
+	return inlen;
+}
+
+struct test {
+	const uint8_t *key;
+	const uint8_t *tweakkey;
+	const uint8_t *unit;
+	const uint8_t *input;
+	const uint8_t *output;
+	size_t keysz;
+	size_t datasz;
+};
+
+static int xts_test_generic(DrewLoader *ldr, const char *name,
+		const struct test *testdata, size_t ntests)
+{
+	int id, result = 0;
+	const drew_block_functbl_t *functbl;
+	drew_block_t algo;
+	drew_mode_t c;
+	const void *tmp;
+
+	id = drew_loader_lookup_by_name(ldr, name, 0, -1);
+	if (id < 0)
+		return id;
+
+	drew_loader_get_functbl(ldr, id, &tmp);
+	functbl = (const drew_block_functbl_t *)tmp;
+
+	for (size_t i = 0; i < ntests; i++) {
+		const struct test *t = testdata + i;
+		uint8_t buf[64];
+
+		result <<= 1;
+
+		algo.functbl = functbl;
+		algo.functbl->init(&algo, 0, ldr, NULL);
+		algo.functbl->setkey(&algo, t->key, t->keysz, DREW_BLOCK_MODE_BOTH);
+		xts_init(&c, 0, ldr, NULL);
+		xts_setblock(&c, &algo);
+		xts_setdata(&c, t->tweakkey, t->keysz);
+
+		xts_setiv(&c, t->unit, BLKSIZE);
+		xts_encrypt(&c, buf, t->input, t->datasz);
+		result |= !!memcmp(buf, t->output, t->datasz);
+
+		xts_reset(&c);
+		xts_decrypt(&c, buf, buf, t->datasz);
+		result |= !!memcmp(buf, t->input, t->datasz);
+
+		xts_fini(&c, 0);
+		algo.functbl->fini(&algo, 0);
+	}
+
+	return result;
+}
+
+/* Check that a run of sectors processed in one call matches a sector processed
+ * on its own, which exercises both the chunking and random access.
+ */
+static int xts_test_sectors(DrewLoader *ldr, const char *name)
+{
+	const size_t sectsize = 520, nsectors = 10;
+	const size_t len = sectsize * nsectors;
+	int id, result = 0;
+	const drew_block_functbl_t *functbl;
+	drew_block_t algo;
+	drew_mode_t c;
+	drew_param_t param;
+	const void *tmp;
+	uint8_t key[16], unit[BLKSIZE];
+	uint8_t *in, *out, buf[520];
+
+	id = drew_loader_lookup_by_name(ldr, name, 0, -1);
+	if (id < 0)
+		return id;
+
+	drew_loader_get_functbl(ldr, id, &tmp);
+	functbl = (const drew_block_functbl_t *)tmp;
+
+	in = (uint8_t *)drew_mem_malloc(len);
+	out = (uint8_t *)drew_mem_malloc(len);
+	for (size_t i = 0; i < len; i++)
+		in[i] = i * 0x3d;
+	for (size_t i = 0; i < sizeof(key); i++)
+		key[i] = i;
+	memset(buf, 0, sizeof(buf));
+	memset(unit, 0, sizeof(unit));
+	unit[0] = 0xfe;
+
+	param.next = NULL;
+	param.name = "sectorSize";
+	param.param.number = sectsize;
+
+	algo.functbl = functbl;
+	algo.functbl->init(&algo, 0, ldr, NULL);
+	algo.functbl->setkey(&algo, key, sizeof(key), DREW_BLOCK_MODE_BOTH);
+	xts_init(&c, 0, ldr, &param);
+	xts_setblock(&c, &algo);
+	xts_setdata(&c, key, sizeof(key));
+	xts_setiv(&c, unit, sizeof(unit));
+	xts_encrypt(&c, out, in, len);
+
+	// The last sector is number 0x107, which needs a carry.
+	unit[0] = 0x07;
+	unit[1] = 0x01;
+	xts_setiv(&c, unit, sizeof(unit));
+	xts_decrypt(&c, buf, out+len-sectsize, sectsize);
+	result |= !!memcmp(buf, in+len-sectsize, sectsize);
+	result <<= 1;
+
+	unit[0] = 0xfe;
+	unit[1] = 0x00;
+	xts_setiv(&c, unit, sizeof(unit));
+	xts_decrypt(&c, out, out, len);
+	result |= !!memcmp(out, in, len);
+
+	xts_fini(&c, 0);
+	algo.functbl->fini(&algo, 0);
+	drew_mem_free(in);
+	drew_mem_free(out);
+
+	return result;
+}
+
+static int xts_test_aes128(DrewLoader *ldr, size_t *ntests)
+{
+	// From IEEE 1619-2007, vectors 1, 2, 3, 15, and 18.
+	struct test testdata[] = {
+		{
+			(const uint8_t *)
+				"\x00\x00\x00\x00\x00\x00\x00\x00"
+				"\x00\x00\x00\x00\x00\x00\x00\x00",
+			(const uint8_t *)
+				"\x00\x00\x00\x00\x00\x00\x00\x00"
+				"\x00\x00\x00\x00\x00\x00\x00\x00",
+			(const uint8_t *)
+				"\x00\x00\x00\x00\x00\x00\x00\x00"
+				"\x00\x00\x00\x00\x00\x00\x00\x00",
+			(const uint8_t *)
+				"\x00\x00\x00\x00\x00\x00\x00\x00"
+				"\x00\x00\x00\x00\x00\x00\x00\x00"
+				"\x00\x00\x00\x00\x00\x00\x00\x00"
+				"\x00\x00\x00\x00\x00\x00\x00\x00",
+			(const uint8_t *)
+				"\x91\x7c\xf6\x9e\xbd\x68\xb2\xec"
+				"\x9b\x9f\xe9\xa3\xea\xdd\xa6\x92"
+				"\xcd\x43\xd2\xf5\x95\x98\xed\x85"
+				"\x8c\x02\xc2\x65\x2f\xbf\x92\x2e",
+			16,
+			32
+		},
+		{
+			(const uint8_t *)
+				"\x11\x11\x11\x11\x11\x11\x11\x11"
+				"\x11\x11\x11\x11\x11\x11\x11\x11",
+			(const uint8_t *)
+				"\x22\x22\x22\x22\x22\x22\x22\x22"
+				"\x22\x22\x22\x22\x22\x22\x22\x22",
+			(const uint8_t *)
+				"\x33\x33\x33\x33\x33\x00\x00\x00"
+				"\x00\x00\x00\x00\x00\x00\x00\x00",
+			(const uint8_t *)
+				"\x44\x44\x44\x44\x44\x44\x44\x44"
+				"\x44\x44\x44\x44\x44\x44\x44\x44"
+				"\x44\x44\x44\x44\x44\x44\x44\x44"
+				"\x44\x44\x44\x44\x44\x44\x44\x44",
+			(const uint8_t *)
+				"\xc4\x54\x18\x5e\x6a\x16\x93\x6e"
+				"\x39\x33\x40\x38\xac\xef\x83\x8b"
+				"\xfb\x18\x6f\xff\x74\x80\xad\xc4"
+				"\x28\x93\x82\xec\xd6\xd3\x94\xf0",
+			16,
+			32
+		},
+		{
+			(const uint8_t *)
+				"\xff\xfe\xfd\xfc\xfb\xfa\xf9\xf8"
+				"\xf7\xf6\xf5\xf4\xf3\xf2\xf1\xf0",
+			(const uint8_t *)
+				"\x22\x22\x22\x22\x22\x22\x22\x22"
+				"\x22\x22\x22\x22\x22\x22\x22\x22",
+			(const uint8_t *)
+				"\x33\x33\x33\x33\x33\x00\x00\x00"
+				"\x00\x00\x00\x00\x00\x00\x00\x00",
+			(const uint8_t *)
+				"\x44\x44\x44\x44\x44\x44\x44\x44"
+				"\x44\x44\x44\x44\x44\x44\x44\x44"
+				"\x44\x44\x44\x44\x44\x44\x44\x44"
+				"\x44\x44\x44\x44\x44\x44\x44\x44",
+			(const uint8_t *)
+				"\xaf\x85\x33\x6b\x59\x7a\xfc\x1a"
+				"\x90\x0b\x2e\xb2\x1e\xc9\x49\xd2"
+				"\x92\xdf\x4c\x04\x7e\x0b\x21\x53"
+				"\x21\x86\xa5\x97\x1a\x22\x7a\x89",
+			16,
+			32
+		},
+		{
+			(const uint8_t *)
+				"\xff\xfe\xfd\xfc\xfb\xfa\xf9\xf8"
+				"\xf7\xf6\xf5\xf4\xf3\xf2\xf1\xf0",
+			(const uint8_t *)
+				"\xbf\xbe\xbd\xbc\xbb\xba\xb9\xb8"
+				"\xb7\xb6\xb5\xb4\xb3\xb2\xb1\xb0",
+			(const uint8_t *)
+				"\x9a\x78\x56\x34\x12\x00\x00\x00"
+				"\x00\x00\x00\x00\x00\x00\x00\x00",
+			(const uint8_t *)
+				"\x00\x01\x02\x03\x04\x05\x06\x07"
+				"\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f"
+				"\x10",
+			(const uint8_t *)
+				"\x6c\x16\x25\xdb\x46\x71\x52\x2d"
+				"\x3d\x75\x99\x60\x1d\xe7\xca\x09"
+				"\xed",
+			16,
+			17
+		},
+		{
+			(const uint8_t *)
+				"\xff\xfe\xfd\xfc\xfb\xfa\xf9\xf8"
+				"\xf7\xf6\xf5\xf4\xf3\xf2\xf1\xf0",
+			(const uint8_t *)
+				"\xbf\xbe\xbd\xbc\xbb\xba\xb9\xb8"
+				"\xb7\xb6\xb5\xb4\xb3\xb2\xb1\xb0",
+			(const uint8_t *)
+				"\x9a\x78\x56\x34\x12\x00\x00\x00"
+				"\x00\x00\x00\x00\x00\x00\x00\x00",
+			(const uint8_t *)
+				"\x00\x01\x02\x03\x04\x05\x06\x07"
+				"\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f"
+				"\x10\x11\x12\x13",
+			(const uint8_t *)
+				"\x9d\x84\xc8\x13\xf7\x19\xaa\x2c"
+				"\x7b\xe3\xf6\x61\x71\xc7\xc5\xc2"
+				"\xed\xbf\x9d\xac",
+			16,
+			20
+		}
+	};
+
+	*ntests = DIM(testdata);
+
+	return xts_test_generic(ldr, "AES128", testdata, DIM(testdata));
+}
+
+static int xts_test(void *p, DrewLoader *ldr)
+{
+	int result = 0, tres;
+	size_t ntests = 0;
+	if (!ldr)
+		return -DREW_ERR_INVALID;
+
+	if ((tres = xts_test_aes128(ldr, &ntests)) >= 0) {
+		result <<= ntests;
+		result |= tres;
+	}
+	if ((tres = xts_test_sectors(ldr, "AES128")) >= 0) {
+		result <<= 2;
+		result |= tres;
+	}
+
+	return result;
+}
+
+static int xts_fini(drew_mode_t *ctx, int flags)
+{
+	struct xts *c = (struct xts *)ctx->ctx;
+
+	free_block(c->algo);
+	free_block(c->tweak);
+	memset(c, 0, sizeof(*c));
+
+	if (!(flags & DREW_MODE_FIXED)) {
+		drew_mem_sfree(c);
+		ctx->ctx = NULL;
+	}
+
+	return 0;
+}
+
+static drew_block_t *clone_block(const drew_block_t *algo)
+{
+	drew_block_t *p;
+
+	if (!algo)
+		return NULL;
+	p = (drew_block_t *)drew_mem_memdup(algo, sizeof(*p));
+	p->functbl->clone(p, algo, 0);
+	return p;
+}
+
+static int xts_clone(drew_mode_t *newctx, const drew_mode_t *oldctx, int flags)
+{
+	struct xts *c = (struct xts *)oldctx->ctx, *cn;
+
+	if (!(flags & DREW_MODE_FIXED))
+		newctx->ctx = drew_mem_smalloc(sizeof(struct xts));
+	cn = (struct xts *)newctx->ctx;
+	memcpy(newctx->ctx, oldctx->ctx, sizeof(struct xts));
+	cn->algo = clone_block(c->algo);
+	cn->tweak = clone_block(c->tweak);
+	newctx->functbl = oldctx->functbl;
+	return 0;
+}
+
+struct plugin {
+	const char *name;
+	const drew_mode_functbl_t *functbl;
+};
+
+static struct plugin plugin_data[] = {
+	{ "XTS", &xts_functbl }
+};
+
+EXPORT()
+extern "C"
+int DREW_PLUGIN_NAME(xts)(void *ldr, int op, int id, void *p)
+{
+	int nplugins = sizeof(plugin_data)/sizeof(plugin_data[0]);
+
+	if (id < 0 || id >= nplugins)
+		return -DREW_ERR_INVALID;
+
+	switch (op) {
+		case DREW_LOADER_LOOKUP_NAME:
+			return 0;
+		case DREW_LOADER_GET_NPLUGINS:
+			return nplugins;
+		case DREW_LOADER_GET_TYPE:
+			return DREW_TYPE_MODE;
+		case DREW_LOADER_GET_FUNCTBL_SIZE:
+			return sizeof(drew_mode_functbl_t);
+		case DREW_LOADER_GET_FUNCTBL:
+			memcpy(p, plugin_data[id].functbl, sizeof(drew_mode_functbl_t));
+			return 0;
+		case DREW_LOADER_GET_NAME_SIZE:
+			return strlen(plugin_data[id].name) + 1;
+		case DREW_LOADER_GET_NAME:
+			memcpy(p, plugin_data[id].name, strlen(plugin_data[id].name)+1);
+			return 0;
+		default:
+			return -DREW_ERR_INVALID;
+	}
+}
+UNEXPORT()
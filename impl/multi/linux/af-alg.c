@@ -23,31 +23,76 @@
  * advantage of hardware implementations that cannot be used by userspace.
  */
 #ifdef __linux__
+// For vmsplice and splice.
+#define _GNU_SOURCE
 #include "internal.h"
 
 #include <glib-2.0/glib.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <linux/if_alg.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <drew/plugin.h>
 
 #include "af-alg.h"
 
 #ifndef SOL_ALG
 #define SOL_ALG 279
 #endif
+#ifndef ALG_SET_AEAD_ASSOCLEN
+#define ALG_SET_AEAD_ASSOCLEN 4
+#endif
+#ifndef ALG_SET_AEAD_AUTHSIZE
+#define ALG_SET_AEAD_AUTHSIZE 5
+#endif
+
+/* Requests with at least this much input are moved into the kernel with
+ * vmsplice and splice instead of being copied by sendmsg.  Below this, the two
+ * extra system calls cost more than the copy.
+ */
+#define AF_ALG_SPLICE_MIN (16 * 1024)
+#define AF_ALG_MAX_IV 32
+
+int af_alg_available(void)
+{
+	int fd;
+
+	if ((fd = socket(AF_ALG, SOCK_SEQPACKET, 0)) == -1)
+		return 0;
+	close(fd);
+	return 1;
+}
 
 int af_alg_initialize(struct af_alg *aas)
 {
 	memset(aas, 0, sizeof(*aas));
 	aas->sockfd = -1;
 	aas->fd = -1;
+	aas->pipefd[0] = -1;
+	aas->pipefd[1] = -1;
 	return 0;
 }
 
+void af_alg_close(struct af_alg *aas)
+{
+	if (aas->fd >= 0)
+		close(aas->fd);
+	if (aas->sockfd >= 0)
+		close(aas->sockfd);
+	if (aas->pipefd[0] >= 0)
+		close(aas->pipefd[0]);
+	if (aas->pipefd[1] >= 0)
+		close(aas->pipefd[1]);
+	af_alg_initialize(aas);
+}
+
 int af_alg_open_socket(struct af_alg *aas, const char *type, const char *algo)
 {
 	memset(&aas->sa, 0, sizeof(aas->sa));
@@ -68,6 +113,14 @@ int af_alg_set_key(struct af_alg *aas, const uint8_t *key, size_t len)
 	return setsockopt(aas->sockfd, SOL_ALG, ALG_SET_KEY, key, len);
 }
 
+int af_alg_set_authsize(struct af_alg *aas, size_t len)
+{
+	// The length is passed as the option length; there is no value.
+	if (setsockopt(aas->sockfd, SOL_ALG, ALG_SET_AEAD_AUTHSIZE, NULL, len))
+		return -errno;
+	return 0;
+}
+
 int af_alg_make_socket(struct af_alg *aas)
 {
 	if ((aas->fd = accept(aas->sockfd, NULL, 0)) < 0)
@@ -75,6 +128,55 @@ int af_alg_make_socket(struct af_alg *aas)
 	return 0;
 }
 
+/* Bind aas to tmpl(algo), or just algo if tmpl is NULL, key it, and make a
+ * request socket.  The tag length is only set if taglen is nonzero.  Unlike the
+ * rest of this file, this returns drew error codes.
+ */
+int af_alg_open_keyed(struct af_alg *aas, const char *type, const char *tmpl,
+		const char *algo, const uint8_t *key, size_t keylen,
+		size_t taglen)
+{
+	char name[sizeof(aas->sa.salg_name)];
+	int res = 0;
+
+	if (tmpl)
+		snprintf(name, sizeof(name), "%s(%s)", tmpl, algo);
+	else
+		snprintf(name, sizeof(name), "%s", algo);
+
+	// The kernel may simply not have this combination.
+	if (af_alg_open_socket(aas, type, name))
+		res = -DREW_ERR_NOT_IMPL;
+	else if (af_alg_set_key(aas, key, keylen))
+		res = -DREW_ERR_INVALID;
+	else if (taglen)
+		res = af_alg_set_authsize(aas, taglen);
+	if (!res)
+		res = af_alg_make_socket(aas);
+	if (res)
+		af_alg_close(aas);
+	return res;
+}
+
+/* Set up newaas to use the same keyed algorithm as aas.  If state is set, the
+ * partial state of aas is copied as well, which only hashes support.
+ */
+int af_alg_clone_socket(struct af_alg *newaas, const struct af_alg *aas,
+		int state)
+{
+	af_alg_initialize(newaas);
+	if (aas->sockfd < 0)
+		return 0;
+	newaas->sa = aas->sa;
+	if ((newaas->sockfd = dup(aas->sockfd)) < 0)
+		return -errno;
+	if (aas->fd < 0)
+		return 0;
+	if ((newaas->fd = accept(state ? aas->fd : aas->sockfd, NULL, 0)) < 0)
+		return -errno;
+	return 0;
+}
+
 int af_alg_do_crypt(const struct af_alg *aas, uint8_t *out, const uint8_t *in,
 		size_t len, int decrypt)
 {
@@ -111,4 +213,192 @@ int af_alg_do_crypt(const struct af_alg *aas, uint8_t *out, const uint8_t *in,
 	return 0;
 }
 
+static size_t iov_length(const struct iovec *iov, size_t n)
+{
+	size_t len = 0;
+
+	for (size_t i = 0; i < n; i++)
+		len += iov[i].iov_len;
+	return len;
+}
+
+// Skip the first len bytes of the iovecs, which must be writable copies.
+static void iov_advance(struct iovec **iov, size_t *n, size_t len)
+{
+	while (*n && len >= (*iov)->iov_len) {
+		len -= (*iov)->iov_len;
+		(*iov)++;
+		(*n)--;
+	}
+	if (*n) {
+		(*iov)->iov_base = (uint8_t *)(*iov)->iov_base + len;
+		(*iov)->iov_len -= len;
+	}
+}
+
+/* Send the operation, IV, and associated data length, along with the input if
+ * in is not NULL.  flags is passed to sendmsg.
+ */
+static int send_header(const struct af_alg *aas, const struct af_alg_op *op,
+		const struct iovec *in, size_t nin, int flags)
+{
+	const uint32_t type = op->decrypt ? ALG_OP_DECRYPT : ALG_OP_ENCRYPT;
+	const uint32_t assoclen = op->assoclen;
+	uint8_t cbuf[CMSG_SPACE(sizeof(type)) +
+		CMSG_SPACE(sizeof(struct af_alg_iv) + AF_ALG_MAX_IV) +
+		CMSG_SPACE(sizeof(assoclen))];
+	const size_t len = in ? iov_length(in, nin) : 0;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct af_alg_iv *aiv;
+	ssize_t n;
+
+	if (op->iv && op->ivlen > AF_ALG_MAX_IV)
+		return -EINVAL;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(cbuf, 0, sizeof(cbuf));
+
+	msg.msg_control = cbuf;
+	msg.msg_controllen = CMSG_SPACE(sizeof(type));
+	if (op->iv)
+		msg.msg_controllen += CMSG_SPACE(sizeof(*aiv) + op->ivlen);
+	if (op->aead)
+		msg.msg_controllen += CMSG_SPACE(sizeof(assoclen));
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_ALG;
+	cmsg->cmsg_type = ALG_SET_OP;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(type));
+	memcpy(CMSG_DATA(cmsg), &type, sizeof(type));
+
+	if (op->iv) {
+		cmsg = CMSG_NXTHDR(&msg, cmsg);
+		cmsg->cmsg_level = SOL_ALG;
+		cmsg->cmsg_type = ALG_SET_IV;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(*aiv) + op->ivlen);
+		aiv = (struct af_alg_iv *)CMSG_DATA(cmsg);
+		aiv->ivlen = op->ivlen;
+		memcpy(aiv->iv, op->iv, op->ivlen);
+	}
+
+	if (op->aead) {
+		cmsg = CMSG_NXTHDR(&msg, cmsg);
+		cmsg->cmsg_level = SOL_ALG;
+		cmsg->cmsg_type = ALG_SET_AEAD_ASSOCLEN;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(assoclen));
+		memcpy(CMSG_DATA(cmsg), &assoclen, sizeof(assoclen));
+	}
+
+	msg.msg_iov = (struct iovec *)in;
+	msg.msg_iovlen = in ? nin : 0;
+
+	if ((n = sendmsg(aas->fd, &msg, flags)) < 0)
+		return -errno;
+	return n == len ? 0 : -EIO;
+}
+
+/* Map the input into a pipe and splice it to the socket, so the kernel reads
+ * it from our pages instead of a copy.  vmsplice may take less than we offer
+ * if the data spans more pages than the pipe holds.
+ */
+static int splice_input(struct af_alg *aas, const struct iovec *in, size_t nin)
+{
+	struct iovec iov[AF_ALG_MAX_IOV], *p = iov;
+	size_t len = iov_length(in, nin);
+
+	if (aas->pipefd[0] < 0 && pipe(aas->pipefd))
+		return -errno;
+
+	memcpy(iov, in, nin * sizeof(*in));
+	while (len) {
+		ssize_t n = vmsplice(aas->pipefd[1], p, nin, 0);
+
+		if (n <= 0)
+			return n ? -errno : -EIO;
+		len -= n;
+		iov_advance(&p, &nin, n);
+		while (n) {
+			ssize_t m = splice(aas->pipefd[0], NULL, aas->fd, NULL, n,
+					len ? SPLICE_F_MORE : 0);
+			if (m <= 0)
+				return m ? -errno : -EIO;
+			n -= m;
+		}
+	}
+	return 0;
+}
+
+/* Perform one request.  The input is gathered from in and the output
+ * scattered to out; in and out may be the same memory.  For an AEAD, the input
+ * is the associated data followed by the plaintext or by the ciphertext and
+ * tag, and the output repeats the associated data.  All the input must fit in
+ * AF_ALG_MAX_REQUEST bytes.  Returns -EBADMSG if an AEAD tag does not match.
+ */
+int af_alg_crypt(struct af_alg *aas, const struct af_alg_op *op,
+		const struct iovec *in, size_t nin, const struct iovec *out,
+		size_t nout)
+{
+	struct iovec iov[AF_ALG_MAX_IOV], *p = iov;
+	const size_t inlen = iov_length(in, nin);
+	size_t outlen = iov_length(out, nout);
+	struct msghdr msg;
+
+	if (nin > AF_ALG_MAX_IOV || nout > AF_ALG_MAX_IOV ||
+			inlen > AF_ALG_MAX_REQUEST)
+		return -EINVAL;
+
+	if (inlen < AF_ALG_SPLICE_MIN)
+		RETFAIL(send_header(aas, op, in, nin, 0));
+	else {
+		RETFAIL(send_header(aas, op, NULL, 0, MSG_MORE));
+		RETFAIL(splice_input(aas, in, nin));
+	}
+
+	/* recvmsg is called even when there is no output, since that is what
+	 * makes the kernel check an AEAD tag; read would return at once.
+	 */
+	memcpy(iov, out, nout * sizeof(*out));
+	memset(&msg, 0, sizeof(msg));
+	do {
+		ssize_t n;
+
+		msg.msg_iov = p;
+		msg.msg_iovlen = nout;
+		if ((n = recvmsg(aas->fd, &msg, 0)) < 0)
+			return -errno;
+		if (!n && outlen)
+			return -EIO;
+		outlen -= n;
+		iov_advance(&p, &nout, n);
+	} while (outlen);
+
+	return 0;
+}
+
+int af_alg_hash_update(const struct af_alg *aas, const uint8_t *data,
+		size_t len)
+{
+	ssize_t n;
+
+	if ((n = send(aas->fd, data, len, MSG_MORE)) < 0)
+		return -errno;
+	return n == len ? 0 : -EIO;
+}
+
+// Hash the last of the data and read the digest.
+int af_alg_hash_final(const struct af_alg *aas, uint8_t *digest, size_t dlen,
+		const uint8_t *data, size_t len)
+{
+	ssize_t n;
+
+	if ((n = send(aas->fd, data, len, 0)) < 0)
+		return -errno;
+	if (n != len)
+		return -EIO;
+	if ((n = read(aas->fd, digest, dlen)) < 0)
+		return -errno;
+	return n == dlen ? 0 : -EIO;
+}
+
 #endif
@@ -35,23 +35,78 @@ extern "C" {
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #ifndef SOL_ALG
 #define SOL_ALG 279
 #endif
 
+/* The most data queued on a socket by a single request.  This stays well under
+ * the default socket buffer size, so a request never waits for buffer space
+ * that only reading its own output would free, and it fits in a pipe.
+ */
+#define AF_ALG_MAX_REQUEST (64 * 1024)
+// The most iovecs that can be passed to af_alg_crypt.
+#define AF_ALG_MAX_IOV 4
+
 struct af_alg {
 	int sockfd;
 	int fd;
+	int pipefd[2];
 	struct sockaddr_alg sa;
 };
 
+/* A request for af_alg_crypt.  If iv is NULL, the IV left by the previous
+ * request is used.  assoclen is only sent if aead is set.
+ */
+struct af_alg_op {
+	const uint8_t *iv;
+	size_t ivlen;
+	size_t assoclen;
+	int decrypt;
+	int aead;
+};
+
+/* An info2 operation that only the linuxblock implementations understand, so
+ * that the kernel modes can use their key without it ever being handed out.
+ * in is a parameter named "request" whose value points to a struct
+ * af_alg_keyreq; the block cipher opens alg on tmpl(its kernel cipher name),
+ * keys it with its own key followed by extra, and sets the tag length if
+ * taglen is nonzero.  Without a request, it only reports that it is supported.
+ * This is internal to the Linux plugins and not part of the block interface.
+ */
+#define AF_ALG_BLOCK_KEY_SOCKET 0x41460001
+
+struct af_alg_keyreq {
+	struct af_alg *alg;
+	const char *type;
+	const char *tmpl;
+	const uint8_t *extra;
+	size_t extralen;
+	size_t taglen;
+};
+
+int af_alg_available(void);
 int af_alg_initialize(struct af_alg *aas);
+void af_alg_close(struct af_alg *aas);
 int af_alg_open_socket(struct af_alg *aas, const char *type, const char *algo);
 int af_alg_set_key(struct af_alg *aas, const uint8_t *key, size_t len);
+int af_alg_set_authsize(struct af_alg *aas, size_t len);
 int af_alg_make_socket(struct af_alg *aas);
+int af_alg_open_keyed(struct af_alg *aas, const char *type, const char *tmpl,
+		const char *algo, const uint8_t *key, size_t keylen,
+		size_t taglen);
+int af_alg_clone_socket(struct af_alg *newaas, const struct af_alg *aas,
+		int state);
 int af_alg_do_crypt(const struct af_alg *aas, uint8_t *out, const uint8_t *in,
 		size_t len, int decrypt);
+int af_alg_crypt(struct af_alg *aas, const struct af_alg_op *op,
+		const struct iovec *in, size_t nin, const struct iovec *out,
+		size_t nout);
+int af_alg_hash_update(const struct af_alg *aas, const uint8_t *data,
+		size_t len);
+int af_alg_hash_final(const struct af_alg *aas, uint8_t *digest, size_t dlen,
+		const uint8_t *data, size_t len);
 
 #ifdef __cplusplus
 }
@@ -21,16 +21,23 @@
 #include "util.h"
 
 #include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _THREAD_SAFE
+#include <pthread.h>
+#endif
+
 #include <drew/bignum.h>
 #include <drew/mem.h>
 #include <drew/pkenc.h>
 #include <drew/plugin.h>
+#include <drew/prng.h>
 
 #define DIM(x) (sizeof(x)/sizeof((x)[0]))
 
@@ -41,6 +48,11 @@ struct rsa {
 	drew_bignum_t *e;
 	drew_bignum_t *d;
 	drew_bignum_t *n;
+	drew_bignum_t *dp;
+	drew_bignum_t *dq;
+	drew_bignum_mont_t *mont;
+	drew_bignum_mont_t *montp;
+	drew_bignum_mont_t *montq;
 };
 
 static int rsa_info(int op, void *p);
@@ -130,10 +142,103 @@ static int rsa_info2(const drew_pkenc_t *ctx, int op, drew_param_t *out,
 	}
 }
 
+#define TEST_GENERATE_BITS 512
+
+/* Generates a small key and checks that n = pq, that ed = 1 mod lcm(p - 1,
+ * q - 1), and that a random message comes back from encryption and decryption
+ * using the CRT.  Key generation needs a PRNG, so this is skipped if
+ * DevURandom isn't available.
+ */
+static int rsa_test_generate(DrewLoader *ldr, const drew_bignum_functbl_t *ft)
+{
+	uint8_t buf[TEST_GENERATE_BITS / 8 - 1];
+	drew_bignum_t bn, t, m, pm1, qm1, lambda;
+	drew_param_t param[3];
+	drew_prng_t prng;
+	drew_pkenc_t ctx;
+	const struct rsa *c;
+	const void *tbl;
+	int res = 0, id;
+
+	if ((id = drew_loader_lookup_by_name(ldr, "DevURandom", 0, -1)) < 0)
+		return 0;
+	if ((res = drew_loader_get_functbl(ldr, id, &tbl)) < 0)
+		return res;
+	prng.functbl = tbl;
+	if ((res = prng.functbl->init(&prng, 0, ldr, NULL)))
+		return res;
+
+	bn.functbl = t.functbl = m.functbl = ft;
+	pm1.functbl = qm1.functbl = lambda.functbl = ft;
+	ft->init(&bn, 0, ldr, NULL);
+	ft->init(&t, 0, ldr, NULL);
+	ft->init(&m, 0, ldr, NULL);
+	ft->init(&pm1, 0, ldr, NULL);
+	ft->init(&qm1, 0, ldr, NULL);
+	ft->init(&lambda, 0, ldr, NULL);
+
+	param[0].name = "bignum";
+	param[0].param.value = &bn;
+	param[0].next = NULL;
+	param[1].name = "prng";
+	param[1].param.value = &prng;
+	param[1].next = &param[2];
+	param[2].name = "bits";
+	param[2].param.number = TEST_GENERATE_BITS;
+	param[2].next = NULL;
+
+	ctx.functbl = &rsa_functbl;
+	if (ctx.functbl->init(&ctx, 0, ldr, param)) {
+		res = 1;
+		goto out;
+	}
+	if (ctx.functbl->generate(&ctx, param+1)) {
+		res = 1;
+		goto fini;
+	}
+	c = ctx.ctx;
+
+	ft->mul(&t, c->p, c->q);
+	res |= !!ft->compare(&t, c->n, 0);
+	res |= ft->nbits(c->n) != TEST_GENERATE_BITS;
+
+	res <<= 1;
+	ft->setsmall(&t, 1);
+	ft->sub(&pm1, c->p, &t);
+	ft->sub(&qm1, c->q, &t);
+	ft->gcd(&t, &pm1, &qm1);
+	ft->mul(&lambda, &pm1, &qm1);
+	ft->div(&lambda, NULL, &lambda, &t);
+	ft->mulmod(&t, c->e, c->d, &lambda);
+	res |= !!ft->comparesmall(&t, 1);
+
+	res <<= 1;
+	res |= !have_crt(c);
+	prng.functbl->bytes(&prng, buf, sizeof(buf));
+	ft->setbytes(&m, buf, sizeof(buf));
+	ctx.functbl->encrypt(&ctx, &t, &m);
+	res |= !ft->compare(&t, &m, 0);
+	ctx.functbl->decrypt(&ctx, &t, &t);
+	res |= !!ft->compare(&t, &m, 0);
+
+fini:
+	ctx.functbl->fini(&ctx, 0);
+out:
+	ft->fini(&bn, 0);
+	ft->fini(&t, 0);
+	ft->fini(&m, 0);
+	ft->fini(&pm1, 0);
+	ft->fini(&qm1, 0);
+	ft->fini(&lambda, 0);
+	prng.functbl->fini(&prng, 0);
+	return res;
+}
+
 static int rsa_test(void *ptr, DrewLoader *ldr)
 {
 	uint8_t p[] = {0x3d}, q[] = {0x35}, n[] = {0x0c, 0xa1}, e[] = {0x11},
-			d[] = {0x0a, 0xc1}, m[] = {0x41}, c[] = {0x0a, 0xe6};
+			d[] = {0x0a, 0xc1}, m[] = {0x41}, c[] = {0x0a, 0xe6},
+			dp[] = {0x35}, dq[] = {0x31}, u[] = {0x26};
 	uint8_t buf[2];
 	const void *functbl;
 	drew_pkenc_t ctx;
@@ -176,9 +281,21 @@ static int rsa_test(void *ptr, DrewLoader *ldr)
 	bns[0].functbl->bytes(&bns[0], buf, sizeof(buf));
 	res <<= 1;
 	res |= !!memcmp(buf, m, sizeof(m));
+	// With the CRT parameters set, the private operation uses them.
+	ctx.functbl->setval(&ctx, "dp", dp, DIM(dp));
+	ctx.functbl->setval(&ctx, "dq", dq, DIM(dq));
+	ctx.functbl->setval(&ctx, "u", u, DIM(u));
+	bns[0].functbl->setbytes(&bns[0], c, sizeof(c));
+	ctx.functbl->decrypt(&ctx, bns, bns);
+	bns[0].functbl->bytes(&bns[0], buf, sizeof(buf));
+	res <<= 1;
+	res |= !!memcmp(buf, m, sizeof(m));
 	ctx.functbl->fini(&ctx, 0);
 	bns[0].functbl->fini(&bns[0], 0);
 
+	res <<= 3;
+	res |= rsa_test_generate(ldr, functbl);
+
 	return res;
 }
 
@@ -213,7 +330,8 @@ static int rsa_fini(drew_pkenc_t *ctx, int flags)
 }
 
 #define CLONE(new, old, x) do { if (!(old)->x) new->x = NULL; \
-	else old->x->functbl->clone(new->x, old->x, 0); } while (0)
+	else { new->x = drew_mem_malloc(sizeof(*new->x)); \
+		old->x->functbl->clone(new->x, old->x, 0); } } while (0)
 
 static int rsa_clone(drew_pkenc_t *newctx, const drew_pkenc_t *oldctx,
 		int flags)
@@ -230,13 +348,17 @@ static int rsa_clone(drew_pkenc_t *newctx, const drew_pkenc_t *oldctx,
 	CLONE(new, old, e);
 	CLONE(new, old, d);
 	CLONE(new, old, n);
+	CLONE(new, old, dp);
+	CLONE(new, old, dq);
+	clone_mont(new, old);
 	newctx->functbl = oldctx->functbl;
 	return 0;
 }
 
 static int rsa_generate(drew_pkenc_t *ctx, const drew_param_t *param)
 {
-	return -DREW_ERR_NOT_IMPL;
+	struct rsa *c = ctx->ctx;
+	return generate(c, param);
 }
 
 static int rsa_setmode(drew_pkenc_t *ctx, int flags)
@@ -0,0 +1,163 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "internal.h"
+#include "util.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef _THREAD_SAFE
+#include <pthread.h>
+#endif
+
+#include <drew/bignum.h>
+#include <drew/mem.h>
+#include <drew/param.h>
+
+#include "batch.h"
+
+HIDE()
+/* This is Montgomery's trick: inv[i] first holds the product of the first i + 1
+ * values, the inverse of the whole product is computed once, and then walking
+ * backwards, each inverse is the running inverse times the preceding product.
+ */
+int pksig_batch_invmod(drew_bignum_t *inv, const drew_bignum_t *a,
+		size_t stride, size_t n, const drew_bignum_t *m)
+{
+	const drew_bignum_functbl_t *ft = m->functbl;
+	drew_bignum_t t, x;
+	bool *zero;
+	int res = 0;
+
+	if (!n)
+		return 0;
+	if (!(zero = drew_mem_malloc(n * sizeof(*zero))))
+		return -ENOMEM;
+	ft->init(&t, 0, NULL, NULL);
+	ft->init(&x, 0, NULL, NULL);
+
+	for (size_t i = 0; i < n; i++) {
+		ft->mod(&x, a + i * stride, m);
+		// Zeros are replaced with one so they don't spoil the product.
+		if ((zero[i] = !ft->comparesmall(&x, 0)))
+			ft->setsmall(&x, 1);
+		if (i)
+			ft->mulmod(inv + i, inv + i - 1, &x, m);
+		else
+			ft->mod(inv, &x, m);
+	}
+	if (ft->invmod(&t, inv + n - 1, m)) {
+		res = -DREW_ERR_INVALID;
+		goto out;
+	}
+	for (size_t i = n - 1; i > 0; i--) {
+		ft->mulmod(inv + i, &t, inv + i - 1, m);
+		if (zero[i])
+			ft->setsmall(&x, 1);
+		else
+			ft->mod(&x, a + i * stride, m);
+		ft->mulmod(&t, &t, &x, m);
+	}
+	ft->mod(inv, &t, m);
+	for (size_t i = 0; i < n; i++)
+		if (zero[i])
+			ft->setzero(inv + i);
+out:
+	ft->fini(&t, 0);
+	ft->fini(&x, 0);
+	drew_mem_free(zero);
+	return res;
+}
+
+#ifdef _THREAD_SAFE
+static size_t nthreads(const drew_param_t *param, size_t n)
+{
+	size_t count = 1;
+
+	for (const drew_param_t *p = param; p; p = p->next)
+		if (!strcmp(p->name, "threads"))
+			count = p->param.number;
+	return count < 1 ? 1 : count > n ? n : count;
+}
+
+struct job {
+	pksig_batch_fn fn;
+	void *arg;
+	size_t start, end;
+	int res;
+	pthread_t thread;
+	bool started;
+};
+
+static void *run_job(void *p)
+{
+	struct job *j = p;
+
+	j->res = j->fn(j->arg, j->start, j->end);
+	return NULL;
+}
+
+int pksig_batch_run(pksig_batch_fn fn, void *arg, size_t n,
+		const drew_param_t *param)
+{
+	const size_t count = nthreads(param, n);
+	struct job *jobs;
+	int res = 0;
+
+	if (count <= 1)
+		return fn(arg, 0, n);
+	if (!(jobs = drew_mem_malloc(count * sizeof(*jobs))))
+		return -ENOMEM;
+
+	for (size_t i = 0; i < count; i++) {
+		struct job *j = jobs + i;
+
+		j->fn = fn;
+		j->arg = arg;
+		j->start = n * i / count;
+		j->end = n * (i + 1) / count;
+		j->res = 0;
+		// The first range is done on this thread.
+		j->started = i && !pthread_create(&j->thread, NULL, run_job, j);
+	}
+	for (size_t i = 0; i < count; i++)
+		if (!jobs[i].started)
+			run_job(jobs + i);
+	for (size_t i = 0; i < count; i++) {
+		if (jobs[i].started)
+			pthread_join(jobs[i].thread, NULL);
+		if (!res)
+			res = jobs[i].res;
+	}
+	drew_mem_free(jobs);
+	return res;
+}
+#else
+int pksig_batch_run(pksig_batch_fn fn, void *arg, size_t n,
+		const drew_param_t *param)
+{
+	return fn(arg, 0, n);
+}
+#endif
+UNHIDE()
@@ -0,0 +1,48 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* Helpers shared by the verifybatch implementations. */
+#ifndef DREW_PKSIG_BATCH_H
+#define DREW_PKSIG_BATCH_H
+
+#include <stddef.h>
+
+#include <drew/bignum.h>
+#include <drew/param.h>
+
+/* Sets inv[i] to the inverse of a[i * stride] modulo the prime m, using a
+ * single modular inversion for all n values.  Values which are zero modulo m
+ * have no inverse; inv[i] is set to zero for those.  inv must point to n
+ * initialized bignums.
+ */
+int pksig_batch_invmod(drew_bignum_t *inv, const drew_bignum_t *a,
+		size_t stride, size_t n, const drew_bignum_t *m);
+
+/* Calls fn(arg, start, end) over ranges covering [0, n).  If param has a
+ * "threads" number greater than one, the ranges are run on up to that many
+ * threads at once; otherwise fn is called once for the whole range.  Returns
+ * the first error returned by fn.
+ */
+typedef int (*pksig_batch_fn)(void *arg, size_t start, size_t end);
+int pksig_batch_run(pksig_batch_fn fn, void *arg, size_t n,
+		const drew_param_t *param);
+
+#endif
@@ -33,14 +33,50 @@
 #include <drew/pksig.h>
 #include <drew/plugin.h>
 
+#include "batch.h"
+
 #define DIM(x) (sizeof(x)/sizeof((x)[0]))
 
+/* The size of the fixed-base comb used for powers of g.  The exponent is split
+ * into COMB_TEETH rows of spacing bits, and the columns into COMB_BLOCKS blocks
+ * with a table of 2^COMB_TEETH entries each, so an exponentiation takes about
+ * n/(COMB_TEETH*COMB_BLOCKS) squarings and n/COMB_TEETH multiplications, where
+ * n is the size of q.
+ */
+#define COMB_TEETH 8
+#define COMB_BLOCKS 2
+/* Building the comb costs about as much as a dozen exponentiations, so it is
+ * only built once a context has signed, or verified in batches, this many times
+ * with the same parameters.
+ */
+#define COMB_MIN_USES 16
+/* With combs for both g and y, a verification costs about a fifth of a
+ * simultaneous exponentiation, so a batch of this many signatures pays for a
+ * comb for y.
+ */
+#define BATCH_COMB_MIN 8
+
+/* table[j][i] is the product of b^(2^(t * spacing + j * width)) over the bits t
+ * set in i, in Montgomery form, where b is the base.  The comb for g depends
+ * only on p, q, and g, and is shared by a context and all of its clones.
+ * verifybatch builds one for y for the length of a batch.
+ */
+struct comb {
+	int refs;
+	size_t spacing;
+	size_t width;
+	drew_bignum_t table[COMB_BLOCKS][1 << COMB_TEETH];
+};
+
 struct dsa {
 	drew_bignum_t *p;
 	drew_bignum_t *q;
 	drew_bignum_t *g;
 	drew_bignum_t *y;
 	drew_bignum_t *x;
+	drew_bignum_mont_t *mont;
+	struct comb *comb;
+	unsigned uses;
 };
 
 static int dsa_info(int op, void *p);
@@ -60,7 +96,10 @@ static int dsa_sign(const drew_pksig_t *, drew_bignum_t *,
 static int dsa_verify(const drew_pksig_t *, drew_bignum_t *,
 		const drew_bignum_t *);
 static int dsa_test(void *, DrewLoader *);
-
+static int dsa_verifybatch(const drew_pksig_t *, drew_bignum_t *,
+		const drew_bignum_t *, int *, size_t, const drew_param_t *);
+static int dsa_signbatch(const drew_pksig_t *, drew_bignum_t *,
+		const drew_bignum_t *, int *, size_t, const drew_param_t *);
 
 static const drew_pksig_functbl_t dsa_functbl = {
 	.info = dsa_info,
@@ -75,7 +114,9 @@ static const drew_pksig_functbl_t dsa_functbl = {
 	.valsize = dsa_valsize,
 	.sign = dsa_sign,
 	.verify = dsa_verify,
-	.test = dsa_test
+	.test = dsa_test,
+	.verifybatch = dsa_verifybatch,
+	.signbatch = dsa_signbatch
 };
 
 struct mapping {
@@ -126,7 +167,7 @@ static int dsa_info(int op, void *p)
 	};
 	switch (op) {
 		case DREW_PKSIG_VERSION:
-			return CURRENT_ABI;
+			return DREW_PKSIG_ABI_SIGNBATCH;
 		case DREW_PKSIG_INTSIZE:
 			return sizeof(struct dsa);
 		case DREW_PKSIG_SIGN_IN:
@@ -163,7 +204,7 @@ static int dsa_info2(const drew_pksig_t *ctx, int op, drew_param_t *out,
 {
 	switch (op) {
 		case DREW_PKSIG_VERSION:
-			return CURRENT_ABI;
+			return DREW_PKSIG_ABI_SIGNBATCH;
 		case DREW_PKSIG_INTSIZE:
 			return sizeof(struct dsa);
 		default:
@@ -174,6 +215,47 @@ static int dsa_info2(const drew_pksig_t *ctx, int op, drew_param_t *out,
 /* Tests from sigver.rsp from NIST's 186-2dsatestvectors.zip.  k values are
  * computed using a perl script.
  */
+#define TEST_BATCH 12
+
+/* Verifies a batch of copies of the signature in sig (r, s and h), with s
+ * changed in every third one and zero in the last one, and checks the result
+ * for each.  The batch is large enough for verifybatch to use the combs.
+ */
+static int dsa_test_batch(const drew_pksig_t *ctx, const drew_bignum_t *sig)
+{
+	const drew_bignum_functbl_t *ft = sig->functbl;
+	drew_bignum_t in[TEST_BATCH * 3], out[TEST_BATCH];
+	int bres[TEST_BATCH], res = 0;
+
+	for (size_t i = 0; i < TEST_BATCH; i++) {
+		drew_bignum_t *s = in + i * 3 + 1;
+
+		for (size_t j = 0; j < 3; j++)
+			ft->clone(in + i * 3 + j, sig + j, 0);
+		ft->init(out+i, 0, NULL, NULL);
+		if (i == TEST_BATCH - 1)
+			ft->setzero(s);
+		else if (i % 3 == 1)
+			ft->setbit(s, 0, !ft->getbit(s, 0));
+	}
+	if (ctx->functbl->verifybatch(ctx, out, in, bres, TEST_BATCH, NULL))
+		res = 1;
+	for (size_t i = 0; i < TEST_BATCH - 1; i++) {
+		const bool valid = !ft->compare(out+i, in + i * 3, 0);
+
+		res |= !!bres[i];
+		res |= valid == (i % 3 == 1);
+	}
+	res |= bres[TEST_BATCH - 1] != -DREW_ERR_INVALID;
+
+	for (size_t i = 0; i < TEST_BATCH; i++) {
+		for (size_t j = 0; j < 3; j++)
+			ft->fini(in + i * 3 + j, 0);
+		ft->fini(out+i, 0);
+	}
+	return res;
+}
+
 static int dsa_test(void *ptr, DrewLoader *ldr)
 {
 	uint8_t p[] = {
@@ -324,7 +406,9 @@ static int dsa_test(void *ptr, DrewLoader *ldr)
 	int res = 0, id;
 	drew_param_t param;
 	const char *bignum = "Bignum";
-	drew_bignum_t bns[7]; // v, r, s, h, k, computed r, computed s.
+	// v, r, s, h, k, computed r, computed s, batch v.
+	drew_bignum_t bns[8];
+	int bres;
 
 	id = drew_loader_lookup_by_name(ldr, bignum, 0, -1);
 	if (id < 0)
@@ -351,6 +435,8 @@ static int dsa_test(void *ptr, DrewLoader *ldr)
 	ctx.functbl->setval(&ctx, "p", p, DIM(p));
 	ctx.functbl->setval(&ctx, "q", q, DIM(q));
 	ctx.functbl->setval(&ctx, "g", g, DIM(g));
+	// Make sign build and use the comb right away.
+	((struct dsa *)ctx.ctx)->uses = COMB_MIN_USES;
 	for (size_t i = 0; i < DIM(tests); i++) {
 		ctx.functbl->setval(&ctx, "x", tests[i].x, DIM(tests[i].x));
 		ctx.functbl->setval(&ctx, "y", tests[i].y, DIM(tests[i].y));
@@ -360,16 +446,30 @@ static int dsa_test(void *ptr, DrewLoader *ldr)
 		ctx.functbl->verify(&ctx, bns, bns+1);
 		res <<= 1;
 		res |= (tests[i].success == !!bns[1].functbl->compare(&bns[1], &bns[0], 0));
+		ctx.functbl->verifybatch(&ctx, bns+7, bns+1, &bres, 1, NULL);
+		res |= !!bres;
+		res |= !!bns[0].functbl->compare(&bns[0], &bns[7], 0);
 		if (tests[i].success) {
 			bns[4].functbl->setbytes(&bns[4], tests[i].k, DIM(tests[i].k));
 			ctx.functbl->sign(&ctx, bns+5, bns+3);
 			res <<= 1;
 			res |= !!bns[1].functbl->compare(&bns[1], &bns[5], 0);
 			res |= !!bns[2].functbl->compare(&bns[2], &bns[6], 0);
+			bns[5].functbl->setzero(&bns[5]);
+			bns[6].functbl->setzero(&bns[6]);
+			ctx.functbl->signbatch(&ctx, bns+5, bns+3, &bres, 1,
+					NULL);
+			res |= !!bres;
+			res |= !!bns[1].functbl->compare(&bns[1], &bns[5], 0);
+			res |= !!bns[2].functbl->compare(&bns[2], &bns[6], 0);
 		}
 	}
 
-	for (size_t i = 0; i < 4; i++)
+	// The last test is a valid signature, and the comb for g is built.
+	res <<= 1;
+	res |= dsa_test_batch(&ctx, bns+1);
+
+	for (size_t i = 0; i < DIM(bns); i++)
 		bns[i].functbl->fini(&bns[i], 0);
 	ctx.functbl->fini(&ctx, 0);
 
@@ -393,8 +493,165 @@ static void free_bignum(drew_bignum_t *ctx)
 	drew_mem_free(ctx);
 }
 
+static void comb_release(struct comb *comb)
+{
+	if (!comb || __atomic_sub_fetch(&comb->refs, 1, __ATOMIC_ACQ_REL))
+		return;
+	for (size_t j = 0; j < COMB_BLOCKS; j++)
+		for (size_t i = 0; i < DIM(comb->table[j]); i++)
+			comb->table[j][i].functbl->fini(&comb->table[j][i], 0);
+	drew_mem_free(comb);
+}
+
+// Sets r to a^(2^n), for n at least 1.
+static void squaremod_n(const drew_bignum_mont_t *m, drew_bignum_t *r,
+		const drew_bignum_t *a, size_t n)
+{
+	r->functbl->montsquare(m, r, a);
+	while (--n)
+		r->functbl->montsquare(m, r, r);
+}
+
+static struct comb *comb_new(const struct dsa *c, const drew_bignum_t *base)
+{
+	const drew_bignum_functbl_t *ft = c->p->functbl;
+	const drew_bignum_mont_t *m = c->mont;
+	const size_t nbits = ft->nbits(c->q);
+	struct comb *comb;
+
+	if (!m || !nbits || !(comb = drew_mem_malloc(sizeof(*comb))))
+		return NULL;
+
+	comb->refs = 1;
+	comb->spacing = (nbits + COMB_TEETH - 1) / COMB_TEETH;
+	comb->width = (comb->spacing + COMB_BLOCKS - 1) / COMB_BLOCKS;
+	for (size_t j = 0; j < COMB_BLOCKS; j++) {
+		drew_bignum_t *table = comb->table[j];
+
+		for (size_t i = 0; i < DIM(comb->table[j]); i++)
+			ft->init(table+i, 0, NULL, NULL);
+		ft->setsmall(table+0, 1);
+		ft->montset(m, table+0, table+0);
+		// The single teeth: b^(2^(t * spacing + j * width)).
+		for (size_t t = 0; t < COMB_TEETH; t++) {
+			drew_bignum_t *tooth = table + (1 << t);
+
+			if (j)
+				squaremod_n(m, tooth,
+						comb->table[j-1] + (1 << t),
+						comb->width);
+			else if (t)
+				squaremod_n(m, tooth, table + (1 << (t-1)),
+						comb->spacing);
+			else
+				ft->montset(m, tooth, base);
+		}
+		// Everything else is a product of two smaller entries.
+		for (size_t i = 3; i < DIM(comb->table[j]); i++)
+			if (i & (i-1))
+				ft->montmul(m, table+i, table + (i & (i-1)),
+						table + (i & -i));
+	}
+	return comb;
+}
+
+/* Returns the comb for g, building it if it is worth it.  If two threads get
+ * here at the same time, both build a comb and one of them is thrown away.
+ */
+static const struct comb *get_comb(struct dsa *c)
+{
+	struct comb *comb, *none = NULL;
+
+	if ((comb = __atomic_load_n(&c->comb, __ATOMIC_ACQUIRE)))
+		return comb;
+	if (__atomic_add_fetch(&c->uses, 1, __ATOMIC_RELAXED) <= COMB_MIN_USES)
+		return NULL;
+	if (!(comb = comb_new(c, c->g)))
+		return NULL;
+	if (__atomic_compare_exchange_n(&c->comb, &none, comb, false,
+				__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		return comb;
+	comb_release(comb);
+	return none;
+}
+
+// Returns bit i of the big-endian number in buf.
+static size_t get_bit(const uint8_t *buf, size_t len, size_t i)
+{
+	return i / 8 < len ? (buf[len - 1 - i / 8] >> (i % 8)) & 1 : 0;
+}
+
+// Returns the table index for column col of the exponent in buf.
+static size_t comb_index(const struct comb *comb, const uint8_t *buf,
+		size_t len, size_t col)
+{
+	size_t index = 0;
+
+	if (col >= comb->spacing)
+		return 0;
+	for (size_t t = 0; t < COMB_TEETH; t++)
+		index |= get_bit(buf, len, col + t * comb->spacing) << t;
+	return index;
+}
+
+/* Sets r to the product of the base of combs[i] to the power k[i] mod p, for i
+ * less than n, which is at most two.  The combs must be for the same q, and
+ * share their squarings.  Every column does the same multiplications, using
+ * the entry for the empty set (which is 1) when no bits are set.
+ */
+static int comb_expmod(const struct comb *const *combs,
+		const drew_bignum_t *const *k, size_t n, const drew_bignum_mont_t *m,
+		drew_bignum_t *r)
+{
+	const struct comb *comb = combs[0];
+	uint8_t *buf[2] = {NULL, NULL};
+	int len[2] = {0, 0}, res = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		len[i] = k[i]->functbl->nbytes(k[i]);
+		if (len[i] < 0 ||
+				k[i]->functbl->nbits(k[i]) > comb->spacing * COMB_TEETH) {
+			res = -DREW_ERR_NOT_IMPL;
+			goto out;
+		}
+		if (!(buf[i] = drew_mem_malloc(len[i] + 1))) {
+			res = -ENOMEM;
+			goto out;
+		}
+		if (k[i]->functbl->bytes(k[i], buf[i], len[i])) {
+			res = -DREW_ERR_NOT_IMPL;
+			goto out;
+		}
+	}
+
+	r->functbl->setsmall(r, 1);
+	r->functbl->montset(m, r, r);
+	for (size_t col = comb->width; col-- > 0; ) {
+		if (col + 1 < comb->width)
+			r->functbl->montsquare(m, r, r);
+		for (size_t i = 0; i < n; i++)
+			for (size_t j = 0; j < COMB_BLOCKS; j++) {
+				const size_t index = comb_index(combs[i], buf[i],
+						len[i], j * comb->width + col);
+				r->functbl->montmul(m, r, r,
+						combs[i]->table[j] + index);
+			}
+	}
+	r->functbl->montget(m, r, r);
+out:
+	for (size_t i = 0; i < n; i++)
+		if (buf[i]) {
+			memset(buf[i], 0, len[i]);
+			drew_mem_free(buf[i]);
+		}
+	return res;
+}
+
 static int fini(struct dsa *c, int flags)
 {
+	comb_release(c->comb);
+	if (c->mont)
+		c->p->functbl->montfini(c->mont);
 	free_bignum(c->p);
 	free_bignum(c->q);
 	free_bignum(c->g);
@@ -477,7 +734,8 @@ static int dsa_fini(drew_pksig_t *ctx, int flags)
 }
 
 #define CLONE(new, old, x) do { if (!(old)->x) new->x = NULL; \
-	else old->x->functbl->clone(new->x, old->x, 0); } while (0)
+	else { new->x = drew_mem_malloc(sizeof(*new->x)); \
+		old->x->functbl->clone(new->x, old->x, 0); } } while (0)
 
 static int dsa_clone(drew_pksig_t *newctx, const drew_pksig_t *oldctx,
 		int flags)
@@ -493,6 +751,10 @@ static int dsa_clone(drew_pksig_t *newctx, const drew_pksig_t *oldctx,
 	CLONE(new, old, g);
 	CLONE(new, old, x);
 	CLONE(new, old, y);
+	if (old->mont)
+		new->p->functbl->montinit(&new->mont, new->p);
+	if ((new->comb = old->comb))
+		__atomic_add_fetch(&new->comb->refs, 1, __ATOMIC_RELAXED);
 	newctx->functbl = oldctx->functbl;
 	return 0;
 }
@@ -518,6 +780,23 @@ static int dsa_setval(drew_pksig_t *ctx, const char *name, const uint8_t *buf,
 
 	drew_bignum_t *bn = *p;
 	bn->functbl->setbytes(bn, buf, len);
+	// The comb depends on the domain parameters, but not the key.
+	if (strchr("pqg", *name)) {
+		comb_release(c->comb);
+		c->comb = NULL;
+		c->uses = 0;
+	}
+	/* This fails for an even p or a bignum without the Montgomery functions,
+	 * and then the plain operations are used.
+	 */
+	if (*name == 'p') {
+		if (c->mont)
+			bn->functbl->montfini(c->mont);
+		c->mont = NULL;
+		if (bn->functbl->info(DREW_BIGNUM_VERSION, NULL) >=
+				DREW_BIGNUM_ABI_MONT)
+			bn->functbl->montinit(&c->mont, bn);
+	}
 	return 0;
 }
 
@@ -542,12 +821,51 @@ static int dsa_valsize(const drew_pksig_t *ctx, const char *name)
 	return (*p)->functbl->nbytes(*p);
 }
 
+/* v = g^u1 y^u2 mod p, with both exponentiations at once where possible.  combs
+ * holds the combs for g and y, or NULLs.
+ */
+static void verify_v(const struct dsa *c, const struct comb *const *combs,
+		drew_bignum_t *v, const drew_bignum_t *u1, const drew_bignum_t *u2)
+{
+	const drew_bignum_functbl_t *ft = v->functbl;
+	const drew_bignum_t *k[2] = {u1, u2};
+	drew_bignum_t t;
+
+	if (combs[0] && combs[1] && !comb_expmod(combs, k, 2, c->mont, v))
+		return;
+	if (c->mont)
+		ft->montexp2(c->mont, v, c->g, u1, c->y, u2);
+	else if (ft->info(DREW_BIGNUM_VERSION, NULL) >= DREW_BIGNUM_ABI_EXPMOD2)
+		ft->expmod2(v, c->g, u1, c->y, u2, c->p);
+	else {
+		ft->init(&t, 0, NULL, NULL);
+		ft->expmod(&t, c->y, u2, c->p);
+		ft->expmod(v, c->g, u1, c->p);
+		ft->mulmod(v, v, &t, c->p);
+		ft->fini(&t, 0);
+	}
+}
+
+// r = (g^k mod p) mod q.
+static void sign_r(const struct dsa *c, const struct comb *comb,
+		drew_bignum_t *r, const drew_bignum_t *k)
+{
+	if (!comb || comb_expmod(&comb, &k, 1, c->mont, r)) {
+		if (c->mont)
+			r->functbl->montexp(c->mont, r, c->g, k);
+		else
+			r->functbl->expmod(r, c->g, k, c->p);
+	}
+	r->functbl->mod(r, r, c->q);
+}
+
 static int dsa_sign(const drew_pksig_t *ctx, drew_bignum_t *out,
 		const drew_bignum_t *in)
 {
 	struct dsa *c = ctx->ctx;
-	drew_bignum_t t, kinv, z, *p = c->p, *q = c->q, *r = out, *s = out+1;
+	drew_bignum_t t, kinv, z, *q = c->q, *r = out, *s = out+1;
 	const drew_bignum_t *h = in, *k = in+1;
+	const struct comb *comb = get_comb(c);
 	int res = 0;
 
 	r->functbl->init(&z, 0, NULL, NULL);
@@ -555,8 +873,7 @@ static int dsa_sign(const drew_pksig_t *ctx, drew_bignum_t *out,
 	r->functbl->init(&kinv, 0, NULL, NULL);
 	z.functbl->setzero(&z);
 	kinv.functbl->invmod(&kinv, k, q);
-	r->functbl->expmod(r, c->g, k, p);
-	r->functbl->mod(r, r, q);
+	sign_r(c, comb, r, k);
 	t.functbl->mul(&t, c->x, r);
 	t.functbl->mod(&t, &t, c->q);
 	t.functbl->add(&t, &t, h);
@@ -567,6 +884,7 @@ static int dsa_sign(const drew_pksig_t *ctx, drew_bignum_t *out,
 		res = -DREW_ERR_INVALID;
 	t.functbl->fini(&t, 0);
 	kinv.functbl->fini(&kinv, 0);
+	z.functbl->fini(&z, 0);
 	return res;
 }
 
@@ -577,14 +895,13 @@ static int dsa_verify(const drew_pksig_t *ctx, drew_bignum_t *out,
 	const drew_bignum_t *r = in, *s = in+1, *h = in+2;
 	drew_bignum_t *v = out;
 	drew_bignum_t wbuf, *w = &wbuf, u1buf, *u1 = &u1buf, u2buf, *u2 = &u2buf;
-	drew_bignum_t zbuf, *z = &zbuf, tbuf, *t = &tbuf;
+	drew_bignum_t zbuf, *z = &zbuf;
 	int res = 0;
 
 	r->functbl->init(w, 0, NULL, NULL);
 	r->functbl->init(u1, 0, NULL, NULL);
 	r->functbl->init(u2, 0, NULL, NULL);
 	r->functbl->init(z, 0, NULL, NULL);
-	r->functbl->init(t, 0, NULL, NULL);
 	z->functbl->setzero(z);
 	// Check whether either r or s is zero.
 	if (!r->functbl->compare(r, z, 0) || !s->functbl->compare(s, z, 0))
@@ -594,19 +911,161 @@ static int dsa_verify(const drew_pksig_t *ctx, drew_bignum_t *out,
 	u1->functbl->mod(u1, u1, c->q);
 	u2->functbl->mul(u2, r, w);
 	u2->functbl->mod(u2, u2, c->q);
-	v->functbl->expmod(v, c->g, u1, c->p);
-	t->functbl->expmod(t, c->y, u2, c->p);
-	v->functbl->mul(v, v, t);
-	v->functbl->mod(v, v, c->p);
+	verify_v(c, (const struct comb *[2]){NULL, NULL}, v, u1, u2);
 	v->functbl->mod(v, v, c->q);
 	w->functbl->fini(w, 0);
 	u1->functbl->fini(u1, 0);
 	u2->functbl->fini(u2, 0);
 	z->functbl->fini(z, 0);
-	t->functbl->fini(t, 0);
 	return res;
 }
 
+// combs holds the combs for g and, when verifying, y.
+struct batch {
+	const struct dsa *c;
+	const struct comb *combs[2];
+	drew_bignum_t *out;
+	const drew_bignum_t *in;
+	int *res;
+	size_t nin, nout;
+};
+
+/* This is verify for signatures start through end - 1, except that the
+ * inverses of s are computed all at once, and the exponentiations use the combs
+ * if there are any.
+ */
+static int verify_range(void *arg, size_t start, size_t end)
+{
+	const struct batch *b = arg;
+	const struct dsa *c = b->c;
+	const drew_bignum_t *in = b->in + start * b->nin;
+	const drew_bignum_functbl_t *ft = in->functbl;
+	const size_t count = end - start;
+	drew_bignum_t u1, u2, *w;
+	int res = 0;
+
+	if (!(w = drew_mem_malloc(count * sizeof(*w))))
+		return -ENOMEM;
+	for (size_t i = 0; i < count; i++)
+		ft->init(w+i, 0, NULL, NULL);
+	ft->init(&u1, 0, NULL, NULL);
+	ft->init(&u2, 0, NULL, NULL);
+
+	if ((res = pksig_batch_invmod(w, in+1, b->nin, count, c->q)))
+		goto out;
+	for (size_t i = 0; i < count; i++) {
+		const drew_bignum_t *r = in + i * b->nin, *s = r+1, *h = r+2;
+		drew_bignum_t *v = b->out + (start + i) * b->nout;
+		int *vres = b->res + start + i;
+
+		*vres = 0;
+		// Check whether either r or s is zero.
+		if (!ft->comparesmall(r, 0) || !ft->comparesmall(s, 0))
+			*vres = -DREW_ERR_INVALID;
+		ft->mulmod(&u1, h, w+i, c->q);
+		ft->mulmod(&u2, r, w+i, c->q);
+		verify_v(c, b->combs, v, &u1, &u2);
+		v->functbl->mod(v, v, c->q);
+	}
+out:
+	for (size_t i = 0; i < count; i++)
+		ft->fini(w+i, 0);
+	drew_mem_free(w);
+	ft->fini(&u1, 0);
+	ft->fini(&u2, 0);
+	return res;
+}
+
+static int dsa_verifybatch(const drew_pksig_t *ctx, drew_bignum_t *out,
+		const drew_bignum_t *in, int *res, size_t n, const drew_param_t *param)
+{
+	struct dsa *c = ctx->ctx;
+	struct comb *ycomb = NULL;
+	struct batch b;
+	int ret;
+
+	b.c = c;
+	b.combs[0] = b.combs[1] = NULL;
+	/* A large batch is worth a comb for y, which is shared by all of its
+	 * signatures, and its signatures count towards building the one for g.
+	 */
+	if (n >= BATCH_COMB_MIN) {
+		__atomic_add_fetch(&c->uses, n - 1, __ATOMIC_RELAXED);
+		if ((b.combs[0] = get_comb(c)))
+			b.combs[1] = ycomb = comb_new(c, c->y);
+	}
+	b.out = out;
+	b.in = in;
+	b.res = res;
+	b.nin = dsa_info(DREW_PKSIG_VERIFY_IN, NULL);
+	b.nout = dsa_info(DREW_PKSIG_VERIFY_OUT, NULL);
+	ret = pksig_batch_run(verify_range, &b, n, param);
+	comb_release(ycomb);
+	return ret;
+}
+
+/* This is sign for signatures start through end - 1, except that the inverses
+ * of k are computed all at once.
+ */
+static int sign_range(void *arg, size_t start, size_t end)
+{
+	const struct batch *b = arg;
+	const struct dsa *c = b->c;
+	const drew_bignum_t *in = b->in + start * b->nin;
+	const drew_bignum_functbl_t *ft = in->functbl;
+	const size_t count = end - start;
+	drew_bignum_t t, *kinv;
+	int res = 0;
+
+	if (!(kinv = drew_mem_malloc(count * sizeof(*kinv))))
+		return -ENOMEM;
+	for (size_t i = 0; i < count; i++)
+		ft->init(kinv+i, 0, NULL, NULL);
+	ft->init(&t, 0, NULL, NULL);
+
+	if ((res = pksig_batch_invmod(kinv, in+1, b->nin, count, c->q)))
+		goto out;
+	for (size_t i = 0; i < count; i++) {
+		const drew_bignum_t *h = in + i * b->nin, *k = h+1;
+		drew_bignum_t *r = b->out + (start + i) * b->nout, *s = r+1;
+
+		sign_r(c, b->combs[0], r, k);
+		ft->mulmod(&t, c->x, r, c->q);
+		ft->add(&t, &t, h);
+		ft->mulmod(s, kinv+i, &t, c->q);
+		// Check whether either r or s is zero.
+		b->res[start + i] = !ft->comparesmall(r, 0) ||
+			!ft->comparesmall(s, 0) ? -DREW_ERR_INVALID : 0;
+	}
+out:
+	for (size_t i = 0; i < count; i++)
+		ft->fini(kinv+i, 0);
+	drew_mem_free(kinv);
+	ft->fini(&t, 0);
+	return res;
+}
+
+static int dsa_signbatch(const drew_pksig_t *ctx, drew_bignum_t *out,
+		const drew_bignum_t *in, int *res, size_t n, const drew_param_t *param)
+{
+	struct dsa *c = ctx->ctx;
+	struct batch b;
+
+	if (!n)
+		return 0;
+	// Every signature in the batch counts towards building the comb.
+	__atomic_add_fetch(&c->uses, n - 1, __ATOMIC_RELAXED);
+	b.c = c;
+	b.combs[0] = get_comb(c);
+	b.combs[1] = NULL;
+	b.out = out;
+	b.in = in;
+	b.res = res;
+	b.nin = dsa_info(DREW_PKSIG_SIGN_IN, NULL);
+	b.nout = dsa_info(DREW_PKSIG_SIGN_OUT, NULL);
+	return pksig_batch_run(sign_range, &b, n, param);
+}
+
 struct plugin {
 	const char *name;
 	const drew_pksig_functbl_t *functbl;
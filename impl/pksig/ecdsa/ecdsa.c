@@ -36,13 +36,23 @@
 #include <drew/mem.h>
 #include <drew/pksig.h>
 #include <drew/plugin.h>
+#include <drew/prng.h>
+
+#include "batch.h"
 
 #define DIM(x) (sizeof(x)/sizeof((x)[0]))
 
+/* The order n of the base point and its Montgomery context are taken from the
+ * curve when the context is set up, since the curve can't change after that.
+ * dm is d in Montgomery form, and is kept up to date whenever d changes.
+ */
 struct ecdsa {
 	drew_bignum_t *d;
 	drew_ecc_t *curve;
 	drew_ecc_point_t *q;
+	drew_bignum_t *n;
+	drew_bignum_t *dm;
+	drew_bignum_mont_t *mont;
 };
 
 static int ecdsa_info(int op, void *p);
@@ -62,7 +72,10 @@ static int ecdsa_sign(const drew_pksig_t *, drew_bignum_t *,
 static int ecdsa_verify(const drew_pksig_t *, drew_bignum_t *,
 		const drew_bignum_t *);
 static int ecdsa_test(void *, DrewLoader *);
-
+static int ecdsa_verifybatch(const drew_pksig_t *, drew_bignum_t *,
+		const drew_bignum_t *, int *, size_t, const drew_param_t *);
+static int ecdsa_signbatch(const drew_pksig_t *, drew_bignum_t *,
+		const drew_bignum_t *, int *, size_t, const drew_param_t *);
 
 static const drew_pksig_functbl_t ecdsa_functbl = {
 	.info = ecdsa_info,
@@ -77,7 +90,9 @@ static const drew_pksig_functbl_t ecdsa_functbl = {
 	.valsize = ecdsa_valsize,
 	.sign = ecdsa_sign,
 	.verify = ecdsa_verify,
-	.test = ecdsa_test
+	.test = ecdsa_test,
+	.verifybatch = ecdsa_verifybatch,
+	.signbatch = ecdsa_signbatch
 };
 
 struct mapping {
@@ -128,7 +143,7 @@ static int ecdsa_info(int op, void *p)
 	};
 	switch (op) {
 		case DREW_PKSIG_VERSION:
-			return CURRENT_ABI;
+			return DREW_PKSIG_ABI_SIGNBATCH;
 		case DREW_PKSIG_INTSIZE:
 			return sizeof(struct ecdsa);
 		case DREW_PKSIG_SIGN_IN:
@@ -165,7 +180,7 @@ static int ecdsa_info2(const drew_pksig_t *ctx, int op, drew_param_t *out,
 {
 	switch (op) {
 		case DREW_PKSIG_VERSION:
-			return CURRENT_ABI;
+			return DREW_PKSIG_ABI_SIGNBATCH;
 		case DREW_PKSIG_INTSIZE:
 			return sizeof(struct ecdsa);
 		default:
@@ -255,7 +270,8 @@ static int ecdsa_test(void *p, DrewLoader *ldr)
 	drew_param_t pa, pb;
 	drew_bignum_t bn[7], *r = bn, *s = bn+1, *h = bn+2, *k = bn+3, *v = bn+4;
 	drew_bignum_t *rorig = bn+5, *sorig = bn+6;
-	int id = 0, res = 0;
+	drew_bignum_t bin[6], bout[6];
+	int id = 0, res = 0, bres[3];
 
 	if ((id = drew_loader_lookup_by_name(ldr, "EllipticCurvePrime", 0, -1)) < 0)
 		return id;
@@ -304,6 +320,35 @@ static int ecdsa_test(void *p, DrewLoader *ldr)
 	if (r->functbl->compare(r, v, 0))
 		res |= 16;
 
+	// The same signature twice in a batch, the second time with the wrong hash.
+	for (size_t i = 0; i < DIM(bin); i++)
+		r->functbl->clone(bin+i, r + i % 3, 0);
+	r->functbl->clone(bin+5, s, DREW_BIGNUM_COPY);
+	for (size_t i = 0; i < DIM(bout); i++)
+		r->functbl->clone(bout+i, r, 0);
+	if (ecdsa.functbl->verifybatch(&ecdsa, bout, bin, bres, 2, NULL) ||
+			bres[0] || r->functbl->compare(r, bout, 0))
+		res |= 32;
+	if (!r->functbl->compare(r, bout+1, 0))
+		res |= 64;
+	for (size_t i = 0; i < DIM(bin); i++)
+		bin[i].functbl->fini(bin+i, 0);
+
+	// Sign twice in a batch, and then with k = 0, which must fail.
+	for (size_t i = 0; i < DIM(bin); i++)
+		r->functbl->clone(bin+i, i & 1 ? k : h, 0);
+	bin[5].functbl->setzero(bin+5);
+	if (ecdsa.functbl->signbatch(&ecdsa, bout, bin, bres, 3, NULL) ||
+			bres[0] || bres[1] || !bres[2])
+		res |= 128;
+	for (size_t i = 0; i < 4; i++)
+		if (r->functbl->compare(bout+i, i & 1 ? sorig : rorig, 0))
+			res |= 256;
+	for (size_t i = 0; i < DIM(bin); i++)
+		bin[i].functbl->fini(bin+i, 0);
+	for (size_t i = 0; i < DIM(bout); i++)
+		bout[i].functbl->fini(bout+i, 0);
+
 	ecdsa.functbl->fini(&ecdsa, 0);
 	curve.functbl->fini(&curve, 0);
 	for (size_t i = 0; i < DIM(bn); i++)
@@ -339,14 +384,24 @@ static int ecdsa_init(drew_pksig_t *ctx, int flags, DrewLoader *ldr,
 	newctx->d = drew_mem_malloc(sizeof(*newctx->d));
 	newctx->q = drew_mem_malloc(sizeof(*newctx->q));
 	newctx->curve = drew_mem_malloc(sizeof(*newctx->curve));
+	newctx->n = drew_mem_malloc(sizeof(*newctx->n));
+	newctx->dm = drew_mem_malloc(sizeof(*newctx->dm));
 
 	newctx->d->functbl = bignum->functbl;
+	newctx->n->functbl = bignum->functbl;
+	newctx->dm->functbl = bignum->functbl;
 	newctx->curve->functbl = curve->functbl;
 
 	newctx->d->functbl->init(newctx->d, 0, ldr, NULL);
+	newctx->n->functbl->init(newctx->n, 0, ldr, NULL);
+	newctx->dm->functbl->init(newctx->dm, 0, ldr, NULL);
 	newctx->curve->functbl->clone(newctx->curve, curve, 0);
 	newctx->curve->functbl->point(newctx->curve, newctx->q);
-	
+	newctx->curve->functbl->valbignum(newctx->curve, "n", newctx->n, 0);
+	if (newctx->n->functbl->info(DREW_BIGNUM_VERSION, NULL) >=
+			DREW_BIGNUM_ABI_MONT)
+		newctx->n->functbl->montinit(&newctx->mont, newctx->n);
+
 	ctx->ctx = newctx;
 	ctx->functbl = &ecdsa_functbl;
 
@@ -357,13 +412,19 @@ static int ecdsa_fini(drew_pksig_t *ctx, int flags)
 {
 	struct ecdsa *c = ctx->ctx;
 
+	if (c->mont)
+		c->n->functbl->montfini(c->mont);
 	c->d->functbl->fini(c->d, 0);
 	c->q->functbl->fini(c->q, 0);
 	c->curve->functbl->fini(c->curve, 0);
+	c->n->functbl->fini(c->n, 0);
+	c->dm->functbl->fini(c->dm, 0);
 
 	drew_mem_free(c->d);
 	drew_mem_free(c->q);
 	drew_mem_free(c->curve);
+	drew_mem_free(c->n);
+	drew_mem_free(c->dm);
 
 	if (!(flags & DREW_PKSIG_FIXED))
 		drew_mem_free(c);
@@ -373,7 +434,8 @@ static int ecdsa_fini(drew_pksig_t *ctx, int flags)
 }
 
 #define CLONE(new, old, x) do { if (!(old)->x) new->x = NULL; \
-	else old->x->functbl->clone(new->x, old->x, 0); } while (0)
+	else { new->x = drew_mem_malloc(sizeof(*new->x)); \
+		old->x->functbl->clone(new->x, old->x, 0); } } while (0)
 
 static int ecdsa_clone(drew_pksig_t *newctx, const drew_pksig_t *oldctx,
 		int flags)
@@ -387,13 +449,93 @@ static int ecdsa_clone(drew_pksig_t *newctx, const drew_pksig_t *oldctx,
 	CLONE(new, old, d);
 	CLONE(new, old, q);
 	CLONE(new, old, curve);
+	CLONE(new, old, n);
+	CLONE(new, old, dm);
+	if (old->mont)
+		new->n->functbl->montinit(&new->mont, new->n);
 	newctx->functbl = oldctx->functbl;
 	return 0;
 }
 
+static void set_dm(struct ecdsa *c)
+{
+	const drew_bignum_functbl_t *ft = c->d->functbl;
+
+	if (!c->mont)
+		return;
+	ft->mod(c->dm, c->d, c->n);
+	ft->montset(c->mont, c->dm, c->dm);
+}
+
+/* Set pt to kG.  Points from plugins built against an interface older than
+ * mulbase don't have it, so they get a plain multiplication of the base point.
+ */
+static int mul_base(const struct ecdsa *c, drew_ecc_point_t *pt,
+		const drew_bignum_t *k)
+{
+	drew_ecc_point_t g;
+	int res;
+
+	if (pt->functbl->info(DREW_ECC_VERSION, NULL) >= DREW_ECC_ABI_MULBASE)
+		return pt->functbl->mulbase(pt, k);
+
+	c->curve->functbl->point(c->curve, &g);
+	if (!(res = c->curve->functbl->valpoint(c->curve, "g", &g)))
+		res = pt->functbl->mul(pt, &g, k);
+	g.functbl->fini(&g, 0);
+	return res;
+}
+
+/* The private key is taken from the PRNG passed as the "prng" parameter.  Eight
+ * more bytes than the size of n are drawn so that reducing them modulo n - 1
+ * leaves no noticeable bias.
+ */
 static int ecdsa_generate(drew_pksig_t *ctx, const drew_param_t *param)
 {
-	return -DREW_ERR_NOT_IMPL;
+	struct ecdsa *c = ctx->ctx;
+	drew_prng_t *prng = NULL;
+	drew_bignum_t n, one;
+	uint8_t *buf;
+	size_t len;
+	int res = 0;
+
+	for (const drew_param_t *p = param; p; p = p->next)
+		if (!strcmp(p->name, "prng"))
+			prng = p->param.value;
+
+	if (!prng)
+		return -DREW_ERR_MORE_INFO;
+
+	c->d->functbl->init(&n, 0, NULL, NULL);
+	c->d->functbl->init(&one, 0, NULL, NULL);
+	c->curve->functbl->valbignum(c->curve, "n", &n, 0);
+	one.functbl->setsmall(&one, 1);
+
+	len = n.functbl->nbytes(&n) + 8;
+	if (!(buf = drew_mem_malloc(len))) {
+		res = -ENOMEM;
+		goto out;
+	}
+	if ((res = prng->functbl->bytes(prng, buf, len)) < 0)
+		goto out;
+	res = 0;
+
+	// d = (x mod (n - 1)) + 1, which is in [1, n - 1].
+	n.functbl->sub(&n, &n, &one);
+	c->d->functbl->setbytes(c->d, buf, len);
+	c->d->functbl->mod(c->d, c->d, &n);
+	c->d->functbl->add(c->d, c->d, &one);
+	if ((res = mul_base(c, c->q, c->d)))
+		goto out;
+	set_dm(c);
+out:
+	if (buf) {
+		memset(buf, 0, len);
+		drew_mem_free(buf);
+	}
+	n.functbl->fini(&n, 0);
+	one.functbl->fini(&one, 0);
+	return res;
 }
 
 static int ecdsa_setmode(drew_pksig_t *ctx, int flags)
@@ -406,9 +548,10 @@ static int ecdsa_setval(drew_pksig_t *ctx, const char *name, const uint8_t *buf,
 {
 	struct ecdsa *c = ctx->ctx;
 
-	if (!strcmp("d", name))
+	if (!strcmp("d", name)) {
 		c->d->functbl->setbytes(c->d, buf, len);
-	else if (!strcmp("q", name))
+		set_dm(c);
+	} else if (!strcmp("q", name))
 		c->q->functbl->setcoordbytes(c->q, buf, len, DREW_ECC_POINT_SEC);
 	else
 		return -DREW_ERR_INVALID;
@@ -442,39 +585,57 @@ static int ecdsa_valsize(const drew_pksig_t *ctx, const char *name)
 		return -DREW_ERR_INVALID;
 }
 
+/* s = k^-1 (h + dr) mod n, given kinv = k^-1 mod n and r < n.  Since d is kept
+ * in Montgomery form, its product with r comes out in the normal form, and
+ * converting kinv does the same for its product with h + dr.  t is scratch
+ * space.
+ */
+static void sign_s(const struct ecdsa *c, drew_bignum_t *s,
+		const drew_bignum_t *kinv, const drew_bignum_t *r,
+		const drew_bignum_t *h, drew_bignum_t *t)
+{
+	const drew_bignum_functbl_t *ft = s->functbl;
+
+	if (c->mont) {
+		ft->montmul(c->mont, t, c->dm, r);
+		ft->addmod(t, t, h, c->n);
+		ft->montset(c->mont, s, kinv);
+		ft->montmul(c->mont, s, s, t);
+	} else {
+		ft->mulmod(t, c->d, r, c->n);
+		ft->add(t, t, h);
+		ft->mulmod(s, kinv, t, c->n);
+	}
+}
+
 static int ecdsa_sign(const drew_pksig_t *ctx, drew_bignum_t *out,
 		const drew_bignum_t *in)
 {
-	struct ecdsa *c = ctx->ctx;
-	drew_bignum_t t, kinv, z, n, *r = out, *s = out+1;
+	const struct ecdsa *c = ctx->ctx;
+	drew_bignum_t t, kinv, *r = out, *s = out+1;
 	const drew_bignum_t *h = in, *k = in+1;
-	drew_ecc_point_t kpt, *K = &kpt;
+	const drew_bignum_functbl_t *ft = r->functbl;
+	drew_ecc_point_t K;
 	int res = 0;
 
-	c->curve->functbl->point(c->curve, K);
-	r->functbl->init(&z, 0, NULL, NULL);
-	r->functbl->init(&n, 0, NULL, NULL);
-	r->functbl->init(&t, 0, NULL, NULL);
-	r->functbl->init(&kinv, 0, NULL, NULL);
-	z.functbl->setzero(&z);
+	c->curve->functbl->point(c->curve, &K);
+	ft->init(&t, 0, NULL, NULL);
+	ft->init(&kinv, 0, NULL, NULL);
 
 	// Compute the point corresponding to k (kG == K).
-	c->curve->functbl->valpoint(c->curve, "g", K);
-	c->curve->functbl->valbignum(c->curve, "n", &n, 0);
-	K->functbl->mul(K, K, k);
-	K->functbl->coordbignum(K, r, DREW_ECC_POINT_X);
-	kinv.functbl->invmod(&kinv, k, &n);
-	r->functbl->mod(r, r, &n);
-	t.functbl->mulmod(&t, c->d, r, &n);
-	t.functbl->add(&t, &t, h);
-	s->functbl->mulmod(s, &kinv, &t, &n);
+	if ((res = mul_base(c, &K, k)))
+		goto out;
+	K.functbl->coordbignum(&K, r, DREW_ECC_POINT_X);
+	ft->mod(r, r, c->n);
+	ft->invmod(&kinv, k, c->n);
+	sign_s(c, s, &kinv, r, h, &t);
 	// Check whether either r or s is zero.
-	if (!r->functbl->compare(r, &z, 0) || !s->functbl->compare(s, &z, 0))
+	if (!ft->comparesmall(r, 0) || !ft->comparesmall(s, 0))
 		res = -DREW_ERR_INVALID;
-	t.functbl->fini(&t, 0);
-	n.functbl->fini(&n, 0);
-	kinv.functbl->fini(&kinv, 0);
-	K->functbl->fini(K, 0);
+out:
+	ft->fini(&t, 0);
+	ft->fini(&kinv, 0);
+	K.functbl->fini(&K, 0);
 	return res;
 }
 
@@ -483,7 +644,8 @@ static int ecdsa_verify(const drew_pksig_t *ctx, drew_bignum_t *out,
 {
 	struct ecdsa *c = ctx->ctx;
 	const drew_bignum_t *r = in, *s = in+1, *h = in+2;
-	drew_bignum_t *v = out, nbuf, *n = &nbuf;
+	const drew_bignum_t *n = c->n;
+	drew_bignum_t *v = out;
 	drew_bignum_t wbuf, *w = &wbuf, u1buf, *u1 = &u1buf, u2buf, *u2 = &u2buf;
 	drew_bignum_t zbuf, *z = &zbuf;
 	const drew_ecc_point_t *Q = c->q;
@@ -494,12 +656,10 @@ static int ecdsa_verify(const drew_pksig_t *ctx, drew_bignum_t *out,
 	r->functbl->init(u1, 0, NULL, NULL);
 	r->functbl->init(u2, 0, NULL, NULL);
 	r->functbl->init(z, 0, NULL, NULL);
-	r->functbl->init(n, 0, NULL, NULL);
 	z->functbl->setzero(z);
 	c->curve->functbl->point(c->curve, R);
 	c->curve->functbl->point(c->curve, G);
 	c->curve->functbl->valpoint(c->curve, "g", G);
-	c->curve->functbl->valbignum(c->curve, "n", n, 0);
 	// Check whether either r or s is zero.
 	if (!r->functbl->compare(r, z, 0) || !s->functbl->compare(s, z, 0))
 		res = -DREW_ERR_INVALID;
@@ -515,11 +675,154 @@ static int ecdsa_verify(const drew_pksig_t *ctx, drew_bignum_t *out,
 	u1->functbl->fini(u1, 0);
 	u2->functbl->fini(u2, 0);
 	z->functbl->fini(z, 0);
-	n->functbl->fini(n, 0);
 	R->functbl->fini(R, 0);
 	return res;
 }
 
+struct batch {
+	const struct ecdsa *c;
+	drew_bignum_t *out;
+	const drew_bignum_t *in;
+	int *res;
+	size_t nin, nout;
+};
+
+/* This is verify for signatures start through end - 1, except that the
+ * inverses of s are computed all at once and the base point is only looked up
+ * once.  Unlike DSA, there is no table for the public key shared across the
+ * batch, since the ECC point interface has no way to keep one; each signature
+ * gets its own mul2.
+ */
+static int verify_range(void *arg, size_t start, size_t end)
+{
+	const struct batch *b = arg;
+	const struct ecdsa *c = b->c;
+	const drew_bignum_t *in = b->in + start * b->nin;
+	const drew_bignum_functbl_t *ft = in->functbl;
+	const size_t count = end - start;
+	const drew_bignum_t *n = c->n;
+	drew_bignum_t u1, u2, *w;
+	drew_ecc_point_t G, R;
+	int res = 0;
+
+	if (!(w = drew_mem_malloc(count * sizeof(*w))))
+		return -ENOMEM;
+	for (size_t i = 0; i < count; i++)
+		ft->init(w+i, 0, NULL, NULL);
+	ft->init(&u1, 0, NULL, NULL);
+	ft->init(&u2, 0, NULL, NULL);
+	c->curve->functbl->point(c->curve, &R);
+	c->curve->functbl->point(c->curve, &G);
+	c->curve->functbl->valpoint(c->curve, "g", &G);
+
+	if ((res = pksig_batch_invmod(w, in+1, b->nin, count, n)))
+		goto out;
+	for (size_t i = 0; i < count; i++) {
+		const drew_bignum_t *r = in + i * b->nin, *s = r+1, *h = r+2;
+		drew_bignum_t *v = b->out + (start + i) * b->nout;
+		int *vres = b->res + start + i;
+
+		*vres = 0;
+		// Check whether either r or s is zero.
+		if (!ft->comparesmall(r, 0) || !ft->comparesmall(s, 0))
+			*vres = -DREW_ERR_INVALID;
+		ft->mulmod(&u1, h, w+i, n);
+		ft->mulmod(&u2, r, w+i, n);
+		R.functbl->mul2(&R, &G, &u1, c->q, &u2);
+		if (R.functbl->isinf(&R))
+			*vres = -DREW_ERR_INVALID;
+		R.functbl->coordbignum(&R, v, DREW_ECC_POINT_X);
+		v->functbl->mod(v, v, n);
+	}
+out:
+	for (size_t i = 0; i < count; i++)
+		ft->fini(w+i, 0);
+	drew_mem_free(w);
+	ft->fini(&u1, 0);
+	ft->fini(&u2, 0);
+	G.functbl->fini(&G, 0);
+	R.functbl->fini(&R, 0);
+	return res;
+}
+
+static int ecdsa_verifybatch(const drew_pksig_t *ctx, drew_bignum_t *out,
+		const drew_bignum_t *in, int *res, size_t n, const drew_param_t *param)
+{
+	struct batch b;
+
+	b.c = ctx->ctx;
+	b.out = out;
+	b.in = in;
+	b.res = res;
+	b.nin = ecdsa_info(DREW_PKSIG_VERIFY_IN, NULL);
+	b.nout = ecdsa_info(DREW_PKSIG_VERIFY_OUT, NULL);
+	return pksig_batch_run(verify_range, &b, n, param);
+}
+
+/* This is sign for signatures start through end - 1.  All the kG are computed
+ * one after another, then the inverses of k all at once, and then each s.
+ */
+static int sign_range(void *arg, size_t start, size_t end)
+{
+	const struct batch *b = arg;
+	const struct ecdsa *c = b->c;
+	const drew_bignum_t *in = b->in + start * b->nin;
+	drew_bignum_t *out = b->out + start * b->nout;
+	const drew_bignum_functbl_t *ft = in->functbl;
+	const size_t count = end - start;
+	drew_bignum_t t, *kinv;
+	drew_ecc_point_t K;
+	int res = 0;
+
+	if (!(kinv = drew_mem_malloc(count * sizeof(*kinv))))
+		return -ENOMEM;
+	for (size_t i = 0; i < count; i++)
+		ft->init(kinv+i, 0, NULL, NULL);
+	ft->init(&t, 0, NULL, NULL);
+	c->curve->functbl->point(c->curve, &K);
+
+	for (size_t i = 0; i < count; i++) {
+		drew_bignum_t *r = out + i * b->nout;
+
+		if ((res = mul_base(c, &K, in + i * b->nin + 1)))
+			goto out;
+		K.functbl->coordbignum(&K, r, DREW_ECC_POINT_X);
+		ft->mod(r, r, c->n);
+	}
+	if ((res = pksig_batch_invmod(kinv, in+1, b->nin, count, c->n)))
+		goto out;
+	for (size_t i = 0; i < count; i++) {
+		const drew_bignum_t *h = in + i * b->nin;
+		drew_bignum_t *r = out + i * b->nout, *s = r+1;
+
+		sign_s(c, s, kinv+i, r, h, &t);
+		// Check whether either r or s is zero.
+		b->res[start + i] = !ft->comparesmall(r, 0) ||
+			!ft->comparesmall(s, 0) ? -DREW_ERR_INVALID : 0;
+	}
+out:
+	for (size_t i = 0; i < count; i++)
+		ft->fini(kinv+i, 0);
+	drew_mem_free(kinv);
+	ft->fini(&t, 0);
+	K.functbl->fini(&K, 0);
+	return res;
+}
+
+static int ecdsa_signbatch(const drew_pksig_t *ctx, drew_bignum_t *out,
+		const drew_bignum_t *in, int *res, size_t n, const drew_param_t *param)
+{
+	struct batch b;
+
+	b.c = ctx->ctx;
+	b.out = out;
+	b.in = in;
+	b.res = res;
+	b.nin = ecdsa_info(DREW_PKSIG_SIGN_IN, NULL);
+	b.nout = ecdsa_info(DREW_PKSIG_SIGN_OUT, NULL);
+	return pksig_batch_run(sign_range, &b, n, param);
+}
+
 struct plugin {
 	const char *name;
 	const drew_pksig_functbl_t *functbl;
@@ -21,16 +21,23 @@
 #include "util.h"
 
 #include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _THREAD_SAFE
+#include <pthread.h>
+#endif
+
 #include <drew/bignum.h>
 #include <drew/mem.h>
 #include <drew/pksig.h>
 #include <drew/plugin.h>
+#include <drew/prng.h>
 
 #define DIM(x) (sizeof(x)/sizeof((x)[0]))
 
@@ -41,6 +48,11 @@ struct rsa {
 	drew_bignum_t *e;
 	drew_bignum_t *d;
 	drew_bignum_t *n;
+	drew_bignum_t *dp;
+	drew_bignum_t *dq;
+	drew_bignum_mont_t *mont;
+	drew_bignum_mont_t *montp;
+	drew_bignum_mont_t *montq;
 };
 
 static int rsa_info(int op, void *p);
@@ -60,7 +72,10 @@ static int rsa_sign(const drew_pksig_t *, drew_bignum_t *,
 static int rsa_verify(const drew_pksig_t *, drew_bignum_t *,
 		const drew_bignum_t *);
 static int rsa_test(void *, DrewLoader *);
-
+static int rsa_verifybatch(const drew_pksig_t *, drew_bignum_t *,
+		const drew_bignum_t *, int *, size_t, const drew_param_t *);
+static int rsa_signbatch(const drew_pksig_t *, drew_bignum_t *,
+		const drew_bignum_t *, int *, size_t, const drew_param_t *);
 
 static const drew_pksig_functbl_t rsa_functbl = {
 	.info = rsa_info,
@@ -75,7 +90,9 @@ static const drew_pksig_functbl_t rsa_functbl = {
 	.valsize = rsa_valsize,
 	.sign = rsa_sign,
 	.verify = rsa_verify,
-	.test = rsa_test
+	.test = rsa_test,
+	.verifybatch = rsa_verifybatch,
+	.signbatch = rsa_signbatch
 };
 
 #include "../../multi/rsa/rsa.c"
@@ -85,7 +102,7 @@ static int rsa_info(int op, void *p)
 	drew_param_t *param = p;
 	switch (op) {
 		case DREW_PKSIG_VERSION:
-			return CURRENT_ABI;
+			return DREW_PKSIG_ABI_SIGNBATCH;
 		case DREW_PKSIG_INTSIZE:
 			return sizeof(struct rsa);
 		case DREW_PKSIG_SIGN_IN:
@@ -122,7 +139,7 @@ static int rsa_info2(const drew_pksig_t *ctx, int op, drew_param_t *out,
 {
 	switch (op) {
 		case DREW_PKSIG_VERSION:
-			return CURRENT_ABI;
+			return DREW_PKSIG_ABI_SIGNBATCH;
 		case DREW_PKSIG_INTSIZE:
 			return sizeof(struct rsa);
 		default:
@@ -133,7 +150,8 @@ static int rsa_info2(const drew_pksig_t *ctx, int op, drew_param_t *out,
 static int rsa_test(void *ptr, DrewLoader *ldr)
 {
 	uint8_t p[] = {0x3d}, q[] = {0x35}, n[] = {0x0c, 0xa1}, e[] = {0x11},
-			d[] = {0x0a, 0xc1}, m[] = {0x41}, c[] = {0x0a, 0xe6};
+			d[] = {0x0a, 0xc1}, m[] = {0x41}, c[] = {0x0a, 0xe6},
+			dp[] = {0x35}, dq[] = {0x31}, u[] = {0x26};
 	uint8_t buf[2];
 	const void *functbl;
 	drew_pksig_t ctx;
@@ -176,6 +194,15 @@ static int rsa_test(void *ptr, DrewLoader *ldr)
 	bns[0].functbl->bytes(&bns[0], buf, sizeof(buf));
 	res <<= 1;
 	res |= !!memcmp(buf, c, sizeof(c));
+	// With the CRT parameters set, the private operation uses them.
+	ctx.functbl->setval(&ctx, "dp", dp, DIM(dp));
+	ctx.functbl->setval(&ctx, "dq", dq, DIM(dq));
+	ctx.functbl->setval(&ctx, "u", u, DIM(u));
+	bns[0].functbl->setbytes(&bns[0], c, sizeof(c));
+	ctx.functbl->sign(&ctx, bns, bns);
+	bns[0].functbl->bytes(&bns[0], buf, sizeof(buf));
+	res <<= 1;
+	res |= !!memcmp(buf, m, sizeof(m));
 	ctx.functbl->fini(&ctx, 0);
 	bns[0].functbl->fini(&bns[0], 0);
 
@@ -213,7 +240,8 @@ static int rsa_fini(drew_pksig_t *ctx, int flags)
 }
 
 #define CLONE(new, old, x) do { if (!(old)->x) new->x = NULL; \
-	else old->x->functbl->clone(new->x, old->x, 0); } while (0)
+	else { new->x = drew_mem_malloc(sizeof(*new->x)); \
+		old->x->functbl->clone(new->x, old->x, 0); } } while (0)
 
 static int rsa_clone(drew_pksig_t *newctx, const drew_pksig_t *oldctx,
 		int flags)
@@ -230,13 +258,17 @@ static int rsa_clone(drew_pksig_t *newctx, const drew_pksig_t *oldctx,
 	CLONE(new, old, e);
 	CLONE(new, old, d);
 	CLONE(new, old, n);
+	CLONE(new, old, dp);
+	CLONE(new, old, dq);
+	clone_mont(new, old);
 	newctx->functbl = oldctx->functbl;
 	return 0;
 }
 
 static int rsa_generate(drew_pksig_t *ctx, const drew_param_t *param)
 {
-	return -DREW_ERR_NOT_IMPL;
+	struct rsa *c = ctx->ctx;
+	return generate(c, param);
 }
 
 static int rsa_setmode(drew_pksig_t *ctx, int flags)
@@ -278,6 +310,25 @@ static int rsa_verify(const drew_pksig_t *ctx, drew_bignum_t *out,
 	return encrypt(c, out, in);
 }
 
+// There is nothing to share between RSA signatures or verifications.
+static int rsa_verifybatch(const drew_pksig_t *ctx, drew_bignum_t *out,
+		const drew_bignum_t *in, int *res, size_t n, const drew_param_t *param)
+{
+	for (size_t i = 0; i < n; i++)
+		res[i] = rsa_verify(ctx, out + i * DIM(enc_out),
+				in + i * DIM(enc_in));
+	return 0;
+}
+
+static int rsa_signbatch(const drew_pksig_t *ctx, drew_bignum_t *out,
+		const drew_bignum_t *in, int *res, size_t n, const drew_param_t *param)
+{
+	for (size_t i = 0; i < n; i++)
+		res[i] = rsa_sign(ctx, out + i * DIM(dec_out),
+				in + i * DIM(dec_in));
+	return 0;
+}
+
 struct plugin {
 	const char *name;
 	const drew_pksig_functbl_t *functbl;
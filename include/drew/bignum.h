@@ -32,6 +32,13 @@
 
 /* The ABI version of the hash interface. */
 #define DREW_BIGNUM_VERSION 0
+/* The first ABI versions of the bignum interface with expmod2 and with the
+ * Montgomery functions.  A bignum may come from a plugin built against an
+ * older interface, so check the version its info function returns before
+ * using those members.
+ */
+#define DREW_BIGNUM_ABI_EXPMOD2 4
+#define DREW_BIGNUM_ABI_MONT 5
 /* The size of the underlying implementation's context.  This is useful for the
  * clone function if there's a need to copy the actual context into a given
  * block of memory, such as locked memory.
@@ -54,6 +61,8 @@
 
 struct drew_bignum_s;
 typedef struct drew_bignum_s drew_bignum_t;
+struct drew_bignum_mont_s;
+typedef struct drew_bignum_mont_s drew_bignum_mont_t;
 
 typedef struct {
 	int (*info)(int op, void *p);
@@ -158,9 +167,162 @@ typedef struct {
 	int (*test)(void *, const drew_loader_t *);
 } drew_bignum_functbl3_t;
 
+/* expmod2(r, g1, x1, g2, x2, m) sets r to g1^x1 * g2^x2 mod m.  The two
+ * exponentiations share one chain of squarings, so this costs little more than
+ * a single expmod.  The exponents must not be negative.
+ */
+typedef struct {
+	int (*info)(int op, void *p);
+	int (*info2)(const drew_bignum_t *, int, drew_param_t *,
+			const drew_param_t *);
+	int (*init)(drew_bignum_t *, int, const drew_loader_t *,
+			const drew_param_t *);
+	int (*clone)(drew_bignum_t *, const drew_bignum_t *, int);
+	int (*fini)(drew_bignum_t *, int);
+	int (*nbits)(const drew_bignum_t *);
+	int (*nbytes)(const drew_bignum_t *);
+	// Also return sign.
+	int (*bytes)(const drew_bignum_t *, uint8_t *, size_t);
+	int (*setbytes)(drew_bignum_t *, const uint8_t *, size_t);
+	int (*setzero)(drew_bignum_t *);
+	int (*setsmall)(drew_bignum_t *, long);
+	int (*negate)(drew_bignum_t *, const drew_bignum_t *);
+	int (*abs)(drew_bignum_t *, const drew_bignum_t *);
+	int (*compare)(const drew_bignum_t *, const drew_bignum_t *, int);
+	int (*comparesmall)(const drew_bignum_t *, long);
+	// C++ uses "or", "bitor", "and", "bitand", and "xor" as operators, so we
+	// can't use those names here.
+	int (*bitwiseor)(drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*bitwiseand)(drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*bitwisexor)(drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*bitwisenot)(drew_bignum_t *, const drew_bignum_t *);
+	int (*getbit)(const drew_bignum_t *, size_t);
+	int (*setbit)(drew_bignum_t *, size_t, bool);
+	int (*add)(drew_bignum_t *, const drew_bignum_t *, const drew_bignum_t *);
+	int (*sub)(drew_bignum_t *, const drew_bignum_t *, const drew_bignum_t *);
+	int (*mul)(drew_bignum_t *, const drew_bignum_t *, const drew_bignum_t *);
+	int (*div)(drew_bignum_t *, drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*mulpow2)(drew_bignum_t *, const drew_bignum_t *, size_t);
+	int (*divpow2)(drew_bignum_t *, drew_bignum_t *, const drew_bignum_t *,
+			size_t);
+	int (*shiftleft)(drew_bignum_t *, const drew_bignum_t *, size_t);
+	int (*shiftright)(drew_bignum_t *, const drew_bignum_t *, size_t);
+	int (*square)(drew_bignum_t *, const drew_bignum_t *);
+	int (*mod)(drew_bignum_t *, const drew_bignum_t *, const drew_bignum_t *);
+	int (*expsmall)(drew_bignum_t *, const drew_bignum_t *, unsigned long);
+	int (*squaremod)(drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*addmod)(drew_bignum_t *, const drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*mulmod)(drew_bignum_t *, const drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*expmod)(drew_bignum_t *, const drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*invmod)(drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*gcd)(drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*test)(void *, const drew_loader_t *);
+	int (*expmod2)(drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *, const drew_bignum_t *);
+} drew_bignum_functbl4_t;
+
+/* A drew_bignum_mont_t holds what is computed from a modulus for Montgomery
+ * multiplication, so that it can be done once per key or curve instead of on
+ * every operation.  montinit creates one for an odd modulus greater than one,
+ * returning -DREW_ERR_INVALID for any other, and montfini frees it.  It is not
+ * modified after it is created, so it may be used from several threads at once.
+ *
+ * montset(m, r, a) converts a to Montgomery form (aR mod m) and montget
+ * converts back.  montmul and montsquare take and give values in Montgomery
+ * form which are less than the modulus.  montexp(m, r, g, x) and montexp2 are
+ * expmod and expmod2 with the modulus of m, and take and give values in the
+ * normal form.
+ */
+typedef struct {
+	int (*info)(int op, void *p);
+	int (*info2)(const drew_bignum_t *, int, drew_param_t *,
+			const drew_param_t *);
+	int (*init)(drew_bignum_t *, int, const drew_loader_t *,
+			const drew_param_t *);
+	int (*clone)(drew_bignum_t *, const drew_bignum_t *, int);
+	int (*fini)(drew_bignum_t *, int);
+	int (*nbits)(const drew_bignum_t *);
+	int (*nbytes)(const drew_bignum_t *);
+	// Also return sign.
+	int (*bytes)(const drew_bignum_t *, uint8_t *, size_t);
+	int (*setbytes)(drew_bignum_t *, const uint8_t *, size_t);
+	int (*setzero)(drew_bignum_t *);
+	int (*setsmall)(drew_bignum_t *, long);
+	int (*negate)(drew_bignum_t *, const drew_bignum_t *);
+	int (*abs)(drew_bignum_t *, const drew_bignum_t *);
+	int (*compare)(const drew_bignum_t *, const drew_bignum_t *, int);
+	int (*comparesmall)(const drew_bignum_t *, long);
+	// C++ uses "or", "bitor", "and", "bitand", and "xor" as operators, so we
+	// can't use those names here.
+	int (*bitwiseor)(drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*bitwiseand)(drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*bitwisexor)(drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*bitwisenot)(drew_bignum_t *, const drew_bignum_t *);
+	int (*getbit)(const drew_bignum_t *, size_t);
+	int (*setbit)(drew_bignum_t *, size_t, bool);
+	int (*add)(drew_bignum_t *, const drew_bignum_t *, const drew_bignum_t *);
+	int (*sub)(drew_bignum_t *, const drew_bignum_t *, const drew_bignum_t *);
+	int (*mul)(drew_bignum_t *, const drew_bignum_t *, const drew_bignum_t *);
+	int (*div)(drew_bignum_t *, drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*mulpow2)(drew_bignum_t *, const drew_bignum_t *, size_t);
+	int (*divpow2)(drew_bignum_t *, drew_bignum_t *, const drew_bignum_t *,
+			size_t);
+	int (*shiftleft)(drew_bignum_t *, const drew_bignum_t *, size_t);
+	int (*shiftright)(drew_bignum_t *, const drew_bignum_t *, size_t);
+	int (*square)(drew_bignum_t *, const drew_bignum_t *);
+	int (*mod)(drew_bignum_t *, const drew_bignum_t *, const drew_bignum_t *);
+	int (*expsmall)(drew_bignum_t *, const drew_bignum_t *, unsigned long);
+	int (*squaremod)(drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*addmod)(drew_bignum_t *, const drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*mulmod)(drew_bignum_t *, const drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*expmod)(drew_bignum_t *, const drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*invmod)(drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*gcd)(drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*test)(void *, const drew_loader_t *);
+	int (*expmod2)(drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *, const drew_bignum_t *);
+	int (*montinit)(drew_bignum_mont_t **, const drew_bignum_t *);
+	int (*montfini)(drew_bignum_mont_t *);
+	int (*montset)(const drew_bignum_mont_t *, drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*montget)(const drew_bignum_mont_t *, drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*montmul)(const drew_bignum_mont_t *, drew_bignum_t *,
+			const drew_bignum_t *, const drew_bignum_t *);
+	int (*montsquare)(const drew_bignum_mont_t *, drew_bignum_t *,
+			const drew_bignum_t *);
+	int (*montexp)(const drew_bignum_mont_t *, drew_bignum_t *,
+			const drew_bignum_t *, const drew_bignum_t *);
+	int (*montexp2)(const drew_bignum_mont_t *, drew_bignum_t *,
+			const drew_bignum_t *, const drew_bignum_t *,
+			const drew_bignum_t *, const drew_bignum_t *);
+} drew_bignum_functbl5_t;
+
 typedef drew_bignum_functbl2_t drew_bignum_functbl0_t;
 typedef drew_bignum_functbl2_t drew_bignum_functbl1_t;
-typedef drew_bignum_functbl3_t drew_bignum_functbl_t;
+typedef drew_bignum_functbl5_t drew_bignum_functbl_t;
 
 struct drew_bignum_s {
 	void *ctx;
@@ -32,6 +32,11 @@
 
 /* The ABI version of the hash interface. */
 #define DREW_ECC_VERSION 0
+/* The first ABI version of the point interface with mulbase.  A point may come
+ * from a plugin built against an older interface, so check the version its
+ * info function returns before using that member.
+ */
+#define DREW_ECC_ABI_MULBASE 4
 /* The size of the underlying implementation's context.  This is useful for the
  * clone function if there's a need to copy the actual context into a given
  * block of memory, such as locked memory.
@@ -161,9 +166,44 @@ typedef struct {
 	int (*test)(void *, DrewLoader *);
 } drew_ecc_point_functbl4_t;
 
+/* mulbase sets the point to the product of the scalar and the base point of the
+ * curve the point belongs to.  Implementations may precompute multiples of the
+ * base point the first time this is called and share them between the curve and
+ * its clones, so this is much faster than mul on the base point when signing or
+ * generating keys.
+ */
+typedef struct {
+	int (*info)(int op, void *p);
+	int (*info2)(const drew_ecc_point_t *, int, drew_param_t *,
+			const drew_param_t *);
+	int (*init)(drew_ecc_point_t *, int, DrewLoader *,
+			const drew_param_t *);
+	int (*clone)(drew_ecc_point_t *, const drew_ecc_point_t *, int);
+	int (*fini)(drew_ecc_point_t *, int);
+	int (*setinf)(drew_ecc_point_t *, bool);
+	int (*isinf)(const drew_ecc_point_t *);
+	int (*compare)(const drew_ecc_point_t *, const drew_ecc_point_t *);
+	int (*setcoordbytes)(drew_ecc_point_t *, const uint8_t *, size_t, int);
+	int (*coordbytes)(const drew_ecc_point_t *, uint8_t *, size_t, int);
+	int (*ncoordbytes)(const drew_ecc_point_t *, int);
+	int (*setcoordbignum)(drew_ecc_point_t *, const drew_bignum_t *, int);
+	int (*coordbignum)(const drew_ecc_point_t *, drew_bignum_t *, int);
+	int (*inv)(drew_ecc_point_t *, const drew_ecc_point_t *);
+	int (*add)(drew_ecc_point_t *, const drew_ecc_point_t *,
+			const drew_ecc_point_t *);
+	int (*mul)(drew_ecc_point_t *, const drew_ecc_point_t *,
+			const drew_bignum_t *);
+	int (*mul2)(drew_ecc_point_t *, const drew_ecc_point_t *,
+			const drew_bignum_t *, const drew_ecc_point_t *,
+			const drew_bignum_t *);
+	int (*dbl)(drew_ecc_point_t *, const drew_ecc_point_t *);
+	int (*test)(void *, DrewLoader *);
+	int (*mulbase)(drew_ecc_point_t *, const drew_bignum_t *);
+} drew_ecc_point_functbl5_t;
+
 typedef drew_ecc_functbl4_t drew_ecc_functbl_t;
 
-typedef drew_ecc_point_functbl4_t drew_ecc_point_functbl_t;
+typedef drew_ecc_point_functbl5_t drew_ecc_point_functbl_t;
 
 struct drew_ecc_s {
 	void *ctx;
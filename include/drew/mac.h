@@ -31,6 +31,11 @@
 
 /* The ABI version of the hash interface. */
 #define DREW_MAC_VERSION 0
+/* The first ABI version of the MAC interface with batch.  A MAC may come from
+ * a plugin built against an older interface, so check the version its info
+ * function returns before using that member.
+ */
+#define DREW_MAC_ABI_BATCH 4
 /* The length of the final MAC in bytes. */
 #define DREW_MAC_SIZE 1
 /* The size of the block in bytes. */
@@ -108,7 +113,28 @@ typedef struct {
 	int (*test)(void *, DrewLoader *);
 } drew_mac_functbl4_t;
 
-typedef drew_mac_functbl4_t drew_mac_functbl_t;
+/* batch computes the MACs of n independent messages under the key already set
+ * on the context.  Message i is data[i] and is len[i] bytes long; its tag is
+ * written to out + i * the tag size.  Any message in progress on the context
+ * is not affected.
+ */
+typedef struct {
+	int (*info)(int op, void *p);
+	int (*info2)(const drew_mac_t *, int, drew_param_t *, const drew_param_t *);
+	int (*init)(drew_mac_t *, int, DrewLoader *, const drew_param_t *);
+	int (*clone)(drew_mac_t *, const drew_mac_t *, int);
+	int (*reset)(drew_mac_t *);
+	int (*fini)(drew_mac_t *, int);
+	int (*setkey)(drew_mac_t *, const uint8_t *, size_t);
+	int (*update)(drew_mac_t *, const uint8_t *, size_t);
+	int (*updatefast)(drew_mac_t *, const uint8_t *, size_t);
+	int (*final)(drew_mac_t *, uint8_t *, int);
+	int (*test)(void *, DrewLoader *);
+	int (*batch)(const drew_mac_t *, uint8_t *, const uint8_t *const *,
+			const size_t *, size_t);
+} drew_mac_functbl5_t;
+
+typedef drew_mac_functbl5_t drew_mac_functbl_t;
 
 struct drew_mac_s {
 	void *ctx;
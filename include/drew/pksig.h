@@ -32,6 +32,13 @@
 
 /* The ABI version of the pksig interface. */
 #define DREW_PKSIG_VERSION 0 /* Not implemented. */
+/* The first ABI version of the pksig interface with verifybatch.  A pksig may
+ * come from a plugin built against an older interface, so check the version
+ * its info function returns before using that member.
+ */
+#define DREW_PKSIG_ABI_VERIFYBATCH 4
+/* The first ABI version of the pksig interface with signbatch. */
+#define DREW_PKSIG_ABI_SIGNBATCH 5
 /* The size of the underlying implementation's context.  This is useful for the
  * clone function if there's a need to copy the actual context into a given
  * block of memory, such as locked memory.
@@ -129,9 +136,65 @@ typedef struct {
 	int (*test)(void *, DrewLoader *);
 } drew_pksig_functbl4_t;
 
+/* verifybatch verifies n signatures under the key set on the context.  Each
+ * signature takes as many inputs and outputs as verify does (the counts for
+ * DREW_PKSIG_VERIFY_IN and DREW_PKSIG_VERIFY_OUT), laid out one signature after
+ * another in in and out, and res[i] is set to what verify would have returned
+ * for signature i.  The return value is nonzero only if the batch could not be
+ * processed at all.  If param contains a "threads" number greater than one, the
+ * work may be split across that many threads.
+ */
+typedef struct {
+	int (*info)(int op, void *p);
+	int (*info2)(const drew_pksig_t *, int, drew_param_t *,
+			const drew_param_t *);
+	int (*init)(drew_pksig_t *, int,
+			DrewLoader *, const drew_param_t *);
+	int (*clone)(drew_pksig_t *, const drew_pksig_t *, int);
+	int (*fini)(drew_pksig_t *, int);
+	int (*generate)(drew_pksig_t *, const drew_param_t *);
+	int (*setmode)(drew_pksig_t *, int);
+	int (*setval)(drew_pksig_t *, const char *, const uint8_t *, size_t);
+	int (*val)(const drew_pksig_t *, const char *, uint8_t *, size_t);
+	int (*valsize)(const drew_pksig_t *, const char *);
+	int (*sign)(const drew_pksig_t *, drew_bignum_t *, const drew_bignum_t *);
+	int (*verify)(const drew_pksig_t *, drew_bignum_t *, const drew_bignum_t *);
+	int (*test)(void *, DrewLoader *);
+	int (*verifybatch)(const drew_pksig_t *, drew_bignum_t *,
+			const drew_bignum_t *, int *, size_t, const drew_param_t *);
+} drew_pksig_functbl5_t;
+
+/* signbatch signs n messages with the key set on the context.  It is to sign
+ * what verifybatch is to verify: the inputs and outputs for each message are
+ * laid out one after another, using the counts for DREW_PKSIG_SIGN_IN and
+ * DREW_PKSIG_SIGN_OUT, and res[i] is set to what sign would have returned for
+ * message i.  The "threads" parameter is the same as for verifybatch.
+ */
+typedef struct {
+	int (*info)(int op, void *p);
+	int (*info2)(const drew_pksig_t *, int, drew_param_t *,
+			const drew_param_t *);
+	int (*init)(drew_pksig_t *, int,
+			DrewLoader *, const drew_param_t *);
+	int (*clone)(drew_pksig_t *, const drew_pksig_t *, int);
+	int (*fini)(drew_pksig_t *, int);
+	int (*generate)(drew_pksig_t *, const drew_param_t *);
+	int (*setmode)(drew_pksig_t *, int);
+	int (*setval)(drew_pksig_t *, const char *, const uint8_t *, size_t);
+	int (*val)(const drew_pksig_t *, const char *, uint8_t *, size_t);
+	int (*valsize)(const drew_pksig_t *, const char *);
+	int (*sign)(const drew_pksig_t *, drew_bignum_t *, const drew_bignum_t *);
+	int (*verify)(const drew_pksig_t *, drew_bignum_t *, const drew_bignum_t *);
+	int (*test)(void *, DrewLoader *);
+	int (*verifybatch)(const drew_pksig_t *, drew_bignum_t *,
+			const drew_bignum_t *, int *, size_t, const drew_param_t *);
+	int (*signbatch)(const drew_pksig_t *, drew_bignum_t *,
+			const drew_bignum_t *, int *, size_t, const drew_param_t *);
+} drew_pksig_functbl6_t;
+
 typedef drew_pksig_functbl2_t drew_pksig_functbl0_t;
 typedef drew_pksig_functbl2_t drew_pksig_functbl1_t;
-typedef drew_pksig_functbl4_t drew_pksig_functbl_t;
+typedef drew_pksig_functbl6_t drew_pksig_functbl_t;
 
 struct drew_pksig_s {
 	void *ctx;
@@ -139,6 +139,8 @@ DREW_SYM_PUBLIC
 int drew_loader_get_metadata(DrewLoader *ldr, int id, int item,
 		drew_metadata_t *meta);
 DREW_SYM_PUBLIC
+int drew_loader_freeze(DrewLoader *ldr);
+DREW_SYM_PUBLIC
 int drew_loader_get_search_path(DrewLoader *ldr, int num,
 		const char **p);
 
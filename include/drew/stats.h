@@ -0,0 +1,83 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef DREW_STATS_H
+#define DREW_STATS_H
+
+#include <stdint.h>
+
+#include <drew/drew.h>
+#include <drew/plugin.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Counters are only maintained if libdrew was built with CFG_STATS (which
+ * defines DREW_STATS); otherwise, the functions below return
+ * -DREW_ERR_NOT_IMPL.  Counters are only ever incremented and are not
+ * synchronized with one another, so a snapshot taken while other threads are
+ * running is not necessarily consistent across fields.
+ */
+
+/* Flags for drew_stats_snapshot.
+ *
+ * THREAD returns only the counts accumulated by the calling thread instead of
+ * the totals for the process.
+ */
+#define DREW_STATS_THREAD		(1 << 0)
+
+typedef struct {
+	uint64_t mem_allocs;	// Calls to the non-secure drew_mem allocators.
+	uint64_t mem_bytes;		// Bytes requested from those functions.
+	uint64_t smem_allocs;	// Calls to the secure drew_mem allocators.
+	uint64_t smem_bytes;	// Bytes requested from those functions.
+	uint64_t mem_reallocs;	// Calls to drew_mem_*realloc.
+	uint64_t mem_frees;		// Calls to drew_mem_*free with non-NULL pointers.
+	uint64_t mlocks;		// Calls to mlock.
+	uint64_t mlock_bytes;	// Bytes passed to mlock.
+	uint64_t mlock_failures;	// Calls to mlock that failed.
+	uint64_t lookups;		// Calls to drew_loader_lookup_by_*.
+	uint64_t functbl_gets;	// Calls to drew_loader_get_functbl.
+	uint64_t lock_acquires;	// Acquisitions of a loader lock.
+	uint64_t lock_waits;	// Acquisitions which had to block.
+} drew_stats_t;
+
+typedef struct {
+	uint64_t inits;
+	uint64_t clones;
+	uint64_t finis;
+} drew_plugin_stats_t;
+
+DREW_SYM_PUBLIC
+int drew_stats_snapshot(drew_stats_t *stats, int flags);
+/* Returns the number of init, clone, and fini calls made through the functbl
+ * of plugin id.  Only plugins using the current ABI for their type are
+ * counted; for others, -DREW_ERR_NOT_IMPL is returned.
+ */
+DREW_SYM_PUBLIC
+int drew_loader_get_stats(DrewLoader *ldr, int id, drew_plugin_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
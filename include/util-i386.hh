@@ -24,8 +24,9 @@
 
 /* This file simply contains specializations for i386 and amd64 machines.  Most
  * of this file provides no extra functionality, only performance optimizations.
- * The sole exception is the GetCpuid function, which is used to determine if
- * certain cryptographic operations are available on the processor.
+ * The sole exceptions are the GetCpuid, HasAESNI, and HasAVX2 functions, which
+ * are used to determine if certain cryptographic operations are available on
+ * the processor.
  */
 
 #if !(defined(__i386__) || defined(__x86_64__))
@@ -86,6 +87,60 @@ inline int GetCpuid(uint32_t func, uint32_t &a, uint32_t &b, uint32_t &c,
 #endif
 }
 
+// Like the above, but for leaves (such as 7) which also take a subleaf in ecx.
+inline int GetCpuid(uint32_t func, uint32_t subfunc, uint32_t &a, uint32_t &b,
+		uint32_t &c, uint32_t &d)
+{
+#if defined(DREW_COMPILER_GCCLIKE)
+#if defined(__amd64__)
+	__asm__ __volatile__("cpuid"
+			: "=a"(a), "=b"(b), "=c"(c), "=d"(d)
+			: "a"(func), "c"(subfunc));
+#else
+	__asm__ __volatile__("push %%ebx\n\tcpuid\n\tmovl %%ebx, %1\n\tpop %%ebx\n"
+			: "=a"(a), "=r"(b), "=c"(c), "=d"(d)
+			: "a"(func), "c"(subfunc));
+#endif
+	return 0;
+#else
+	return -DREW_ERR_NOT_IMPL;
+#endif
+}
+
+/* Every processor with AES-NI also has SSSE3, but check for both anyway, since
+ * the code which uses the AES instructions for other ciphers also uses pshufb.
+ */
+inline bool HasAESNI()
+{
+	uint32_t a, b, c, d;
+	if (GetCpuid(1, a, b, c, d))
+		return false;
+	return (c & 0x02000200) == 0x02000200;
+}
+
+/* AVX and AVX2 need not only processor support, but also an operating system
+ * which saves the ymm registers on context switch.  The latter is indicated by
+ * OSXSAVE and the bits set in XCR0.
+ */
+inline bool HasAVX2()
+{
+#if defined(DREW_COMPILER_GCCLIKE)
+	uint32_t a, b, c, d, xlo, xhi;
+	if (GetCpuid(0, a, b, c, d) || a < 7)
+		return false;
+	GetCpuid(1, a, b, c, d);
+	if ((c & 0x18000000) != 0x18000000)
+		return false;
+	__asm__ __volatile__("xgetbv" : "=a"(xlo), "=d"(xhi) : "c"(0));
+	if ((xlo & 0x6) != 0x6)
+		return false;
+	GetCpuid(7, 0, a, b, c, d);
+	return b & 0x00000020;
+#else
+	return false;
+#endif
+}
+
 template<>
 inline uint8_t EndianBase::GetArrayByte(const uint64_t *arr, size_t n)
 {
@@ -0,0 +1,57 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef DREW_COUNTERS_H
+#define DREW_COUNTERS_H
+
+#include <stddef.h>
+
+#include <drew/stats.h>
+
+/* Each counter is kept twice: once in a process-wide structure, which is
+ * updated with a relaxed atomic add, and once in a thread-local structure,
+ * which needs no synchronization at all.  Without DREW_STATS, these macros
+ * expand to nothing.
+ */
+#ifdef DREW_STATS
+extern drew_stats_t drew_stats__global;
+extern __thread drew_stats_t drew_stats__thread;
+
+#define STATS_ADD(field, n) do { \
+	__atomic_fetch_add(&drew_stats__global.field, (n), __ATOMIC_RELAXED); \
+	drew_stats__thread.field += (n); \
+} while (0)
+
+/* Replaces the init, clone, and fini entries of a functbl with counting
+ * trampolines.  Returns the index used to look up the counts, or -1 if the
+ * table cannot be counted.
+ */
+int drew_stats__wrap(int type, void *functbl, size_t size);
+int drew_stats__plugin(int slot, drew_plugin_stats_t *stats);
+/* Tells the trampolines in slot that the wrapped functbl has moved. */
+void drew_stats__move(int slot, const void *functbl);
+#else
+#define STATS_ADD(field, n) do { } while (0)
+#endif
+
+#define STATS_INC(field) STATS_ADD(field, 1)
+
+#endif
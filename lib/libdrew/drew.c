@@ -21,15 +21,20 @@
  */
 
 #include "internal.h"
+#include "counters.h"
 #include <drew/drew.h>
+#include <drew/stats.h>
 
 #include <dlfcn.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include <glib-2.0/gmodule.h>
 #include <glib-2.0/glib.h>
@@ -39,6 +44,14 @@
 #define FLAG_PLUGIN_OK		1
 // Set if the plugin contains no implementations.
 #define FLAG_PLUGIN_DUMMY	2
+// Set if the plugin is only known from a manifest and its library has not yet
+// been opened.
+#define FLAG_PLUGIN_LAZY	4
+
+// Set if manifests should be ignored.
+#define FLAG_LOADER_NO_MANIFEST	1
+
+#define MANIFEST_NAME "manifest"
 
 typedef int (*plugin_api_t)(void *, int, int, void *);
 
@@ -50,10 +63,17 @@ typedef struct {
 	char *name;
 	char *path;
 	plugin_api_t api;
-	handle_t handle;
+	handle_t handle;	// NULL if not yet opened.
 	int nplugins;
 } library_t;
 
+// There is one of these per directory that we've looked for a manifest in.
+typedef struct {
+	char *path;
+	char *data;			// NULL if there is no manifest.
+	time_t mtime;
+} manifest_t;
+
 // There is one of these per plugin (that is, item with a functbl).
 typedef struct {
 	char *name;
@@ -65,10 +85,13 @@ typedef struct {
 	int flags;
 	int nmetadata;
 	drew_metadata_t *metadata;
+	int stats_slot;
 } plugin_t;
 
 // We use a GRWLock here because after setup, the lock will be essentially
-// uncontended assuming nobody tries to load more plugins.
+// uncontended assuming nobody tries to load more plugins.  Once the loader is
+// frozen, lib and plugin (and everything they point to that we allocated) live
+// in a single read-only mapping, arena, and the lock is no longer used.
 struct _DrewLoader {
 	int version;
 	int flags;
@@ -76,6 +99,11 @@ struct _DrewLoader {
 	library_t *lib;
 	int nplugins;
 	plugin_t *plugin;
+	int nmanifests;
+	manifest_t *manifest;
+	void *arena;
+	size_t arenasize;
+	gint frozen;
 	gint ref_count;
 	GRWLock lock;
 };
@@ -84,6 +112,42 @@ struct _DrewLoaderClass {
 	GObjectClass parent_class;
 };
 
+/* Returns whether the lock was taken, which must be passed to read_unlock.  The
+ * loader may be frozen while we wait for the lock, so frozen can't be checked
+ * again when unlocking.
+ */
+static inline bool read_lock(DrewLoader *ldr)
+{
+	// A frozen loader never changes, so it can be read without locking.
+	if (g_atomic_int_get(&ldr->frozen))
+		return false;
+#ifdef DREW_STATS
+	STATS_INC(lock_acquires);
+	if (g_rw_lock_reader_trylock(&ldr->lock))
+		return true;
+	STATS_INC(lock_waits);
+#endif
+	g_rw_lock_reader_lock(&ldr->lock);
+	return true;
+}
+
+static inline void read_unlock(DrewLoader *ldr, bool locked)
+{
+	if (locked)
+		g_rw_lock_reader_unlock(&ldr->lock);
+}
+
+static inline void write_lock(DrewLoader *ldr)
+{
+#ifdef DREW_STATS
+	STATS_INC(lock_acquires);
+	if (g_rw_lock_writer_trylock(&ldr->lock))
+		return;
+	STATS_INC(lock_waits);
+#endif
+	g_rw_lock_writer_lock(&ldr->lock);
+}
+
 static handle_t open_library(const char *pathname)
 {
 	return g_module_open(pathname, G_MODULE_BIND_LAZY | G_MODULE_BIND_LOCAL);
@@ -101,17 +165,13 @@ static plugin_api_t get_api(handle_t handle)
 		p : NULL;
 }
 
-/* Allocate a library table entry and load the library information from it.  If
- * library is NULL, try to load the current executable instead.
- */
-static int load_library(DrewLoader *ldr, const char *library,
-		const char *path, library_t **libp)
+/* Allocate a new, empty library table entry. */
+static library_t *new_library(DrewLoader *ldr)
 {
-	int err = 0;
 	library_t *p, *lib;
 	p = g_realloc(ldr->lib, sizeof(*p) * (ldr->nlibs + 1));
 	if (!p)
-		return -ENOMEM;
+		return NULL;
 	if (p != ldr->lib) {
 		// Fix up the lib pointers in the plugins.
 		for (int i = 0; i < ldr->nplugins; i++)
@@ -121,6 +181,19 @@ static int load_library(DrewLoader *ldr, const char *library,
 	lib = &ldr->lib[ldr->nlibs];
 	memset(lib, 0, sizeof(*lib));
 	ldr->nlibs++;
+	return lib;
+}
+
+/* Allocate a library table entry and load the library information from it.  If
+ * library is NULL, try to load the current executable instead.
+ */
+static int load_library(DrewLoader *ldr, const char *library,
+		const char *path, library_t **libp)
+{
+	int err = 0;
+	library_t *lib;
+	if (!(lib = new_library(ldr)))
+		return -ENOMEM;
 
 	if (!library) {
 		err = -DREW_ERR_RESOLUTION;
@@ -157,6 +230,102 @@ out:
 	return err;
 }
 
+/* Load the information for the plugin with index i in the library into p,
+ * which must be zeroed.  On failure, anything allocated is freed again.
+ */
+static int load_plugin_info(DrewLoader *ldr, library_t *lib, plugin_t *p,
+		int i)
+{
+	int err, namesize, mdsize;
+
+	err = -DREW_ERR_ENUMERATION;
+	p->type = lib->api(ldr, DREW_LOADER_GET_TYPE, i, NULL);
+	if (p->type < 0)
+		goto out;
+
+	p->functblsize = lib->api(ldr, DREW_LOADER_GET_FUNCTBL_SIZE, i, NULL);
+	if (p->functblsize <= 0 || p->functblsize % sizeof(void *))
+		goto out;
+
+	// Includes terminating NUL.
+	namesize = lib->api(ldr, DREW_LOADER_GET_NAME_SIZE, i, NULL);
+	if (namesize <= 0)
+		goto out;
+
+	// Metadata are optional, so don't error out if they're not available.
+	mdsize = lib->api(ldr, DREW_LOADER_GET_METADATA_SIZE, i, NULL);
+	if (mdsize < 0)
+		mdsize = 0;
+
+	err = -ENOMEM;
+	p->functbl = g_malloc(p->functblsize);
+	if (!p->functbl)
+		goto out;
+
+	if (mdsize) {
+		p->metadata = g_malloc(mdsize);
+		if (!p->metadata)
+			goto out;
+	}
+
+	p->name = g_malloc(namesize);
+	if (!p->name)
+		goto out;
+
+	err = -DREW_ERR_FUNCTION;
+	if (lib->api(ldr, DREW_LOADER_GET_FUNCTBL, i, p->functbl))
+		goto out;
+	p->stats_slot = -1;
+#ifdef DREW_STATS
+	p->stats_slot = drew_stats__wrap(p->type, p->functbl, p->functblsize);
+#endif
+
+	err = -DREW_ERR_ENUMERATION;
+	if (lib->api(ldr, DREW_LOADER_GET_NAME, i, p->name))
+		goto out;
+	p->name[namesize-1] = '\0'; // Just in case.
+
+	if (mdsize)
+		if (lib->api(ldr, DREW_LOADER_GET_METADATA, i, p->metadata))
+			goto out;
+	p->nmetadata = mdsize / sizeof(drew_metadata_t);
+
+	p->lib = lib;
+	p->flags = FLAG_PLUGIN_OK;
+	err = 0;
+out:
+	if (err) {
+		g_free(p->functbl);
+		g_free(p->name);
+		g_free(p->metadata);
+		p->functbl = NULL;
+		p->name = NULL;
+		p->metadata = NULL;
+	}
+	return err;
+}
+
+/* Allocate space for nplugins more plugins (or one dummy entry, if nplugins is
+ * zero) and return a pointer to the first new entry.
+ */
+static plugin_t *new_plugins(DrewLoader *ldr, int nplugins)
+{
+	int extra = !nplugins;
+	plugin_t *p;
+
+	p = g_realloc(ldr->plugin, sizeof(*p) * (ldr->nplugins + nplugins + 1));
+	if (!p)
+		return NULL;
+	memset(p+ldr->nplugins, 0, sizeof(*p) * (nplugins + 1));
+	ldr->plugin = p;
+	p += ldr->nplugins;
+	ldr->nplugins += nplugins + extra;
+
+	if (extra)
+		p->flags = FLAG_PLUGIN_DUMMY;
+	return p;
+}
+
 /* Load all the info from the library, including all plugin-specific
  * information.
  */
@@ -164,93 +333,235 @@ static int load_library_info(DrewLoader *ldr, library_t *lib)
 {
 	int err = -DREW_ERR_ENUMERATION;
 	int offset = ldr->nplugins;
-	int extra = 0;
 	plugin_t *p = NULL;
 
 	lib->nplugins = lib->api(ldr, DREW_LOADER_GET_NPLUGINS, 0, NULL);
 	if (lib->nplugins < 0)
 		goto out;
 
-	if (!lib->nplugins)
-		extra = 1;
-
 	err = -ENOMEM;
-	p = g_realloc(ldr->plugin, sizeof(*p) * (ldr->nplugins + lib->nplugins + 1));
-	if (!p)
+	if (!(p = new_plugins(ldr, lib->nplugins)))
 		goto out;
-	memset(p+ldr->nplugins, 0, sizeof(*p) * (lib->nplugins + 1));
-	ldr->nplugins += lib->nplugins + extra;
-	ldr->plugin = p;
-
-	if (!lib->nplugins)
-		p[ldr->nplugins-1].flags = FLAG_PLUGIN_DUMMY;
 
-	p += offset;
 	for (int i = 0; i < lib->nplugins; i++, p++) {
-		int namesize, mdsize;
-
-		memset(p, 0, sizeof(*p));
-
-		err = -DREW_ERR_ENUMERATION;
-		p->type = lib->api(ldr, DREW_LOADER_GET_TYPE, i, NULL);
-		if (p->type < 0)
+		if ((err = load_plugin_info(ldr, lib, p, i)))
 			goto out;
+		p->id = offset + i;
+	}
+	err = 0;
+out:
+	return err ? err : offset;
+}
 
-		p->functblsize = lib->api(ldr, DREW_LOADER_GET_FUNCTBL_SIZE, i, NULL);
-		if (p->functblsize <= 0 || p->functblsize % sizeof(void *))
-			goto out;
+/* Find the manifest in the directory path, reading it if we haven't already.
+ * The manifest is a text file with one line per plugin, each with four
+ * tab-separated fields: the library filename, the index of the plugin within
+ * that library, its type, and its algorithm name.  Lines starting with # are
+ * ignored.  It is written by drew-config --manifest.
+ */
+static manifest_t *get_manifest(DrewLoader *ldr, const char *path)
+{
+	manifest_t *m;
+	struct stat st;
+	char *filename;
 
-		// Includes terminating NUL.
-		namesize = lib->api(ldr, DREW_LOADER_GET_NAME_SIZE, i, NULL);
-		if (namesize <= 0)
-			goto out;
+	for (int i = 0; i < ldr->nmanifests; i++)
+		if (!strcmp(ldr->manifest[i].path, path))
+			return ldr->manifest + i;
 
-		// Metadata are optional, so don't error out if they're not available.
-		mdsize = lib->api(ldr, DREW_LOADER_GET_METADATA_SIZE, i, NULL);
-		if (mdsize < 0)
-			mdsize = 0;
+	m = g_realloc(ldr->manifest, sizeof(*m) * (ldr->nmanifests + 1));
+	if (!m)
+		return NULL;
+	ldr->manifest = m;
+	m += ldr->nmanifests;
+	memset(m, 0, sizeof(*m));
+	if (!(m->path = g_strdup(path)))
+		return NULL;
+	ldr->nmanifests++;
+
+	// A missing manifest is recorded too, so we don't look for it again.
+	filename = g_strdup_printf("%s/%s", path, MANIFEST_NAME);
+	if (filename && !stat(filename, &st)) {
+		m->mtime = st.st_mtime;
+		if (!g_file_get_contents(filename, &m->data, NULL, NULL))
+			m->data = NULL;
+	}
+	g_free(filename);
+	return m;
+}
 
-		err = -ENOMEM;
-		p->functbl = g_malloc(p->functblsize);
-		if (!p->functbl)
-			goto out;
+/* Parse one line of a manifest.  Returns the start of the next line, or NULL
+ * if the manifest is exhausted and there was no line to parse.  *namep is NULL
+ * if the line is not an entry for library.  The name is not NUL-terminated; its
+ * length is put in *lenp.
+ */
+static const char *parse_manifest_line(const char *line, const char *library,
+		int *indexp, int *typep, const char **namep, size_t *lenp)
+{
+	size_t liblen = strlen(library);
+	const char *end, *next;
+	char *q;
 
-		if (mdsize) {
-			p->metadata = g_malloc(mdsize);
-			if (!p->metadata)
-				goto out;
-		}
+	*namep = NULL;
+	if (!*line)
+		return NULL;
+	end = strchr(line, '\n');
+	next = end ? end + 1 : line + strlen(line);
+	if (!end)
+		end = next;
+
+	if (*line == '#' || strncmp(line, library, liblen) || line[liblen] != '\t')
+		return next;
+	line += liblen + 1;
+	*indexp = strtol(line, &q, 10);
+	if (q == line || *q != '\t')
+		return next;
+	line = q + 1;
+	*typep = strtol(line, &q, 10);
+	if (q == line || *q != '\t' || *typep <= 0)
+		return next;
+	*namep = q + 1;
+	*lenp = end - *namep;
+	return next;
+}
 
-		p->name = g_malloc(namesize);
-		if (!p->name)
-			goto out;
+/* Add the plugins in library, as listed in the manifest in path, without
+ * opening the library.  The library is opened by load_lazy_library when one of
+ * the plugins' functbls or metadata are needed.  If there is no usable entry in
+ * the manifest, return -DREW_ERR_NONEXISTENT so that the caller can fall back
+ * to opening the library.
+ */
+static int load_from_manifest(DrewLoader *ldr, const char *library,
+		const char *path)
+{
+	int offset = ldr->nplugins, count = 0, index, type;
+	const char *line, *name;
+	size_t len;
+	manifest_t *m;
+	library_t *lib;
+	plugin_t *p;
+	char *libpath;
+	struct stat st;
 
-		err = -DREW_ERR_FUNCTION;
-		if (lib->api(ldr, DREW_LOADER_GET_FUNCTBL, i, p->functbl))
-			goto out;
+	if (ldr->flags & FLAG_LOADER_NO_MANIFEST)
+		return -DREW_ERR_NONEXISTENT;
+	if (!(m = get_manifest(ldr, path)) || !m->data)
+		return -DREW_ERR_NONEXISTENT;
 
-		err = -DREW_ERR_ENUMERATION;
-		if (lib->api(ldr, DREW_LOADER_GET_NAME, i, p->name))
-			goto out;
-		p->name[namesize-1] = '\0'; // Just in case.
+	// Entries must be listed in order, and the library must not have been
+	// changed since the manifest was written.
+	line = m->data;
+	while ((line = parse_manifest_line(line, library, &index, &type, &name,
+					&len))) {
+		if (!name)
+			continue;
+		if (index != count++)
+			return -DREW_ERR_NONEXISTENT;
+	}
+	if (!count)
+		return -DREW_ERR_NONEXISTENT;
 
-		if (mdsize)
-			if (lib->api(ldr, DREW_LOADER_GET_METADATA, i, p->metadata))
-				goto out;
-		p->nmetadata = mdsize / sizeof(drew_metadata_t);
+	if (!(libpath = g_strdup_printf("%s/%s", path, library)))
+		return -ENOMEM;
+	if (stat(libpath, &st) || st.st_mtime > m->mtime) {
+		g_free(libpath);
+		return -DREW_ERR_NONEXISTENT;
+	}
+
+	if (!(lib = new_library(ldr))) {
+		g_free(libpath);
+		return -ENOMEM;
+	}
+	lib->path = libpath;
+	lib->name = g_strdup(library);
+	lib->nplugins = count;
 
+	if (!(p = new_plugins(ldr, count)))
+		return -ENOMEM;
+	line = m->data;
+	while ((line = parse_manifest_line(line, library, &index, &type, &name,
+					&len))) {
+		if (!name)
+			continue;
+		p->name = g_strndup(name, len);
+		p->type = type;
 		p->lib = lib;
-		p->id = offset + i;
-		p->flags = FLAG_PLUGIN_OK;
+		p->id = offset + index;
+		p->stats_slot = -1;
+		p->flags = FLAG_PLUGIN_OK | FLAG_PLUGIN_LAZY;
+		p++;
 	}
-	err = 0;
+	return offset;
+}
+
+/* Open the library for plugin id, which was loaded from a manifest, and load
+ * the information for all its plugins.  This must be called under the write
+ * lock.
+ */
+static int load_lazy_library(DrewLoader *ldr, int id)
+{
+	library_t *lib = ldr->plugin[id].lib;
+	plugin_t *p, *tmp = NULL;
+	int start, err;
+
+	if (!(ldr->plugin[id].flags & FLAG_PLUGIN_LAZY))
+		return 0;
+
+	for (start = id; start > 0 && ldr->plugin[start-1].lib == lib; start--);
+	p = ldr->plugin + start;
+
+	err = -DREW_ERR_RESOLUTION;
+	if (!(lib->handle = open_library(lib->path)))
+		goto out;
+	err = -DREW_ERR_ENUMERATION;
+	if (!(lib->api = get_api(lib->handle)))
+		goto out;
+	if (lib->api(ldr, DREW_LOADER_GET_NPLUGINS, 0, NULL) != lib->nplugins)
+		goto out;
+
+	// Load everything first so that a stale manifest leaves things unchanged.
+	err = -ENOMEM;
+	if (!(tmp = g_malloc0(sizeof(*tmp) * lib->nplugins)))
+		goto out;
+	for (int i = 0; i < lib->nplugins; i++) {
+		if ((err = load_plugin_info(ldr, lib, tmp + i, i)))
+			break;
+		if (tmp[i].type != p[i].type || strcmp(tmp[i].name, p[i].name))
+			err = -DREW_ERR_ENUMERATION;
+	}
+	for (int i = 0; i < lib->nplugins; i++) {
+		if (!err) {
+			// Keep the old name; callers may already have a pointer to it.
+			g_free(tmp[i].name);
+			tmp[i].name = p[i].name;
+			tmp[i].id = p[i].id;
+			p[i] = tmp[i];
+		}
+		else {
+			g_free(tmp[i].functbl);
+			g_free(tmp[i].name);
+			g_free(tmp[i].metadata);
+		}
+	}
+	g_free(tmp);
 out:
-	if (err && p) {
-		g_free(p->functbl);
-		g_free(p->name);
-		g_free(p->metadata);
+	if (err && lib->handle) {
+		close_library(lib->handle);
+		lib->handle = NULL;
+		lib->api = NULL;
 	}
-	return err ? err : offset;
+	return err;
+}
+
+/* Like load_lazy_library, but takes the write lock itself. */
+static int load_lazy(DrewLoader *ldr, int id)
+{
+	int retval;
+
+	write_lock(ldr);
+	retval = load_lazy_library(ldr, id);
+	g_rw_lock_writer_unlock(&ldr->lock);
+	return retval;
 }
 
 DrewLoader *drew_loader_new(void)
@@ -264,6 +575,9 @@ DrewLoader *drew_loader_new(void)
 
 	ldr->ref_count = 1;
 
+	if (g_getenv("DREW_LOADER_NO_MANIFEST"))
+		ldr->flags |= FLAG_LOADER_NO_MANIFEST;
+
 	// This protects everything except the reference count, which is atomic.
 	g_rw_lock_init(&ldr->lock);
 
@@ -285,13 +599,28 @@ void drew_loader_unref(DrewLoader *ldr)
 
 	if (g_atomic_int_dec_and_test(&ldr->ref_count)) {
 		g_rw_lock_clear(&ldr->lock);
+		if (ldr->frozen) {
+			for (int i = 0; i < ldr->nlibs; i++)
+				if (ldr->lib[i].handle)
+					close_library(ldr->lib[i].handle);
+			munmap(ldr->arena, ldr->arenasize);
+			g_free(ldr);
+			return;
+		}
 		for (int i = 0; i < ldr->nlibs; i++) {
 			g_free(ldr->lib[i].name);
 			g_free(ldr->lib[i].path);
-			close_library(ldr->lib[i].handle);
+			if (ldr->lib[i].handle)
+				close_library(ldr->lib[i].handle);
 		}
 		g_free(ldr->lib);
 
+		for (int i = 0; i < ldr->nmanifests; i++) {
+			g_free(ldr->manifest[i].path);
+			g_free(ldr->manifest[i].data);
+		}
+		g_free(ldr->manifest);
+
 		for (int i = 0; i < ldr->nplugins; i++) {
 			if (!(ldr->plugin[i].flags & FLAG_PLUGIN_OK))
 				continue;
@@ -312,7 +641,12 @@ int drew_loader_load_plugin(DrewLoader *ldr, const char *plugin,
 	int retval = 0, err = 0;
 	library_t *lib;
 
-	g_rw_lock_writer_lock(&ldr->lock);
+	write_lock(ldr);
+
+	if (ldr->frozen) {
+		retval = -DREW_ERR_NOT_ALLOWED;
+		goto out;
+	}
 
 	if (plugin && !path) {
 		int npaths = drew_loader_get_search_path(ldr, 0, NULL), i;
@@ -324,6 +658,8 @@ int drew_loader_load_plugin(DrewLoader *ldr, const char *plugin,
 
 		for (i = 0; i < npaths; i++) {
 			drew_loader_get_search_path(ldr, i, &path);
+			if ((retval = load_from_manifest(ldr, plugin, path)) >= 0)
+				goto out;
 			if (!load_library(ldr, plugin, path, &lib))
 				break;
 		}
@@ -332,6 +668,9 @@ int drew_loader_load_plugin(DrewLoader *ldr, const char *plugin,
 			goto out;
 		}
 	}
+	else if (plugin &&
+			(retval = load_from_manifest(ldr, plugin, path)) >= 0)
+		goto out;
 	else if ((err = load_library(ldr, plugin, path, &lib))) {
 		retval = err;
 		goto out;
@@ -342,6 +681,157 @@ out:
 	return retval;
 }
 
+/* A simple bump allocator used to lay out a frozen loader. */
+struct arena {
+	uint8_t *p;
+	size_t off;
+};
+
+static inline size_t arena_round(size_t len)
+{
+	return (len + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+}
+
+static inline size_t arena_strsize(const char *s)
+{
+	return s ? arena_round(strlen(s) + 1) : 0;
+}
+
+static void *arena_copy(struct arena *a, const void *src, size_t len)
+{
+	void *dst = a->p + a->off;
+
+	if (!src)
+		return NULL;
+	memcpy(dst, src, len);
+	a->off += arena_round(len);
+	return dst;
+}
+
+static char *arena_strdup(struct arena *a, const char *s)
+{
+	return s ? arena_copy(a, s, strlen(s) + 1) : NULL;
+}
+
+/* Make the loader immutable.  All the plugins listed in manifests are loaded,
+ * and then the library and plugin tables, along with the names, functbls, and
+ * metadata, are copied into a single read-only mapping.  After this, no more
+ * plugins can be loaded and lookups no longer take the lock.  Since the data
+ * are never written again, processes forked after freezing share them.
+ *
+ * Any functbl or name pointers obtained before freezing are no longer valid.
+ */
+int drew_loader_freeze(DrewLoader *ldr)
+{
+	struct arena a = {NULL, 0};
+	library_t *libs;
+	plugin_t *plugins;
+	size_t size, pgsize;
+	long val;
+	int retval = 0;
+
+	if (!ldr)
+		return -DREW_ERR_INVALID;
+
+	write_lock(ldr);
+
+	if (ldr->frozen)
+		goto out;
+
+	for (int i = 0; i < ldr->nplugins; i++) {
+		plugin_t *p = ldr->plugin + i;
+
+		if (!(p->flags & FLAG_PLUGIN_LAZY) || !load_lazy_library(ldr, i))
+			continue;
+		// The manifest was wrong about this library; forget its plugins.
+		for (int j = i; j < ldr->nplugins && ldr->plugin[j].lib == p->lib;
+				j++) {
+			g_free(ldr->plugin[j].name);
+			ldr->plugin[j].name = NULL;
+			ldr->plugin[j].flags = 0;
+		}
+	}
+
+	size = arena_round(sizeof(*libs) * ldr->nlibs) +
+		arena_round(sizeof(*plugins) * ldr->nplugins);
+	for (int i = 0; i < ldr->nlibs; i++)
+		size += arena_strsize(ldr->lib[i].name) +
+			arena_strsize(ldr->lib[i].path);
+	for (int i = 0; i < ldr->nplugins; i++) {
+		const plugin_t *p = ldr->plugin + i;
+
+		size += arena_strsize(p->name);
+		if (p->functbl)
+			size += arena_round(p->functblsize);
+		if (p->metadata)
+			size += arena_round(sizeof(*p->metadata) * p->nmetadata);
+	}
+	val = sysconf(_SC_PAGESIZE);
+	pgsize = (val <= 0) ? 4096 : val;
+	// mmap won't map zero bytes, so there's always at least one page.
+	size = (size + !size + pgsize - 1) & ~(pgsize - 1);
+
+	retval = -ENOMEM;
+	a.p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+			-1, 0);
+	if (a.p == MAP_FAILED)
+		goto out;
+
+	libs = arena_copy(&a, ldr->lib, sizeof(*libs) * ldr->nlibs);
+	plugins = arena_copy(&a, ldr->plugin, sizeof(*plugins) * ldr->nplugins);
+	for (int i = 0; i < ldr->nlibs; i++) {
+		libs[i].name = arena_strdup(&a, ldr->lib[i].name);
+		libs[i].path = arena_strdup(&a, ldr->lib[i].path);
+	}
+	for (int i = 0; i < ldr->nplugins; i++) {
+		const plugin_t *old = ldr->plugin + i;
+		plugin_t *p = plugins + i;
+
+		if (old->lib)
+			p->lib = libs + (old->lib - ldr->lib);
+		p->name = arena_strdup(&a, old->name);
+		if (old->functbl)
+			p->functbl = arena_copy(&a, old->functbl, old->functblsize);
+		if (old->metadata)
+			p->metadata = arena_copy(&a, old->metadata,
+					sizeof(*old->metadata) * old->nmetadata);
+#ifdef DREW_STATS
+		if (p->functbl)
+			drew_stats__move(p->stats_slot, p->functbl);
+#endif
+	}
+	mprotect(a.p, size, PROT_READ);
+
+	for (int i = 0; i < ldr->nlibs; i++) {
+		g_free(ldr->lib[i].name);
+		g_free(ldr->lib[i].path);
+	}
+	for (int i = 0; i < ldr->nplugins; i++) {
+		g_free(ldr->plugin[i].name);
+		g_free(ldr->plugin[i].functbl);
+		g_free(ldr->plugin[i].metadata);
+	}
+	g_free(ldr->lib);
+	g_free(ldr->plugin);
+	for (int i = 0; i < ldr->nmanifests; i++) {
+		g_free(ldr->manifest[i].path);
+		g_free(ldr->manifest[i].data);
+	}
+	g_free(ldr->manifest);
+	ldr->manifest = NULL;
+	ldr->nmanifests = 0;
+
+	ldr->lib = libs;
+	ldr->plugin = plugins;
+	ldr->arena = a.p;
+	ldr->arenasize = size;
+	g_atomic_int_set(&ldr->frozen, 1);
+	retval = 0;
+out:
+	g_rw_lock_writer_unlock(&ldr->lock);
+	return retval;
+}
+
 static inline bool is_valid_id(DrewLoader *ldr, int id, int dummyok)
 {
 	int mask = FLAG_PLUGIN_OK | (dummyok ? FLAG_PLUGIN_DUMMY : 0);
@@ -367,7 +857,7 @@ int drew_loader_get_nplugins(DrewLoader *ldr, int id)
 	if (!ldr)
 		return -DREW_ERR_INVALID;
 
-	g_rw_lock_reader_lock(&ldr->lock);
+	bool locked = read_lock(ldr);
 
 	if (id == -1) {
 		retval = ldr->nplugins;
@@ -380,7 +870,7 @@ int drew_loader_get_nplugins(DrewLoader *ldr, int id)
 
 	retval = ldr->plugin[id].lib->nplugins;
 out:
-	g_rw_lock_reader_unlock(&ldr->lock);
+	read_unlock(ldr, locked);
 	return retval;
 }
 
@@ -389,22 +879,44 @@ int drew_loader_get_type(DrewLoader *ldr, int id)
 	if (!ldr)
 		return -DREW_ERR_INVALID;
 
-	g_rw_lock_reader_lock(&ldr->lock);
+	bool locked = read_lock(ldr);
 
 	int retval = is_valid_id(ldr, id, 0) ? ldr->plugin[id].type :
 		-DREW_ERR_INVALID;
 
-	g_rw_lock_reader_unlock(&ldr->lock);
+	read_unlock(ldr, locked);
+
+	return retval;
+}
+
+int drew_loader_get_stats(DrewLoader *ldr, int id, drew_plugin_stats_t *stats)
+{
+#ifdef DREW_STATS
+	if (!ldr || !stats)
+		return -DREW_ERR_INVALID;
+
+	bool locked = read_lock(ldr);
+
+	int retval = is_valid_id(ldr, id, 0) ?
+		drew_stats__plugin(ldr->plugin[id].stats_slot, stats) :
+		-DREW_ERR_INVALID;
+
+	read_unlock(ldr, locked);
 
 	return retval;
+#else
+	return -DREW_ERR_NOT_IMPL;
+#endif
 }
 
 int drew_loader_get_functbl(DrewLoader *ldr, int id, const void **tbl)
 {
+	STATS_INC(functbl_gets);
+
 	if (!ldr)
 		return -DREW_ERR_INVALID;
 
-	g_rw_lock_reader_lock(&ldr->lock);
+	bool locked = read_lock(ldr);
 
 	int retval;
 
@@ -413,13 +925,20 @@ int drew_loader_get_functbl(DrewLoader *ldr, int id, const void **tbl)
 		goto out;
 	}
 
+	if (ldr->plugin[id].flags & FLAG_PLUGIN_LAZY) {
+		read_unlock(ldr, locked);
+		if ((retval = load_lazy(ldr, id)))
+			return retval;
+		locked = read_lock(ldr);
+	}
+
 	if (tbl)
 		*tbl = ldr->plugin[id].functbl;
 
 	retval = ldr->plugin[id].functblsize;
 
 out:
-	g_rw_lock_reader_unlock(&ldr->lock);
+	read_unlock(ldr, locked);
 	return retval;
 }
 
@@ -429,7 +948,7 @@ int drew_loader_get_algo_name(DrewLoader *ldr, int id,
 	if (!ldr)
 		return -DREW_ERR_INVALID;
 
-	g_rw_lock_reader_lock(&ldr->lock);
+	bool locked = read_lock(ldr);
 
 	int retval = 0;
 
@@ -438,7 +957,7 @@ int drew_loader_get_algo_name(DrewLoader *ldr, int id,
 	else
 		*namep = ldr->plugin[id].name;
 
-	g_rw_lock_reader_unlock(&ldr->lock);
+	read_unlock(ldr, locked);
 
 	return retval;
 }
@@ -446,10 +965,12 @@ int drew_loader_get_algo_name(DrewLoader *ldr, int id,
 int drew_loader_lookup_by_name(DrewLoader *ldr, const char *name,
 		int start, int end)
 {
+	STATS_INC(lookups);
+
 	if (!ldr)
 		return -DREW_ERR_INVALID;
 
-	g_rw_lock_reader_lock(&ldr->lock);
+	bool locked = read_lock(ldr);
 
 	if (end == -1)
 		end = ldr->nplugins;
@@ -458,12 +979,12 @@ int drew_loader_lookup_by_name(DrewLoader *ldr, const char *name,
 		if (!is_valid_id(ldr, i, 0))
 			continue;
 		if (!strcmp(ldr->plugin[i].name, name)) {
-			g_rw_lock_reader_unlock(&ldr->lock);
+			read_unlock(ldr, locked);
 			return i;
 		}
 	}
 
-	g_rw_lock_reader_unlock(&ldr->lock);
+	read_unlock(ldr, locked);
 
 	return -DREW_ERR_NONEXISTENT;
 }
@@ -471,10 +992,12 @@ int drew_loader_lookup_by_name(DrewLoader *ldr, const char *name,
 int drew_loader_lookup_by_type(DrewLoader *ldr, int type, int start,
 		int end)
 {
+	STATS_INC(lookups);
+
 	if (!ldr)
 		return -DREW_ERR_INVALID;
 
-	g_rw_lock_reader_lock(&ldr->lock);
+	bool locked = read_lock(ldr);
 
 	if (end == -1)
 		end = ldr->nplugins;
@@ -483,12 +1006,12 @@ int drew_loader_lookup_by_type(DrewLoader *ldr, int type, int start,
 		if (!is_valid_id(ldr, i, 0))
 			continue;
 		if (ldr->plugin[i].type == type) {
-			g_rw_lock_reader_unlock(&ldr->lock);
+			read_unlock(ldr, locked);
 			return i;
 		}
 	}
 
-	g_rw_lock_reader_unlock(&ldr->lock);
+	read_unlock(ldr, locked);
 
 	return -DREW_ERR_NONEXISTENT;
 }
@@ -555,29 +1078,39 @@ int drew_loader_get_metadata(DrewLoader *ldr, int id, int item,
 	if (!ldr)
 		return -DREW_ERR_INVALID;
 
-	g_rw_lock_reader_lock(&ldr->lock);
+	bool locked = read_lock(ldr);
 
 	if (!is_valid_id(ldr, id, 0)) {
-		g_rw_lock_reader_unlock(&ldr->lock);
+		read_unlock(ldr, locked);
 		return -DREW_ERR_NONEXISTENT;
 	}
 
+	if (ldr->plugin[id].flags & FLAG_PLUGIN_LAZY) {
+		read_unlock(ldr, locked);
+		if ((retval = load_lazy(ldr, id)))
+			return retval;
+		locked = read_lock(ldr);
+	}
+
 	if (item == -1) {
 		retval = special_metadata(ldr, id,
 				(item - ldr->plugin[id].nmetadata), NULL);
+		retval = ldr->plugin[id].nmetadata + (retval == 0);
 
-		g_rw_lock_reader_unlock(&ldr->lock);
-		return ldr->plugin[id].nmetadata + (retval == 0);
+		read_unlock(ldr, locked);
+		return retval;
 	}
 
-	if (item < 0)
+	if (item < 0) {
+		read_unlock(ldr, locked);
 		return -DREW_ERR_INVALID;
+	}
 
 	if (item < ldr->plugin[id].nmetadata) {
 		memcpy(meta, ldr->plugin[id].metadata + item, sizeof(*meta));
 		meta->predicate = g_strdup(meta->predicate);
 		meta->object = g_strdup(meta->object);
-		g_rw_lock_reader_unlock(&ldr->lock);
+		read_unlock(ldr, locked);
 		return 0;
 	}
 	else {
@@ -587,15 +1120,15 @@ int drew_loader_get_metadata(DrewLoader *ldr, int id, int item,
 		if (retval < 0) {
 			g_free((void *)md.predicate);
 			g_free((void *)md.object);
-			g_rw_lock_reader_unlock(&ldr->lock);
+			read_unlock(ldr, locked);
 			return -DREW_ERR_NONEXISTENT;
 		}
 		memcpy(meta, &md, sizeof(*meta));
-		g_rw_lock_reader_unlock(&ldr->lock);
+		read_unlock(ldr, locked);
 		return 0;
 	}
 
-	g_rw_lock_reader_unlock(&ldr->lock);
+	read_unlock(ldr, locked);
 
 	return -DREW_ERR_NONEXISTENT;
 }
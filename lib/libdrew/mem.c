@@ -40,6 +40,7 @@
 
 #include "internal.h"
 #include "util.h"
+#include "counters.h"
 
 #include <errno.h>
 #include <limits.h>
@@ -167,9 +168,15 @@ static inline void *do_allocate(struct pool *pool, size_t size, int secure,
 	if (secure || ALWAYS_ZERO)
 		if (!(new = create_entry(pool, p, size, secure)))
 			goto err;
-	if (secure && !(pool->flags & DREW_MEM_SECMEM_NO_LOCK) &&
-			mlock(p, new->block) && !(pool->flags & DREW_MEM_SECMEM_FAIL_OK))
-		goto err;
+	if (secure && !(pool->flags & DREW_MEM_SECMEM_NO_LOCK)) {
+		STATS_INC(mlocks);
+		STATS_ADD(mlock_bytes, new->block);
+		if (mlock(p, new->block)) {
+			STATS_INC(mlock_failures);
+			if (!(pool->flags & DREW_MEM_SECMEM_FAIL_OK))
+				goto err;
+		}
+	}
 	if (new)
 		pool->alloc = new;
 	return p;
@@ -184,6 +191,14 @@ static inline void *allocate(struct pool *pool, size_t size, int secure,
 {
 	bool defpool = !pool;
 	void *p;
+	if (secure) {
+		STATS_INC(smem_allocs);
+		STATS_ADD(smem_bytes, size);
+	}
+	else {
+		STATS_INC(mem_allocs);
+		STATS_ADD(mem_bytes, size);
+	}
 	if (!size)
 		return NULL;
 	if (defpool)
@@ -291,6 +306,7 @@ void drew_mem_psfree(void *poolp, void *ptr)
 	struct allocation *p, *prev;
 	if (!ptr)
 		return;
+	STATS_INC(mem_frees);
 	LOCK(pool);
 	if (defpool)
 		init_pool();
@@ -320,8 +336,11 @@ void drew_mem_pfree(void *poolp, void *ptr)
 {
 	if (ALWAYS_ZERO)
 		drew_mem_psfree(poolp, ptr);
-	else
+	else {
+		if (ptr)
+			STATS_INC(mem_frees);
 		free(ptr);
+	}
 }
 
 void drew_mem_free(void *ptr)
@@ -365,6 +384,7 @@ static inline void *do_realloc(struct pool *pool, void *ptr, void *new,
 void *drew_mem_psrealloc(void *poolp, void *ptr, size_t size)
 {
 	void *new = NULL;
+	STATS_INC(mem_reallocs);
 	if (!ptr)
 		return drew_mem_psmalloc(poolp, size);
 	if (!size) {
@@ -385,6 +405,7 @@ void *drew_mem_srealloc(void *ptr, size_t size)
 void *drew_mem_prealloc(void *poolp, void *ptr, size_t size)
 {
 	void *new = NULL;
+	STATS_INC(mem_reallocs);
 	if (!ptr)
 		return drew_mem_pmalloc(poolp, size);
 	if (!size) {
@@ -0,0 +1,250 @@
+/*-
+ * Copyright © 2011 brian m. carlson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* Optional counters for tuning.  See <drew/stats.h>. */
+
+#include "internal.h"
+#include "counters.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <drew/drew.h>
+#include <drew/stats.h>
+
+#ifdef DREW_STATS
+#include <drew/block.h>
+#include <drew/bignum.h>
+#include <drew/ecc.h>
+#include <drew/hash.h>
+#include <drew/kdf.h>
+#include <drew/mac.h>
+#include <drew/mode.h>
+#include <drew/pkenc.h>
+#include <drew/pksig.h>
+#include <drew/prng.h>
+#include <drew/stream.h>
+
+drew_stats_t drew_stats__global;
+__thread drew_stats_t drew_stats__thread;
+
+/* Plugins call each other (and are called by applications) directly through
+ * their functbls, so the only way to count init, clone, and fini calls is to
+ * hand out a functbl whose entries point to a trampoline that bumps a counter
+ * and then calls the real function.  The trampolines need to know which
+ * function to call, so there is a fixed number of them, each with its own
+ * slot.  Slots are never reused; plugins loaded after they are exhausted are
+ * simply not counted.
+ *
+ * Plugins point the context's functbl at their own copy of the table, which
+ * would bypass the trampolines for every call after init, so a successful init
+ * or clone points it back at the loader's copy.  Some plugins install a
+ * different table entirely to select a faster implementation; those are left
+ * alone (and only their inits are counted).
+ *
+ * All the current functbls have the same signatures for these functions,
+ * modulo the type of the context pointer, and all the context types have the
+ * same layout.
+ */
+typedef int (*init_t)(void *, int, DrewLoader *, const drew_param_t *);
+typedef int (*clone_t)(void *, const void *, int);
+typedef int (*fini_t)(void *, int);
+
+struct context {
+	void *ctx;
+	const void *functbl;
+	void *priv;
+};
+
+struct slot {
+	init_t init;
+	clone_t clone;
+	fini_t fini;
+	const void *functbl;
+	void *orig;
+	size_t size;
+	drew_plugin_stats_t stats;
+};
+
+#define NSLOTS 120
+
+static struct slot slots[NSLOTS];
+static int nslots;
+
+#define REPEAT10(m, x) m(x ## 0) m(x ## 1) m(x ## 2) m(x ## 3) m(x ## 4) \
+	m(x ## 5) m(x ## 6) m(x ## 7) m(x ## 8) m(x ## 9)
+#define REPEAT(m) REPEAT10(m, ) REPEAT10(m, 1) REPEAT10(m, 2) \
+	REPEAT10(m, 3) REPEAT10(m, 4) REPEAT10(m, 5) REPEAT10(m, 6) \
+	REPEAT10(m, 7) REPEAT10(m, 8) REPEAT10(m, 9) REPEAT10(m, 10) \
+	REPEAT10(m, 11)
+
+#define COUNT(n, field) \
+	__atomic_fetch_add(&slots[n].stats.field, 1, __ATOMIC_RELAXED)
+
+static inline void redirect(struct slot *s, struct context *ctx)
+{
+	if (!memcmp(ctx->functbl, s->orig, s->size))
+		ctx->functbl = s->functbl;
+}
+
+#define TRAMPOLINES(n) \
+static int init_ ## n(void *ctx, int flags, DrewLoader *ldr, \
+		const drew_param_t *param) \
+{ \
+	int res; \
+	COUNT(n, inits); \
+	if (!(res = slots[n].init(ctx, flags, ldr, param))) \
+		redirect(slots + n, ctx); \
+	return res; \
+} \
+static int clone_ ## n(void *newctx, const void *oldctx, int flags) \
+{ \
+	int res; \
+	COUNT(n, clones); \
+	if (!(res = slots[n].clone(newctx, oldctx, flags))) \
+		redirect(slots + n, newctx); \
+	return res; \
+} \
+static int fini_ ## n(void *ctx, int flags) \
+{ \
+	COUNT(n, finis); \
+	return slots[n].fini(ctx, flags); \
+}
+
+#define ENTRY(n) { init_ ## n, clone_ ## n, fini_ ## n },
+
+REPEAT(TRAMPOLINES)
+
+static const struct {
+	init_t init;
+	clone_t clone;
+	fini_t fini;
+} trampolines[] = {
+	REPEAT(ENTRY)
+};
+
+struct layout {
+	size_t size;
+	size_t init;
+	size_t clone;
+	size_t fini;
+};
+
+#define LAYOUT(t) { \
+	sizeof(t), offsetof(t, init), offsetof(t, clone), offsetof(t, fini) \
+}
+
+static const struct layout layouts[] = {
+	[DREW_TYPE_HASH] = LAYOUT(drew_hash_functbl3_t),
+	[DREW_TYPE_BLOCK] = LAYOUT(drew_block_functbl3_t),
+	[DREW_TYPE_MODE] = LAYOUT(drew_mode_functbl4_t),
+	[DREW_TYPE_MAC] = LAYOUT(drew_mac_functbl5_t),
+	[DREW_TYPE_STREAM] = LAYOUT(drew_stream_functbl3_t),
+	[DREW_TYPE_PRNG] = LAYOUT(drew_prng_functbl4_t),
+	[DREW_TYPE_BIGNUM] = LAYOUT(drew_bignum_functbl5_t),
+	[DREW_TYPE_PKENC] = LAYOUT(drew_pkenc_functbl4_t),
+	[DREW_TYPE_PKSIG] = LAYOUT(drew_pksig_functbl6_t),
+	[DREW_TYPE_KDF] = LAYOUT(drew_kdf_functbl4_t),
+	[DREW_TYPE_ECC] = LAYOUT(drew_ecc_functbl4_t),
+};
+
+/* This is called with the loader's write lock held, but slots are shared
+ * between loaders, so the allocation must still be atomic.
+ */
+int drew_stats__wrap(int type, void *functbl, size_t size)
+{
+	const struct layout *l;
+	unsigned char *tbl = functbl;
+	struct slot *s;
+	int n;
+
+	STATIC_ASSERT(DIM(trampolines) == NSLOTS);
+
+	if (type <= 0 || (size_t)type >= DIM(layouts))
+		return -1;
+	l = layouts + type;
+	// An older ABI; the entries aren't where we expect them.
+	if (size != l->size)
+		return -1;
+	if ((n = __atomic_fetch_add(&nslots, 1, __ATOMIC_RELAXED)) >= NSLOTS)
+		return -1;
+	s = slots + n;
+	if (!(s->orig = malloc(size)))
+		return -1;
+	memcpy(s->orig, functbl, size);
+	s->size = size;
+	memcpy(&s->init, tbl + l->init, sizeof(s->init));
+	memcpy(&s->clone, tbl + l->clone, sizeof(s->clone));
+	memcpy(&s->fini, tbl + l->fini, sizeof(s->fini));
+	s->functbl = functbl;
+	memcpy(tbl + l->init, &trampolines[n].init, sizeof(s->init));
+	memcpy(tbl + l->clone, &trampolines[n].clone, sizeof(s->clone));
+	memcpy(tbl + l->fini, &trampolines[n].fini, sizeof(s->fini));
+	return n;
+}
+
+void drew_stats__move(int slot, const void *functbl)
+{
+	if (slot >= 0 && slot < NSLOTS)
+		slots[slot].functbl = functbl;
+}
+
+int drew_stats__plugin(int slot, drew_plugin_stats_t *stats)
+{
+	const drew_plugin_stats_t *s;
+
+	if (slot < 0 || slot >= NSLOTS)
+		return -DREW_ERR_NOT_IMPL;
+	s = &slots[slot].stats;
+	stats->inits = __atomic_load_n(&s->inits, __ATOMIC_RELAXED);
+	stats->clones = __atomic_load_n(&s->clones, __ATOMIC_RELAXED);
+	stats->finis = __atomic_load_n(&s->finis, __ATOMIC_RELAXED);
+	return 0;
+}
+#endif
+
+int drew_stats_snapshot(drew_stats_t *stats, int flags)
+{
+#ifdef DREW_STATS
+	const uint64_t *src;
+	uint64_t *dst = (uint64_t *)stats;
+
+	if (!stats)
+		return -DREW_ERR_INVALID;
+	if (flags & ~DREW_STATS_THREAD)
+		return -DREW_ERR_INVALID;
+
+	if (flags & DREW_STATS_THREAD) {
+		memcpy(stats, &drew_stats__thread, sizeof(*stats));
+		return 0;
+	}
+
+	STATIC_ASSERT(sizeof(*stats) % sizeof(uint64_t) == 0);
+	src = (const uint64_t *)&drew_stats__global;
+	for (size_t i = 0; i < sizeof(*stats) / sizeof(uint64_t); i++)
+		dst[i] = __atomic_load_n(src + i, __ATOMIC_RELAXED);
+	return 0;
+#else
+	return -DREW_ERR_NOT_IMPL;
+#endif
+}
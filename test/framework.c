@@ -11,6 +11,9 @@
 #include "framework.h"
 
 #include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -23,8 +26,26 @@
 
 #include <drew/mem.h>
 #include <drew/plugin.h>
+#include <drew/stats.h>
 
 double cpuspeed = 0;
+clockid_t framework_clock = DEFAULT_CLOCK;
+
+/* When set, the speed tests run on several threads at once and the timer that
+ * stops them is armed by test_scaling, not framework_setup.
+ */
+static bool framework_threaded;
+
+/* While a benchmark is running, print_speed_info records its measurement here
+ * instead of printing it.  Each thread has its own.
+ */
+static __thread struct {
+	bool active;
+	bool valid;
+	double start;
+	double secs;
+	double bytes;
+} bench_sample;
 
 bool is_forbidden_errno(int val)
 {
@@ -52,6 +73,7 @@ void framework_sighandler(int signum)
 
 struct framework_data {
 	timer_t timer;
+	bool armed;
 };
 
 void *framework_setup(void)
@@ -64,6 +86,10 @@ void *framework_setup(void)
 	if (!fwdata)
 		return NULL;
 
+	fwdata->armed = !framework_threaded;
+	if (!fwdata->armed)
+		return fwdata;
+
 	memset(&timerspec, 0, sizeof(timerspec));
 	timerspec.it_value.tv_sec = NSECONDS;
 	act.sa_flags = SA_RESETHAND;
@@ -82,8 +108,13 @@ void framework_teardown(void *data)
 	struct framework_data *fwdata = data;
 	struct itimerspec timerspec;
 
-	memset(&timerspec, 0, sizeof(timerspec));
-	timer_settime(fwdata->timer, 0, &timerspec, NULL);
+	if (fwdata->armed) {
+		memset(&timerspec, 0, sizeof(timerspec));
+		timer_settime(fwdata->timer, 0, &timerspec, NULL);
+		// Benchmarks call this many times, so don't leak timers.
+		timer_delete(fwdata->timer);
+	}
+	drew_mem_free(fwdata);
 }
 
 int print_test_results_impl(int result, char **ids, const char *text)
@@ -132,6 +163,15 @@ void print_speed_info(int chunk, int nchunks, const struct timespec *cstart,
 	start = sec_from_timespec(cstart);
 	end = sec_from_timespec(cend);
 	diff = end - start;
+
+	if (bench_sample.active) {
+		bench_sample.start = start;
+		bench_sample.secs = diff;
+		bench_sample.bytes = chunk * ((double)nchunks);
+		bench_sample.valid = true;
+		return;
+	}
+
 	rate = chunk * ((double)nchunks) / diff;
 	rate /= 1048576;
 
@@ -142,6 +182,480 @@ void print_speed_info(int chunk, int nchunks, const struct timespec *cstart,
 	putchar('\n');
 }
 
+/* The benchmark mode.  For each message size, the speed test is run a few
+ * times to warm up and then a number of times to measure; the median, mean, and
+ * standard deviation of the throughput are reported along with the median
+ * number of cycles per byte.
+ */
+#define BENCH_TEXT	0
+#define BENCH_CSV	1
+#define BENCH_JSON	2
+
+// The smallest and largest message sizes in the sweep, in bytes.
+#define BENCH_MIN_SIZE	16
+#define BENCH_MAX_SIZE	(1024 * 1024)
+// The amount of data processed in each run, unless overridden with -n.
+#define BENCH_BYTES		(4 * 1024 * 1024)
+#define BENCH_REPS		5
+#define BENCH_WARMUP	1
+#define BENCH_MAX_REPS	100
+
+struct bench_opts {
+	int format;
+	int reps;
+	int warmup;
+	const char *category;
+	double hz;
+	bool first;
+};
+
+#if defined(__i386__) || defined(__x86_64__)
+static inline uint64_t read_tsc(void)
+{
+	uint32_t lo, hi;
+
+	__asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((uint64_t)hi << 32) | lo;
+}
+
+/* Determine how many TSC ticks elapse per second of USED_CLOCK.  The TSC ticks
+ * at a constant rate, so these are reference cycles, not core cycles.
+ */
+static double calibrate_tsc(void)
+{
+	struct timespec start, now;
+	uint64_t tstart, tend;
+	double elapsed;
+
+	clock_gettime(USED_CLOCK, &start);
+	tstart = read_tsc();
+	do {
+		clock_gettime(USED_CLOCK, &now);
+		elapsed = sec_from_timespec(&now) - sec_from_timespec(&start);
+	} while (elapsed < 0.1);
+	tend = read_tsc();
+
+	return (tend - tstart) / elapsed;
+}
+#else
+static double calibrate_tsc(void)
+{
+	return 0;
+}
+#endif
+
+static int compare_doubles(const void *a, const void *b)
+{
+	const double *x = a, *y = b;
+
+	return (*x > *y) - (*x < *y);
+}
+
+static double median(double *v, int n)
+{
+	qsort(v, n, sizeof(*v), compare_doubles);
+	return (n & 1) ? v[n/2] : (v[n/2 - 1] + v[n/2]) / 2;
+}
+
+static void print_json_string(const char *s)
+{
+	putchar('"');
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			putchar('\\');
+		putchar(*s);
+	}
+	putchar('"');
+}
+
+static void bench_print_header(struct bench_opts *opts)
+{
+	if (opts->format == BENCH_CSV)
+		printf("category,name,flags,size,reps,median_mibps,mean_mibps,"
+				"stddev_mibps,min_mibps,max_mibps,cycles_per_byte\n");
+	else if (opts->format == BENCH_JSON) {
+		printf("{\"category\": ");
+		print_json_string(opts->category);
+		printf(", \"tsc_hz\": %.0f, \"results\": [", opts->hz);
+	}
+	opts->first = true;
+}
+
+static void bench_print_footer(struct bench_opts *opts)
+{
+	if (opts->format == BENCH_JSON)
+		printf("\n]}\n");
+}
+
+static void bench_print_row(struct bench_opts *opts, const char *name,
+		int flags, int size, const double *rates, int n, double cpb)
+{
+	double sorted[BENCH_MAX_REPS], mean = 0, var = 0, med;
+
+	memcpy(sorted, rates, n * sizeof(*rates));
+	med = median(sorted, n);
+	for (int i = 0; i < n; i++)
+		mean += rates[i];
+	mean /= n;
+	for (int i = 0; i < n; i++)
+		var += (rates[i] - mean) * (rates[i] - mean);
+	var = n > 1 ? var / (n - 1) : 0;
+
+	switch (opts->format) {
+		case BENCH_CSV:
+			printf("%s,%s,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+					opts->category, name, flags, size, n, med, mean, sqrt(var),
+					sorted[0], sorted[n-1], cpb);
+			break;
+		case BENCH_JSON:
+			printf("%s\n  {\"name\": ", opts->first ? "" : ",");
+			print_json_string(name);
+			printf(", \"flags\": %d, \"size\": %d, \"reps\": %d, "
+					"\"median_mibps\": %.3f, \"mean_mibps\": %.3f, "
+					"\"stddev_mibps\": %.3f, \"min_mibps\": %.3f, "
+					"\"max_mibps\": %.3f, \"cycles_per_byte\": %.3f}",
+					flags, size, n, med, mean, sqrt(var), sorted[0],
+					sorted[n-1], cpb);
+			break;
+		default:
+			printf("%-32s: %8d bytes: %10.3f MiB/s (stddev %.3f, n=%d)",
+					name, size, med, sqrt(var), n);
+			if (cpb)
+				printf(" (%0.3f cycles/byte)", cpb);
+			putchar('\n');
+			break;
+	}
+	opts->first = false;
+	fflush(stdout);
+}
+
+/* Run the speed test for one algorithm over the size sweep, or just chunk if it
+ * is nonzero.  Returns the first error from the speed test, if any.
+ */
+static int test_benchmark(drew_loader_t *ldr, const char *name,
+		const char *algo, const char *label, const void *functbl, int chunk,
+		int nchunks, int flags, struct bench_opts *opts)
+{
+	const int minsize = chunk ? chunk : BENCH_MIN_SIZE;
+	const int maxsize = chunk ? chunk : BENCH_MAX_SIZE;
+
+	for (int size = minsize; size <= maxsize; size *= 4) {
+		double rates[BENCH_MAX_REPS], cpbs[BENCH_MAX_REPS];
+		int n = nchunks, nvalid = 0, res;
+
+		if (!n)
+			n = size < BENCH_BYTES ? BENCH_BYTES / size : 1;
+
+		for (int i = 0; i < opts->warmup + opts->reps; i++) {
+			bench_sample.active = true;
+			bench_sample.valid = false;
+			res = test_speed(ldr, name, algo, functbl, size, n, flags);
+			bench_sample.active = false;
+			if (res)
+				return res;
+			if (i < opts->warmup || !bench_sample.valid ||
+					bench_sample.secs <= 0)
+				continue;
+			rates[nvalid] = bench_sample.bytes / bench_sample.secs / 1048576;
+			cpbs[nvalid] = opts->hz * bench_sample.secs / bench_sample.bytes;
+			nvalid++;
+		}
+		if (nvalid)
+			bench_print_row(opts, label, flags, size, rates, nvalid,
+					median(cpbs, nvalid));
+	}
+	return 0;
+}
+
+/* The scaling mode.  The speed test runs on 1, 2, 4, ... up to the requested
+ * number of threads at once, all sharing the loader, and reports the aggregate
+ * throughput, the throughput of each thread, and how close the aggregate comes
+ * to the single-threaded throughput times the number of threads.
+ */
+struct scale_gate {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool open;
+};
+
+struct scale_thread {
+	pthread_t thread;
+	struct scale_gate *gate;
+	drew_loader_t *ldr;
+	const char *name;
+	const char *algo;
+	const void *functbl;
+	int chunk;
+	int nchunks;
+	int flags;
+	int result;
+	bool valid;
+	double start;
+	double secs;
+	double bytes;
+};
+
+static void *scale_worker(void *arg)
+{
+	struct scale_thread *st = arg;
+
+	bench_sample.active = true;
+	bench_sample.valid = false;
+	pthread_mutex_lock(&st->gate->lock);
+	while (!st->gate->open)
+		pthread_cond_wait(&st->gate->cond, &st->gate->lock);
+	pthread_mutex_unlock(&st->gate->lock);
+	st->result = test_speed(st->ldr, st->name, st->algo, st->functbl,
+			st->chunk, st->nchunks, st->flags);
+	bench_sample.active = false;
+
+	st->valid = bench_sample.valid && bench_sample.secs > 0;
+	st->start = bench_sample.start;
+	st->secs = bench_sample.secs;
+	st->bytes = bench_sample.bytes;
+	return NULL;
+}
+
+static void scale_print_header(struct bench_opts *opts)
+{
+	if (opts->format == BENCH_CSV)
+		printf("category,name,flags,size,threads,aggregate_mibps,"
+				"thread_mean_mibps,thread_min_mibps,thread_max_mibps,"
+				"efficiency\n");
+	else if (opts->format == BENCH_JSON) {
+		printf("{\"category\": ");
+		print_json_string(opts->category);
+		printf(", \"results\": [");
+	}
+	opts->first = true;
+}
+
+static void scale_print_row(struct bench_opts *opts, const char *name,
+		int flags, int size, int nthreads, double aggregate, double mean,
+		double min, double max, double efficiency)
+{
+	switch (opts->format) {
+		case BENCH_CSV:
+			printf("%s,%s,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.1f\n", opts->category,
+					name, flags, size, nthreads, aggregate, mean, min, max,
+					efficiency);
+			break;
+		case BENCH_JSON:
+			printf("%s\n  {\"name\": ", opts->first ? "" : ",");
+			print_json_string(name);
+			printf(", \"flags\": %d, \"size\": %d, \"threads\": %d, "
+					"\"aggregate_mibps\": %.3f, \"thread_mean_mibps\": %.3f, "
+					"\"thread_min_mibps\": %.3f, \"thread_max_mibps\": %.3f, "
+					"\"efficiency\": %.1f}", flags, size, nthreads, aggregate,
+					mean, min, max, efficiency);
+			break;
+		default:
+			printf("%-32s: %3d threads: %10.3f MiB/s (per thread %.3f, "
+					"min %.3f, max %.3f) (%.1f%% efficiency)\n", name,
+					nthreads, aggregate, mean, min, max, efficiency);
+			break;
+	}
+	opts->first = false;
+	fflush(stdout);
+}
+
+static int run_threads(struct scale_thread *threads, int nthreads)
+{
+	struct scale_gate gate = {
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER,
+		.open = false
+	};
+	struct itimerspec timerspec;
+	struct sigaction act;
+	timer_t timer;
+	int res = 0, created = 0;
+
+	memset(&act, 0, sizeof(act));
+	act.sa_flags = SA_RESETHAND;
+	act.sa_handler = framework_sighandler;
+	framework_sigflag = 0;
+	sigaction(SIGALRM, &act, NULL);
+	timer_create(USED_CLOCK, NULL, &timer);
+
+	for (; created < nthreads; created++) {
+		threads[created].gate = &gate;
+		if (pthread_create(&threads[created].thread, NULL, scale_worker,
+					threads + created))
+			break;
+	}
+	memset(&timerspec, 0, sizeof(timerspec));
+	timerspec.it_value.tv_sec = NSECONDS;
+	if (created < nthreads) {
+		// Let the threads that did start finish right away.
+		res = -ENOMEM;
+		framework_sigflag = 1;
+	}
+	else
+		timer_settime(timer, 0, &timerspec, NULL);
+
+	pthread_mutex_lock(&gate.lock);
+	gate.open = true;
+	pthread_cond_broadcast(&gate.cond);
+	pthread_mutex_unlock(&gate.lock);
+
+	for (int i = 0; i < created; i++)
+		pthread_join(threads[i].thread, NULL);
+
+	memset(&timerspec, 0, sizeof(timerspec));
+	timer_settime(timer, 0, &timerspec, NULL);
+	timer_delete(timer);
+	return res;
+}
+
+static int test_scaling(drew_loader_t *ldr, const char *name,
+		const char *algo, const char *label, const void *functbl, int chunk,
+		int nchunks, int flags, int maxthreads, struct bench_opts *opts)
+{
+	struct scale_thread *threads;
+	double base = 0;
+	int res = 0;
+
+	threads = calloc(maxthreads, sizeof(*threads));
+	if (!threads)
+		return -ENOMEM;
+
+	framework_threaded = true;
+	for (int step = 1; ; step *= 2) {
+		const int n = step < maxthreads ? step : maxthreads;
+		double first = 0, last = 0, bytes = 0, sum = 0, min = 0, max = 0;
+		double aggregate;
+
+		for (int i = 0; i < n; i++) {
+			struct scale_thread *st = threads + i;
+
+			memset(st, 0, sizeof(*st));
+			st->ldr = ldr;
+			st->name = name;
+			st->algo = algo;
+			st->functbl = functbl;
+			st->chunk = chunk;
+			st->nchunks = nchunks;
+			st->flags = flags;
+		}
+		if ((res = run_threads(threads, n)))
+			break;
+
+		for (int i = 0; i < n; i++) {
+			struct scale_thread *st = threads + i;
+			double rate;
+
+			if ((res = st->result))
+				break;
+			if (!st->valid) {
+				res = -DREW_ERR_BUG;
+				break;
+			}
+			rate = st->bytes / st->secs / 1048576;
+			if (!i || st->start < first)
+				first = st->start;
+			if (!i || st->start + st->secs > last)
+				last = st->start + st->secs;
+			if (!i || rate < min)
+				min = rate;
+			if (!i || rate > max)
+				max = rate;
+			sum += rate;
+			bytes += st->bytes;
+		}
+		if (res)
+			break;
+
+		aggregate = bytes / (last - first) / 1048576;
+		if (n == 1)
+			base = aggregate;
+		scale_print_row(opts, label, flags, chunk, n, aggregate, sum / n, min,
+				max, aggregate / (base * n) * 100);
+		if (n == maxthreads)
+			break;
+	}
+	framework_threaded = false;
+	free(threads);
+	return res;
+}
+
+/* The latency mode.  The test programs time individual operations with
+ * measure_latency, which prints percentiles of the time per call.  Calls that
+ * are too quick for the clock are timed in batches, and each sample is then the
+ * mean of a batch.  Slow calls, such as key generation, run past the time limit
+ * until there are enough samples for the percentiles to mean something, but
+ * never past LATENCY_MAX_SLOW_TIME; a 4096-bit RSA key can take seconds.
+ */
+#define LATENCY_SAMPLES		10000
+#define LATENCY_MIN_SAMPLES	32
+#define LATENCY_MIN_BATCH	1000.0 // nanoseconds
+#define LATENCY_MAX_BATCH	(1 << 20)
+#define LATENCY_MAX_TIME	1e9 // nanoseconds
+#define LATENCY_MAX_SLOW_TIME	5e9 // nanoseconds
+#define LATENCY_WARMUP		1e7 // nanoseconds
+
+static const char *latency_label;
+
+static double ns_between(const struct timespec *start,
+		const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1e9 +
+		(end->tv_nsec - start->tv_nsec);
+}
+
+static double percentile(const double *sorted, int n, double p)
+{
+	int i = ceil(p * n) - 1;
+
+	return sorted[i < 0 ? 0 : (i >= n ? n - 1 : i)];
+}
+
+int measure_latency(const char *op, int (*func)(void *), void *arg)
+{
+	struct timespec start, end;
+	double *samples, ns, total = 0;
+	int batch = 1, calls = 0, n = 0, res = 0;
+
+	/* Warm up the caches and find how many calls make up a sample from the mean
+	 * time per call.
+	 */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		if ((res = func(arg)))
+			return res;
+		calls++;
+		clock_gettime(CLOCK_MONOTONIC, &end);
+	} while ((ns = ns_between(&start, &end)) < LATENCY_WARMUP);
+	while (batch < LATENCY_MAX_BATCH && batch * ns / calls < LATENCY_MIN_BATCH)
+		batch *= 2;
+
+	if (!(samples = malloc(LATENCY_SAMPLES * sizeof(*samples))))
+		return -ENOMEM;
+
+	while (n < LATENCY_SAMPLES && total < LATENCY_MAX_SLOW_TIME &&
+			(n < LATENCY_MIN_SAMPLES || total < LATENCY_MAX_TIME)) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (int i = 0; i < batch; i++)
+			if ((res = func(arg)))
+				goto out;
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		ns = ns_between(&start, &end);
+		total += ns;
+		samples[n++] = ns / batch;
+	}
+
+	qsort(samples, n, sizeof(*samples), compare_doubles);
+	printf("%-32s: %-24s: %10.1f ns (p90 %.1f, p99 %.1f, p99.9 %.1f, "
+			"max %.1f) (%d samples of %d)\n", latency_label, op,
+			percentile(samples, n, 0.5), percentile(samples, n, 0.9),
+			percentile(samples, n, 0.99), percentile(samples, n, 0.999),
+			samples[n-1], n, batch);
+	fflush(stdout);
+out:
+	free(samples);
+	return res;
+}
+
 // Some algorithms will need to handle the empty input.
 int process_bytes(ssize_t len, uint8_t **buf, const char *data)
 {
@@ -164,16 +678,61 @@ int process_bytes(ssize_t len, uint8_t **buf, const char *data)
 	return TEST_OK;
 }
 
+/* Print the library's counters to stderr, so that they don't get mixed up
+ * with machine-readable benchmark output.
+ */
+static void print_stats(DrewLoader *ldr, int type)
+{
+	drew_stats_t st;
+	int nplugins, res;
+
+	if ((res = drew_stats_snapshot(&st, 0))) {
+		fprintf(stderr, "stats: not available (%d)\n", res);
+		return;
+	}
+	fprintf(stderr, "stats: mem: %" PRIu64 " allocs (%" PRIu64 " bytes), "
+			"%" PRIu64 " secure allocs (%" PRIu64 " bytes), "
+			"%" PRIu64 " reallocs, %" PRIu64 " frees\n",
+			st.mem_allocs, st.mem_bytes, st.smem_allocs, st.smem_bytes,
+			st.mem_reallocs, st.mem_frees);
+	fprintf(stderr, "stats: mlock: %" PRIu64 " calls (%" PRIu64 " bytes), "
+			"%" PRIu64 " failed\n",
+			st.mlocks, st.mlock_bytes, st.mlock_failures);
+	fprintf(stderr, "stats: loader: %" PRIu64 " lookups, "
+			"%" PRIu64 " functbl requests, "
+			"%" PRIu64 " lock acquisitions (%" PRIu64 " waited)\n",
+			st.lookups, st.functbl_gets, st.lock_acquires, st.lock_waits);
+
+	nplugins = drew_loader_get_nplugins(ldr, -1);
+	for (int i = 0; i < nplugins; i++) {
+		drew_plugin_stats_t ps;
+		const char *name;
+
+		if (drew_loader_get_type(ldr, i) != type)
+			continue;
+		if (drew_loader_get_stats(ldr, i, &ps))
+			continue;
+		if (!ps.inits && !ps.clones && !ps.finis)
+			continue;
+		drew_loader_get_algo_name(ldr, i, &name);
+		fprintf(stderr, "stats: %-24s: %" PRIu64 " inits, %" PRIu64 " clones, "
+				"%" PRIu64 " finis\n", name, ps.inits, ps.clones, ps.finis);
+	}
+}
+
 int usage(const char *argv0, int retval)
 {
 	FILE *fp = retval ? stderr : stdout;
-	fprintf(fp, "usage:\n%s [-hspti] [options]\n", argv0);
+	fprintf(fp, "usage:\n%s [-hsptibl] [-j num] [options]\n", argv0);
 	fprintf(fp,
 			"\t-h\t: print this help message\n"
 			"\t-s\t: perform a speed test (default)\n"
 			"\t-p\t: perform a test for compliance to the API\n"
 			"\t-t\t: perform a test using a test vector file\n"
-			"\t-i\t: perform a test using code in the plugin\n\n");
+			"\t-i\t: perform a test using code in the plugin\n"
+			"\t-b\t: perform a benchmark over a range of sizes\n"
+			"\t-j num\t: perform a speed test on up to num threads at once\n"
+			"\t-l\t: measure the latency of individual operations\n\n");
 	fprintf(fp,
 			"\t-f\t: treat unimplemented tests as errors\n"
 			"\t-a algo\t: specify a secondary algorithm\n"
@@ -181,7 +740,11 @@ int usage(const char *argv0, int retval)
 			"\t-n num\t: process num chunks\n"
 			"\t-o algo\t: only use algorithm algo\n"
 			"\t-u speed\t: specify cpu speed in GHz\n"
-			"\t-r file\t: use file for test vectors\n");
+			"\t-r file\t: use file for test vectors\n"
+			"\t-F fmt\t: print benchmark results as text, csv, or json\n"
+			"\t-R num\t: measure each benchmark num times\n"
+			"\t-W num\t: run each benchmark num times before measuring\n"
+			"\t-S\t: print library statistics when finished\n");
 	return retval;
 }
 
@@ -199,16 +762,23 @@ int main(int argc, char **argv)
 	int verbose = 0;
 	int flags = 0;
 	int success_only = 0;
+	int nthreads = 0;
+	int stats = 0;
 	const char *optalgo = NULL;
 	const char *only = NULL;
 	const char *resource = NULL; // A filename of testcases.
 	drew_loader_t *ldr = NULL;
 	struct test_external tes;
+	struct bench_opts bopts = {
+		.format = BENCH_TEXT,
+		.reps = BENCH_REPS,
+		.warmup = BENCH_WARMUP
+	};
 
 	ldr = drew_loader_new();
 	drew_mem_pool_adjust(NULL, DREW_MEM_SECMEM, DREW_MEM_SECMEM_NO_LOCK, NULL);
 
-	while ((opt = getopt(argc, argv, "hstipfda:c:n:o:r:u:v")) != -1) {
+	while ((opt = getopt(argc, argv, "hstipblfda:c:j:n:o:r:u:vF:R:SW:")) != -1) {
 		switch (opt) {
 			case '?':
 			case ':':
@@ -227,6 +797,18 @@ int main(int argc, char **argv)
 			case 'i':
 				mode = MODE_TEST_INTERNAL;
 				break;
+			case 'b':
+				mode = MODE_BENCH;
+				break;
+			case 'l':
+				mode = MODE_LATENCY;
+				break;
+			case 'j':
+				mode = MODE_SCALE;
+				nthreads = atoi(optarg);
+				if (nthreads < 1)
+					return usage(argv[0], 2);
+				break;
 			case 'f':
 				success_only = 1;
 				break;
@@ -254,14 +836,51 @@ int main(int argc, char **argv)
 			case 'u':
 				cpuspeed = atof(optarg) * 1000000000.0;
 				break;
+			case 'F':
+				if (!strcmp(optarg, "text"))
+					bopts.format = BENCH_TEXT;
+				else if (!strcmp(optarg, "csv"))
+					bopts.format = BENCH_CSV;
+				else if (!strcmp(optarg, "json"))
+					bopts.format = BENCH_JSON;
+				else
+					return usage(argv[0], 2);
+				break;
+			case 'R':
+				bopts.reps = atoi(optarg);
+				if (bopts.reps < 1 || bopts.reps > BENCH_MAX_REPS)
+					return usage(argv[0], 2);
+				break;
+			case 'S':
+				stats = 1;
+				break;
+			case 'W':
+				bopts.warmup = atoi(optarg);
+				if (bopts.warmup < 0)
+					return usage(argv[0], 2);
+				break;
 		}
 	}
 
 	if (!mode)
 		mode = MODE_SPEED;
-	if (chunk <= 0)
+	if (mode == MODE_BENCH || mode == MODE_SCALE) {
+		bopts.category = strrchr(argv[0], '/');
+		bopts.category = bopts.category ? bopts.category + 1 : argv[0];
+		if (!strncmp(bopts.category, "test-", 5))
+			bopts.category += 5;
+	}
+	if (mode == MODE_SCALE)
+		framework_clock = CLOCK_MONOTONIC;
+	if (mode == MODE_BENCH) {
+		// In benchmark mode, the defaults mean a sweep over sizes.
+		chunk = chunk > 0 ? chunk : 0;
+		nchunks = nchunks > 0 ? nchunks : 0;
+		bopts.hz = cpuspeed ? cpuspeed : calibrate_tsc();
+	}
+	else if (chunk <= 0)
 		chunk = CHUNK;
-	if (nchunks <= 0)
+	if (mode != MODE_BENCH && nchunks <= 0)
 		nchunks = NCHUNKS;
 
 	if ((retval = drew_loader_load_plugin(ldr, NULL, NULL))) {
@@ -281,8 +900,13 @@ int main(int argc, char **argv)
 			continue;
 		}
 	}
+	// Nothing else gets loaded, so exercise the frozen lookup paths.
+	if ((retval = drew_loader_freeze(ldr))) {
+		printf("failed to freeze loader (error %d)\n", -retval);
+		error++;
+	}
 
-	if (optalgo)
+	if (optalgo && !(bopts.category && bopts.format != BENCH_TEXT))
 		printf("# Using algorithm %s for tests.\n", optalgo);
 
 	nplugins = drew_loader_get_nplugins(ldr, -1);
@@ -290,6 +914,10 @@ int main(int argc, char **argv)
 
 	if (mode == MODE_TEST)
 		test_external_parse(ldr, resource, &tes);
+	if (mode == MODE_BENCH)
+		bench_print_header(&bopts);
+	if (mode == MODE_SCALE)
+		scale_print_header(&bopts);
 
 	for (i = 0; i < nplugins; i++) {
 		const void *functbl;
@@ -331,8 +959,12 @@ int main(int argc, char **argv)
 			size_t off = strlen(buf);
 			snprintf(buf+off, sizeof(buf)-off, " (%s) ", pluginname);
 		}
-		printf("%-32s: ", buf);
-		fflush(stdout);
+		// These modes print a label on each line of results instead.
+		if (mode != MODE_BENCH && mode != MODE_SCALE &&
+				mode != MODE_LATENCY) {
+			printf("%-32s: ", buf);
+			fflush(stdout);
+		}
 
 		switch (mode) {
 			case MODE_SPEED:
@@ -343,6 +975,24 @@ int main(int argc, char **argv)
 				if (result == -DREW_ERR_NOT_IMPL)
 					print_test_results_impl(result, NULL, "speed test");
 				break;
+			case MODE_BENCH:
+				result = test_benchmark(ldr, name, algo, buf, functbl, chunk,
+						nchunks, flags, &bopts);
+				if (result && ((result != -DREW_ERR_NOT_IMPL) || success_only))
+					error++;
+				break;
+			case MODE_SCALE:
+				result = test_scaling(ldr, name, algo, buf, functbl, chunk,
+						nchunks, flags, nthreads, &bopts);
+				if (result && ((result != -DREW_ERR_NOT_IMPL) || success_only))
+					error++;
+				break;
+			case MODE_LATENCY:
+				latency_label = buf;
+				result = test_latency(ldr, name, algo, functbl, flags);
+				if (result && ((result != -DREW_ERR_NOT_IMPL) || success_only))
+					error++;
+				break;
 			case MODE_TEST:
 				result = test_external(ldr, name, functbl, resource, &tes);
 				if (result && ((result != -DREW_ERR_NOT_IMPL) || success_only))
@@ -365,6 +1015,10 @@ int main(int argc, char **argv)
 	}
 	if (mode == MODE_TEST)
 		test_external_cleanup(&tes);
+	if (mode == MODE_BENCH || mode == MODE_SCALE)
+		bench_print_footer(&bopts);
+	if (stats)
+		print_stats(ldr, type);
 	drew_loader_unref(ldr);
 
 	if (error && !(error & 0xff))
@@ -29,15 +29,23 @@
 #define MODE_TEST			2
 #define MODE_TEST_INTERNAL	3
 #define MODE_TEST_API		4
+#define MODE_BENCH			5
+#define MODE_SCALE			6
+#define MODE_LATENCY		7
 
 #if defined(CLOCK_PROCESS_CPUTIME_ID)
-#define USED_CLOCK CLOCK_PROCESS_CPUTIME_ID
+#define DEFAULT_CLOCK CLOCK_PROCESS_CPUTIME_ID
 #elif defined(CLOCK_MONOTONIC)
-#define USED_CLOCK CLOCK_MONOTONIC
+#define DEFAULT_CLOCK CLOCK_MONOTONIC
 #else
-#define USED_CLOCK CLOCK_REALTIME
+#define DEFAULT_CLOCK CLOCK_REALTIME
 #endif
 
+/* The clock used to time speed tests.  This is DEFAULT_CLOCK except when
+ * running on multiple threads, where process CPU time would count every thread.
+ */
+#define USED_CLOCK framework_clock
+
 #define TEST_CODE(x)		(x & ~0xff)
 
 #define TEST_OK				(0 << 8)
@@ -78,14 +86,18 @@ struct test_external {
 
 
 extern volatile sig_atomic_t framework_sigflag;
+extern clockid_t framework_clock;
 
 int test_get_type(void);
 int test_speed(drew_loader_t *ldr, const char *name, const char *algo,
 		const void *functbl, int chunk, int nchunks, int flags);
 int test_internal(drew_loader_t *ldr, const char *name, const void *functbl);
+int test_latency(drew_loader_t *ldr, const char *name, const char *algo,
+		const void *functbl, int flags);
 const char *test_get_default_algo(drew_loader_t *ldr, const char *name);
 void print_speed_info(int chunk, int nchunks, const struct timespec *cstart,
 		const struct timespec *cend);
+int measure_latency(const char *op, int (*func)(void *), void *arg);
 int print_test_results(int result, char **ids);
 void framework_teardown(void *data);
 void *framework_setup(void);
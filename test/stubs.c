@@ -53,3 +53,13 @@ int test_api(DrewLoader *ldr, const char *name, const char *algo,
 }
 
 #endif
+
+#ifdef STUBS_LATENCY
+
+int test_latency(drew_loader_t *ldr, const char *name, const char *algo,
+		const void *tbl, int flags)
+{
+	return -DREW_ERR_NOT_IMPL;
+}
+
+#endif
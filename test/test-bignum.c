@@ -57,6 +57,7 @@ static inline int test_speed_loop(drew_bignum_t *ctx, uint8_t *buf,
 
 #define STUBS_EXTERNAL 1
 #define STUBS_API 1
+#define STUBS_LATENCY 1
 #include "stubs.c"
 
 int test_speed(drew_loader_t *ldr, const char *name, const char *algo,
@@ -501,3 +501,45 @@ int test_speed(drew_loader_t *ldr, const char *name, const char *algo,
 
 	return 0;
 }
+
+struct setkey_op {
+	drew_block_t ctx;
+	const uint8_t *key;
+	int keysz;
+	int mode;
+};
+
+static int setkey_op(void *arg)
+{
+	struct setkey_op *op = arg;
+
+	return op->ctx.functbl->setkey(&op->ctx, op->key, op->keysz, op->mode);
+}
+
+int test_latency(drew_loader_t *ldr, const char *name, const char *algo,
+		const void *tbl, int flags)
+{
+	struct setkey_op op;
+	uint8_t *key;
+	int res;
+
+	op.keysz = 0;
+	op.keysz = ((const drew_block_functbl_t *)tbl)->info(DREW_BLOCK_KEYSIZE,
+			&op.keysz);
+	if (op.keysz <= 0)
+		return -DREW_ERR_INVALID;
+	if (!(key = calloc(op.keysz, 1)))
+		return -ENOMEM;
+
+	op.ctx.functbl = tbl;
+	op.key = key;
+	op.mode = (flags & FLAG_DECRYPT) ? DREW_BLOCK_MODE_DECRYPT :
+		DREW_BLOCK_MODE_ENCRYPT;
+	if (!(res = op.ctx.functbl->init(&op.ctx, 0, ldr, NULL))) {
+		res = measure_latency("setkey", setkey_op, &op);
+		op.ctx.functbl->fini(&op.ctx, 0);
+	}
+
+	free(key);
+	return res;
+}
@@ -41,6 +41,7 @@ int test_internal(drew_loader_t *ldr, const char *name, const void *tbl)
 
 #define STUBS_EXTERNAL 1
 #define STUBS_API 1
+#define STUBS_LATENCY 1
 #include "stubs.c"
 
 int test_speed(drew_loader_t *ldr, const char *name, const char *algo,
@@ -419,6 +419,30 @@ int test_api(DrewLoader *ldr, const char *name, const char *algo,
 	return retval;
 }
 
+/* Initialize ctx, picking a digest size if the algorithm needs one.  If it
+ * does, param holds the parameter and *used points to it.
+ */
+static int init_context(drew_hash_t *ctx, drew_param_t *param,
+		const drew_param_t **used)
+{
+	int res;
+
+	*used = NULL;
+	if ((res = ctx->functbl->init(ctx, 0, NULL, NULL)) == -DREW_ERR_MORE_INFO) {
+		size_t vals[] = {512, 384, 256, 224, 160, 128};
+		for (int i = 0; i < DIM(vals); i++) {
+			param->name = "digestSize";
+			param->param.number = vals[i] / 8;
+			param->next = NULL;
+			if (!(res = ctx->functbl->init(ctx, 0, NULL, param))) {
+				*used = param;
+				break;
+			}
+		}
+	}
+	return res;
+}
+
 int test_speed(drew_loader_t *ldr, const char *name, const char *algo,
 		const void *tbl, int chunk, int nchunks, int flags)
 {
@@ -426,6 +450,8 @@ int test_speed(drew_loader_t *ldr, const char *name, const char *algo,
 	uint8_t *buf;
 	struct timespec cstart, cend;
 	drew_hash_t ctx;
+	drew_param_t param;
+	const drew_param_t *used;
 	void *fwdata;
 	int (*update)(drew_hash_t *, const uint8_t *, size_t);
 
@@ -441,18 +467,7 @@ int test_speed(drew_loader_t *ldr, const char *name, const char *algo,
 
 	fwdata = framework_setup();
 
-	if ((res = ctx.functbl->init(&ctx, 0, NULL, NULL)) == -DREW_ERR_MORE_INFO) {
-		size_t vals[] = {512, 384, 256, 224, 160, 128};
-		for (int i = 0; i < DIM(vals); i++) {
-			drew_param_t param;
-			param.name = "digestSize";
-			param.param.number = vals[i] / 8;
-			param.next = NULL;
-			if (!(res = ctx.functbl->init(&ctx, 0, NULL, &param)))
-				break;
-		}
-	}
-	if (res)
+	if ((res = init_context(&ctx, &param, &used)))
 		return res;
 
 	hashsize = ctx.functbl->info2(&ctx, DREW_HASH_SIZE_CTX, NULL, NULL);
@@ -470,3 +485,60 @@ int test_speed(drew_loader_t *ldr, const char *name, const char *algo,
 
 	return 0;
 }
+
+struct latency_op {
+	drew_hash_t ctx;
+	const drew_param_t *param;
+	uint8_t buf[64];
+	int hashsize;
+};
+
+static int clone_op(void *arg)
+{
+	struct latency_op *op = arg;
+	drew_hash_t copy;
+	int res;
+
+	if ((res = op->ctx.functbl->clone(&copy, &op->ctx, 0)))
+		return res;
+	return copy.functbl->fini(&copy, 0);
+}
+
+static int hash64_op(void *arg)
+{
+	struct latency_op *op = arg;
+	drew_hash_t ctx;
+	int res;
+
+	ctx.functbl = op->ctx.functbl;
+	if ((res = ctx.functbl->init(&ctx, 0, NULL, op->param)))
+		return res;
+	ctx.functbl->update(&ctx, op->buf, sizeof(op->buf));
+	if ((res = ctx.functbl->final(&ctx, op->buf, op->hashsize, 0)) < 0)
+		return res;
+	return ctx.functbl->fini(&ctx, 0);
+}
+
+int test_latency(drew_loader_t *ldr, const char *name, const char *algo,
+		const void *tbl, int flags)
+{
+	struct latency_op op;
+	drew_param_t param;
+	int res;
+
+	memset(op.buf, 0, sizeof(op.buf));
+	op.ctx.functbl = tbl;
+	if ((res = init_context(&op.ctx, &param, &op.param)))
+		return res;
+	op.hashsize = op.ctx.functbl->info2(&op.ctx, DREW_HASH_SIZE_CTX, NULL,
+			NULL);
+	if (op.hashsize <= 0 || op.hashsize > (int)sizeof(op.buf))
+		return -DREW_ERR_INVALID;
+	op.ctx.functbl->update(&op.ctx, op.buf, sizeof(op.buf));
+
+	if (!(res = measure_latency("clone", clone_op, &op)))
+		res = measure_latency("init+update(64)+final", hash64_op, &op);
+
+	op.ctx.functbl->fini(&op.ctx, 0);
+	return res;
+}
@@ -269,6 +269,7 @@ int test_process_testcase(void *data, int type, const char *item,
 }
 
 #define STUBS_API 1
+#define STUBS_LATENCY 1
 #include "stubs.c"
 
 struct generic {
@@ -119,6 +119,35 @@ char *test_get_id(void *data)
 	return strdup(tc->id);
 }
 
+#define TEST_BATCH 3
+
+// MAC the message several times at once and check each tag.
+static int test_batch(const drew_mac_t *ctx, const struct testcase *tc)
+{
+	const uint8_t *data[TEST_BATCH];
+	size_t len[TEST_BATCH];
+	int tagsz = ctx->functbl->info2(ctx, DREW_MAC_SIZE_CTX, NULL, NULL);
+	uint8_t *buf;
+	int res = 0;
+
+	if (tagsz < (int)tc->maclen)
+		return TEST_INTERNAL_ERR;
+	buf = malloc(tagsz * TEST_BATCH);
+
+	for (size_t i = 0; i < TEST_BATCH; i++) {
+		data[i] = tc->pt;
+		len[i] = tc->len;
+	}
+	if (ctx->functbl->batch(ctx, buf, data, len, TEST_BATCH))
+		res = TEST_FAILED;
+	for (size_t i = 0; !res && i < TEST_BATCH; i++)
+		if (memcmp(buf + i * tagsz, tc->ct, tc->maclen))
+			res = TEST_FAILED;
+
+	free(buf);
+	return res;
+}
+
 int test_execute(void *data, const char *name, const void *tbl,
 		struct test_external *tep)
 {
@@ -168,9 +197,13 @@ int test_execute(void *data, const char *name, const void *tbl,
 	for (size_t i = 0; i < tc->nrepeats; i++)
 		ctx.functbl->update(&ctx, tc->pt, tc->len);
 	ctx.functbl->final(&ctx, buf, 0);
-	ctx.functbl->fini(&ctx, 0);
 	if (memcmp(buf, tc->ct, tc->maclen))
 		res = TEST_FAILED;
+	// Older plugins don't have batch, so check before using it.
+	if (!res && tc->nrepeats == 1 && ctx.functbl->info(DREW_MAC_VERSION,
+				NULL) >= DREW_MAC_ABI_BATCH)
+		res = test_batch(&ctx, tc);
+	ctx.functbl->fini(&ctx, 0);
 
 	free(buf);
 	return res;
@@ -323,3 +356,80 @@ int test_speed(drew_loader_t *ldr, const char *name, const char *algo,
 
 	return 0;
 }
+
+struct latency_op {
+	drew_mac_t ctx;
+	uint8_t buf[64];
+	uint8_t result[512];
+};
+
+static int clone_op(void *arg)
+{
+	struct latency_op *op = arg;
+	drew_mac_t copy;
+	int res;
+
+	if ((res = op->ctx.functbl->clone(&copy, &op->ctx, 0)))
+		return res;
+	return copy.functbl->fini(&copy, 0);
+}
+
+static int mac64_op(void *arg)
+{
+	struct latency_op *op = arg;
+	int res;
+
+	if ((res = op->ctx.functbl->reset(&op->ctx)))
+		return res;
+	op->ctx.functbl->update(&op->ctx, op->buf, sizeof(op->buf));
+	res = op->ctx.functbl->final(&op->ctx, op->result, 0);
+	return res < 0 ? res : 0;
+}
+
+int test_latency(drew_loader_t *ldr, const char *name, const char *algo,
+		const void *tbl, int flags)
+{
+	struct latency_op op;
+	drew_param_t param, bparam;
+	drew_hash_t hash;
+	drew_block_t block;
+	uint8_t key[32];
+	int res = 0;
+
+	if (!algo)
+		algo = test_get_default_algo(ldr, name);
+
+	if ((res = make_new_ctx(ldr, algo, &hash, DREW_TYPE_HASH)) < 0)
+		return res;
+
+	if ((res = make_new_ctx(ldr, test_get_default_block_algo(ldr, name),
+					&block, DREW_TYPE_BLOCK)) < 0)
+		return res;
+
+	param.name = "digest";
+	param.next = &bparam;
+	param.param.value = &hash;
+
+	bparam.name = "cipher";
+	bparam.next = NULL;
+	bparam.param.value = &block;
+
+	hash.functbl->init(&hash, 0, ldr, NULL);
+	block.functbl->init(&block, 0, ldr, NULL);
+
+	memset(key, 0, sizeof(key));
+	memset(op.buf, 0, sizeof(op.buf));
+	op.ctx.functbl = tbl;
+	if (!(res = op.ctx.functbl->init(&op.ctx, 0, ldr, &param))) {
+		if (!(res = op.ctx.functbl->setkey(&op.ctx, key, sizeof(key))) &&
+				!(res = measure_latency("reset+update(64)+final", mac64_op,
+						&op)))
+			res = measure_latency("clone", clone_op, &op);
+		op.ctx.functbl->fini(&op.ctx, 0);
+	}
+
+	hash.functbl->fini(&hash, 0);
+	block.functbl->fini(&block, 0);
+
+	return res;
+}
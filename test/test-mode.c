@@ -123,6 +123,18 @@ char *test_get_id(void *data)
 	return strdup(tc->id);
 }
 
+/* Whether a test for mode applies to the implementation called name.  The
+ * kernel-backed modes are registered as, for example, "CTR-kernel", but use the
+ * same test vectors as the software modes.
+ */
+static bool mode_matches(const char *name, const char *mode)
+{
+	const size_t len = strlen(mode);
+
+	return !strncmp(name, mode, len) &&
+		(!name[len] || !strcmp(name+len, "-kernel"));
+}
+
 static drew_block_t *new_block_cipher(struct test_external *tep,
 		const char *name)
 {
@@ -158,7 +170,7 @@ int test_execute(void *data, const char *name, const void *tbl,
 	// test-block.c.
 	if (!tc->mode)
 		return TEST_CORRUPT;
-	if (strcmp(name, tc->mode))
+	if (!mode_matches(name, tc->mode))
 		return TEST_NOT_FOR_US;
 	if (!tc->pt || !tc->ct)
 		return TEST_CORRUPT;
@@ -191,7 +203,12 @@ int test_execute(void *data, const char *name, const void *tbl,
 	}
 	for (int i = 0; i <= use_fast; i++) {
 		uint8_t *buffer = i ? buf2 : buf;
-		ctx.functbl->setblock(&ctx, bctx);
+		// Kernel-backed modes can't use every block cipher implementation.
+		if (ctx.functbl->setblock(&ctx, bctx) == -DREW_ERR_NOT_IMPL) {
+			ctx.functbl->fini(&ctx, 0);
+			result = TEST_NOT_FOR_US;
+			goto out;
+		}
 		ctx.functbl->setiv(&ctx, tc->nonce, tc->nlen);
 		if (tc->aadlen)
 			ctx.functbl->setdata(&ctx, tc->aad, tc->aadlen);
@@ -349,8 +366,19 @@ int test_speed(drew_loader_t *ldr, const char *name, const char *algo,
 	ftbl->init(&bctx, 0, NULL, NULL);
 	ftbl->setkey(&bctx, key, keysz, 0);
 	mctx.functbl->init(&mctx, 0, ldr, NULL);
-	mctx.functbl->setblock(&mctx, &bctx);
-	mctx.functbl->setiv(&mctx, buf2, blksz);
+	if (mctx.functbl->setblock(&mctx, &bctx)) {
+		mctx.functbl->fini(&mctx, 0);
+		ftbl->fini(&bctx, 0);
+		free(buf);
+		free(buf2);
+		free(key);
+		return ENOTSUP;
+	}
+	// OCB only takes nonces shorter than the block.
+	if (mctx.functbl->setiv(&mctx, buf2, blksz))
+		mctx.functbl->setiv(&mctx, buf2, blksz - 1);
+	// XTS takes its tweak key here; other modes ignore it or treat it as data.
+	mctx.functbl->setdata(&mctx, key, keysz);
 	encrypt = flags & FLAG_DECRYPT ?
 		((chunk & 15) ? mctx.functbl->decrypt : mctx.functbl->decryptfast) :
 		((chunk & 15) ? mctx.functbl->encrypt : mctx.functbl->encryptfast);
@@ -493,3 +521,90 @@ int test_api(DrewLoader *ldr, const char *name, const char *algo,
 
 	return retval;
 }
+
+struct latency_op {
+	drew_mode_t mctx;
+	drew_block_t bctx;
+	DrewLoader *ldr;
+	uint8_t iv[32];
+	int blksz;
+};
+
+static int set_up_mode(struct latency_op *op, drew_mode_t *mctx)
+{
+	int res;
+
+	if ((res = mctx->functbl->init(mctx, 0, op->ldr, NULL)))
+		return res;
+	if ((res = mctx->functbl->setblock(mctx, &op->bctx)))
+		return res;
+	// OCB only takes nonces shorter than the block.
+	if (mctx->functbl->setiv(mctx, op->iv, op->blksz))
+		return mctx->functbl->setiv(mctx, op->iv, op->blksz - 1);
+	return 0;
+}
+
+static int setup_op(void *arg)
+{
+	struct latency_op *op = arg;
+	drew_mode_t mctx;
+	int res;
+
+	mctx.functbl = op->mctx.functbl;
+	if ((res = set_up_mode(op, &mctx)))
+		return res;
+	return mctx.functbl->fini(&mctx, 0);
+}
+
+static int clone_op(void *arg)
+{
+	struct latency_op *op = arg;
+	drew_mode_t copy;
+	int res;
+
+	if ((res = op->mctx.functbl->clone(&copy, &op->mctx, 0)))
+		return res;
+	return copy.functbl->fini(&copy, 0);
+}
+
+int test_latency(drew_loader_t *ldr, const char *name, const char *algo,
+		const void *tbl, int flags)
+{
+	struct latency_op op;
+	const void *p;
+	uint8_t *key;
+	int id, keysz = 0, res;
+
+	if (!algo)
+		algo = test_get_default_algo(ldr, name);
+
+	if ((id = drew_loader_lookup_by_name(ldr, algo, 0, -1)) < 0)
+		return id;
+	drew_loader_get_functbl(ldr, id, &p);
+	op.bctx.functbl = p;
+
+	op.blksz = op.bctx.functbl->info(DREW_BLOCK_BLKSIZE, NULL);
+	keysz = op.bctx.functbl->info(DREW_BLOCK_KEYSIZE, &keysz);
+	if (op.blksz <= 0 || op.blksz > (int)sizeof(op.iv) || keysz <= 0)
+		return -DREW_ERR_INVALID;
+	if (!(key = calloc(keysz, 1)))
+		return -ENOMEM;
+
+	memset(op.iv, 0, sizeof(op.iv));
+	op.ldr = ldr;
+	op.mctx.functbl = tbl;
+	op.bctx.functbl->init(&op.bctx, 0, NULL, NULL);
+	op.bctx.functbl->setkey(&op.bctx, key, keysz, 0);
+	if (!(res = set_up_mode(&op, &op.mctx))) {
+		// XTS takes its tweak key here; other modes ignore it or treat it as
+		// data.
+		op.mctx.functbl->setdata(&op.mctx, key, keysz);
+		if (!(res = measure_latency("init+setblock+setiv", setup_op, &op)))
+			res = measure_latency("clone", clone_op, &op);
+		op.mctx.functbl->fini(&op.mctx, 0);
+	}
+	op.bctx.functbl->fini(&op.bctx, 0);
+
+	free(key);
+	return res;
+}
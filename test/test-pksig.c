@@ -17,6 +17,7 @@
 
 #include <drew/plugin.h>
 #include <drew/pksig.h>
+#include <drew/prng.h>
 
 #define FILENAME "test/vectors-pksig"
 
@@ -85,6 +86,7 @@ void *test_clone_data(void *tc, int flags)
 
 	q->id = NULL;
 	q->algo = strdup(p->algo);
+	memcpy(q->keysize, p->keysize, sizeof(q->keysize));
 	memcpy(q->insize, p->insize, sizeof(q->insize));
 	memcpy(q->outsize, p->outsize, sizeof(q->outsize));
 	for (int i = 0; i < 256; i++) {
@@ -136,6 +138,108 @@ int make_bignum(drew_bignum_t *bn, const uint8_t *data, size_t len,
 	return 0;
 }
 
+/* Initialize ctx and load the key from tc into it.  bn is the bignum to use. */
+static int make_context(drew_pksig_t *ctx, const void *tbl,
+		const struct testcase *tc, drew_bignum_t *bn, struct test_external *tep)
+{
+	drew_param_t ctxparam;
+	int res;
+
+	if ((res = make_bignum(bn, NULL, 0, tep)))
+		return res;
+	ctxparam.name = "bignum";
+	ctxparam.next = NULL;
+	ctxparam.param.value = bn;
+	ctx->functbl = tbl;
+	if ((res = ctx->functbl->init(ctx, 0, tep->ldr, &ctxparam)))
+		return res;
+	for (int i = 0; i < 256; i++) {
+		char buf[2] = {0, 0};
+		buf[0] = i;
+		if (tc->key[i])
+			if ((res = ctx->functbl->setval(ctx, buf, tc->key[i],
+							tc->keysize[i])) < 0)
+				return res;
+	}
+	return 0;
+}
+
+/* Set up the inputs of a signing operation (or a verification operation, if
+ * verify is set) from tc, along with the expected outputs and bignums to hold
+ * the actual outputs.  For verification, a value that is an output when signing
+ * is an input, and vice versa.
+ */
+static int make_values(const drew_pksig_t *ctx, const struct testcase *tc,
+		bool verify, drew_bignum_t *in, drew_bignum_t *expected,
+		drew_bignum_t *out, int *noutp, struct test_external *tep)
+{
+	const int nin = ctx->functbl->info(verify ? DREW_PKSIG_VERIFY_IN :
+			DREW_PKSIG_SIGN_IN, NULL);
+	const int nout = ctx->functbl->info(verify ? DREW_PKSIG_VERIFY_OUT :
+			DREW_PKSIG_SIGN_OUT, NULL);
+	int res;
+
+	for (int i = 0; i < nin; i++) {
+		drew_param_t param;
+		int c;
+		param.param.number = i;
+		if ((res = ctx->functbl->info(verify ?
+						DREW_PKSIG_VERIFY_IN_INDEX_TO_NAME :
+						DREW_PKSIG_SIGN_IN_INDEX_TO_NAME, &param)))
+			return res;
+		c = param.param.string[0];
+		if (verify && tc->out[c])
+			res = make_bignum(&in[i], tc->out[c], tc->outsize[c], tep);
+		else
+			res = make_bignum(&in[i], tc->in[c], tc->insize[c], tep);
+		if (res)
+			return res;
+	}
+	for (int i = 0; i < nout; i++) {
+		drew_param_t param;
+		int c;
+		param.param.number = i;
+		if ((res = ctx->functbl->info(verify ?
+						DREW_PKSIG_VERIFY_OUT_INDEX_TO_NAME :
+						DREW_PKSIG_SIGN_OUT_INDEX_TO_NAME, &param)))
+			return res;
+		c = param.param.string[0];
+		if (verify && tc->in[c])
+			res = make_bignum(&expected[i], tc->in[c], tc->insize[c], tep);
+		else
+			res = make_bignum(&expected[i], tc->out[c], tc->outsize[c], tep);
+		if (res)
+			return res;
+		if ((res = make_bignum(&out[i], NULL, 0, tep)))
+			return res;
+	}
+	*noutp = nout;
+	return 0;
+}
+
+/* Run the operation set up by make_values again as a batch of one through
+ * signbatch (or verifybatch, if verify is set) and check that it gives the same
+ * outputs.
+ */
+static int test_batch(const drew_pksig_t *ctx, bool verify, drew_bignum_t *in,
+		const drew_bignum_t *expected, drew_bignum_t *out, int nout)
+{
+	int res, bres;
+
+	for (int i = 0; i < nout; i++)
+		out[i].functbl->setzero(&out[i]);
+	res = verify ? ctx->functbl->verifybatch(ctx, out, in, &bres, 1, NULL) :
+		ctx->functbl->signbatch(ctx, out, in, &bres, 1, NULL);
+	if (res)
+		return res < 0 ? res : TEST_FAILED;
+	if (bres < 0)
+		return bres;
+	for (int i = 0; i < nout; i++)
+		if (expected[i].functbl->compare(&expected[i], &out[i], 0))
+			return TEST_FAILED;
+	return 0;
+}
+
 int test_execute(void *data, const char *name, const void *tbl,
 		struct test_external *tep)
 {
@@ -152,109 +256,42 @@ int test_execute(void *data, const char *name, const void *tbl,
 
 	drew_pksig_t ctx;
 	drew_bignum_t bn;
-	drew_param_t ctxparam;
-	int nin, nout;
+	int nout;
 	drew_bignum_t *inbuf = malloc(256 * sizeof(*inbuf));
 	drew_bignum_t *outbuf = malloc(256 * sizeof(*outbuf));
 	drew_bignum_t *cmpbuf = malloc(256 * sizeof(*cmpbuf));
 
-	make_bignum(&bn, NULL, 0, tep);
-	ctxparam.name = "bignum";
-	ctxparam.next = NULL;
-	ctxparam.param.value = &bn;
-	ctx.functbl = tbl;
-	if ((result = ctx.functbl->init(&ctx, 0, tep->ldr, &ctxparam)))
+	if ((result = make_context(&ctx, tbl, tc, &bn, tep)))
 		return result;
-	for (int i = 0; i < 256; i++) {
-		char buf[2] = {0, 0};
-		buf[0] = i;
-		if (tc->key[i])
-			if ((res = ctx.functbl->setval(&ctx, buf, tc->key[i], tc->keysize[i])) < 0)
-				return res;
-	}
 	if (!(tc->flags & 1)) {
-		nin = ctx.functbl->info(DREW_PKSIG_SIGN_IN, NULL);
-		nout = ctx.functbl->info(DREW_PKSIG_SIGN_OUT, NULL);
-		for (int i = 0; i < nin; i++) {
-			drew_param_t param;
-			int c;
-			param.param.number = i;
-			if ((result = ctx.functbl->info(DREW_PKSIG_SIGN_IN_INDEX_TO_NAME,
-							&param)))
-				return result;
-			c = param.param.string[0];
-			if ((res = make_bignum(&inbuf[i], tc->in[c], tc->insize[c], tep)))
-				return res;
-		}
-		for (int i = 0; i < nout; i++) {
-			drew_param_t param;
-			int c;
-			param.param.number = i;
-			if ((result = ctx.functbl->info(DREW_PKSIG_SIGN_OUT_INDEX_TO_NAME,
-							&param)))
-				return result;
-			c = param.param.string[0];
-			if ((result = make_bignum(&outbuf[i], tc->out[c], tc->outsize[c], tep)))
-				return result;
-			if ((result = make_bignum(&cmpbuf[i], NULL, 0, tep)))
-				return result;
-		}
+		if ((res = make_values(&ctx, tc, false, inbuf, outbuf, cmpbuf, &nout,
+						tep)))
+			return res;
 		if ((res = ctx.functbl->sign(&ctx, cmpbuf, inbuf)) < 0)
 			return res;
 		for (int i = 0; i < nout; i++)
 			if (outbuf[i].functbl->compare(&outbuf[i], &cmpbuf[i], 0))
 				return TEST_FAILED;
+		if (ctx.functbl->info(DREW_PKSIG_VERSION, NULL) >=
+				DREW_PKSIG_ABI_SIGNBATCH &&
+				(res = test_batch(&ctx, false, inbuf, outbuf,
+						cmpbuf, nout)))
+			return res;
 	}
 	if (!(tc->flags & 2)) {
-		nin = ctx.functbl->info(DREW_PKSIG_VERIFY_IN, NULL);
-		nout = ctx.functbl->info(DREW_PKSIG_VERIFY_OUT, NULL);
-		for (int i = 0; i < nin; i++) {
-			drew_param_t param;
-			int c;
-			const uint8_t *p;
-			size_t len;
-			param.param.number = i;
-			if ((result = ctx.functbl->info(DREW_PKSIG_VERIFY_IN_INDEX_TO_NAME,
-							&param)))
-				return result;
-			c = param.param.string[0];
-			if (tc->out[c]) {
-				p = tc->out[c];
-				len = tc->outsize[c];
-			}
-			else {
-				p = tc->in[c];
-				len = tc->insize[c];
-			}
-			if ((result = make_bignum(&inbuf[i], p, len, tep)))
-				return result;
-		}
-		for (int i = 0; i < nout; i++) {
-			drew_param_t param;
-			int c;
-			const uint8_t *p;
-			size_t len;
-			param.param.number = i;
-			if ((result = ctx.functbl->info(DREW_PKSIG_VERIFY_OUT_INDEX_TO_NAME,
-							&param)))
-				return result;
-			c = param.param.string[0];
-			if (tc->in[c]) {
-				p = tc->in[c];
-				len = tc->insize[c];
-			}
-			else {
-				p = tc->out[c];
-				len = tc->outsize[c];
-			}
-			if ((result = make_bignum(&outbuf[i], p, len, tep)))
-				return result;
-		}
+		if ((res = make_values(&ctx, tc, true, inbuf, outbuf, cmpbuf, &nout,
+						tep)))
+			return res;
 		if ((res = ctx.functbl->verify(&ctx, cmpbuf, inbuf)) < 0)
 			return res;
 		for (int i = 0; i < nout; i++)
 			if (outbuf[i].functbl->compare(&outbuf[i], &cmpbuf[i], 0))
 				return TEST_FAILED;
+		if (ctx.functbl->info(DREW_PKSIG_VERSION, NULL) >=
+				DREW_PKSIG_ABI_VERIFYBATCH &&
+				(res = test_batch(&ctx, true, inbuf, outbuf,
+						cmpbuf, nout)))
+			return res;
 	}
 	ctx.functbl->fini(&ctx, 0);
 
@@ -279,6 +316,14 @@ int test_process_testcase(void *data, int type, const char *item,
 				return TEST_EXECUTE;
 			break;
 		case 'a':
+			// A new algorithm needs a new key.
+			if (tc->algo && strcmp(tc->algo, item)) {
+				for (int i = 0; i < 256; i++) {
+					free(tc->key[i]);
+					tc->key[i] = NULL;
+					tc->keysize[i] = 0;
+				}
+			}
 			free(tc->algo);
 			tc->algo = strdup(item);
 			break;
@@ -316,3 +361,155 @@ int test_speed(drew_loader_t *ldr, const char *name, const char *algo,
 {
 	return -DREW_ERR_NOT_IMPL;
 }
+
+struct latency_op {
+	drew_pksig_t ctx;
+	drew_bignum_t *in;
+	drew_bignum_t *out;
+};
+
+static int sign_op(void *arg)
+{
+	struct latency_op *op = arg;
+	int res = op->ctx.functbl->sign(&op->ctx, op->out, op->in);
+
+	return res < 0 ? res : 0;
+}
+
+static int verify_op(void *arg)
+{
+	struct latency_op *op = arg;
+	int res = op->ctx.functbl->verify(&op->ctx, op->out, op->in);
+
+	return res < 0 ? res : 0;
+}
+
+struct keygen_op {
+	drew_pksig_t *ctx;
+	drew_param_t param[3];
+};
+
+static int generate_op(void *arg)
+{
+	struct keygen_op *op = arg;
+
+	return op->ctx->functbl->generate(op->ctx, op->param);
+}
+
+static const size_t keygen_bits[] = {2048, 4096};
+
+/* Time key generation, if the algorithm has it, with each size in keygen_bits,
+ * both on one thread and with two.  Key generation needs a PRNG, so this is
+ * skipped if DevURandom isn't available.
+ */
+static int keygen_latency(drew_loader_t *ldr, drew_pksig_t *ctx)
+{
+	struct keygen_op op;
+	drew_prng_t prng;
+	const void *tbl;
+	char label[64];
+	int id, res;
+
+	if ((id = drew_loader_lookup_by_name(ldr, "DevURandom", 0, -1)) < 0)
+		return 0;
+	if ((res = drew_loader_get_functbl(ldr, id, &tbl)) < 0)
+		return res;
+	prng.functbl = tbl;
+	if ((res = prng.functbl->init(&prng, 0, ldr, NULL)))
+		return res;
+
+	op.ctx = ctx;
+	op.param[0].name = "prng";
+	op.param[0].param.value = &prng;
+	op.param[0].next = &op.param[1];
+	op.param[1].name = "bits";
+	op.param[1].next = &op.param[2];
+	op.param[2].name = "threads";
+	op.param[2].next = NULL;
+	for (size_t i = 0; i < DIM(keygen_bits); i++) {
+		for (size_t threads = 1; threads <= 2; threads++) {
+			op.param[1].param.number = keygen_bits[i];
+			op.param[2].param.number = threads;
+			if ((res = generate_op(&op)) == -DREW_ERR_NOT_IMPL) {
+				res = 0;
+				goto out;
+			}
+			if (res)
+				goto out;
+			snprintf(label, sizeof(label), "generate %zu (%zu %s)",
+					keygen_bits[i], threads,
+					threads > 1 ? "threads" : "thread");
+			if ((res = measure_latency(label, generate_op, &op)))
+				goto out;
+		}
+	}
+out:
+	prng.functbl->fini(&prng, 0);
+	return res;
+}
+
+static size_t key_size(const struct testcase *tc)
+{
+	size_t total = 0;
+
+	for (int i = 0; i < 256; i++)
+		total += tc->keysize[i];
+	return total;
+}
+
+/* Time signing and verification with the largest key for this algorithm in the
+ * test vectors, and then key generation.
+ */
+int test_latency(drew_loader_t *ldr, const char *name, const char *algo,
+		const void *tbl, int flags)
+{
+	struct test_external tes;
+	struct testcase *tc = NULL;
+	struct latency_op op;
+	drew_bignum_t bn;
+	drew_bignum_t *inbuf = NULL, *outbuf = NULL, *cmpbuf = NULL;
+	int nout, res;
+
+	if ((res = test_external_parse(ldr, NULL, &tes)))
+		goto out;
+
+	for (size_t i = 0; i < tes.ndata && tes.data[i]; i++) {
+		struct testcase *p = tes.data[i];
+		if (p->algo && !strcmp(p->algo, name) &&
+				(!tc || key_size(p) > key_size(tc)))
+			tc = p;
+	}
+	if (!tc) {
+		res = -DREW_ERR_NOT_IMPL;
+		goto out;
+	}
+
+	inbuf = malloc(256 * sizeof(*inbuf));
+	outbuf = malloc(256 * sizeof(*outbuf));
+	cmpbuf = malloc(256 * sizeof(*cmpbuf));
+	if (!inbuf || !outbuf || !cmpbuf) {
+		res = -ENOMEM;
+		goto out;
+	}
+
+	if ((res = make_context(&op.ctx, tbl, tc, &bn, &tes)))
+		goto out;
+	op.in = inbuf;
+	op.out = cmpbuf;
+	if (!(tc->flags & 1) && !(res = make_values(&op.ctx, tc, false, inbuf,
+					outbuf, cmpbuf, &nout, &tes)))
+		res = measure_latency("sign", sign_op, &op);
+	if (!res && !(tc->flags & 2) && !(res = make_values(&op.ctx, tc, true,
+					inbuf, outbuf, cmpbuf, &nout, &tes)))
+		res = measure_latency("verify", verify_op, &op);
+	if (!res)
+		res = keygen_latency(ldr, &op.ctx);
+	op.ctx.functbl->fini(&op.ctx, 0);
+
+out:
+	free(inbuf);
+	free(outbuf);
+	free(cmpbuf);
+	test_external_cleanup(&tes);
+	return res;
+}
@@ -147,6 +147,7 @@ int test_external_cleanup(struct test_external *tes)
 }
 
 #define STUBS_API 1
+#define STUBS_LATENCY 1
 #include "stubs.c"
 
 int test_speed(drew_loader_t *ldr, const char *name, const char *algo,
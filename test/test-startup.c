@@ -0,0 +1,199 @@
+/*-
+ * brian m. carlson <sandals@crustytoothpaste.net> wrote this source code.
+ * This source code is in the public domain; you may do whatever you please with
+ * it.  However, a credit in the documentation, although not required, would be
+ * appreciated.
+ */
+/* Measure how long it takes to set up a loader, load the given plugins, and
+ * get the functbl for one algorithm, which is roughly what a short-lived
+ * program does on startup.  This is done both with and without any manifest in
+ * the plugin directory so the two can be compared.
+ *
+ * With -m, check instead that plugins listed in a manifest are registered from
+ * the manifest alone.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <drew/plugin.h>
+
+#define NITERS 100
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int start_up(char **plugins, int nplugins, const char *dir,
+		const char *algo)
+{
+	DrewLoader *ldr;
+	const void *tbl;
+	int id, res = 0;
+
+	if (!(ldr = drew_loader_new()))
+		return -1;
+	for (int i = 0; i < nplugins; i++)
+		if ((res = drew_loader_load_plugin(ldr, plugins[i], dir)) < 0)
+			goto out;
+	if (algo) {
+		if ((id = drew_loader_lookup_by_name(ldr, algo, 0, -1)) < 0) {
+			res = id;
+			goto out;
+		}
+		if ((res = drew_loader_get_functbl(ldr, id, &tbl)) < 0)
+			goto out;
+	}
+	res = 0;
+out:
+	drew_loader_unref(ldr);
+	return res;
+}
+
+static int run(const char *label, char **plugins, int nplugins,
+		const char *dir, const char *algo, int niters)
+{
+	double total = 0.0, min = 0.0;
+	int res;
+
+	// Once to get everything into the page cache.
+	if ((res = start_up(plugins, nplugins, dir, algo))) {
+		fprintf(stderr, "%s: error %d\n", label, -res);
+		return 1;
+	}
+	for (int i = 0; i < niters; i++) {
+		double start = now(), t;
+
+		start_up(plugins, nplugins, dir, algo);
+		t = now() - start;
+		total += t;
+		if (!i || t < min)
+			min = t;
+	}
+	printf("%-12s: %d plugins, %d iterations: mean %.1f us, min %.1f us\n",
+			label, nplugins, niters, total / niters * 1e6, min * 1e6);
+	return 0;
+}
+
+/* Write a manifest listing nentries plugins in a library which isn't really a
+ * library, with an entry for another library before the middle one, and load
+ * it.  This only works if every entry is taken from the manifest, since the
+ * library can't be opened.
+ */
+static int check_manifest(int nentries)
+{
+	char dir[] = "/tmp/drew-manifest-XXXXXX", path[64], name[16];
+	DrewLoader *ldr = NULL;
+	FILE *fp;
+	int offset, res = 1;
+
+	if (!mkdtemp(dir))
+		return 1;
+	snprintf(path, sizeof(path), "%s/fake.so", dir);
+	if (!(fp = fopen(path, "w")))
+		goto out;
+	fputs("not a library\n", fp);
+	fclose(fp);
+	// The library must not be newer than the manifest.
+	snprintf(path, sizeof(path), "%s/manifest", dir);
+	if (!(fp = fopen(path, "w")))
+		goto out;
+	fputs("# Plugin manifest for libdrew.\n", fp);
+	for (int i = 0; i < nentries; i++) {
+		if (i == nentries / 2)
+			fprintf(fp, "other.so\t0\t%d\tOther\n", DREW_TYPE_HASH);
+		fprintf(fp, "fake.so\t%d\t%d\tFake-%d\n", i, DREW_TYPE_HASH, i);
+	}
+	fclose(fp);
+
+	if (!(ldr = drew_loader_new()))
+		goto out;
+	if ((offset = drew_loader_load_plugin(ldr, "fake.so", dir)) < 0) {
+		fprintf(stderr, "manifest (%d entries): load failed: error %d\n",
+				nentries, -offset);
+		goto out;
+	}
+	if (drew_loader_get_nplugins(ldr, offset) != nentries)
+		goto out;
+	for (int i = 0; i < nentries; i++) {
+		snprintf(name, sizeof(name), "Fake-%d", i);
+		if (drew_loader_lookup_by_name(ldr, name, 0, -1) != offset + i)
+			goto out;
+		if (drew_loader_get_type(ldr, offset + i) != DREW_TYPE_HASH)
+			goto out;
+	}
+	if (drew_loader_lookup_by_name(ldr, "Other", 0, -1) >= 0)
+		goto out;
+	// Only now is the library opened, which fails.
+	if (drew_loader_get_functbl(ldr, offset, NULL) >= 0)
+		goto out;
+	res = 0;
+out:
+	if (ldr)
+		drew_loader_unref(ldr);
+	if (res)
+		fprintf(stderr, "manifest (%d entries): failed\n", nentries);
+	snprintf(path, sizeof(path), "%s/manifest", dir);
+	unlink(path);
+	snprintf(path, sizeof(path), "%s/fake.so", dir);
+	unlink(path);
+	rmdir(dir);
+	return res;
+}
+
+int usage(const char *argv0, int retval)
+{
+	FILE *fp = retval ? stderr : stdout;
+	fprintf(fp, "usage:\n%s [-h] [-a algo] [-d dir] [-n num] plugin...\n"
+			"%s -m\n", argv0, argv0);
+	fprintf(fp,
+			"\t-h\t: print this help message\n"
+			"\t-a algo\t: also look up algo and get its functbl\n"
+			"\t-d dir\t: load plugins from dir instead of the search path\n"
+			"\t-n num\t: start up num times\n"
+			"\t-m\t: check loading plugins from a manifest\n");
+	return retval;
+}
+
+int main(int argc, char **argv)
+{
+	const char *algo = NULL, *dir = NULL;
+	int niters = NITERS, opt, error = 0;
+
+	while ((opt = getopt(argc, argv, "ha:d:n:m")) != -1) {
+		switch (opt) {
+			case 'h':
+				return usage(argv[0], 0);
+			case 'a':
+				algo = optarg;
+				break;
+			case 'd':
+				dir = optarg;
+				break;
+			case 'n':
+				niters = atoi(optarg);
+				break;
+			case 'm':
+				return check_manifest(1) | check_manifest(3);
+			default:
+				return usage(argv[0], 2);
+		}
+	}
+	if (optind == argc || niters <= 0)
+		return usage(argv[0], 2);
+
+	setenv("DREW_LOADER_NO_MANIFEST", "1", 1);
+	error |= run("no manifest", argv + optind, argc - optind, dir, algo,
+			niters);
+	unsetenv("DREW_LOADER_NO_MANIFEST");
+	error |= run("manifest", argv + optind, argc - optind, dir, algo, niters);
+	return error;
+}
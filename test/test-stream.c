@@ -281,3 +281,43 @@ int test_speed(drew_loader_t *ldr, const char *name, const char *algo,
 
 	return 0;
 }
+
+struct setkey_op {
+	drew_stream_t ctx;
+	const uint8_t *key;
+	int keysz;
+};
+
+static int setkey_op(void *arg)
+{
+	struct setkey_op *op = arg;
+
+	return op->ctx.functbl->setkey(&op->ctx, op->key, op->keysz,
+			DREW_STREAM_MODE_ENCRYPT);
+}
+
+int test_latency(drew_loader_t *ldr, const char *name, const char *algo,
+		const void *tbl, int flags)
+{
+	struct setkey_op op;
+	uint8_t *key;
+	int res;
+
+	op.keysz = 0;
+	op.keysz = ((const drew_stream_functbl_t *)tbl)->info(DREW_STREAM_KEYSIZE,
+			&op.keysz);
+	if (op.keysz <= 0)
+		return -DREW_ERR_INVALID;
+	if (!(key = calloc(op.keysz, 1)))
+		return -ENOMEM;
+
+	op.ctx.functbl = tbl;
+	op.key = key;
+	if (!(res = op.ctx.functbl->init(&op.ctx, 0, ldr, NULL))) {
+		res = measure_latency("setkey", setkey_op, &op);
+		op.ctx.functbl->fini(&op.ctx, 0);
+	}
+
+	free(key);
+	return res;
+}
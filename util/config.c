@@ -1,5 +1,6 @@
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <popt.h>
 
@@ -10,13 +11,20 @@
 #define TYPE_VERSION 1
 #define TYPE_PATHS 2
 #define TYPE_MODULES 4
+#define TYPE_MANIFEST 8
 
 #define DIM(x) (sizeof(x)/sizeof((x)[0]))
 
+const char *directory = NULL;
+
 const struct poptOption options[] = {
 	{ "version", 'v', 0, 0, TYPE_VERSION, "list version of libdrew" },
 	{ "paths", 'p', 0, 0, TYPE_PATHS, "list library search paths" },
 	{ "modules", 'm', 0, 0, TYPE_MODULES, "list modules" },
+	{ "manifest", 'M', 0, 0, TYPE_MANIFEST,
+		"write a manifest for the plugins given" },
+	{ "directory", 'd', POPT_ARG_STRING, &directory, 0,
+		"load plugins from DIR instead of the search path", "DIR" },
 	POPT_AUTOHELP
 	POPT_TABLEEND
 };
@@ -39,7 +47,9 @@ const char *algo_types[] = {
 int main(int argc, const char **argv)
 {
 	const char *p, *arg = NULL;
-	int ver, c;
+	const char **args;
+	int *ids;
+	int ver, c, nargs = 0;
 	int type = TYPE_DEFAULT;
 	poptContext ctx;
 	drew_loader_t *ldr;
@@ -49,12 +59,17 @@ int main(int argc, const char **argv)
 	while ((c = poptGetNextOpt(ctx)) >= 0)
 		type |= c;
 
+	args = calloc(argc, sizeof(*args));
+	ids = calloc(argc, sizeof(*ids));
+	if (!args || !ids)
+		return 2;
+
 	ldr = drew_loader_new();
 	drew_loader_load_plugin(ldr, NULL, NULL);
-	while ((arg = poptGetArg(ctx)))
-		drew_loader_load_plugin(ldr, arg, NULL);
-
-	poptFreeContext(ctx);
+	while ((arg = poptGetArg(ctx))) {
+		args[nargs] = arg;
+		ids[nargs++] = drew_loader_load_plugin(ldr, arg, directory);
+	}
 
 	if (!type) {
 		ver = drew_get_version(0, &p, NULL);
@@ -87,6 +102,30 @@ int main(int argc, const char **argv)
 					ft->info(DREW_HASH_VERSION, NULL));
 		}
 	}
+	if (type & TYPE_MANIFEST) {
+		// See get_manifest in lib/libdrew/drew.c for the format.
+		printf("# Plugin manifest for libdrew.  Generated by drew-config.\n");
+		for (int i = 0; i < nargs; i++) {
+			int n = ids[i] < 0 ? 0 : drew_loader_get_nplugins(ldr, ids[i]);
+
+			if (ids[i] < 0)
+				fprintf(stderr, "drew-config: can't load %s: error %d\n",
+						args[i], -ids[i]);
+			for (int j = 0; j < n; j++) {
+				const void *tbl;
+				int t = drew_loader_get_type(ldr, ids[i] + j);
+
+				// Make sure the plugin can actually be loaded.
+				if (t < 0 || drew_loader_get_functbl(ldr, ids[i] + j, &tbl) < 0)
+					break;
+				drew_loader_get_algo_name(ldr, ids[i] + j, &p);
+				printf("%s\t%d\t%d\t%s\n", args[i], j, t, p);
+			}
+		}
+	}
+	poptFreeContext(ctx);
+	free(args);
+	free(ids);
 	drew_loader_unref(ldr);
 	return 0;
 }